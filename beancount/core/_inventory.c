@@ -0,0 +1,491 @@
+/* A native base class for inventories.
+ *
+ * Inventory is a dict of (currency, cost) to Position instances. The methods
+ * which add positions to it are called for every posting when booking,
+ * realizing and checking balances, so they are implemented here, along with
+ * the constructor; the other methods of beancount.core.inventory.Inventory
+ * remain in Python. The dict itself is the table of lots, and the numbers of
+ * units remain Decimal instances, so that the arithmetic is exactly that of
+ * the Python implementation.
+ *
+ * The Amount and Position instances are created directly, without going
+ * through the Python constructors of these named tuples, as _store.c does.
+ */
+
+#define PY_SSIZE_T_CLEAN
+
+#include <Python.h>
+
+
+/* Module-level constants. */
+static PyTypeObject* amount_type = NULL;
+static PyTypeObject* position_type = NULL;
+static PyTypeObject* cost_type = NULL;
+static PyObject* zero = NULL;
+static PyObject* units_name = NULL;
+static PyObject* cost_name = NULL;
+static PyObject* number_name = NULL;
+
+/* The values of beancount.core.inventory.Booking, which are imported on first
+ * use, as that module is the one which imports this one. */
+enum { BOOKING_CREATED, BOOKING_REDUCED, BOOKING_AUGMENTED, BOOKING_IGNORED };
+static const char* booking_names[] = { "CREATED", "REDUCED", "AUGMENTED", "IGNORED" };
+static PyObject* booking_values[4] = { NULL, NULL, NULL, NULL };
+
+
+/* Get a value of Booking. Returns a borrowed reference. */
+static PyObject* get_booking(int booking)
+{
+    if ( booking_values[booking] == NULL ) {
+        PyObject* module = PyImport_ImportModule("beancount.core.inventory");
+        PyObject* booking_enum;
+        int i;
+        if ( module == NULL ) {
+            return NULL;
+        }
+        booking_enum = PyObject_GetAttrString(module, "Booking");
+        Py_DECREF(module);
+        if ( booking_enum == NULL ) {
+            return NULL;
+        }
+        for ( i = 0; i < 4; i++ ) {
+            PyObject* value = PyObject_GetAttrString(booking_enum, booking_names[i]);
+            if ( value == NULL ) {
+                Py_DECREF(booking_enum);
+                return NULL;
+            }
+            Py_XSETREF(booking_values[i], value);
+        }
+        Py_DECREF(booking_enum);
+    }
+    return booking_values[booking];
+}
+
+/* Get a field of a named tuple, by index if it is of the expected type, or by
+ * name otherwise. Returns a new reference. */
+static PyObject* get_field(PyObject* object, PyTypeObject* type,
+                           Py_ssize_t index, PyObject* name)
+{
+    if ( PyObject_TypeCheck(object, type) ) {
+        PyObject* field = PyTuple_GET_ITEM(object, index);
+        Py_INCREF(field);
+        return field;
+    }
+    return PyObject_GetAttr(object, name);
+}
+
+/* Create a pair of a named tuple type. */
+static PyObject* new_pair(PyTypeObject* type, PyObject* first, PyObject* second)
+{
+    PyObject* pair = type->tp_alloc(type, 2);
+    if ( pair == NULL ) {
+        return NULL;
+    }
+    Py_INCREF(first);
+    PyTuple_SET_ITEM(pair, 0, first);
+    Py_INCREF(second);
+    PyTuple_SET_ITEM(pair, 1, second);
+    return pair;
+}
+
+/* Add units at cost to an inventory. Returns the (position, booking) pair
+ * returned by Inventory.add_amount(). */
+static PyObject* add_amount(PyObject* self, PyObject* units, PyObject* cost)
+{
+    PyObject* number = NULL;
+    PyObject* currency = NULL;
+    PyObject* key = NULL;
+    PyObject* position = NULL;
+    PyObject* new_position = NULL;
+    PyObject* result = NULL;
+    int booking;
+
+    if ( !PyObject_TypeCheck(units, amount_type) ) {
+        PyErr_Format(PyExc_AssertionError, "Internal error: %R (type: %s)",
+                     units, Py_TYPE(units)->tp_name);
+        return NULL;
+    }
+    if ( cost != Py_None && !PyObject_TypeCheck(cost, cost_type) ) {
+        PyErr_Format(PyExc_AssertionError, "Internal error: %R (type: %s)",
+                     cost, Py_TYPE(cost)->tp_name);
+        return NULL;
+    }
+    number = PyTuple_GET_ITEM(units, 0);
+    currency = PyTuple_GET_ITEM(units, 1);
+
+    /* Find the position. */
+    key = PyTuple_Pack(2, currency, cost);
+    if ( key == NULL ) {
+        return NULL;
+    }
+    position = PyDict_GetItemWithError(self, key);
+    if ( position == NULL && PyErr_Occurred() ) {
+        goto done;
+    }
+    Py_XINCREF(position);
+
+    if ( position != NULL ) {
+        /* Note: In order to augment or reduce, all the fields have to match. */
+        PyObject* position_units = NULL;
+        PyObject* position_number = NULL;
+        PyObject* new_number = NULL;
+        int sign, position_sign, is_zero;
+
+        position_units = get_field(position, position_type, 0, units_name);
+        if ( position_units == NULL ) {
+            goto done;
+        }
+        position_number = get_field(position_units, amount_type, 0, number_name);
+        Py_DECREF(position_units);
+        if ( position_number == NULL ) {
+            goto done;
+        }
+
+        /* Check if reducing. */
+        if ( (position_sign = PyObject_RichCompareBool(position_number, zero, Py_GE)) < 0 ||
+             (sign = PyObject_RichCompareBool(number, zero, Py_GE)) < 0 ) {
+            Py_DECREF(position_number);
+            goto done;
+        }
+        booking = position_sign != sign ? BOOKING_REDUCED : BOOKING_AUGMENTED;
+
+        /* Compute the new number of units. */
+        new_number = PyNumber_Add(position_number, number);
+        Py_DECREF(position_number);
+        if ( new_number == NULL ) {
+            goto done;
+        }
+        if ( (is_zero = PyObject_RichCompareBool(new_number, zero, Py_EQ)) < 0 ) {
+            Py_DECREF(new_number);
+            goto done;
+        }
+        if ( is_zero ) {
+            /* If empty, delete the position. */
+            Py_DECREF(new_number);
+            if ( PyDict_DelItem(self, key) < 0 ) {
+                goto done;
+            }
+        }
+        else {
+            /* Otherwise update it. */
+            PyObject* new_units = new_pair(amount_type, new_number, currency);
+            Py_DECREF(new_number);
+            if ( new_units == NULL ) {
+                goto done;
+            }
+            new_position = new_pair(position_type, new_units, cost);
+            Py_DECREF(new_units);
+            if ( new_position == NULL || PyDict_SetItem(self, key, new_position) < 0 ) {
+                goto done;
+            }
+        }
+    }
+    else {
+        /* If not found, create a new one. */
+        int is_zero = PyObject_RichCompareBool(number, zero, Py_EQ);
+        if ( is_zero < 0 ) {
+            goto done;
+        }
+        if ( is_zero ) {
+            booking = BOOKING_IGNORED;
+        }
+        else {
+            new_position = new_pair(position_type, units, cost);
+            if ( new_position == NULL || PyDict_SetItem(self, key, new_position) < 0 ) {
+                goto done;
+            }
+            booking = BOOKING_CREATED;
+        }
+    }
+
+    {
+        PyObject* booking_value = get_booking(booking);
+        if ( booking_value != NULL ) {
+            result = PyTuple_Pack(2, position != NULL ? position : Py_None, booking_value);
+        }
+    }
+
+  done:
+    Py_DECREF(key);
+    Py_XDECREF(position);
+    Py_XDECREF(new_position);
+    return result;
+}
+
+/* Add a position or posting to an inventory. Returns the (position, booking)
+ * pair returned by Inventory.add_position(). */
+static PyObject* add_position(PyObject* self, PyObject* position)
+{
+    PyObject* units;
+    PyObject* cost;
+    PyObject* result;
+
+    if ( PyObject_TypeCheck(position, position_type) ) {
+        return add_amount(self, PyTuple_GET_ITEM(position, 0),
+                          PyTuple_GET_ITEM(position, 1));
+    }
+    units = PyObject_GetAttr(position, units_name);
+    cost = units ? PyObject_GetAttr(position, cost_name) : NULL;
+    if ( cost == NULL ) {
+        Py_XDECREF(units);
+        if ( PyErr_ExceptionMatches(PyExc_AttributeError) ) {
+            PyErr_Clear();
+            PyErr_Format(PyExc_AssertionError, "Invalid type for position: %S", position);
+        }
+        return NULL;
+    }
+    if ( cost != Py_None && !PyObject_TypeCheck(cost, cost_type) ) {
+        PyErr_Format(PyExc_AssertionError, "Invalid type for cost: %S", cost);
+        result = NULL;
+    }
+    else {
+        result = add_amount(self, units, cost);
+    }
+    Py_DECREF(units);
+    Py_DECREF(cost);
+    return result;
+}
+
+/* Add all the positions of a sequence to an inventory. */
+static int add_positions(PyObject* self, PyObject* positions)
+{
+    PyObject* iterator = PyObject_GetIter(positions);
+    PyObject* position;
+    if ( iterator == NULL ) {
+        return -1;
+    }
+    while ( (position = PyIter_Next(iterator)) != NULL ) {
+        PyObject* result = add_position(self, position);
+        Py_DECREF(position);
+        if ( result == NULL ) {
+            Py_DECREF(iterator);
+            return -1;
+        }
+        Py_DECREF(result);
+    }
+    Py_DECREF(iterator);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+
+/*------------------------------------------------------------------------------
+ * Inventory type.
+ */
+
+static int inventory_init(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    static char* kwlist[] = { "positions", NULL };
+    PyObject* positions = Py_None;
+
+    if ( !PyArg_ParseTupleAndKeywords(args, kwds, "|O:Inventory", kwlist, &positions) ) {
+        return -1;
+    }
+    if ( PyDict_Check(positions) ) {
+        return PyDict_Update(self, positions);
+    }
+    if ( positions == Py_None ) {
+        return 0;
+    }
+    return add_positions(self, positions);
+}
+
+static PyObject* inventory_add_amount(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    static char* kwlist[] = { "units", "cost", NULL };
+    PyObject* units;
+    PyObject* cost = Py_None;
+
+    if ( !PyArg_ParseTupleAndKeywords(args, kwds, "O|O:add_amount", kwlist,
+                                      &units, &cost) ) {
+        return NULL;
+    }
+    return add_amount(self, units, cost);
+}
+
+static PyObject* inventory_add_position(PyObject* self, PyObject* position)
+{
+    return add_position(self, position);
+}
+
+static PyObject* inventory_add_inventory(PyObject* self, PyObject* other)
+{
+    PyObject* positions;
+    int result;
+
+    /* Copy the positions first, in case 'other' is this inventory. */
+    if ( PyDict_Check(other) ) {
+        positions = PyDict_Values(other);
+    }
+    else {
+        positions = PyObject_CallMethod(other, "get_positions", NULL);
+    }
+    if ( positions == NULL ) {
+        return NULL;
+    }
+    result = add_positions(self, positions);
+    Py_DECREF(positions);
+    if ( result < 0 ) {
+        return NULL;
+    }
+    Py_INCREF(self);
+    return self;
+}
+
+static PyMethodDef inventory_methods[] = {
+    {"add_amount", (PyCFunction)(void(*)(void))inventory_add_amount,
+     METH_VARARGS|METH_KEYWORDS,
+     "add_amount(units, cost=None)\n"
+     "\n"
+     "Add to this inventory using amount and cost. This adds with strict lot\n"
+     "matching, that is, no partial matches are done on the arguments to the\n"
+     "keys of the inventory.\n"
+     "\n"
+     "Args:\n"
+     "  units: An Amount instance to add.\n"
+     "  cost: An instance of Cost or None, as a key to the inventory.\n"
+     "Returns:\n"
+     "  A pair of (position, booking) where 'position' is the position that\n"
+     "  that was modified BEFORE it was modified, and where 'booking' is a\n"
+     "  Booking enum that hints at how the lot was booked to this inventory.\n"
+     "  Position may be None if there is no corresponding Position object,\n"
+     "  e.g. the position was deleted.\n"},
+    {"add_position", (PyCFunction)inventory_add_position, METH_O,
+     "add_position(position)\n"
+     "\n"
+     "Add using a position (with strict lot matching).\n"
+     "\n"
+     "Args:\n"
+     "  position: The Posting or Position to add to this inventory.\n"
+     "Returns:\n"
+     "  A pair of (position, booking) where 'position' is the position that\n"
+     "  that was modified, and where 'booking' is a Booking enum that hints at\n"
+     "  how the lot was booked to this inventory.\n"},
+    {"add_inventory", (PyCFunction)inventory_add_inventory, METH_O,
+     "add_inventory(other)\n"
+     "\n"
+     "Add all the positions of another Inventory instance to this one.\n"
+     "\n"
+     "Args:\n"
+     "  other: An instance of Inventory to add to this one.\n"
+     "Returns:\n"
+     "  This inventory, modified.\n"},
+    {NULL, NULL, 0, NULL}
+};
+
+static char inventory_doc[] =
+    "Inventory(positions=None)\n"
+    "\n"
+    "The native base class of Inventory, a dict of (currency, cost) to\n"
+    "Position instances. Create it from a list of Position instances or an\n"
+    "existing dict or Inventory instance.\n";
+
+static PyTypeObject inventory_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "beancount.core._inventory.Inventory",   /* tp_name */
+    sizeof(PyDictObject),                    /* tp_basicsize */
+    0,                                       /* tp_itemsize */
+    0,                                       /* tp_dealloc */
+    0,                                       /* tp_print */
+    0,                                       /* tp_getattr */
+    0,                                       /* tp_setattr */
+    0,                                       /* tp_reserved */
+    0,                                       /* tp_repr */
+    0,                                       /* tp_as_number */
+    0,                                       /* tp_as_sequence */
+    0,                                       /* tp_as_mapping */
+    0,                                       /* tp_hash */
+    0,                                       /* tp_call */
+    0,                                       /* tp_str */
+    0,                                       /* tp_getattro */
+    0,                                       /* tp_setattro */
+    0,                                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,  /* tp_flags */
+    inventory_doc,                           /* tp_doc */
+    0,                                       /* tp_traverse */
+    0,                                       /* tp_clear */
+    0,                                       /* tp_richcompare */
+    0,                                       /* tp_weaklistoffset */
+    0,                                       /* tp_iter */
+    0,                                       /* tp_iternext */
+    inventory_methods,                       /* tp_methods */
+    0,                                       /* tp_members */
+    0,                                       /* tp_getset */
+    0,                                       /* tp_base */
+    0,                                       /* tp_dict */
+    0,                                       /* tp_descr_get */
+    0,                                       /* tp_descr_set */
+    0,                                       /* tp_dictoffset */
+    inventory_init,                          /* tp_init */
+};
+
+
+/*------------------------------------------------------------------------------
+ * Module.
+ */
+
+/* Import an attribute of a module. */
+static PyObject* import_attribute(const char* module_name, const char* name)
+{
+    PyObject* module = PyImport_ImportModule(module_name);
+    PyObject* attribute;
+    if ( module == NULL ) {
+        return NULL;
+    }
+    attribute = PyObject_GetAttrString(module, name);
+    Py_DECREF(module);
+    return attribute;
+}
+
+static struct PyModuleDef moduledef = {
+    PyModuleDef_HEAD_INIT,
+    "_inventory",                             /* m_name */
+    "Beancount inventory extension module",   /* m_doc */
+    -1,                                       /* m_size */
+    NULL,                                     /* m_methods */
+    NULL,                                     /* m_reload */
+    NULL,                                     /* m_traverse */
+    NULL,                                     /* m_clear */
+    NULL,                                     /* m_free */
+};
+
+PyMODINIT_FUNC PyInit__inventory(void)
+{
+    PyObject* module;
+
+    amount_type = (PyTypeObject*)import_attribute("beancount.core.amount", "Amount");
+    position_type = (PyTypeObject*)import_attribute("beancount.core.position", "Position");
+    cost_type = (PyTypeObject*)import_attribute("beancount.core.position", "Cost");
+    if ( amount_type == NULL || position_type == NULL || cost_type == NULL ) {
+        return NULL;
+    }
+    if ( !PyType_Check(amount_type) || !PyType_IsSubtype(amount_type, &PyTuple_Type) ||
+         !PyType_Check(position_type) || !PyType_IsSubtype(position_type, &PyTuple_Type) ||
+         !PyType_Check(cost_type) ) {
+        PyErr_SetString(PyExc_TypeError, "Unexpected Amount, Position or Cost types");
+        return NULL;
+    }
+    zero = PyLong_FromLong(0);
+    units_name = PyUnicode_InternFromString("units");
+    cost_name = PyUnicode_InternFromString("cost");
+    number_name = PyUnicode_InternFromString("number");
+    if ( zero == NULL || units_name == NULL || cost_name == NULL || number_name == NULL ) {
+        return NULL;
+    }
+
+    inventory_type.tp_base = &PyDict_Type;
+    if ( PyType_Ready(&inventory_type) < 0 ) {
+        return NULL;
+    }
+
+    module = PyModule_Create(&moduledef);
+    if ( module == NULL ) {
+        return NULL;
+    }
+    Py_INCREF(&inventory_type);
+    if ( PyModule_AddObject(module, "Inventory", (PyObject*)&inventory_type) < 0 ) {
+        Py_DECREF(&inventory_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -26,7 +26,6 @@ __copyright__ = "Copyright (C) 2013-2017  Martin Blais"
 __license__ = "GNU GPLv2"
 
 import collections
-from collections.abc import Iterable
 import enum
 import re
 
@@ -35,9 +34,9 @@ from beancount.core.number import Decimal
 from beancount.core.number import same_sign
 from beancount.core.amount import Amount
 from beancount.core.position import Cost
-from beancount.core.position import Position
 from beancount.core.position import from_string as position_from_string
 from beancount.core import convert
+from beancount.core import _inventory
 from beancount.core.display_context import DEFAULT_FORMATTER
 
 
@@ -55,29 +54,18 @@ class Booking(enum.Enum):
 
 # FIXME: You should disallow __getitem__, __delitem__ and __setitem__.
 # Move the dict inside the container.
-class Inventory(dict):
+class Inventory(_inventory.Inventory):
     """An Inventory is a set of positions.
 
+    The constructor, add_amount(), add_position() and add_inventory() are
+    implemented by the native base class, a dict, in _inventory.c. The
+    constructor accepts a list of Position instances or an existing dict or
+    Inventory instance.
+
     Attributes:
       positions: A list of Position instances, held in this Inventory object.
     """
 
-    def __init__(self, positions=None):
-        """Create a new inventory using a list of existing positions.
-
-        Args:
-          positions: A list of Position instances or an existing dict or
-            Inventory instance.
-        """
-        if isinstance(positions, (dict, Inventory)):
-            dict.__init__(self, positions)
-        else:
-            dict.__init__(self)
-            if positions:
-                assert isinstance(positions, Iterable)
-                for position in positions:
-                    self.add_position(position)
-
     def __iter__(self):
         """Iterate over the positions. Note that there is no guaranteed order."""
         return iter(self.values())
@@ -351,85 +339,6 @@ class Inventory(dict):
     # Methods to build an Inventory instance.
     #
 
-    def add_amount(self, units, cost=None):
-        """Add to this inventory using amount and cost. This adds with strict lot
-        matching, that is, no partial matches are done on the arguments to the
-        keys of the inventory.
-
-        Args:
-          units: An Amount instance to add.
-          cost: An instance of Cost or None, as a key to the inventory.
-        Returns:
-          A pair of (position, booking) where 'position' is the position that
-          that was modified BEFORE it was modified, and where 'booking' is a
-          Booking enum that hints at how the lot was booked to this inventory.
-          Position may be None if there is no corresponding Position object,
-          e.g. the position was deleted.
-        """
-        assert isinstance(units, Amount), (
-            "Internal error: {!r} (type: {})".format(units, type(units).__name__))
-        assert cost is None or isinstance(cost, Cost), (
-            "Internal error: {!r} (type: {})".format(cost, type(cost).__name__))
-
-        # Find the position.
-        key = (units.currency, cost)
-        pos = self.get(key, None)
-
-        if pos is not None:
-            # Note: In order to augment or reduce, all the fields have to match.
-
-            # Check if reducing.
-            booking = (Booking.REDUCED
-                       if not same_sign(pos.units.number, units.number)
-                       else Booking.AUGMENTED)
-
-            # Compute the new number of units.
-            number = pos.units.number + units.number
-            if number == ZERO:
-                # If empty, delete the position.
-                del self[key]
-            else:
-                # Otherwise update it.
-                self[key] = Position(Amount(number, units.currency), cost)
-        else:
-            # If not found, create a new one.
-            if units.number == ZERO:
-                booking = Booking.IGNORED
-            else:
-                self[key] = Position(units, cost)
-                booking = Booking.CREATED
-
-        return pos, booking
-
-    def add_position(self, position):
-        """Add using a position (with strict lot matching).
-        Return True if this position was booked against and reduced another.
-
-        Args:
-          position: The Posting or Position to add to this inventory.
-        Returns:
-          A pair of (position, booking) where 'position' is the position that
-          that was modified, and where 'booking' is a Booking enum that hints at
-          how the lot was booked to this inventory.
-        """
-        assert hasattr(position, 'units') and hasattr(position, 'cost'), (
-            "Invalid type for position: {}".format(position))
-        assert isinstance(position.cost, (type(None), Cost)), (
-            "Invalid type for cost: {}".format(position.cost))
-        return self.add_amount(position.units, position.cost)
-
-    def add_inventory(self, other):
-        """Add all the positions of another Inventory instance to this one.
-
-        Args:
-          other: An instance of Inventory to add to this one.
-        Returns:
-          This inventory, modified.
-        """
-        for position in other.get_positions():
-            self.add_position(position)
-        return self
-
     def __add__(self, other):
         """Add another inventory to this one. This inventory is not modified.
 
@@ -442,7 +351,7 @@ class Inventory(dict):
         new_inventory += other
         return new_inventory
 
-    __iadd__ = add_inventory
+    __iadd__ = _inventory.Inventory.add_inventory
 
     @staticmethod
     def from_string(string):
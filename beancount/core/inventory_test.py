@@ -5,6 +5,7 @@ __copyright__ = "Copyright (C) 2014-2016  Martin Blais"
 __license__ = "GNU GPLv2"
 
 import datetime
+import pickle
 import unittest
 import copy
 from datetime import date
@@ -12,6 +13,7 @@ from datetime import date
 from beancount.core.number import D
 from beancount.core.amount import A
 from beancount.core import amount
+from beancount.core import data
 from beancount.core.position import Position
 from beancount.core.position import Cost
 from beancount.core.inventory import Inventory
@@ -465,6 +467,33 @@ class TestInventory(unittest.TestCase):
             inv.add_position(pos)
         self.assertEqual(Inventory(self.POSITIONS_ALL_KINDS), inv)
 
+    def test_add_position__posting(self):
+        inv = Inventory()
+        posting = data.Posting('Assets:Invest', A('10 HOOL'),
+                               Cost(D('1.10'), 'USD', None, None), None, None, None)
+        _, booking = inv.add_position(posting)
+        self.assertEqual(Booking.CREATED, booking)
+        self.assertEqual(I('10 HOOL {1.10 USD}'), inv)
+        self.assertIs(Position, type(inv.get_only_position()))
+
+    def test_add_invalid(self):
+        inv = Inventory()
+        with self.assertRaises(AssertionError):
+            inv.add_amount('10 USD')
+        with self.assertRaises(AssertionError):
+            inv.add_amount(A('10 USD'), A('1 CAD'))
+        with self.assertRaises(AssertionError):
+            inv.add_position(A('10 USD'))
+        with self.assertRaises(TypeError):
+            inv.add_amount(A('10 USD'), None, None)
+        self.assertEqual(Inventory(), inv)
+
+    def test_pickle(self):
+        inv = I('10 HOOL {1.10 USD}, 2.22 CAD')
+        restored = pickle.loads(pickle.dumps(inv))
+        self.assertIs(Inventory, type(restored))
+        self.assertEqual(inv, restored)
+
     def test_op_add(self):
         inv1 = I('17.00 USD')
         orig_inv1 = I('17.00 USD')
@@ -481,6 +510,9 @@ class TestInventory(unittest.TestCase):
         self.assertEqual(expect_updated, inv_updated)
         self.assertEqual(expect_updated, inv1)
 
+        inv1 += inv1
+        self.assertEqual(I('22 USD, 24 CAD'), inv1)
+
     def test_sum_inventories(self):
         inv1 = Inventory()
         inv1.add_amount(A('10 USD'))
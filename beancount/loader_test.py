@@ -1,15 +1,22 @@
 __copyright__ = "Copyright (C) 2014-2016  Martin Blais"
 __license__ = "GNU GPLv2"
 
+import datetime
 import logging
 import unittest
 import tempfile
 import textwrap
 import os
+import sys
+import types
 from unittest import mock
 from os import path
 
+from beancount.core.amount import A
+from beancount.core import data
 from beancount import loader
+from beancount.plugins import readonly_plugin
+from beancount.parser import booking
 from beancount.parser import parser
 from beancount.utils import test_utils
 from beancount.utils import encryption_test
@@ -310,6 +317,189 @@ class TestLoadIncludes(unittest.TestCase):
                          list(map(path.basename, options_map['include'])))
 
 
+class TestLoadIncludesParallel(unittest.TestCase):
+
+    FILES = {
+        'apples.beancount': """
+          include "fruits/*.beancount"
+          include "legumes/tomates.beancount"
+          include "legumes/missing.beancount"
+          option "operating_currency" "USD"
+          2014-01-01 open Assets:Apples
+        """,
+        'fruits/oranges.beancount': """
+          include "../apples.beancount"
+          include "../legumes/tomates.beancount"
+          option "operating_currency" "CAD"
+          2014-01-02 open Assets:Oranges  CAD
+        """,
+        'fruits/bananas.beancount': """
+          include "../legumes/patates.beancount"
+          option "operating_currency" "EUR"
+          2014-01-03 open Assets:Bananas  EUR
+          2014-01-03 invalid Assets:Bananas
+        """,
+        'legumes/tomates.beancount': """
+          2014-01-04 open Assets:Tomates
+        """,
+        'legumes/patates.beancount': """
+          include "../fruits/bananas.beancount"
+          2014-01-05 open Assets:Patates  JPY
+        """}
+
+    def parse(self, tmp, num_processes):
+        with mock.patch.object(loader, 'PARSE_PROCESSES', num_processes), \
+             mock.patch.object(loader, 'PARALLEL_PARSE_THRESHOLD', 0):
+            return loader._parse_recursive(
+                [(path.join(tmp, 'apples.beancount'), True)], None)
+
+    def test_parse_files_parallel(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, self.FILES)
+            sources = [(path.join(tmp, 'fruits/oranges.beancount'), True),
+                       (path.join(tmp, 'fruits/bananas.beancount'), True),
+                       (path.join(tmp, 'fruits/oranges.beancount'), True),
+                       (path.join(tmp, 'legumes/missing.beancount'), True),
+                       ('2014-01-01 open Assets:String', False)]
+            with mock.patch.object(loader, 'PARSE_PROCESSES', 2), \
+                 mock.patch.object(loader, 'PARALLEL_PARSE_THRESHOLD', 0):
+                parsed = loader._parse_files_parallel(sources, set(), None)
+                self.assertEqual({path.join(tmp, 'fruits/oranges.beancount'),
+                                  path.join(tmp, 'fruits/bananas.beancount')},
+                                 set(parsed))
+                self.assertEqual(parser.parse_file(
+                    path.join(tmp, 'fruits/bananas.beancount'))[0],
+                                 parsed[path.join(tmp, 'fruits/bananas.beancount')][0])
+
+                # Too few files.
+                self.assertEqual({}, loader._parse_files_parallel(sources[2:], set(), None))
+
+            with mock.patch.object(loader, 'PARSE_PROCESSES', 2):
+                # Too small files.
+                self.assertEqual({}, loader._parse_files_parallel(sources, set(), None))
+
+    def test_parse_recursive_parallel(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, self.FILES)
+            entries, errors, options_map = self.parse(tmp, 1)
+            par_entries, par_errors, par_options_map = self.parse(tmp, 4)
+
+        self.assertEqual(entries, par_entries)
+        self.assertEqual([error.message for error in errors],
+                         [error.message for error in par_errors])
+        for key in 'include', 'operating_currency', 'commodities':
+            self.assertEqual(options_map[key], par_options_map[key])
+
+        # Cycles and duplicates are still detected.
+        self.assertEqual(5, len(entries))
+        self.assertEqual(['apples.beancount', 'bananas.beancount', 'oranges.beancount',
+                          'patates.beancount', 'tomates.beancount'],
+                         list(map(path.basename, par_options_map['include'])))
+        self.assertEqual(3, sum('Duplicate filename' in error.message
+                                for error in par_errors))
+        self.assertEqual(1, sum('does not match' in error.message
+                                for error in par_errors))
+        self.assertEqual(['USD', 'CAD', 'EUR'], par_options_map['operating_currency'])
+        self.assertEqual({'CAD', 'EUR', 'JPY'}, par_options_map['commodities'])
+
+
+@readonly_plugin
+def count_entries(entries, unused_options_map, config=None):
+    """A read-only plugin reporting the number and type of the entries."""
+    message = '{} {} {}'.format(config, type(entries).__name__, len(entries))
+    return entries, [loader.LoadError(data.new_metadata('<count>', 0), message, None)]
+
+
+@readonly_plugin
+def fail_entries(entries, unused_options_map):
+    """A read-only plugin failing."""
+    raise TypeError("Failed")
+
+
+def add_entry(entries, unused_options_map):
+    """A plugin adding an entry."""
+    return entries + [data.Open(data.new_metadata('<add>', 0), entries[0].date,
+                                'Assets:Added', None, None)], []
+
+
+class TestReadonlyPlugins(unittest.TestCase):
+
+    def load(self):
+        modules = {}
+        for name, plugins in [('count', [count_entries]),
+                              ('fail', [count_entries, fail_entries]),
+                              ('add', [count_entries, add_entry])]:
+            modules['readonly_test.' + name] = module = types.ModuleType(name)
+            module.__plugins__ = plugins
+        with mock.patch.dict(sys.modules, modules):
+            return loader.load_string("""
+              plugin "readonly_test.count" "a"
+              plugin "readonly_test.fail"
+              plugin "readonly_test.count" "b"
+              plugin "readonly_test.add"
+              plugin "readonly_test.count" "c"
+              plugin "readonly_test.count" "d"
+
+              2014-01-01 open Assets:Cash
+              2014-01-01 open Assets:Other
+            """, dedent=True)
+
+    def test_readonly_plugins(self):
+        entries, errors, _ = self.load()
+        self.assertEqual(3, len(entries))
+        self.assertEqual(['a tuple 2',
+                          'None tuple 2',
+                          'Error importing "readonly_test.fail": Failed',
+                          'b tuple 2',
+                          'None list 2',
+                          'c tuple 3',
+                          'd tuple 3'],
+                         [error.message for error in errors])
+
+    def test_readonly_plugins_parallel(self):
+        entries, errors, _ = self.load()
+        with mock.patch.object(loader, 'PLUGIN_PROCESSES', 2), \
+             mock.patch.object(loader, 'PARALLEL_PLUGINS_THRESHOLD', 0):
+            par_entries, par_errors, _ = self.load()
+        self.assertEqual(entries, par_entries)
+        self.assertEqual(errors, par_errors)
+        self.assertIsNone(loader._readonly_plugins_state)
+
+
+class TestResortEntries(unittest.TestCase):
+
+    def note(self, day, lineno):
+        return data.Note(data.new_metadata('<test>', lineno),
+                         datetime.date(2014, 1, day), 'Assets:Cash', str(lineno))
+
+    def assertResorted(self, entries, sorted_entries):
+        expected = sorted(entries, key=data.entry_sortkey)
+        resorted = loader.resort_entries(list(entries), list(sorted_entries))
+        self.assertEqual(list(map(id, expected)), list(map(id, resorted)))
+
+    def test_resort_entries(self):
+        sorted_entries = [self.note(day, 1) for day in range(1, 30)]
+        new_entries = [self.note(15, 1), self.note(2, 0), self.note(29, 2)]
+
+        # Unchanged, or with entries removed.
+        self.assertResorted(sorted_entries, sorted_entries)
+        self.assertResorted(sorted_entries[:10] + sorted_entries[12:], sorted_entries)
+        self.assertResorted([], sorted_entries)
+
+        # Appended, prepended or inserted entries, sorted with the same keys
+        # as those around them in the order they were returned.
+        self.assertResorted(sorted_entries + new_entries, sorted_entries)
+        self.assertResorted(new_entries + sorted_entries, sorted_entries)
+        self.assertResorted(sorted_entries[:5] + new_entries + sorted_entries[5:],
+                            sorted_entries)
+        self.assertResorted(new_entries, [])
+
+        # Replaced and reordered entries.
+        self.assertResorted(list(reversed(sorted_entries)), sorted_entries)
+        self.assertResorted([entry._replace(comment='') for entry in sorted_entries],
+                            sorted_entries)
+
+
 class TestLoadIncludesEncrypted(encryption_test.TestEncryptedBase):
 
     def test_include_encrypted(self):
@@ -473,6 +663,159 @@ class TestLoadCache(unittest.TestCase):
                 os.environ['BEANCOUNT_LOAD_CACHE_FILENAME'] = prev_env
 
 
+class TestParseCache(unittest.TestCase):
+
+    def setUp(self):
+        self.parsed = []
+        mock.patch('beancount.loader._parse_file',
+                   loader.parse_cache_function(loader.PARSE_CACHE_FILENAME,
+                                               0,  # No time threshold.
+                                               self._parse_file)).start()
+
+    def tearDown(self):
+        mock.patch.stopall()
+
+    def _parse_file(self, filename, *args, **kw):
+        self.parsed.append(path.basename(filename))
+        return parser.parse_file(filename, *args, **kw)
+
+    def parse(self, filename):
+        self.parsed.clear()
+        return loader._parse_recursive([(filename, True)], None)
+
+    def test_parse_cache(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "oranges.beancount"
+                  include "bananas.beancount"
+                  option "operating_currency" "USD"
+                  2014-01-01 open Assets:Apples
+                """,
+                'oranges.beancount': """
+                  2014-01-02 open Assets:Oranges  CAD
+                """,
+                'bananas.beancount': """
+                  2014-01-02 open Assets:Bananas
+                """})
+            top_filename = path.join(tmp, 'apples.beancount')
+            entries, errors, options_map = self.parse(top_filename)
+            self.assertEqual(['apples.beancount', 'oranges.beancount',
+                              'bananas.beancount'], self.parsed)
+            self.assertTrue(path.exists(path.join(tmp, '.oranges.beancount.parsecache')))
+
+            # Parse again, all the files come from the cache.
+            cached_entries, cached_errors, cached_options_map = self.parse(top_filename)
+            self.assertEqual([], self.parsed)
+            self.assertEqual(entries, cached_entries)
+            self.assertEqual(options_map['include'], cached_options_map['include'])
+            self.assertEqual({'CAD'}, cached_options_map['commodities'])
+
+            # Edit one of the files, only that one is parsed again.
+            with open(path.join(tmp, 'bananas.beancount'), 'a') as file:
+                file.write('2014-01-03 open Assets:Plantains\n')
+            entries, errors, options_map = self.parse(top_filename)
+            self.assertEqual(['bananas.beancount'], self.parsed)
+            self.assertEqual(4, len(entries))
+
+            # Corrupt a cache file, it gets parsed again.
+            with open(path.join(tmp, '.oranges.beancount.parsecache'), 'wb') as file:
+                file.write(b'garbage')
+            with test_utils.capture('stderr'):
+                self.parse(top_filename)
+            self.assertEqual(['oranges.beancount'], self.parsed)
+
+            # A different parser invalidates all the files.
+            with mock.patch.object(loader, 'get_parser_version', return_value='other'):
+                self.parse(top_filename)
+            self.assertEqual(3, len(self.parsed))
+
+    def test_parse_cache_key(self):
+        key = loader.compute_parse_cache_key('/a.beancount', b'contents')
+        self.assertEqual(key, loader.compute_parse_cache_key('/a.beancount', b'contents'))
+        self.assertNotEqual(key, loader.compute_parse_cache_key('/b.beancount',
+                                                                b'contents'))
+        self.assertNotEqual(key, loader.compute_parse_cache_key('/a.beancount',
+                                                                b'contents\n'))
+        self.assertNotEqual(key, loader.compute_parse_cache_key('/a.beancount',
+                                                                b'contents',
+                                                                encoding='latin1'))
+
+
+class TestBookingCheckpoint(unittest.TestCase):
+
+    def setUp(self):
+        mock.patch('beancount.loader._book',
+                   loader.booking_checkpoint_function(loader.BOOKING_CHECKPOINT_FILENAME,
+                                                      0,  # No time threshold.
+                                                      loader._uncached_book)).start()
+        self.book_mock = mock.patch('beancount.parser.booking.book_checkpointed',
+                                    wraps=booking.book_checkpointed).start()
+
+    def tearDown(self):
+        mock.patch.stopall()
+
+    def load(self, filename):
+        return loader._load([(filename, True)], None, None, None)
+
+    def test_booking_checkpoint(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'ledger.beancount': """
+                  2014-01-01 open Assets:Invest
+                  2014-01-01 open Assets:Cash
+
+                  2014-01-02 *
+                    Assets:Invest     10 HOOL {100.00 USD}
+                    Assets:Cash
+
+                  2014-01-03 *
+                    Assets:Invest     -2 HOOL {}
+                    Assets:Cash
+                """})
+            filename = path.join(tmp, 'ledger.beancount')
+            checkpoint_filename = path.join(tmp, '.ledger.beancount.bookingcheckpoint')
+            self.load(filename)
+            self.assertTrue(path.exists(checkpoint_filename))
+            self.assertIsNone(self.book_mock.call_args[0][2])
+
+            # Append a transaction, booking resumes from the checkpoint.
+            with open(filename, 'a') as file:
+                file.write('2014-01-04 *\n'
+                           '  Assets:Invest     -3 HOOL {}\n'
+                           '  Assets:Cash\n')
+            entries, errors, _ = self.load(filename)
+            checkpoint = self.book_mock.call_args[0][2]
+            self.assertEqual(datetime.date(2014, 1, 3), checkpoint.date)
+            self.assertEqual(entries[:3], checkpoint.entries)
+            with mock.patch.object(loader, '_book', loader._uncached_book):
+                expected_entries, expected_errors, _ = self.load(filename)
+            self.assertEqual(expected_entries, entries)
+            self.assertEqual(expected_errors, errors)
+
+            # Load again, the checkpoint has moved to the last date.
+            self.load(filename)
+            self.assertEqual(datetime.date(2014, 1, 4),
+                             self.book_mock.call_args[0][2].date)
+
+            # Edit the history, the checkpoint isn't used.
+            with open(filename) as file:
+                contents = file.read()
+            with open(filename, 'w') as file:
+                file.write(contents.replace('10 HOOL', '20 HOOL'))
+            entries, errors, _ = self.load(filename)
+            self.assertEqual([], errors)
+            self.assertEqual(A('-2000.00 USD'), entries[2].postings[1].units)
+
+            # Corrupt the checkpoint file, all the entries are booked.
+            with open(checkpoint_filename, 'wb') as file:
+                file.write(b'garbage')
+            with test_utils.capture('stderr'):
+                entries, errors, _ = self.load(filename)
+            self.assertEqual([], errors)
+            self.assertEqual(A('-2000.00 USD'), entries[2].postings[1].units)
+
+
 class TestEncoding(unittest.TestCase):
 
     def test_string_unicode(self):
@@ -0,0 +1,372 @@
+"""Benchmark the processing of large generated ledgers.
+
+This generates synthetic ledgers with increasing numbers of postings and
+measures each stage of loading them separately: lexing alone, parsing, booking,
+running the plugins and validation. Throughput is reported in tokens per second
+and directives per second, along with the peak resident memory of the process
+after each stage. Each ledger is processed in a fresh subprocess, so that the
+peak memory of a ledger does not include that of the previous ones.
+
+The results can be printed as a table or as JSON, to be stored and compared
+against those of another version, e.g.,
+
+  python3 -m beancount.parser.benchmark --format=json > benchmark.json
+
+The --compare-fastcall option instead compares the speed of the parser with
+builder methods looked up on every call and with the dispatch table bound once
+per parse (the 'fastcall' option of the parser).
+"""
+__copyright__ = "Copyright (C) 2017  Martin Blais"
+__license__ = "GNU GPLv2"
+
+from concurrent import futures
+import datetime
+import gc
+import json
+import os
+import platform
+import random
+import re
+import sys
+import tempfile
+import time
+
+try:
+    import resource
+except ImportError:
+    resource = None
+
+from beancount.core import data
+from beancount.ops import validation
+from beancount.parser import _parser
+from beancount.parser import booking
+from beancount.parser import grammar
+from beancount.parser import lexer
+from beancount.parser import parser as parser_
+from beancount.utils import version
+from beancount import loader
+import beancount
+
+
+ACCOUNTS = ['Assets:US:Bank:Checking',
+            'Assets:US:Bank:Savings',
+            'Liabilities:US:CreditCard',
+            'Expenses:Food:Restaurant',
+            'Expenses:Food:Groceries',
+            'Expenses:Transport:Taxi',
+            'Income:US:Employer:Salary']
+
+PAYEES = ['Cafe Mogador', 'Metro Supermarket', 'Yellow Cab', 'ACME Corp.']
+
+# The account used for the purchases and sales of stock, held at cost.
+INVEST_ACCOUNT = 'Assets:US:Broker:HOOL'
+
+# The number of lots held in INVEST_ACCOUNT once the sales start.
+NUM_LOTS = 20
+
+# The default sizes of the generated ledgers, in numbers of postings.
+DEFAULT_SIZES = '10K,100K,1M,10M'
+
+
+def generate_ledger(file, num_transactions, seed=0):
+    """Write a synthetic ledger of two-legged transactions.
+
+    Most transactions are simple transfers between ACCOUNTS. One in ten buys
+    a lot of stock held at cost in an account with FIFO booking, and once
+    NUM_LOTS lots have been bought, one in ten sells the oldest lot, so that
+    booking has lots to match but the size of the inventory remains bounded.
+    Every transaction has exactly two postings.
+
+    Args:
+      file: A file object to write the ledger to.
+      num_transactions: An integer, the number of transactions to generate.
+      seed: An integer, the seed of the random generator.
+    """
+    rand = random.Random(seed)
+    start_date = datetime.date(2000, 1, 1)
+    for account in ACCOUNTS:
+        file.write('{} open {}\n'.format(start_date, account))
+    file.write('\n')
+    for index in range(num_transactions):
+        date = start_date + datetime.timedelta(days=index // 10)
+        if index % 10 == 4 and index > NUM_LOTS * 10:
+            file.write('{} * "Sell HOOL"\n'.format(date))
+            file.write('  {:32} -10 HOOL {{}} @ 60.00 USD\n'.format(INVEST_ACCOUNT))
+            file.write('  {:32}\n'.format(ACCOUNTS[0]))
+        elif index % 10 == 9:
+            if index == 9:
+                file.write('{} open {} HOOL "FIFO"\n'.format(date, INVEST_ACCOUNT))
+            file.write('{} * "Buy HOOL"\n'.format(date))
+            file.write('  {:32} 10 HOOL {{{:.2f} USD}}\n'.format(
+                INVEST_ACCOUNT, rand.randint(4000, 6000) / 100))
+            file.write('  {:32}\n'.format(ACCOUNTS[0]))
+        else:
+            account, other_account = rand.sample(ACCOUNTS, 2)
+            number = rand.randint(1, 100000) / 100
+            file.write('{} * "{}" "Transaction {}" #tag\n'.format(
+                date, rand.choice(PAYEES), index))
+            file.write('  {:32} {:.2f} USD\n'.format(account, number))
+            file.write('  {:32} {:.2f} USD\n'.format(other_account, -number))
+        file.write('\n')
+
+
+def parse_size(string):
+    """Parse a number of postings with an optional K or M suffix.
+
+    Args:
+      string: A string, e.g. '100K' or '2500'.
+    Returns:
+      An integer.
+    Raises:
+      ValueError: If the string is not a valid size.
+    """
+    match = re.fullmatch(r'(\d+)([KkMm]?)', string.strip())
+    if not match:
+        raise ValueError("Invalid size: '{}'".format(string))
+    return int(match.group(1)) * {'': 1, 'K': 10**3, 'M': 10**6}[
+        match.group(2).upper()]
+
+
+def get_ledger(directory, num_postings):
+    """Generate a ledger with a given number of postings, if not already there.
+
+    Args:
+      directory: A string, the name of the directory to store the ledger in.
+      num_postings: An integer, the number of postings of the ledger.
+    Returns:
+      The name of the ledger file.
+    """
+    filename = os.path.join(directory, 'ledger-{}.beancount'.format(num_postings))
+    if not os.path.exists(filename):
+        # Write to a temporary name first, so that an interrupted run does not
+        # leave a truncated ledger behind to be reused.
+        tmp_filename = filename + '.tmp'
+        with open(tmp_filename, 'w') as file:
+            generate_ledger(file, num_postings // 2)
+        os.rename(tmp_filename, filename)
+    return filename
+
+
+def get_peak_rss():
+    """Return the peak resident memory of this process.
+
+    Returns:
+      An integer, a number of bytes, or None if it is not available.
+    """
+    if resource is None:
+        return None
+    maxrss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # The value is in bytes on macOS and in kilobytes elsewhere.
+    return maxrss if sys.platform == 'darwin' else maxrss * 1024
+
+
+def run_stages(filename):
+    """Run all the stages of loading a ledger and measure each of them.
+
+    Args:
+      filename: A string, the name of the ledger file.
+    Returns:
+      A list of dicts, one per stage, with the 'stage' name, the processor time
+      in 'seconds', the number of 'tokens' lexed and of 'directives' processed
+      by the stage (or None), and the 'peak_rss' of the process after the stage,
+      in bytes.
+    """
+    results = []
+
+    def record(stage, start, tokens=None, directives=None):
+        seconds = time.process_time() - start
+        results.append(dict(stage=stage, seconds=seconds,
+                            tokens=tokens, directives=directives,
+                            peak_rss=get_peak_rss()))
+
+    gc.collect()
+    start = time.process_time()
+    num_tokens = sum(1 for _ in lexer.lex_iter(filename))
+    record('lex', start, tokens=num_tokens)
+
+    gc.collect()
+    start = time.process_time()
+    entries, errors, options_map = parser_.parse_file(filename)
+    entries.sort(key=data.entry_sortkey)
+    record('parse', start, tokens=num_tokens, directives=len(entries))
+
+    gc.collect()
+    start = time.process_time()
+    entries, balance_errors = booking.book(entries, options_map)
+    errors.extend(balance_errors)
+    record('booking', start, directives=len(entries))
+
+    gc.collect()
+    start = time.process_time()
+    entries, errors = loader.run_transformations(entries, errors, options_map, None)
+    record('plugins', start, directives=len(entries))
+
+    gc.collect()
+    start = time.process_time()
+    errors.extend(validation.validate(entries, options_map))
+    record('validation', start, directives=len(entries))
+
+    if errors:
+        raise ValueError("Unexpected errors in generated ledger: {}".format(
+            errors[0].message))
+    return results
+
+
+def run_benchmark(filename, repeat):
+    """Measure the stages of loading a ledger, in a subprocess.
+
+    Args:
+      filename: A string, the name of the ledger file.
+      repeat: An integer, the number of runs; the fastest of each stage is kept.
+    Returns:
+      A list of dicts, as for run_stages(), with the rates of each stage in
+      'tokens_per_sec' and 'directives_per_sec'.
+    """
+    runs = []
+    for _ in range(repeat):
+        with futures.ProcessPoolExecutor(max_workers=1) as executor:
+            runs.append(executor.submit(run_stages, filename).result())
+
+    results = []
+    for stage_results in zip(*runs):
+        result = dict(min(stage_results, key=lambda result: result['seconds']))
+        result['peak_rss'] = max((result['peak_rss'] or 0)
+                                 for result in stage_results) or None
+        for name in 'tokens', 'directives':
+            count = result[name]
+            result[name + '_per_sec'] = (count / result['seconds']
+                                         if count and result['seconds'] else None)
+        results.append(result)
+    return results
+
+
+def format_rate(rate):
+    return '{:12,.0f}'.format(rate) if rate is not None else '{:>12}'.format('-')
+
+
+def print_table(reports, file):
+    """Print the results of the benchmark as a table.
+
+    Args:
+      reports: A list of dicts with the 'postings' of each ledger and the
+        'stages' results for it.
+      file: A file object to write to.
+    """
+    fmt = '{:>10}  {:<10}  {:>9}  {:>12}  {:>12}  {:>10}\n'
+    file.write(fmt.format('postings', 'stage', 'seconds', 'tokens/s',
+                          'directives/s', 'peak MB'))
+    for report in reports:
+        for result in report['stages']:
+            peak_rss = result['peak_rss']
+            file.write(fmt.format(
+                '{:,}'.format(report['postings']),
+                result['stage'],
+                '{:.3f}'.format(result['seconds']),
+                format_rate(result['tokens_per_sec']),
+                format_rate(result['directives_per_sec']),
+                '{:.1f}'.format(peak_rss / 2**20) if peak_rss else '-'))
+
+
+def time_parse(filename, **kw):
+    """Measure the time it takes to parse a file.
+
+    Args:
+      filename: A string, the name of the file to parse.
+      **kw: Options for the parser.
+    Returns:
+      The processor time of the parse, in seconds.
+    """
+    builder = grammar.Builder(filename)
+    gc.collect()
+    start = time.process_time()
+    _parser.parse_file(filename, builder, **kw)
+    return time.process_time() - start
+
+
+def compare_fastcall(filename, repeat, file):
+    """Compare the speed of the parser with and without the 'fastcall' option.
+
+    Args:
+      filename: A string, the name of the ledger file.
+      repeat: An integer, the number of runs; the fastest is kept.
+      file: A file object to write the results to.
+    """
+    num_tokens = sum(1 for _ in lexer.lex_iter(filename))
+    # Alternate the runs, so that they are equally affected by the load of the
+    # machine.
+    times = {False: [], True: []}
+    for _ in range(repeat):
+        for fastcall in False, True:
+            times[fastcall].append(time_parse(filename, fastcall=fastcall))
+
+    rates = {}
+    for fastcall in False, True:
+        seconds = min(times[fastcall])
+        rates[fastcall] = num_tokens / seconds
+        file.write('fastcall={!s:5}  {:8.3f} s  {:12,.0f} tokens/s\n'.format(
+            fastcall, seconds, rates[fastcall]))
+    file.write('fastcall adds {:,.0f} tokens/s ({:+.1%})\n'.format(
+        rates[True] - rates[False], rates[True] / rates[False] - 1))
+
+
+def main():
+    parser = version.ArgumentParser(description=__doc__.splitlines()[0])
+
+    parser.add_argument('-s', '--sizes', action='store', default=DEFAULT_SIZES,
+                        help=('Comma-separated numbers of postings of the '
+                              'generated ledgers, with optional K or M suffixes.'))
+
+    parser.add_argument('-r', '--repeat', type=int, default=1,
+                        help='Number of runs of each stage; the fastest is kept.')
+
+    parser.add_argument('-d', '--directory', action='store',
+                        help=('Directory to store the generated ledgers in, to '
+                              'reuse them across runs. By default, they are '
+                              'generated in a temporary directory.'))
+
+    parser.add_argument('-f', '--format', choices=['text', 'json'], default='text',
+                        help='Output format.')
+
+    parser.add_argument('--compare-fastcall', action='store_true',
+                        help=("Only compare the parser with and without the "
+                              "'fastcall' option on each ledger."))
+
+    opts = parser.parse_args()
+
+    try:
+        sizes = [parse_size(size) for size in opts.sizes.split(',')]
+    except ValueError as exc:
+        parser.error(str(exc))
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        directory = opts.directory or tmpdir
+        os.makedirs(directory, exist_ok=True)
+
+        if opts.compare_fastcall:
+            for num_postings in sizes:
+                print('{:,} postings'.format(num_postings))
+                compare_fastcall(get_ledger(directory, num_postings),
+                                 opts.repeat, sys.stdout)
+            return 0
+
+        reports = []
+        for num_postings in sizes:
+            filename = get_ledger(directory, num_postings)
+            reports.append({'postings': num_postings,
+                            'bytes': os.path.getsize(filename),
+                            'stages': run_benchmark(filename, opts.repeat)})
+
+    if opts.format == 'json':
+        json.dump({'version': beancount.__version__,
+                   'python': platform.python_version(),
+                   'platform': platform.platform(),
+                   'date': datetime.datetime.now().isoformat(timespec='seconds'),
+                   'ledgers': reports}, sys.stdout, indent=2)
+        sys.stdout.write('\n')
+    else:
+        print_table(reports, sys.stdout)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
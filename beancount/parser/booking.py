@@ -5,7 +5,9 @@ __copyright__ = "Copyright (C) 2015-2016  Martin Blais"
 __license__ = "GNU GPLv2"
 
 import collections
+import hashlib
 
+import beancount
 from beancount.core.number import MISSING
 from beancount.parser import booking_full
 from beancount.core import data
@@ -15,6 +17,27 @@ from beancount.core import inventory
 BookingError = collections.namedtuple('BookingError', 'source message entry')
 
 
+# The state of booking after all the entries before a date, from which booking
+# can resume for the entries from that date on.
+#
+# Attributes:
+#   date: A datetime.date instance, the date of the checkpoint.
+#   key: A string, the hash of the incomplete entries before the date and of the
+#     options which affect booking, as computed by compute_checkpoint_key().
+#   entries: A list of the booked entries before the date.
+#   errors: A list of the booking errors of these entries.
+#   balances: A dict of account name to the Inventory of its balance after
+#     these entries.
+BookingCheckpoint = collections.namedtuple('BookingCheckpoint',
+                                           'date key entries errors balances')
+
+# The options which affect the results of booking.
+BOOKING_OPTIONS = ('booking_method',
+                   'inferred_tolerance_default',
+                   'inferred_tolerance_multiplier',
+                   'infer_tolerance_from_cost')
+
+
 def book(incomplete_entries, options_map):
     """Book inventory lots and complete all positions with incomplete numbers.
 
@@ -27,11 +50,7 @@ def book(incomplete_entries, options_map):
         entries: A list of completed entries with all their postings completed.
         errors: New errors produced during interpolation.
     """
-    # Get the list of booking methods for each account.
-    booking_methods = collections.defaultdict(lambda: options_map["booking_method"])
-    for entry in incomplete_entries:
-        if isinstance(entry, data.Open) and entry.booking:
-            booking_methods[entry.account] = entry.booking
+    booking_methods = get_booking_methods(incomplete_entries, options_map)
 
     # Do the booking here!
     entries, booking_errors = booking_full.book(incomplete_entries, options_map,
@@ -43,6 +62,179 @@ def book(incomplete_entries, options_map):
     return entries, (booking_errors + missing_errors)
 
 
+def book_checkpointed(incomplete_entries, options_map, checkpoint=None):
+    """Book the entries, resuming from a checkpoint of an earlier booking.
+
+    This is book() for ledgers to which entries are only ever appended. If the
+    incomplete entries before the date of the checkpoint are the same as those
+    it was created from, their booked entries and errors are taken from it, and
+    only the following entries are booked, from its balances. Otherwise all the
+    entries are booked. In both cases, a new checkpoint is created at the date of
+    the last entry.
+
+    Args:
+      incomplete_entries: A list of directives sorted by date, as for book().
+      options_map: An options dict as produced by the parser.
+      checkpoint: An instance of BookingCheckpoint, or None.
+    Returns:
+      A triple of
+        entries: A list of completed entries, as from book().
+        errors: A list of errors, as from book().
+        checkpoint: An instance of BookingCheckpoint at the date of the last
+          entry, or the given checkpoint if that is the same.
+    """
+    booking_methods = get_booking_methods(incomplete_entries, options_map)
+
+    # Validate the checkpoint against the entries before its date.
+    md5 = new_checkpoint_hash(options_map)
+    begin = 0
+    if checkpoint is not None:
+        begin = bisect_date(incomplete_entries, checkpoint.date)
+        update_checkpoint_hash(md5, incomplete_entries[:begin])
+        if md5.hexdigest() != checkpoint.key:
+            checkpoint = None
+            begin = 0
+            md5 = new_checkpoint_hash(options_map)
+    if checkpoint is not None:
+        entries = list(checkpoint.entries)
+        booking_errors = list(checkpoint.errors)
+        balances = checkpoint.balances
+    else:
+        entries = []
+        booking_errors = []
+        balances = None
+
+    # Book the entries before the date of the last entry, where the new
+    # checkpoint is created, if that is later than the current one.
+    if incomplete_entries:
+        date = incomplete_entries[-1].date
+        end = bisect_date(incomplete_entries, date)
+        if end > begin or checkpoint is None:
+            # Note: Booking adds metadata to the postings of the incomplete
+            # entries, so they must be hashed before.
+            update_checkpoint_hash(md5, incomplete_entries[begin:end])
+            new_entries, new_errors, balances = booking_full._book(
+                incomplete_entries[begin:end], options_map, booking_methods, balances)
+            entries.extend(new_entries)
+            booking_errors.extend(new_errors)
+            checkpoint = BookingCheckpoint(date, md5.hexdigest(), list(entries),
+                                           list(booking_errors), dict(balances))
+            begin = end
+
+    # Book the remaining entries.
+    new_entries, new_errors, _ = booking_full._book(
+        incomplete_entries[begin:], options_map, booking_methods, balances)
+    entries.extend(new_entries)
+    booking_errors.extend(new_errors)
+
+    # Check for MISSING elements remaining.
+    missing_errors = validate_missing_eliminated(entries, options_map)
+
+    return entries, (booking_errors + missing_errors), checkpoint
+
+
+def get_booking_methods(entries, options_map):
+    """Get the booking methods of the accounts.
+
+    Args:
+      entries: A list of directives.
+      options_map: An options dict as produced by the parser.
+    Returns:
+      A mapping of account name to Booking method, which defaults to that of the
+      options.
+    """
+    booking_methods = collections.defaultdict(lambda: options_map["booking_method"])
+    for entry in entries:
+        if isinstance(entry, data.Open) and entry.booking:
+            booking_methods[entry.account] = entry.booking
+    return booking_methods
+
+
+def bisect_date(entries, date):
+    """Find the index of the first entry on or after a date.
+
+    Args:
+      entries: A list of directives sorted by date.
+      date: A datetime.date instance.
+    Returns:
+      An integer, the index of the first entry whose date is not before 'date',
+      or the number of entries if there is none.
+    """
+    lo, hi = 0, len(entries)
+    while lo < hi:
+        mid = (lo + hi) // 2
+        if entries[mid].date < date:
+            lo = mid + 1
+        else:
+            hi = mid
+    return lo
+
+
+def new_checkpoint_hash(options_map):
+    """Create the hash of a checkpoint, before any entries.
+
+    Args:
+      options_map: An options dict as produced by the parser.
+    Returns:
+      A hashlib object, initialized with the version and the booking options.
+    """
+    options_values = [options_map[name] for name in BOOKING_OPTIONS]
+    md5 = hashlib.md5()
+    md5.update(repr((beancount.__version__, options_values)).encode('utf8'))
+    return md5
+
+
+def update_checkpoint_hash(md5, entries):
+    """Add incomplete entries to the hash of a checkpoint.
+
+    The metadata of the entries and postings is hashed too, because booking
+    copies it, and tags and links are sorted, so that the hash doesn't depend on
+    the order of sets.
+
+    Args:
+      md5: A hashlib object, as from new_checkpoint_hash().
+      entries: A list of directives.
+    """
+    for entry in entries:
+        fields = [_meta_key(entry.meta)]
+        for name, value in zip(entry._fields[1:], entry[1:]):
+            if name == 'postings':
+                value = [posting._replace(meta=_meta_key(posting.meta))
+                         for posting in value]
+            elif name in ('tags', 'links') and value:
+                value = sorted(value)
+            fields.append(value)
+        md5.update(repr((type(entry).__name__, fields)).encode('utf8'))
+
+
+def _meta_key(meta):
+    """Get a value to hash for a metadata dict.
+
+    Args:
+      meta: A metadata dict, or None.
+    Returns:
+      The filename and line number, if that's all the dict holds, or else the
+      dict itself.
+    """
+    if meta is not None and len(meta) == 2 and 'filename' in meta and 'lineno' in meta:
+        return (meta['filename'], meta['lineno'])
+    return meta
+
+
+def compute_checkpoint_key(entries, options_map):
+    """Compute the key of a checkpoint.
+
+    Args:
+      entries: A list of the incomplete directives before the checkpoint.
+      options_map: An options dict as produced by the parser.
+    Returns:
+      A string, the hexadecimal hash of the entries and booking options.
+    """
+    md5 = new_checkpoint_hash(options_map)
+    update_checkpoint_hash(md5, entries)
+    return md5.hexdigest()
+
+
 def validate_missing_eliminated(entries, unused_options_map):
     """Validate that all the missing bits of postings have been eliminated.
 
@@ -73,8 +73,9 @@ __copyright__ = "Copyright (C) 2015-2017  Martin Blais"
 __license__ = "GNU GPLv2"
 
 import collections
-import copy
 import enum
+import multiprocessing
+import multiprocessing.pool
 from typing import Text
 import uuid
 
@@ -88,6 +89,7 @@ from beancount.core.position import Position
 from beancount.core.position import Cost
 from beancount.core.position import CostSpec
 from beancount.parser import booking_method
+from beancount.parser import lot_index
 from beancount.core import position
 from beancount.core import inventory
 from beancount.core import interpolate
@@ -102,6 +104,22 @@ def unique_label() -> Text:
 SelfReduxError = collections.namedtuple('SelfReduxError', 'source message entry')
 
 
+# The maximum number of processes used to book independent chains of accounts
+# in parallel. The processes are forked and inherit the entries, so only the
+# booked transactions are transferred back to this process. Forking a process
+# which runs other threads isn't safe, so this is disabled by default; raise it
+# (e.g. to os.cpu_count()) from a single-threaded program with large ledgers.
+BOOKING_PROCESSES = 1
+
+# The number of transactions below which we don't bother starting processes to
+# book them.
+PARALLEL_BOOKING_THRESHOLD = 20000
+
+# The inputs of the booking being run in parallel, inherited by the worker
+# processes, or None.
+_booking_state = None
+
+
 def book(entries, options_map, methods):
     """Interpolate missing data from the entries using the full historical algorithm.
     See the internal implementation _book() for details.
@@ -113,7 +131,7 @@ def book(entries, options_map, methods):
     return entries, errors
 
 
-def _book(entries, options_map, methods):
+def _book(entries, options_map, methods, balances=None):
     """Interpolate missing data from the entries using the full historical algorithm.
 
     Args:
@@ -122,100 +140,298 @@ def _book(entries, options_map, methods):
       options_map: An options dict as produced by the parser.
       methods: A mapping of account name to their corresponding booking
         method.
+      balances: A dict of account name to the Inventory of its balance before
+        the entries, to resume booking from, or None to start from empty
+        balances. It is not modified.
     Returns:
       A triple of
         entries: A list of interpolated entries with all their postings completed.
         errors: New errors produced during interpolation.
         balances: A dict of account name and resulting balances.
     """
+    if (BOOKING_PROCESSES >= 2 and
+        len(entries) >= PARALLEL_BOOKING_THRESHOLD and
+        'fork' in multiprocessing.get_all_start_methods()):
+        chains = split_chains(entries)
+        if len(chains) >= 2:
+            try:
+                return _book_parallel(entries, options_map, methods, chains, balances)
+            except multiprocessing.pool.MaybeEncodingError:
+                # The booked transactions could not be pickled; book them here.
+                pass
+
     new_entries = []
     errors = []
-    balances = collections.defaultdict(inventory.Inventory)
+    balances_index = lot_index.LotIndex(copy_balances(balances or {}))
     for entry in entries:
         if isinstance(entry, Transaction):
-            # Group postings by currency.
-            refer_groups, cat_errors = categorize_by_currency(entry, balances)
-            if cat_errors:
-                errors.extend(cat_errors)
+            entry, entry_errors = book_transaction(entry, options_map, methods,
+                                                   balances_index)
+            errors.extend(entry_errors)
+            if entry is None:
                 continue
-            posting_groups = replace_currencies(entry.postings, refer_groups)
-
-            # Get the list of tolerances.
-            tolerances = interpolate.infer_tolerances(entry.postings, options_map)
-
-            # Resolve reductions to a particular lot in their inventory balance.
-            repl_postings = []
-            for currency, group_postings in posting_groups:
-                # Important note: the group of 'postings' here is a subset of
-                # that from entry.postings, and may include replicated
-                # auto-postings. Never use entry.postings going forward.
-
-                # (See http://furius.ca/beancount/doc/self-reductions for an
-                # explanation of how we will eventually treat each currency
-                # group in this block; Summary: We will need to run the
-                # reductions prior to the augmentations in order to support
-                # reductions between the postings of a single transaction.)
-                # Disabled.
-                if False:  # pylint: disable=using-constant-test
-                    if has_self_reduction(group_postings, methods):
-                        errors.append(SelfReduxError(
-                            entry.meta, "Self-reduction is not allowed", entry))
-
-                # Perform booking reductions, that is, match postings which
-                # reduce the ante-inventory of their accounts to an existing
-                # position in the inventory against a possibly incomplete
-                # CostSpec specification, and replace the postings' cost to the
-                # fully-specified (with a date & label) existing Cost instance.
-                # Note that 'balances' remains untouched.
-                #
-                # Also note that 'booked_postings' may include augmenting
-                # postings whose 'cost' attribute has been left to a CostSpec
-                # instance. Therefore, the postings held-at-cost may hold a
-                # mixture of Cost and CostSpec instances. This is necessary to
-                # let the interpolation do its magic on partially incomplete
-                # CostSpec instances below.
-                (booked_postings,
-                 booking_errors) = book_reductions(entry, group_postings, balances,
-                                                   methods)
-
-                # If there were any errors, skip this group of postings.
-                if booking_errors:
-                    errors.extend(booking_errors)
-                    continue
-
-                # Interpolate missing numbers from all postings. This
-                # includes partially incomplete CostSpec instances remaining
-                # on augmenting postings. After this interpolation, all
-                # 'inter_postings' consists entirely of postings holding
-                # instances of Cost.
-                (inter_postings,
-                 interpolation_errors,
-                 interpolated) = interpolate_group(booked_postings, balances, currency,
-                                                   tolerances)
-
-                if interpolation_errors:
-                    errors.extend(interpolation_errors)
-                repl_postings.extend(inter_postings)
-
-            # Replace postings by interpolated ones.
-            meta = entry.meta.copy()
-            meta[interpolate.AUTOMATIC_TOLERANCES] = tolerances
-            entry = entry._replace(postings=repl_postings,
-                                   meta=meta)
-
-            # Update the running balances for each account using the final,
-            # booked and interpolated values. Note that we could optimize away
-            # some of this in book_reductions() but we choose not to do so, as a
-            # sanity check that the direct aggregation of the final booked lots
-            # will compute the same result as that during the book_reductions()
-            # process.
-            for posting in repl_postings:
-                balance = balances[posting.account]
-                balance.add_position(posting)
+        new_entries.append(entry)
+
+    return new_entries, errors, balances_index.balances
+
+
+def book_transaction(entry, options_map, methods, balances_index):
+    """Book and interpolate a single transaction against the running balances.
+
+    Args:
+      entry: An instance of Transaction, possibly incomplete.
+      options_map: An options dict as produced by the parser.
+      methods: A mapping of account name to their corresponding booking
+        method.
+      balances_index: An instance of LotIndex of the balances of the accounts
+        before the transaction. It is updated with the booked postings.
+    Returns:
+      A pair of
+        entry: The booked transaction, or None if it could not be categorized
+          and must be left out.
+        errors: A list of the errors produced while booking it.
+    """
+    errors = []
+    balances = balances_index.balances
+
+    # Group postings by currency.
+    refer_groups, cat_errors = categorize_by_currency(entry, balances,
+                                                      balances_index)
+    if cat_errors:
+        return None, cat_errors
+    posting_groups = replace_currencies(entry.postings, refer_groups)
+
+    # Get the list of tolerances.
+    tolerances = interpolate.infer_tolerances(entry.postings, options_map)
+
+    # Resolve reductions to a particular lot in their inventory balance.
+    repl_postings = []
+    for currency, group_postings in posting_groups:
+        # Important note: the group of 'postings' here is a subset of
+        # that from entry.postings, and may include replicated
+        # auto-postings. Never use entry.postings going forward.
+
+        # (See http://furius.ca/beancount/doc/self-reductions for an
+        # explanation of how we will eventually treat each currency
+        # group in this block; Summary: We will need to run the
+        # reductions prior to the augmentations in order to support
+        # reductions between the postings of a single transaction.)
+        # Disabled.
+        if False:  # pylint: disable=using-constant-test
+            if has_self_reduction(group_postings, methods):
+                errors.append(SelfReduxError(
+                    entry.meta, "Self-reduction is not allowed", entry))
+
+        # Perform booking reductions, that is, match postings which
+        # reduce the ante-inventory of their accounts to an existing
+        # position in the inventory against a possibly incomplete
+        # CostSpec specification, and replace the postings' cost to the
+        # fully-specified (with a date & label) existing Cost instance.
+        # Note that 'balances' remains untouched.
+        #
+        # Also note that 'booked_postings' may include augmenting
+        # postings whose 'cost' attribute has been left to a CostSpec
+        # instance. Therefore, the postings held-at-cost may hold a
+        # mixture of Cost and CostSpec instances. This is necessary to
+        # let the interpolation do its magic on partially incomplete
+        # CostSpec instances below.
+        (booked_postings,
+         booking_errors) = book_reductions(entry, group_postings, balances,
+                                           methods, balances_index)
+
+        # If there were any errors, skip this group of postings.
+        if booking_errors:
+            errors.extend(booking_errors)
+            continue
+
+        # Interpolate missing numbers from all postings. This
+        # includes partially incomplete CostSpec instances remaining
+        # on augmenting postings. After this interpolation, all
+        # 'inter_postings' consists entirely of postings holding
+        # instances of Cost.
+        (inter_postings,
+         interpolation_errors,
+         interpolated) = interpolate_group(booked_postings, balances, currency,
+                                           tolerances)
+
+        if interpolation_errors:
+            errors.extend(interpolation_errors)
+        repl_postings.extend(inter_postings)
+
+    # Replace postings by interpolated ones.
+    meta = entry.meta.copy()
+    meta[interpolate.AUTOMATIC_TOLERANCES] = tolerances
+    entry = entry._replace(postings=repl_postings,
+                           meta=meta)
+
+    # Update the running balances for each account using the final,
+    # booked and interpolated values. Note that we could optimize away
+    # some of this in book_reductions() but we choose not to do so, as a
+    # sanity check that the direct aggregation of the final booked lots
+    # will compute the same result as that during the book_reductions()
+    # process.
+    for posting in repl_postings:
+        balances_index.add_position(posting.account, posting)
+
+    return entry, errors
+
+
+def split_chains(entries):
+    """Split the transactions into chains of transactions on independent accounts.
+
+    The transactions which have an account in common are in the same chain, so
+    that the chains can be booked independently of each other, each in the
+    order of the entries. A transaction without postings is a chain of its own.
+
+    Args:
+      entries: A list of directives.
+    Returns:
+      A list of chains, each a list of the indexes of its transactions in
+      'entries', in increasing order.
+    """
+    # Merge the sets of accounts which appear in the same transactions, with a
+    # union-find structure of account names.
+    parents = {}
+    def find(account):
+        root = account
+        while parents[root] != root:
+            root = parents[root]
+        while account != root:
+            parents[account], account = root, parents[account]
+        return root
+
+    transactions = []
+    for index, entry in enumerate(entries):
+        if not isinstance(entry, Transaction):
+            continue
+        if not entry.postings:
+            transactions.append((index, None))
+            continue
+        root = None
+        for posting in entry.postings:
+            account = posting.account
+            if account not in parents:
+                parents[account] = account
+            account_root = find(account)
+            if root is None:
+                root = account_root
+            elif account_root != root:
+                parents[account_root] = root
+        transactions.append((index, entry.postings[0].account))
+
+    chains = {}
+    for index, account in transactions:
+        key = index if account is None else find(account)
+        chains.setdefault(key, []).append(index)
+    return sorted(chains.values())
+
+
+def copy_balances(balances, accounts=None):
+    """Copy the inventories of the balances of accounts.
 
+    Args:
+      balances: A dict of account name to Inventory instance.
+      accounts: A set of the account names to copy, or None for all of them.
+    Returns:
+      A new dict of account name to a copy of its Inventory.
+    """
+    return {account: inventory.Inventory(balance)
+            for account, balance in balances.items()
+            if accounts is None or account in accounts}
+
+
+def _book_parallel(entries, options_map, methods, chains, balances=None):
+    """Book independent chains of transactions in forked processes.
+
+    The chains are distributed among at most BOOKING_PROCESSES groups, the
+    largest first, each to the group with the fewest transactions. This process
+    books the first group itself while forked workers book the others, because
+    transferring the booked transactions back costs about as much as booking
+    them. The results are merged back in the order of the entries, so they are
+    the same as those of booking all the entries in sequence.
+
+    Args:
+      entries: A list of directives, as for _book().
+      options_map: An options dict, as for _book().
+      methods: A mapping of account name to booking method, as for _book().
+      chains: A list of chains of transaction indexes, as from split_chains().
+      balances: A dict of the initial balances, or None, as for _book().
+    Returns:
+      The same triple as _book().
+    Raises:
+      multiprocessing.pool.MaybeEncodingError: If the booked transactions could
+        not be pickled.
+    """
+    global _booking_state  # pylint: disable=global-statement
+    num_processes = min(BOOKING_PROCESSES, len(chains))
+    groups = [[] for _ in range(num_processes)]
+    for chain in sorted(chains, key=len, reverse=True):
+        min(groups, key=len).extend(chain)
+    for group in groups:
+        group.sort()
+
+    balances = balances or {}
+    _booking_state = (entries, options_map, methods, balances)
+    try:
+        with multiprocessing.get_context('fork').Pool(num_processes - 1) as pool:
+            async_results = pool.map_async(_book_group_forked, groups[1:], chunksize=1)
+            results = [_book_group(entries, options_map, methods, balances, groups[0])]
+            results.extend(async_results.get())
+    finally:
+        _booking_state = None
+
+    booked = {}
+    new_balances = collections.defaultdict(inventory.Inventory, copy_balances(balances))
+    for group_booked, group_balances in results:
+        booked.update(group_booked)
+        new_balances.update(group_balances)
+
+    new_entries = []
+    errors = []
+    for index, entry in enumerate(entries):
+        if isinstance(entry, Transaction):
+            entry, entry_errors = booked[index]
+            errors.extend(entry_errors)
+            if entry is None:
+                continue
         new_entries.append(entry)
+    return new_entries, errors, new_balances
+
+
+def _book_group_forked(indexes):
+    """Book a group of chains of transactions in a worker process.
+
+    Args:
+      indexes: A sorted list of the indexes of the transactions to book, in the
+        entries inherited from the parent.
+    Returns:
+      The result of _book_group().
+    """
+    entries, options_map, methods, balances = _booking_state
+    return _book_group(entries, options_map, methods, balances, indexes)
 
-    return new_entries, errors, balances
+
+def _book_group(entries, options_map, methods, balances, indexes):
+    """Book a group of chains of transactions.
+
+    Args:
+      entries: A list of directives, as for _book().
+      options_map: An options dict, as for _book().
+      methods: A mapping of account name to booking method, as for _book().
+      balances: A dict of the initial balances of the accounts, as for _book().
+      indexes: A sorted list of the indexes of the transactions to book.
+    Returns:
+      A pair of a dict of transaction index to the result of book_transaction(),
+      and a dict of the account names of the group to their final balances.
+    """
+    accounts = {posting.account
+                for index in indexes
+                for posting in entries[index].postings}
+    balances_index = lot_index.LotIndex(copy_balances(balances, accounts))
+    booked = {index: book_transaction(entries[index], options_map, methods,
+                                      balances_index)
+              for index in indexes}
+    return booked, dict(balances_index.balances)
 
 
 # An error raised if we failed to bucket a posting to a particular currency.
@@ -244,7 +460,7 @@ def get_bucket_currency(refer):
 Refer = collections.namedtuple('Refer', 'index units_currency cost_currency price_currency')
 
 
-def categorize_by_currency(entry, balances):
+def categorize_by_currency(entry, balances, balances_index=None):
     """Group the postings by the currency they declare.
 
     This is used to prepare the postings for the next stages: Interpolation and
@@ -274,6 +490,8 @@ def categorize_by_currency(entry, balances):
       postings: A list of incomplete postings to categorize.
       balances: A dict of currency to inventory contents before the transaction is
         applied.
+      balances_index: An instance of LotIndex of 'balances', or None, to create
+        one.
     Returns:
       A list of (currency string, list of tuples) items describing each postings
       and its interpolated currencies, and a list of generated errors for
@@ -285,6 +503,8 @@ def categorize_by_currency(entry, balances):
         price_currency: The interpolated currency for price.
     """
     errors = []
+    if balances_index is None:
+        balances_index = lot_index.LotIndex(balances)
 
     groups = collections.defaultdict(list)
     sortdict = {}
@@ -356,17 +576,14 @@ def categorize_by_currency(entry, balances):
     for refer in unknown:
         (index, units_currency, cost_currency, price_currency) = refer
         posting = entry.postings[index]
-        balance = balances.get(posting.account, None)
-        if balance is None:
-            balance = inventory.Inventory()
 
         if units_currency is MISSING:
-            balance_currencies = balance.currencies()
+            balance_currencies = balances_index.get_currencies(posting.account)
             if len(balance_currencies) == 1:
                 units_currency = balance_currencies.pop()
 
         if cost_currency is MISSING or price_currency is MISSING:
-            balance_cost_currencies = balance.cost_currencies()
+            balance_cost_currencies = balances_index.get_cost_currencies(posting.account)
             if len(balance_cost_currencies) == 1:
                 balance_cost_currency = balance_cost_currencies.pop()
                 if price_currency is MISSING:
@@ -392,10 +609,7 @@ def categorize_by_currency(entry, balances):
         for rindex, refer in enumerate(refers):
             if refer.units_currency is MISSING:
                 posting = entry.postings[refer.index]
-                balance = balances.get(posting.account, None)
-                if balance is None:
-                    continue
-                balance_currencies = balance.currencies()
+                balance_currencies = balances_index.get_currencies(posting.account)
                 if len(balance_currencies) == 1:
                     refers[rindex] = refer._replace(units_currency=balance_currencies.pop())
 
@@ -502,7 +716,7 @@ def has_self_reduction(postings, methods):
 
 
 def book_reductions(entry, group_postings, balances,
-                    methods):
+                    methods, balances_index=None):
     """Book inventory reductions against the ante-balances.
 
     This function accepts a dict of (account, Inventory balance) and for each
@@ -522,6 +736,9 @@ def book_reductions(entry, group_postings, balances,
       balances: A dict of account name to inventory contents.
       methods: A mapping of account name to their corresponding booking
         method enum.
+      balances_index: An instance of LotIndex of 'balances', or None, to create
+        one. The lots are matched using this index rather than by scanning the
+        balances.
     Returns:
       A pair of
         booked_postings: A list of booked postings, with reducing lots resolved
@@ -533,29 +750,26 @@ def book_reductions(entry, group_postings, balances,
         errors: A list of errors, if there were any.
     """
     errors = []
+    if balances_index is None:
+        balances_index = lot_index.LotIndex(balances)
 
-    # A local copy of the balances dictionary which is updated just for the
+    # The changes to the balances of the accounts which are applied just for the
     # duration of this function's updates, in order to take into account the
-    # cumulative effect of all the postings inferred here
-    local_balances = {}
+    # cumulative effect of all the postings inferred here. Note: We ensure there
+    # is no mutation on 'balances' to keep this function without side-effects.
+    #
+    # Also note that if there is no existing balance, then won't be any lot
+    # reduction because none of the postings will be able to match against
+    # any currencies of the balance.
+    local_changes = collections.defaultdict(inventory.Inventory)
 
-    empty = inventory.Inventory()
     booked_postings = []
     for posting in group_postings:
         # Process a single posting.
         units = posting.units
         costspec = posting.cost
         account = posting.account
-
-        # Note: We ensure there is no mutation on 'balances' to keep this
-        # function without side-effects. Note that we may be able to optimize
-        # performance later on by giving up this property.
-        #
-        # Also note that if there is no existing balance, then won't be any lot
-        # reduction because none of the postings will be able to match against
-        # any currencies of the balance.
-        previous_balance = balances.get(account, empty)
-        balance = local_balances.setdefault(account, copy.copy(previous_balance))
+        changes = local_changes.get(account)
 
         # Check if this is a lot held at cost.
         if costspec is None or units.number is MISSING:
@@ -566,41 +780,23 @@ def book_reductions(entry, group_postings, balances,
             # augmentation.
             method = methods[account]
             if (method is not Booking.NONE and
-                balance is not None and
-                balance.is_reduced_by(units)):
+                balances_index.is_reduced_by(account, units, changes)):
                 # This posting is a reduction.
 
-                # Match the positions.
+                # Match the positions held at cost in the balance against the
+                # cost spec. For FIFO and LIFO, only the positions which the
+                # posting reduces are returned.
                 cost_number = compute_cost_number(costspec, units)
-                matches = []
-                for position in balance:
-                    # Skip inventory contents of a different currency.
-                    if (units.currency and
-                        position.units.currency != units.currency):
-                        continue
-                    # Skip balance positions not held at cost.
-                    if position.cost is None:
-                        continue
-                    if (cost_number is not None and
-                        position.cost.number != cost_number):
-                        continue
-                    if (isinstance(costspec.currency, str) and
-                        position.cost.currency != costspec.currency):
-                        continue
-                    if (costspec.date and
-                        position.cost.date != costspec.date):
-                        continue
-                    if (costspec.label and
-                        position.cost.label != costspec.label):
-                        continue
-                    matches.append(position)
+                matches = balances_index.match(account, units, costspec, cost_number,
+                                               method, changes)
 
                 # Check for ambiguous matches.
                 if len(matches) == 0:
                     errors.append(
                         ReductionError(entry.meta,
                                        'No position matches "{}" against balance {}'.format(
-                                           posting, balance),
+                                           posting,
+                                           balances_index.get_balance(account, changes)),
                                        entry))
                     return [], errors  # This is irreconcilable, remove these postings.
 
@@ -620,7 +816,7 @@ def book_reductions(entry, group_postings, balances,
                 # held at cost because the other postings may need interpolation
                 # in order to be resolved properly.
                 for posting in reduction_postings:
-                    balance.add_position(posting)
+                    local_changes[account].add_position(posting)
             else:
                 # This posting is an augmentation.
                 #
@@ -2733,6 +2733,131 @@ class TestBookingApi(unittest.TestCase):
             self.assertEqual(entry.postings[1].units, A('-100.00 USD'))
 
 
+class TestBookParallel(unittest.TestCase):
+
+    @parser.parse_doc(allow_incomplete=True)
+    def test_split_chains(self, entries, _, __):
+        """
+        2015-01-01 open Assets:Cash
+
+        2015-01-02 * "0"
+          Assets:Invest1    10 HOOL {100.00 USD}
+          Assets:Cash1
+
+        2015-01-03 * "1"
+          Assets:Invest2    10 HOOL {100.00 USD}
+          Assets:Cash2
+
+        2015-01-04 * "2"
+          Assets:Cash3    -10.00 USD
+          Expenses:Food
+
+        2015-01-05 * "3"
+          Assets:Cash1    -10.00 USD
+          Assets:Cash2
+
+        2015-01-06 * "4"
+          Assets:Invest3    10 HOOL {100.00 USD}
+          Assets:Cash3
+        """
+        entries.append(entries[-1]._replace(postings=[]))
+        self.assertEqual([[1, 2, 4], [3, 5], [6]], bf.split_chains(entries))
+
+    @parser.parse_doc(allow_incomplete=True)
+    def test_book_parallel(self, entries, _, options_map):
+        """
+        2015-01-01 * "Invest1"
+          Assets:Invest1    10 HOOL {100.00 USD}
+          Assets:Cash1
+
+        2015-01-01 * "Invest2"
+          Assets:Invest2    10 HOOL {100.00 USD}
+          Assets:Cash2
+
+        2015-01-02 * "Invest1, reduction"
+          Assets:Invest1    -4 HOOL {}
+          Assets:Cash1
+
+        2015-01-02 * "Invest2, ambiguous"
+          Assets:Invest2    -4 HOOL {}
+          Assets:Invest2    -4 HOOL {200.00 USD}
+          Assets:Cash2
+
+        2015-01-02 balance Assets:Invest1  6 HOOL
+
+        2015-01-03 * "Invest3, cannot categorize"
+          Assets:Invest3    10 HOOL {100.00 USD}
+          Assets:Cash3
+          Assets:Other
+
+        2015-01-04 * "Invest3"
+          Assets:Invest3    10 HOOL {100.00 USD}
+          Assets:Cash3
+
+        2015-01-05 * "Invest2, reduction"
+          Assets:Invest2    -20 HOOL {100.00 USD}
+          Assets:Cash2
+        """
+        methods = collections.defaultdict(lambda: Booking.FIFO)
+        with mock.patch.object(bf, 'BOOKING_PROCESSES', 1):
+            expected = bf._book(entries, options_map, methods)
+        self.assertEqual(3, len(expected[1]))
+
+        if 'fork' not in bf.multiprocessing.get_all_start_methods():
+            self.skipTest("Forked processes are not available")
+        with mock.patch.object(bf, 'BOOKING_PROCESSES', 2), \
+             mock.patch.object(bf, 'PARALLEL_BOOKING_THRESHOLD', 0):
+            new_entries, errors, balances = bf._book(entries, options_map, methods)
+        self.assertEqual(expected[0], new_entries)
+        self.assertEqual(expected[1], errors)
+        self.assertEqual(dict(expected[2]), dict(balances))
+
+    @parser.parse_doc(allow_incomplete=True)
+    def test_book_from_balances(self, entries, _, options_map):
+        """
+        2015-01-01 * "Invest1"
+          Assets:Invest1    10 HOOL {100.00 USD}
+          Assets:Cash1
+
+        2015-01-01 * "Invest2"
+          Assets:Invest2    10 HOOL {100.00 USD}
+          Assets:Cash2
+
+        2015-01-02 * "Invest1, reduction"
+          Assets:Invest1    -4 HOOL {}
+          Assets:Cash1
+
+        2015-01-02 * "Invest2, reduction"
+          Assets:Invest2    -4 HOOL {}
+          Assets:Cash2
+        """
+        methods = collections.defaultdict(lambda: Booking.FIFO)
+        expected = bf._book(entries, options_map, methods)
+        _, _, balances = bf._book(entries[:2], options_map, methods)
+        balances = dict(balances)
+        balances_copy = bf.copy_balances(balances)
+        balances['Assets:Other'] = I('1 USD')
+
+        new_entries, errors, new_balances = bf._book(entries[2:], options_map, methods,
+                                                     balances)
+        self.assertEqual(expected[0][2:], new_entries)
+        self.assertEqual(expected[1], errors)
+        self.assertEqual(dict(expected[2], **{'Assets:Other': I('1 USD')}),
+                         dict(new_balances))
+        self.assertEqual(balances_copy['Assets:Invest1'], balances['Assets:Invest1'])
+
+        if 'fork' not in bf.multiprocessing.get_all_start_methods():
+            self.skipTest("Forked processes are not available")
+        with mock.patch.object(bf, 'BOOKING_PROCESSES', 2), \
+             mock.patch.object(bf, 'PARALLEL_BOOKING_THRESHOLD', 0):
+            new_entries, errors, new_balances = bf._book(entries[2:], options_map,
+                                                         methods, balances)
+        self.assertEqual(expected[0][2:], new_entries)
+        self.assertEqual(dict(expected[2], **{'Assets:Other': I('1 USD')}),
+                         dict(new_balances))
+        self.assertEqual(balances_copy['Assets:Invest1'], balances['Assets:Invest1'])
+
+
 # FIXME: TODO - Rewrite these tests. See average_test.py.
 class TestBook(unittest.TestCase):
 
@@ -2,6 +2,7 @@ __copyright__ = "Copyright (C) 2015-2016  Martin Blais"
 __license__ = "GNU GPLv2"
 
 import collections
+import datetime
 import re
 import textwrap
 import unittest
@@ -12,6 +13,8 @@ from beancount.core.amount import Amount
 from beancount.core.data import Booking
 from beancount.core.data import Transaction
 from beancount.core.position import Cost
+from beancount.core import inventory
+from beancount.parser import options
 from beancount.parser import parser
 from beancount.parser import cmptest
 from beancount.parser import booking
@@ -268,5 +271,112 @@ class TestBookingValidation(cmptest.TestCase):
         self.assertEqual([booking.BookingError], list(map(type, validation_errors)))
 
 
+
+class TestBookCheckpointed(unittest.TestCase):
+
+    LEDGER = textwrap.dedent("""
+      2014-01-01 open Assets:Invest  "FIFO"
+      2014-01-01 open Assets:Cash
+
+      2014-01-02 * #a #b
+        Assets:Invest     10 HOOL {100.00 USD}
+        Assets:Cash
+
+      2014-01-03 *
+        Assets:Invest     10 HOOL {110.00 USD}
+        Assets:Cash
+
+      2014-01-03 *
+        Assets:Invest     -2 HOOL {}
+        Assets:Cash
+
+      2014-01-04 *
+        Assets:Invest     -2 HOOL {120.00 USD}
+        Assets:Cash
+    """)
+
+    APPENDED = textwrap.dedent("""
+      2014-01-04 *
+        Assets:Invest     -9 HOOL {}
+        Assets:Cash
+
+      2014-01-05 *
+        Assets:Invest     -2 HOOL {}
+        Assets:Cash
+    """)
+
+    def book(self, string, checkpoint=None):
+        entries, _, options_map = parser.parse_string(string)
+        expected_entries, expected_errors = booking.book(
+            parser.parse_string(string)[0], options_map)
+        entries, errors, new_checkpoint = booking.book_checkpointed(
+            entries, options_map, checkpoint)
+        self.assertEqual(expected_entries, entries)
+        self.assertEqual(expected_errors, errors)
+        return entries, errors, new_checkpoint
+
+    def test_book_checkpointed(self):
+        entries, errors, checkpoint = self.book(self.LEDGER)
+        self.assertEqual(1, len(errors))
+        self.assertEqual(datetime.date(2014, 1, 4), checkpoint.date)
+        self.assertEqual(entries[:5], checkpoint.entries)
+        self.assertEqual([], checkpoint.errors)
+        self.assertEqual(inventory.from_string('8 HOOL {100.00 USD, 2014-01-02}, '
+                                               '10 HOOL {110.00 USD, 2014-01-03}'),
+                         checkpoint.balances['Assets:Invest'])
+
+        # Resume from the checkpoint.
+        entries, errors, new_checkpoint = self.book(self.LEDGER + self.APPENDED,
+                                                    checkpoint)
+        self.assertIs(checkpoint.entries[2], entries[2])
+        self.assertEqual(datetime.date(2014, 1, 5), new_checkpoint.date)
+        self.assertEqual(1, len(new_checkpoint.errors))
+        self.assertEqual(inventory.from_string('9 HOOL {110.00 USD, 2014-01-03}'),
+                         new_checkpoint.balances['Assets:Invest'])
+
+        # The same entries, the checkpoint is returned as is.
+        _, _, same_checkpoint = self.book(self.LEDGER, checkpoint)
+        self.assertIs(checkpoint, same_checkpoint)
+
+        # An edit before the checkpoint invalidates it.
+        entries, _, new_checkpoint = self.book(
+            self.LEDGER.replace('10 HOOL {100.00', '11 HOOL {100.00'), checkpoint)
+        self.assertIsNot(checkpoint.entries[2], entries[2])
+        self.assertNotEqual(checkpoint.key, new_checkpoint.key)
+
+        # So does a change of the options which affect booking.
+        entries, _, new_checkpoint = self.book(
+            'option "booking_method" "LIFO"\n' + self.LEDGER, checkpoint)
+        self.assertNotEqual(checkpoint.key, new_checkpoint.key)
+
+        # No entries.
+        self.assertEqual(([], [], None), booking.book_checkpointed(
+            [], options.OPTIONS_DEFAULTS.copy(), None))
+
+    def test_compute_checkpoint_key(self):
+        entries, _, options_map = parser.parse_string(self.LEDGER)
+        key = booking.compute_checkpoint_key(entries, options_map)
+        self.assertEqual(key, booking.compute_checkpoint_key(
+            parser.parse_string(self.LEDGER)[0], options_map))
+        self.assertNotEqual(key, booking.compute_checkpoint_key(entries[:-1], options_map))
+        self.assertNotEqual(key, booking.compute_checkpoint_key(
+            parser.parse_string(self.LEDGER.replace('#a #b', '#a'))[0], options_map))
+        self.assertNotEqual(key, booking.compute_checkpoint_key(
+            parser.parse_string('\n' + self.LEDGER)[0], options_map))
+
+        # The metadata of the postings is hashed.
+        entries[2].postings[1].meta['note'] = 'Hello'
+        self.assertNotEqual(key, booking.compute_checkpoint_key(entries, options_map))
+
+    def test_bisect_date(self):
+        entries, _, _ = parser.parse_string(self.LEDGER)
+        for date, index in [(datetime.date(2013, 1, 1), 0),
+                            (datetime.date(2014, 1, 1), 0),
+                            (datetime.date(2014, 1, 3), 3),
+                            (datetime.date(2014, 1, 4), 5),
+                            (datetime.date(2014, 1, 5), 6)]:
+            self.assertEqual(index, booking.bisect_date(entries, date))
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.4.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison implementation for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2019 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -34,6 +34,10 @@
 /* C LALR(1) parser skeleton written by Richard Stallman, by
    simplifying the original so-called "semantic" parser.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 /* All symbols defined below should begin with yy or YY, to avoid
    infringing on user name space.  This should be done even for local
    variables, as they might otherwise be expanded by user macros.
@@ -41,23 +45,20 @@
    define necessary library symbols; they are noted "INFRINGES ON
    USER NAME SPACE" below.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
-
-/* Identify Bison output.  */
-#define YYBISON 1
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
 
-/* Bison version.  */
-#define YYBISON_VERSION "3.4"
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
 
 /* Pure parsers.  */
-#define YYPURE 1
+#define YYPURE 2
 
 /* Push parsers.  */
-#define YYPUSH 0
+#define YYPUSH 1
 
 /* Pull parsers.  */
 #define YYPULL 1
@@ -70,6 +71,7 @@
 
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <assert.h>
 #include "parser.h"
 #include "lexer.h"
@@ -80,23 +82,51 @@
  * in the handler. Always run the code to clean the references provided by the
  * reduced rule. {05bb0fb60e86}
  */
-#define BUILDY(clean, target, method_name, format, ...)                         \
-    target = PyObject_CallMethod(builder, method_name, format, __VA_ARGS__);    \
+#define BUILDY(clean, target, method, format, ...)                              \
+    target = CALL_BUILDER(DISPATCH, builder, method, format, __VA_ARGS__);      \
+    clean;                                                                      \
+    if (target == NULL) {                                                       \
+        build_grammar_error_from_exception(scanner, builder);                   \
+        YYERROR;                                                                \
+    }
+
+
+/*
+ * Like BUILDY, but create the object by evaluating the given C expression
+ * instead of calling the builder method, if the builder does not override the
+ * methods of grammar.Builder (see native_builder_initialize()). The expression
+ * must behave like the method call: borrow its arguments and return a new
+ * reference, or NULL with an exception set.
+ */
+#define BUILDN(clean, target, native_expr, method, format, ...)                \
+    target = (NATIVE->enabled ?                                                 \
+              (native_expr) :                                                   \
+              CALL_BUILDER(DISPATCH, builder, method, format, __VA_ARGS__));    \
     clean;                                                                      \
     if (target == NULL) {                                                       \
-        build_grammar_error_from_exception();                                   \
+        build_grammar_error_from_exception(scanner, builder);                   \
         YYERROR;                                                                \
     }
 
+/* The state for creating objects natively in the current parse. */
+#define NATIVE  (&yyget_extra(scanner)->native)
 
-/* First line of reported file/line string. This is used as #line. */
-int yy_firstline;
+/* The dispatch table of the builder methods in the current parse. */
+#define DISPATCH  (&yyget_extra(scanner)->dispatch)
 
-#define FILE_LINE_ARGS  yy_filename, ((yyloc).first_line + yy_firstline)
+/* The list receiving the entries as they are reduced, when streaming. */
+#define STREAM  (yyget_extra(scanner)->stream)
+
+
+/* The filename and line number of the current rule, for the builder methods.
+ * The first line of the reported file/line string is stored on the lexer
+ * state and is used as #line. */
+#define LINE_ARG        ((yyloc).first_line + yyget_extra(scanner)->firstline)
+#define FILE_LINE_ARGS  yyget_extra(scanner)->filename, LINE_ARG
 
 
 /* Build a grammar error from the exception context. */
-void build_grammar_error_from_exception(void)
+void build_grammar_error_from_exception(yyscan_t scanner, PyObject* builder)
 {
     TRACE_ERROR("Grammar Builder Exception");
 
@@ -112,12 +142,17 @@ void build_grammar_error_from_exception(void)
 
     if (pvalue != NULL) {
         /* Build and accumulate a new error object. {27d1d459c5cd} */
-        PyObject* rv = PyObject_CallMethod(builder, "build_grammar_error", "siOOO",
-                                           yy_filename, yylineno + yy_firstline,
-                                           pvalue, ptype, ptraceback);
+        yyextra_t* extra = yyget_extra(scanner);
+        /* Exceptions raised from C code may not have a traceback. */
+        PyObject* rv = CALL_BUILDER(&extra->dispatch, builder, build_grammar_error,
+                                    "siOOO",
+                                    extra->filename,
+                                    yyget_lineno(scanner) + extra->firstline,
+                                    pvalue, ptype,
+                                    ptraceback != NULL ? ptraceback : Py_None);
         Py_DECREF(ptype);
         Py_DECREF(pvalue);
-        Py_DECREF(ptraceback);
+        Py_XDECREF(ptraceback);
 
         if (rv == NULL) {
             /* Note: Leave the internal error trickling up its detail. */
@@ -134,7 +169,7 @@ void build_grammar_error_from_exception(void)
 
 
 /* Error-handling function. {ca6aab8b9748} */
-void yyerror(char const* message)
+void yyerror(YYLTYPE* locp, yyscan_t scanner, PyObject* builder, char const* message)
 {
     /* Skip lex errors: they have already been registered the lexer itself. */
     if (strstr(message, "LEX_ERROR") != NULL) {
@@ -142,9 +177,12 @@ void yyerror(char const* message)
     }
     else {
         /* Register a syntax error with the builder. */
-        PyObject* rv = PyObject_CallMethod(builder, "build_grammar_error", "sis",
-                                           yy_filename, yylineno + yy_firstline,
-                                           message);
+        yyextra_t* extra = yyget_extra(scanner);
+        PyObject* rv = CALL_BUILDER(&extra->dispatch, builder, build_grammar_error,
+                                    "sis",
+                                    extra->filename,
+                                    yyget_lineno(scanner) + extra->firstline,
+                                    message);
         if (rv == NULL) {
             PyErr_SetString(PyExc_RuntimeError,
                             "Internal error: Building exception from yyerror()");
@@ -166,8 +204,540 @@ const char* getTokenName(int token);
 #define DECREF6(x1, x2, x3, x4, x5, x6)    DECREF5(x1, x2, x3, x4, x5); Py_DECREF(x6);
 
 
-#line 170 "beancount/parser/grammar.c"
+/*
+ * Native creation of the most common objects.
+ *
+ * Transactions, their postings, amounts, metadata and the temporary lists are
+ * by far the most frequent reductions. When the builder uses the stock
+ * grammar.Builder methods for them, they are created here directly as the
+ * same namedtuple types those methods return, which avoids a Python call for
+ * each. The functions below mirror these methods; keep them in sync.
+ */
+
+/* The types of the objects created natively, imported on first use. */
+static PyObject* amount_type = NULL;
+static PyObject* posting_type = NULL;
+static PyObject* transaction_type = NULL;
+static PyObject* key_value_type = NULL;
+static PyObject* tags_links_type = NULL;
+static PyObject* parser_error_type = NULL;
+static PyObject* builder_type = NULL;
+static PyObject* empty_set = NULL;
+static PyObject* empty_string = NULL;
+static PyObject* filename_key = NULL;
+static PyObject* lineno_key = NULL;
+
+/* Import an attribute from a module. Returns a new reference. */
+static PyObject* import_attribute(const char* module_name, const char* name)
+{
+    PyObject* module = PyImport_ImportModule(module_name);
+    PyObject* attribute;
+    if ( module == NULL ) {
+        return NULL;
+    }
+    attribute = PyObject_GetAttrString(module, name);
+    Py_DECREF(module);
+    return attribute;
+}
+
+/* Import the types used to create objects natively. These modules cannot be
+ * imported when this extension module is initialized, since they import it. */
+static int import_native_types(void)
+{
+    if ( builder_type != NULL ) {
+        return 0;
+    }
+    amount_type = import_attribute("beancount.core.amount", "Amount");
+    posting_type = import_attribute("beancount.core.data", "Posting");
+    transaction_type = import_attribute("beancount.core.data", "Transaction");
+    empty_set = import_attribute("beancount.core.data", "EMPTY_SET");
+    key_value_type = import_attribute("beancount.parser.grammar", "KeyValue");
+    tags_links_type = import_attribute("beancount.parser.grammar", "TagsLinks");
+    parser_error_type = import_attribute("beancount.parser.grammar", "ParserError");
+    empty_string = PyUnicode_FromString("");
+    filename_key = PyUnicode_InternFromString("filename");
+    lineno_key = PyUnicode_InternFromString("lineno");
+    if ( amount_type == NULL || posting_type == NULL || transaction_type == NULL ||
+         empty_set == NULL || key_value_type == NULL || tags_links_type == NULL ||
+         parser_error_type == NULL || empty_string == NULL ||
+         filename_key == NULL || lineno_key == NULL ) {
+        Py_CLEAR(amount_type);
+        Py_CLEAR(posting_type);
+        Py_CLEAR(transaction_type);
+        Py_CLEAR(empty_set);
+        Py_CLEAR(key_value_type);
+        Py_CLEAR(tags_links_type);
+        Py_CLEAR(parser_error_type);
+        Py_CLEAR(empty_string);
+        Py_CLEAR(filename_key);
+        Py_CLEAR(lineno_key);
+        return -1;
+    }
+    builder_type = import_attribute("beancount.parser.grammar", "Builder");
+    return builder_type == NULL ? -1 : 0;
+}
+
+/* Return true if the builder's method is the one defined by grammar.Builder.
+ * The function is checked by name too, in case it has been replaced on the
+ * class itself, e.g., by tests. */
+static int is_default_builder_method(PyObject* builder, const char* method_name)
+{
+    PyObject* default_function = PyObject_GetAttrString(builder_type, method_name);
+    PyObject* method = PyObject_GetAttrString(builder, method_name);
+    PyObject* qualname = NULL;
+    const char* qualname_str = NULL;
+    int result = (default_function != NULL && method != NULL &&
+                  PyMethod_Check(method) &&
+                  PyMethod_GET_FUNCTION(method) == default_function &&
+                  PyMethod_GET_SELF(method) == builder &&
+                  PyFunction_Check(default_function) &&
+                  (qualname = PyObject_GetAttrString(default_function,
+                                                     "__qualname__")) != NULL &&
+                  PyUnicode_Check(qualname) &&
+                  (qualname_str = PyUnicode_AsUTF8(qualname)) != NULL &&
+                  strncmp(qualname_str, "Builder.", 8) == 0 &&
+                  strcmp(qualname_str + 8, method_name) == 0);
+    Py_XDECREF(qualname);
+    Py_XDECREF(default_function);
+    Py_XDECREF(method);
+    PyErr_Clear();
+    return result;
+}
+
+static PyObject* new_tags_links(void);
+
+/* Enable creating objects natively if the builder allows it. */
+void native_builder_initialize(native_builder_t* native, PyObject* builder,
+                               const char* filename)
+{
+    static const char* method_names[] = {
+        "amount", "dcupdate", "handle_list", "key_value", "posting",
+        "tag_link_new", "tag_link_TAG", "tag_link_LINK",
+        "transaction", "finalize_tags_links", "unpack_txn_strings", NULL};
+    const char** name;
+
+    memset(native, 0, sizeof(native_builder_t));
+    if ( import_native_types() < 0 ) {
+        PyErr_Clear();
+        return;
+    }
+    for ( name = method_names; *name != NULL; ++name ) {
+        if ( !is_default_builder_method(builder, *name) ) {
+            return;
+        }
+    }
+
+    native->filename = PyUnicode_FromString(filename);
+    native->errors = PyObject_GetAttrString(builder, "errors");
+    native->tags = PyObject_GetAttrString(builder, "tags");
+    native->meta = PyObject_GetAttrString(builder, "meta");
+    native->dcupdate = PyObject_GetAttrString(builder, "_dcupdate");
+    if ( native->filename == NULL ||
+         native->errors == NULL || !PyList_Check(native->errors) ||
+         native->tags == NULL || !PyList_Check(native->tags) ||
+         native->meta == NULL || !PyDict_Check(native->meta) ||
+         native->dcupdate == NULL ||
+         (native->empty_tags_links = new_tags_links()) == NULL ) {
+        native_builder_finalize(native);
+        PyErr_Clear();
+        return;
+    }
+    native->enabled = 1;
+}
+
+void native_builder_finalize(native_builder_t* native)
+{
+    Py_CLEAR(native->filename);
+    Py_CLEAR(native->errors);
+    Py_CLEAR(native->tags);
+    Py_CLEAR(native->meta);
+    Py_CLEAR(native->dcupdate);
+    Py_CLEAR(native->empty_tags_links);
+    native->enabled = 0;
+}
+
+/* Create an instance of a namedtuple type from borrowed references to its
+ * fields, bypassing its Python constructor. */
+static PyObject* native_tuple(PyObject* type, Py_ssize_t size, ...)
+{
+    PyObject* tuple = ((PyTypeObject*)type)->tp_alloc((PyTypeObject*)type, size);
+    va_list args;
+    Py_ssize_t i;
+    if ( tuple == NULL ) {
+        return NULL;
+    }
+    va_start(args, size);
+    for ( i = 0; i < size; ++i ) {
+        PyObject* item = va_arg(args, PyObject*);
+        Py_INCREF(item);
+        PyTuple_SET_ITEM(tuple, i, item);
+    }
+    va_end(args);
+    return tuple;
+}
+
+/* See data.new_metadata(). */
+static PyObject* native_metadata(native_builder_t* native, int lineno)
+{
+    PyObject* meta = PyDict_New();
+    PyObject* pylineno = PyLong_FromLong(lineno);
+    if ( meta == NULL || pylineno == NULL ||
+         PyDict_SetItem(meta, filename_key, native->filename) < 0 ||
+         PyDict_SetItem(meta, lineno_key, pylineno) < 0 ) {
+        Py_XDECREF(meta);
+        Py_XDECREF(pylineno);
+        return NULL;
+    }
+    Py_DECREF(pylineno);
+    return meta;
+}
+
+/* Append a ParserError to the builder's errors. Steals the message. */
+static int native_error(native_builder_t* native, PyObject* meta, PyObject* message)
+{
+    PyObject* error;
+    int result;
+    if ( message == NULL ) {
+        return -1;
+    }
+    error = native_tuple(parser_error_type, 3, meta, message, Py_None);
+    Py_DECREF(message);
+    if ( error == NULL ) {
+        return -1;
+    }
+    result = PyList_Append(native->errors, error);
+    Py_DECREF(error);
+    return result;
+}
+
+/* Add all the elements of an iterable to a set. */
+static int set_update(PyObject* set, PyObject* iterable)
+{
+    PyObject* iterator = PyObject_GetIter(iterable);
+    PyObject* item;
+    if ( iterator == NULL ) {
+        return -1;
+    }
+    while ( (item = PyIter_Next(iterator)) != NULL ) {
+        int result = PySet_Add(set, item);
+        Py_DECREF(item);
+        if ( result < 0 ) {
+            break;
+        }
+    }
+    Py_DECREF(iterator);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+/* See Builder.handle_list(). */
+static PyObject* native_handle_list(PyObject* object_list, PyObject* new_object)
+{
+    if ( object_list == Py_None ) {
+        object_list = PyList_New(0);
+        if ( object_list == NULL ) {
+            return NULL;
+        }
+    }
+    else {
+        Py_INCREF(object_list);
+    }
+    if ( new_object != Py_None && PyList_Append(object_list, new_object) < 0 ) {
+        Py_DECREF(object_list);
+        return NULL;
+    }
+    return object_list;
+}
+
+/* Append a new entry to the list of streamed entries and return the list of
+ * declarations unchanged, which therefore remains None. */
+static PyObject* stream_entry(PyObject* stream, PyObject* object_list,
+                              PyObject* new_object)
+{
+    if ( new_object != Py_None && PyList_Append(stream, new_object) < 0 ) {
+        return NULL;
+    }
+    Py_INCREF(object_list);
+    return object_list;
+}
+
+/* Create a new TagsLinks instance with empty sets. */
+static PyObject* new_tags_links(void)
+{
+    PyObject* tags = PySet_New(NULL);
+    PyObject* links = PySet_New(NULL);
+    PyObject* tags_links = NULL;
+    if ( tags != NULL && links != NULL ) {
+        tags_links = native_tuple(tags_links_type, 2, tags, links);
+    }
+    Py_XDECREF(tags);
+    Py_XDECREF(links);
+    return tags_links;
+}
+
+/* See Builder.tag_link_new(). Most entries have no tags nor links, so they all
+ * share the same empty instance for the duration of the parse, which is only
+ * replaced by a new one when something is added to it. */
+static PyObject* native_tag_link_new(native_builder_t* native)
+{
+    Py_INCREF(native->empty_tags_links);
+    return native->empty_tags_links;
+}
+
+/* See Builder.tag_link_TAG() and Builder.tag_link_LINK(). The index selects
+ * the set of tags (0) or links (1). */
+static PyObject* native_tag_link_add(native_builder_t* native, PyObject* tags_links,
+                                     Py_ssize_t index, PyObject* value)
+{
+    if ( tags_links == native->empty_tags_links ) {
+        tags_links = new_tags_links();
+        if ( tags_links == NULL ) {
+            return NULL;
+        }
+    }
+    else {
+        Py_INCREF(tags_links);
+    }
+    if ( PySet_Add(PyTuple_GET_ITEM(tags_links, index), value) < 0 ) {
+        Py_DECREF(tags_links);
+        return NULL;
+    }
+    return tags_links;
+}
+
+/* See Builder.amount() and Builder.dcupdate(). */
+static PyObject* native_amount(native_builder_t* native,
+                               PyObject* number, PyObject* currency)
+{
+    if ( PyUnicode_Check(currency) && PyUnicode_GET_LENGTH(currency) > 0 ) {
+        int is_decimal = PyObject_IsInstance(number, decimal_type);
+        if ( is_decimal < 0 ) {
+            return NULL;
+        }
+        if ( is_decimal ) {
+            PyObject* rv = PyObject_CallFunctionObjArgs(native->dcupdate,
+                                                        number, currency, NULL);
+            if ( rv == NULL ) {
+                return NULL;
+            }
+            Py_DECREF(rv);
+        }
+    }
+    return native_tuple(amount_type, 2, number, currency);
+}
+
+/* See Builder.posting(). This only handles postings without a price, which
+ * require no validation; the others are left to the builder. */
+static PyObject* native_posting(native_builder_t* native, int lineno,
+                                PyObject* account, PyObject* units, PyObject* cost,
+                                char flag)
+{
+    PyObject* meta = native_metadata(native, lineno);
+    PyObject* pyflag;
+    PyObject* posting;
+    if ( meta == NULL ) {
+        return NULL;
+    }
+    if ( flag ) {
+        pyflag = PyUnicode_FromOrdinal((unsigned char)flag);
+        if ( pyflag == NULL ) {
+            Py_DECREF(meta);
+            return NULL;
+        }
+    }
+    else {
+        pyflag = Py_None;
+        Py_INCREF(pyflag);
+    }
+    posting = native_tuple(posting_type, 6, account, units, cost, Py_None, pyflag, meta);
+    Py_DECREF(pyflag);
+    Py_DECREF(meta);
+    return posting;
+}
+
+/* See Builder.transaction(). */
+static PyObject* native_transaction(native_builder_t* native, int lineno,
+                                    PyObject* date, char flag, PyObject* txn_strings,
+                                    PyObject* tags_links, PyObject* posting_or_kv_list)
+{
+    PyObject* meta = native_metadata(native, lineno);
+    PyObject* explicit_meta = NULL;
+    PyObject* postings = PyList_New(0);
+    PyObject* owned_tags_links = NULL;
+    PyObject* last_meta = NULL;
+    PyObject* tags;
+    PyObject* links;
+    PyObject* frozen_tags = NULL;
+    PyObject* frozen_links = NULL;
+    PyObject* pyflag = NULL;
+    PyObject* payee;
+    PyObject* narration;
+    PyObject* result = NULL;
+    Py_ssize_t num_strings;
+    Py_ssize_t i;
+
+    if ( meta == NULL || postings == NULL ) {
+        goto done;
+    }
 
+    /* Separate postings and key-values. */
+    if ( posting_or_kv_list != Py_None ) {
+        for ( i = 0; i < PyList_GET_SIZE(posting_or_kv_list); ++i ) {
+            PyObject* item = PyList_GET_ITEM(posting_or_kv_list, i);
+            if ( Py_TYPE(item) == (PyTypeObject*)posting_type ) {
+                if ( PyList_Append(postings, item) < 0 ) {
+                    goto done;
+                }
+                last_meta = PyTuple_GET_ITEM(item, 5);
+            }
+            else if ( Py_TYPE(item) == (PyTypeObject*)tags_links_type ) {
+                if ( PyList_GET_SIZE(postings) > 0 ) {
+                    if ( native_error(native, meta, PyUnicode_FromFormat(
+                             "Tags or links not allowed after first Posting: %S",
+                             item)) < 0 ) {
+                        goto done;
+                    }
+                }
+                else if ( item != native->empty_tags_links ) {
+                    if ( tags_links == native->empty_tags_links ) {
+                        tags_links = owned_tags_links = new_tags_links();
+                        if ( tags_links == NULL ) {
+                            goto done;
+                        }
+                    }
+                    if ( set_update(PyTuple_GET_ITEM(tags_links, 0),
+                                    PyTuple_GET_ITEM(item, 0)) < 0 ||
+                         set_update(PyTuple_GET_ITEM(tags_links, 1),
+                                    PyTuple_GET_ITEM(item, 1)) < 0 ) {
+                        goto done;
+                    }
+                }
+            }
+            else if ( Py_TYPE(item) == (PyTypeObject*)key_value_type ) {
+                PyObject* value = PyTuple_GET_ITEM(item, 1);
+                PyObject* existing;
+                if ( last_meta == NULL && explicit_meta == NULL &&
+                     (explicit_meta = PyDict_New()) == NULL ) {
+                    goto done;
+                }
+                existing = PyDict_SetDefault(
+                    last_meta != NULL ? last_meta : explicit_meta,
+                    PyTuple_GET_ITEM(item, 0), value);
+                if ( existing == NULL ) {
+                    goto done;
+                }
+                if ( existing != value &&
+                     native_error(native, meta, PyUnicode_FromFormat(
+                         last_meta != NULL ?
+                         "Duplicate posting metadata field: %S" :
+                         "Duplicate metadata field on entry: %S", item)) < 0 ) {
+                    goto done;
+                }
+            }
+            else {
+                PyErr_Format(PyExc_TypeError, "Unexpected transaction item: %R", item);
+                goto done;
+            }
+        }
+    }
+
+    /* Freeze the tags & links or set to default empty values. */
+    if ( PyList_GET_SIZE(native->tags) > 0 ) {
+        if ( tags_links == native->empty_tags_links ) {
+            tags_links = owned_tags_links = new_tags_links();
+            if ( tags_links == NULL ) {
+                goto done;
+            }
+        }
+        if ( set_update(PyTuple_GET_ITEM(tags_links, 0), native->tags) < 0 ) {
+            goto done;
+        }
+    }
+    tags = PyTuple_GET_ITEM(tags_links, 0);
+    links = PyTuple_GET_ITEM(tags_links, 1);
+    frozen_tags = PySet_GET_SIZE(tags) > 0 ? PyFrozenSet_New(tags) : (Py_INCREF(empty_set), empty_set);
+    frozen_links = PySet_GET_SIZE(links) > 0 ? PyFrozenSet_New(links) : (Py_INCREF(empty_set), empty_set);
+    if ( frozen_tags == NULL || frozen_links == NULL ) {
+        goto done;
+    }
+
+    /* Initialize the metadata fields from the set of active values. */
+    if ( PyDict_GET_SIZE(native->meta) > 0 ) {
+        PyObject* key;
+        PyObject* value_list;
+        Py_ssize_t pos = 0;
+        while ( PyDict_Next(native->meta, &pos, &key, &value_list) ) {
+            PyObject* value = PySequence_GetItem(value_list, -1);
+            int rv;
+            if ( value == NULL ) {
+                goto done;
+            }
+            rv = PyDict_SetItem(meta, key, value);
+            Py_DECREF(value);
+            if ( rv < 0 ) {
+                goto done;
+            }
+        }
+    }
+
+    /* Add on explicitly defined values. */
+    if ( explicit_meta != NULL && PyDict_Update(meta, explicit_meta) < 0 ) {
+        goto done;
+    }
+
+    /* Unpack the transaction fields. */
+    num_strings = txn_strings == Py_None ? 0 : PyList_GET_SIZE(txn_strings);
+    if ( num_strings == 1 ) {
+        payee = Py_None;
+        narration = PyList_GET_ITEM(txn_strings, 0);
+    }
+    else if ( num_strings == 2 ) {
+        payee = PyList_GET_ITEM(txn_strings, 0);
+        narration = PyList_GET_ITEM(txn_strings, 1);
+    }
+    else if ( num_strings == 0 ) {
+        payee = Py_None;
+        narration = empty_string;
+    }
+    else {
+        if ( native_error(native, meta, PyUnicode_FromFormat(
+                 "Too many strings on transaction description: %S",
+                 txn_strings)) == 0 ) {
+            result = Py_None;
+            Py_INCREF(result);
+        }
+        goto done;
+    }
+
+    /* Create the transaction. */
+    pyflag = PyUnicode_FromOrdinal((unsigned char)flag);
+    if ( pyflag != NULL ) {
+        result = native_tuple(transaction_type, 8, meta, date, pyflag, payee, narration,
+                              frozen_tags, frozen_links, postings);
+    }
+
+  done:
+    Py_XDECREF(meta);
+    Py_XDECREF(explicit_meta);
+    Py_XDECREF(postings);
+    Py_XDECREF(owned_tags_links);
+    Py_XDECREF(frozen_tags);
+    Py_XDECREF(frozen_links);
+    Py_XDECREF(pyflag);
+    return result;
+}
+
+
+#line 731 "beancount/parser/grammar.c"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
 # ifndef YY_NULLPTR
 #  if defined __cplusplus
 #   if 201103L <= __cplusplus
@@ -180,158 +750,212 @@ const char* getTokenName(int token);
 #  endif
 # endif
 
-/* Enabling verbose error messages.  */
-#ifdef YYERROR_VERBOSE
-# undef YYERROR_VERBOSE
-# define YYERROR_VERBOSE 1
-#else
-# define YYERROR_VERBOSE 1
-#endif
-
-/* Use api.header.include to #include this header
-   instead of duplicating it here.  */
-#ifndef YY_YY_BEANCOUNT_PARSER_GRAMMAR_H_INCLUDED
-# define YY_YY_BEANCOUNT_PARSER_GRAMMAR_H_INCLUDED
-/* Debug traces.  */
-#ifndef YYDEBUG
-# define YYDEBUG 1
-#endif
-#if YYDEBUG
-extern int yydebug;
-#endif
-
-/* Token type.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-  enum yytokentype
-  {
-    LEX_ERROR = 258,
-    INDENT = 259,
-    EOL = 260,
-    COMMENT = 261,
-    SKIPPED = 262,
-    PIPE = 263,
-    ATAT = 264,
-    AT = 265,
-    LCURLCURL = 266,
-    RCURLCURL = 267,
-    LCURL = 268,
-    RCURL = 269,
-    EQUAL = 270,
-    COMMA = 271,
-    TILDE = 272,
-    HASH = 273,
-    ASTERISK = 274,
-    SLASH = 275,
-    COLON = 276,
-    PLUS = 277,
-    MINUS = 278,
-    LPAREN = 279,
-    RPAREN = 280,
-    FLAG = 281,
-    TXN = 282,
-    BALANCE = 283,
-    OPEN = 284,
-    CLOSE = 285,
-    COMMODITY = 286,
-    PAD = 287,
-    EVENT = 288,
-    PRICE = 289,
-    NOTE = 290,
-    DOCUMENT = 291,
-    QUERY = 292,
-    CUSTOM = 293,
-    PUSHTAG = 294,
-    POPTAG = 295,
-    PUSHMETA = 296,
-    POPMETA = 297,
-    OPTION = 298,
-    INCLUDE = 299,
-    PLUGIN = 300,
-    NONE = 301,
-    BOOL = 302,
-    DATE = 303,
-    ACCOUNT = 304,
-    CURRENCY = 305,
-    STRING = 306,
-    NUMBER = 307,
-    TAG = 308,
-    LINK = 309,
-    KEY = 310,
-    NEGATIVE = 311
-  };
-#endif
-
-/* Value type.  */
-#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-union YYSTYPE
+#include "grammar.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
 {
-#line 126 "beancount/parser/grammar.y"
-
-    char character;
-    const char* string;
-    PyObject* pyobj;
-    struct {
-        PyObject* pyobj1;
-        PyObject* pyobj2;
-    } pairobj;
-
-#line 280 "beancount/parser/grammar.c"
-
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_LEX_ERROR = 3,                  /* LEX_ERROR  */
+  YYSYMBOL_INDENT = 4,                     /* INDENT  */
+  YYSYMBOL_EOL = 5,                        /* EOL  */
+  YYSYMBOL_COMMENT = 6,                    /* COMMENT  */
+  YYSYMBOL_SKIPPED = 7,                    /* SKIPPED  */
+  YYSYMBOL_PIPE = 8,                       /* PIPE  */
+  YYSYMBOL_ATAT = 9,                       /* ATAT  */
+  YYSYMBOL_AT = 10,                        /* AT  */
+  YYSYMBOL_LCURLCURL = 11,                 /* LCURLCURL  */
+  YYSYMBOL_RCURLCURL = 12,                 /* RCURLCURL  */
+  YYSYMBOL_LCURL = 13,                     /* LCURL  */
+  YYSYMBOL_RCURL = 14,                     /* RCURL  */
+  YYSYMBOL_EQUAL = 15,                     /* EQUAL  */
+  YYSYMBOL_COMMA = 16,                     /* COMMA  */
+  YYSYMBOL_TILDE = 17,                     /* TILDE  */
+  YYSYMBOL_HASH = 18,                      /* HASH  */
+  YYSYMBOL_ASTERISK = 19,                  /* ASTERISK  */
+  YYSYMBOL_SLASH = 20,                     /* SLASH  */
+  YYSYMBOL_COLON = 21,                     /* COLON  */
+  YYSYMBOL_PLUS = 22,                      /* PLUS  */
+  YYSYMBOL_MINUS = 23,                     /* MINUS  */
+  YYSYMBOL_LPAREN = 24,                    /* LPAREN  */
+  YYSYMBOL_RPAREN = 25,                    /* RPAREN  */
+  YYSYMBOL_FLAG = 26,                      /* FLAG  */
+  YYSYMBOL_TXN = 27,                       /* TXN  */
+  YYSYMBOL_BALANCE = 28,                   /* BALANCE  */
+  YYSYMBOL_OPEN = 29,                      /* OPEN  */
+  YYSYMBOL_CLOSE = 30,                     /* CLOSE  */
+  YYSYMBOL_COMMODITY = 31,                 /* COMMODITY  */
+  YYSYMBOL_PAD = 32,                       /* PAD  */
+  YYSYMBOL_EVENT = 33,                     /* EVENT  */
+  YYSYMBOL_PRICE = 34,                     /* PRICE  */
+  YYSYMBOL_NOTE = 35,                      /* NOTE  */
+  YYSYMBOL_DOCUMENT = 36,                  /* DOCUMENT  */
+  YYSYMBOL_QUERY = 37,                     /* QUERY  */
+  YYSYMBOL_CUSTOM = 38,                    /* CUSTOM  */
+  YYSYMBOL_PUSHTAG = 39,                   /* PUSHTAG  */
+  YYSYMBOL_POPTAG = 40,                    /* POPTAG  */
+  YYSYMBOL_PUSHMETA = 41,                  /* PUSHMETA  */
+  YYSYMBOL_POPMETA = 42,                   /* POPMETA  */
+  YYSYMBOL_OPTION = 43,                    /* OPTION  */
+  YYSYMBOL_INCLUDE = 44,                   /* INCLUDE  */
+  YYSYMBOL_PLUGIN = 45,                    /* PLUGIN  */
+  YYSYMBOL_NONE = 46,                      /* NONE  */
+  YYSYMBOL_BOOL = 47,                      /* BOOL  */
+  YYSYMBOL_DATE = 48,                      /* DATE  */
+  YYSYMBOL_ACCOUNT = 49,                   /* ACCOUNT  */
+  YYSYMBOL_CURRENCY = 50,                  /* CURRENCY  */
+  YYSYMBOL_STRING = 51,                    /* STRING  */
+  YYSYMBOL_NUMBER = 52,                    /* NUMBER  */
+  YYSYMBOL_TAG = 53,                       /* TAG  */
+  YYSYMBOL_LINK = 54,                      /* LINK  */
+  YYSYMBOL_KEY = 55,                       /* KEY  */
+  YYSYMBOL_NEGATIVE = 56,                  /* NEGATIVE  */
+  YYSYMBOL_YYACCEPT = 57,                  /* $accept  */
+  YYSYMBOL_empty = 58,                     /* empty  */
+  YYSYMBOL_txn = 59,                       /* txn  */
+  YYSYMBOL_eol = 60,                       /* eol  */
+  YYSYMBOL_empty_line = 61,                /* empty_line  */
+  YYSYMBOL_number_expr = 62,               /* number_expr  */
+  YYSYMBOL_txn_strings = 63,               /* txn_strings  */
+  YYSYMBOL_tags_links = 64,                /* tags_links  */
+  YYSYMBOL_transaction = 65,               /* transaction  */
+  YYSYMBOL_optflag = 66,                   /* optflag  */
+  YYSYMBOL_price_annotation = 67,          /* price_annotation  */
+  YYSYMBOL_posting = 68,                   /* posting  */
+  YYSYMBOL_key_value = 69,                 /* key_value  */
+  YYSYMBOL_key_value_line = 70,            /* key_value_line  */
+  YYSYMBOL_key_value_value = 71,           /* key_value_value  */
+  YYSYMBOL_posting_or_kv_list = 72,        /* posting_or_kv_list  */
+  YYSYMBOL_key_value_list = 73,            /* key_value_list  */
+  YYSYMBOL_currency_list = 74,             /* currency_list  */
+  YYSYMBOL_pushtag = 75,                   /* pushtag  */
+  YYSYMBOL_poptag = 76,                    /* poptag  */
+  YYSYMBOL_pushmeta = 77,                  /* pushmeta  */
+  YYSYMBOL_popmeta = 78,                   /* popmeta  */
+  YYSYMBOL_open = 79,                      /* open  */
+  YYSYMBOL_opt_booking = 80,               /* opt_booking  */
+  YYSYMBOL_close = 81,                     /* close  */
+  YYSYMBOL_commodity = 82,                 /* commodity  */
+  YYSYMBOL_pad = 83,                       /* pad  */
+  YYSYMBOL_balance = 84,                   /* balance  */
+  YYSYMBOL_amount = 85,                    /* amount  */
+  YYSYMBOL_amount_tolerance = 86,          /* amount_tolerance  */
+  YYSYMBOL_maybe_number = 87,              /* maybe_number  */
+  YYSYMBOL_maybe_currency = 88,            /* maybe_currency  */
+  YYSYMBOL_compound_amount = 89,           /* compound_amount  */
+  YYSYMBOL_incomplete_amount = 90,         /* incomplete_amount  */
+  YYSYMBOL_cost_spec = 91,                 /* cost_spec  */
+  YYSYMBOL_cost_comp_list = 92,            /* cost_comp_list  */
+  YYSYMBOL_cost_comp = 93,                 /* cost_comp  */
+  YYSYMBOL_price = 94,                     /* price  */
+  YYSYMBOL_event = 95,                     /* event  */
+  YYSYMBOL_query = 96,                     /* query  */
+  YYSYMBOL_note = 97,                      /* note  */
+  YYSYMBOL_filename = 98,                  /* filename  */
+  YYSYMBOL_document = 99,                  /* document  */
+  YYSYMBOL_custom_value = 100,             /* custom_value  */
+  YYSYMBOL_custom_value_list = 101,        /* custom_value_list  */
+  YYSYMBOL_custom = 102,                   /* custom  */
+  YYSYMBOL_entry = 103,                    /* entry  */
+  YYSYMBOL_option = 104,                   /* option  */
+  YYSYMBOL_include = 105,                  /* include  */
+  YYSYMBOL_plugin = 106,                   /* plugin  */
+  YYSYMBOL_directive = 107,                /* directive  */
+  YYSYMBOL_declarations = 108,             /* declarations  */
+  YYSYMBOL_file = 109                      /* file  */
 };
-typedef union YYSTYPE YYSTYPE;
-# define YYSTYPE_IS_TRIVIAL 1
-# define YYSTYPE_IS_DECLARED 1
-#endif
+typedef enum yysymbol_kind_t yysymbol_kind_t;
 
-/* Location type.  */
-#if ! defined YYLTYPE && ! defined YYLTYPE_IS_DECLARED
-typedef struct YYLTYPE YYLTYPE;
-struct YYLTYPE
-{
-  int first_line;
-  int first_column;
-  int last_line;
-  int last_column;
-};
-# define YYLTYPE_IS_DECLARED 1
-# define YYLTYPE_IS_TRIVIAL 1
-#endif
 
 
 
-int yyparse (void);
+#ifdef short
+# undef short
+#endif
 
-#endif /* !YY_YY_BEANCOUNT_PARSER_GRAMMAR_H_INCLUDED  */
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
 
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
 
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
 
-#ifdef short
-# undef short
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
 #endif
 
-#ifdef YYTYPE_UINT8
-typedef YYTYPE_UINT8 yytype_uint8;
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
 #else
-typedef unsigned char yytype_uint8;
+typedef short yytype_int16;
 #endif
 
-#ifdef YYTYPE_INT8
-typedef YYTYPE_INT8 yytype_int8;
-#else
-typedef signed char yytype_int8;
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
 #endif
 
-#ifdef YYTYPE_UINT16
-typedef YYTYPE_UINT16 yytype_uint16;
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
 #else
-typedef unsigned short yytype_uint16;
+typedef short yytype_uint8;
 #endif
 
-#ifdef YYTYPE_INT16
-typedef YYTYPE_INT16 yytype_int16;
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
 #else
-typedef short yytype_int16;
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
 #endif
 
 #ifndef YYSIZE_T
@@ -339,7 +963,7 @@ typedef short yytype_int16;
 #  define YYSIZE_T __SIZE_TYPE__
 # elif defined size_t
 #  define YYSIZE_T size_t
-# elif ! defined YYSIZE_T
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
 #  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
 #  define YYSIZE_T size_t
 # else
@@ -347,7 +971,20 @@ typedef short yytype_int16;
 # endif
 #endif
 
-#define YYSIZE_MAXIMUM ((YYSIZE_T) -1)
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_uint8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
 
 #ifndef YY_
 # if defined YYENABLE_NLS && YYENABLE_NLS
@@ -361,38 +998,43 @@ typedef short yytype_int16;
 # endif
 #endif
 
-#ifndef YY_ATTRIBUTE
-# if (defined __GNUC__                                               \
-      && (2 < __GNUC__ || (__GNUC__ == 2 && 96 <= __GNUC_MINOR__)))  \
-     || defined __SUNPRO_C && 0x5110 <= __SUNPRO_C
-#  define YY_ATTRIBUTE(Spec) __attribute__(Spec)
-# else
-#  define YY_ATTRIBUTE(Spec) /* empty */
-# endif
-#endif
 
 #ifndef YY_ATTRIBUTE_PURE
-# define YY_ATTRIBUTE_PURE   YY_ATTRIBUTE ((__pure__))
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
 #endif
 
 #ifndef YY_ATTRIBUTE_UNUSED
-# define YY_ATTRIBUTE_UNUSED YY_ATTRIBUTE ((__unused__))
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
 #endif
 
 /* Suppress unused-variable warnings by "using" E.  */
 #if ! defined lint || defined __GNUC__
-# define YYUSE(E) ((void) (E))
+# define YY_USE(E) ((void) (E))
 #else
-# define YYUSE(E) /* empty */
+# define YY_USE(E) /* empty */
 #endif
 
-#if defined __GNUC__ && ! defined __ICC && 407 <= __GNUC__ * 100 + __GNUC_MINOR__
 /* Suppress an incorrect diagnostic about yylval being uninitialized.  */
-# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN \
-    _Pragma ("GCC diagnostic push") \
-    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")\
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
     _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
-# define YY_IGNORE_MAYBE_UNINITIALIZED_END \
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
     _Pragma ("GCC diagnostic pop")
 #else
 # define YY_INITIAL_VALUE(Value) Value
@@ -405,37 +1047,25 @@ typedef short yytype_int16;
 # define YY_INITIAL_VALUE(Value) /* Nothing. */
 #endif
 
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
 
 #define YY_ASSERT(E) ((void) (0 && (E)))
 
-#if ! defined yyoverflow || YYERROR_VERBOSE
+#if 1
 
 /* The parser invokes alloca or malloc; define the necessary symbols.  */
 
-# ifdef YYSTACK_USE_ALLOCA
-#  if YYSTACK_USE_ALLOCA
-#   ifdef __GNUC__
-#    define YYSTACK_ALLOC __builtin_alloca
-#   elif defined __BUILTIN_VA_ARG_INCR
-#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
-#   elif defined _AIX
-#    define YYSTACK_ALLOC __alloca
-#   elif defined _MSC_VER
-#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
-#    define alloca _alloca
-#   else
-#    define YYSTACK_ALLOC alloca
-#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
-#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
-      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
-#     ifndef EXIT_SUCCESS
-#      define EXIT_SUCCESS 0
-#     endif
-#    endif
-#   endif
-#  endif
-# endif
-
 # ifdef YYSTACK_ALLOC
    /* Pacify GCC's 'empty if-body' warning.  */
 #  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
@@ -473,8 +1103,7 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 #   endif
 #  endif
 # endif
-#endif /* ! defined yyoverflow || YYERROR_VERBOSE */
-
+#endif /* 1 */
 
 #if (! defined yyoverflow \
      && (! defined __cplusplus \
@@ -484,18 +1113,19 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 /* A type that is properly aligned for any stack member.  */
 union yyalloc
 {
-  yytype_int16 yyss_alloc;
+  yy_state_t yyss_alloc;
   YYSTYPE yyvs_alloc;
   YYLTYPE yyls_alloc;
 };
 
 /* The size of the maximum gap between one aligned stack and the next.  */
-# define YYSTACK_GAP_MAXIMUM (sizeof (union yyalloc) - 1)
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
 
 /* The size of an array large to enough to hold all stacks, each with
    N elements.  */
 # define YYSTACK_BYTES(N) \
-     ((N) * (sizeof (yytype_int16) + sizeof (YYSTYPE) + sizeof (YYLTYPE)) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE) \
+             + YYSIZEOF (YYLTYPE)) \
       + 2 * YYSTACK_GAP_MAXIMUM)
 
 # define YYCOPY_NEEDED 1
@@ -508,11 +1138,11 @@ union yyalloc
 # define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
     do                                                                  \
       {                                                                 \
-        YYSIZE_T yynewbytes;                                            \
+        YYPTRDIFF_T yynewbytes;                                         \
         YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
         Stack = &yyptr->Stack_alloc;                                    \
-        yynewbytes = yystacksize * sizeof (*Stack) + YYSTACK_GAP_MAXIMUM; \
-        yyptr += yynewbytes / sizeof (*yyptr);                          \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
       }                                                                 \
     while (0)
 
@@ -524,12 +1154,12 @@ union yyalloc
 # ifndef YYCOPY
 #  if defined __GNUC__ && 1 < __GNUC__
 #   define YYCOPY(Dst, Src, Count) \
-      __builtin_memcpy (Dst, Src, (Count) * sizeof (*(Src)))
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
 #  else
 #   define YYCOPY(Dst, Src, Count)              \
       do                                        \
         {                                       \
-          YYSIZE_T yyi;                         \
+          YYPTRDIFF_T yyi;                      \
           for (yyi = 0; yyi < (Count); yyi++)   \
             (Dst)[yyi] = (Src)[yyi];            \
         }                                       \
@@ -552,17 +1182,20 @@ union yyalloc
 /* YYNSTATES -- Number of states.  */
 #define YYNSTATES  240
 
-#define YYUNDEFTOK  2
+/* YYMAXUTOK -- Last valid token kind.  */
 #define YYMAXUTOK   311
 
+
 /* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
    as returned by yylex, with out-of-bounds checking.  */
-#define YYTRANSLATE(YYX)                                                \
-  ((unsigned) (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
 
 /* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
    as returned by yylex.  */
-static const yytype_uint8 yytranslate[] =
+static const yytype_int8 yytranslate[] =
 {
        0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -599,78 +1232,78 @@ static const yytype_uint8 yytranslate[] =
 };
 
 #if YYDEBUG
-  /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
-static const yytype_uint16 yyrline[] =
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
 {
-       0,   260,   260,   263,   267,   271,   275,   280,   281,   285,
-     286,   287,   288,   294,   298,   303,   308,   313,   318,   323,
-     327,   332,   337,   342,   349,   357,   362,   368,   374,   378,
-     382,   386,   388,   393,   398,   403,   408,   414,   420,   425,
-     426,   427,   428,   429,   430,   431,   432,   433,   437,   443,
-     448,   452,   457,   462,   468,   473,   479,   484,   489,   495,
-     501,   507,   516,   522,   529,   533,   539,   545,   551,   557,
-     563,   569,   577,   584,   589,   594,   599,   604,   609,   614,
-     621,   627,   632,   637,   643,   648,   653,   659,   663,   667,
-     671,   678,   684,   690,   696,   702,   704,   711,   716,   721,
-     726,   731,   736,   746,   751,   757,   764,   765,   766,   767,
-     768,   769,   770,   771,   772,   773,   774,   775,   780,   786,
-     792,   797,   803,   804,   805,   806,   807,   808,   809,   810,
-     813,   817,   822,   840,   847
+       0,   834,   834,   837,   841,   845,   849,   854,   855,   859,
+     860,   861,   862,   868,   872,   877,   882,   887,   892,   897,
+     901,   906,   911,   916,   923,   931,   936,   942,   949,   953,
+     957,   961,   963,   968,   974,   979,   984,   991,   997,  1002,
+    1003,  1004,  1005,  1006,  1007,  1008,  1009,  1010,  1014,  1020,
+    1025,  1029,  1034,  1039,  1045,  1050,  1056,  1061,  1066,  1072,
+    1078,  1084,  1093,  1099,  1106,  1110,  1116,  1122,  1128,  1134,
+    1140,  1146,  1154,  1161,  1166,  1171,  1176,  1181,  1186,  1191,
+    1198,  1204,  1209,  1214,  1220,  1225,  1230,  1236,  1240,  1244,
+    1248,  1255,  1261,  1267,  1273,  1279,  1281,  1288,  1293,  1298,
+    1303,  1308,  1313,  1323,  1328,  1334,  1341,  1342,  1343,  1344,
+    1345,  1346,  1347,  1348,  1349,  1350,  1351,  1352,  1357,  1366,
+    1372,  1377,  1383,  1384,  1385,  1386,  1387,  1388,  1389,  1390,
+    1393,  1397,  1413,  1431,  1438
 };
 #endif
 
-#if YYDEBUG || YYERROR_VERBOSE || 1
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if 1
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
 /* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
    First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
 static const char *const yytname[] =
 {
-  "$end", "error", "$undefined", "LEX_ERROR", "INDENT", "EOL", "COMMENT",
-  "SKIPPED", "PIPE", "ATAT", "AT", "LCURLCURL", "RCURLCURL", "LCURL",
-  "RCURL", "EQUAL", "COMMA", "TILDE", "HASH", "ASTERISK", "SLASH", "COLON",
-  "PLUS", "MINUS", "LPAREN", "RPAREN", "FLAG", "TXN", "BALANCE", "OPEN",
-  "CLOSE", "COMMODITY", "PAD", "EVENT", "PRICE", "NOTE", "DOCUMENT",
-  "QUERY", "CUSTOM", "PUSHTAG", "POPTAG", "PUSHMETA", "POPMETA", "OPTION",
-  "INCLUDE", "PLUGIN", "NONE", "BOOL", "DATE", "ACCOUNT", "CURRENCY",
-  "STRING", "NUMBER", "TAG", "LINK", "KEY", "NEGATIVE", "$accept", "empty",
-  "txn", "eol", "empty_line", "number_expr", "txn_strings", "tags_links",
-  "transaction", "optflag", "price_annotation", "posting", "key_value",
-  "key_value_line", "key_value_value", "posting_or_kv_list",
-  "key_value_list", "currency_list", "pushtag", "poptag", "pushmeta",
-  "popmeta", "open", "opt_booking", "close", "commodity", "pad", "balance",
-  "amount", "amount_tolerance", "maybe_number", "maybe_currency",
-  "compound_amount", "incomplete_amount", "cost_spec", "cost_comp_list",
-  "cost_comp", "price", "event", "query", "note", "filename", "document",
-  "custom_value", "custom_value_list", "custom", "entry", "option",
-  "include", "plugin", "directive", "declarations", "file", YY_NULLPTR
+  "\"end of file\"", "error", "\"invalid token\"", "LEX_ERROR", "INDENT",
+  "EOL", "COMMENT", "SKIPPED", "PIPE", "ATAT", "AT", "LCURLCURL",
+  "RCURLCURL", "LCURL", "RCURL", "EQUAL", "COMMA", "TILDE", "HASH",
+  "ASTERISK", "SLASH", "COLON", "PLUS", "MINUS", "LPAREN", "RPAREN",
+  "FLAG", "TXN", "BALANCE", "OPEN", "CLOSE", "COMMODITY", "PAD", "EVENT",
+  "PRICE", "NOTE", "DOCUMENT", "QUERY", "CUSTOM", "PUSHTAG", "POPTAG",
+  "PUSHMETA", "POPMETA", "OPTION", "INCLUDE", "PLUGIN", "NONE", "BOOL",
+  "DATE", "ACCOUNT", "CURRENCY", "STRING", "NUMBER", "TAG", "LINK", "KEY",
+  "NEGATIVE", "$accept", "empty", "txn", "eol", "empty_line",
+  "number_expr", "txn_strings", "tags_links", "transaction", "optflag",
+  "price_annotation", "posting", "key_value", "key_value_line",
+  "key_value_value", "posting_or_kv_list", "key_value_list",
+  "currency_list", "pushtag", "poptag", "pushmeta", "popmeta", "open",
+  "opt_booking", "close", "commodity", "pad", "balance", "amount",
+  "amount_tolerance", "maybe_number", "maybe_currency", "compound_amount",
+  "incomplete_amount", "cost_spec", "cost_comp_list", "cost_comp", "price",
+  "event", "query", "note", "filename", "document", "custom_value",
+  "custom_value_list", "custom", "entry", "option", "include", "plugin",
+  "directive", "declarations", "file", YY_NULLPTR
 };
-#endif
 
-# ifdef YYPRINT
-/* YYTOKNUM[NUM] -- (External) token number corresponding to the
-   (internal) symbol number NUM (which must be that of a token).  */
-static const yytype_uint16 yytoknum[] =
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
 {
-       0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,   268,   269,   270,   271,   272,   273,   274,
-     275,   276,   277,   278,   279,   280,   281,   282,   283,   284,
-     285,   286,   287,   288,   289,   290,   291,   292,   293,   294,
-     295,   296,   297,   298,   299,   300,   301,   302,   303,   304,
-     305,   306,   307,   308,   309,   310,   311
-};
-# endif
+  return yytname[yysymbol];
+}
+#endif
 
-#define YYPACT_NINF -119
+#define YYPACT_NINF (-119)
 
-#define yypact_value_is_default(Yystate) \
-  (!!((Yystate) == (-119)))
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
 
-#define YYTABLE_NINF -135
+#define YYTABLE_NINF (-135)
 
-#define yytable_value_is_error(Yytable_value) \
+#define yytable_value_is_error(Yyn) \
   0
 
-  /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-     STATE-NUM.  */
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
 static const yytype_int16 yypact[] =
 {
     -119,  -119,   125,    18,  -119,  -119,  -119,  -119,  -119,   -31,
@@ -699,9 +1332,9 @@ static const yytype_int16 yypact[] =
        1,  -119,    37,  -119,    37,   134,  -119,  -119,  -119,  -119
 };
 
-  /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
-     Performed when YYTABLE does not specify something else to do.  Zero
-     means the default is an error.  */
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
 static const yytype_uint8 yydefact[] =
 {
        2,   133,     0,     0,   132,    11,     9,    10,    12,     0,
@@ -730,7 +1363,7 @@ static const yytype_uint8 yydefact[] =
        2,    81,     0,    32,     0,     0,    86,    35,    34,    79
 };
 
-  /* YYPGOTO[NTERM-NUM].  */
+/* YYPGOTO[NTERM-NUM].  */
 static const yytype_int16 yypgoto[] =
 {
     -119,     0,  -119,   -37,  -119,   -24,  -119,  -118,  -119,  -119,
@@ -741,10 +1374,10 @@ static const yytype_int16 yypgoto[] =
     -119,  -119,  -119
 };
 
-  /* YYDEFGOTO[NTERM-NUM].  */
-static const yytype_int16 yydefgoto[] =
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_uint8 yydefgoto[] =
 {
-      -1,   143,    63,    66,    17,   203,    87,   127,    18,   197,
+       0,   143,    63,    66,    17,   203,    87,   127,    18,   197,
      232,   188,   185,   173,   102,   182,   144,   111,    19,    20,
       21,    22,    23,   142,    24,    25,    26,    27,   103,   108,
      204,   208,   219,   233,   212,   220,   221,    28,    29,    30,
@@ -752,9 +1385,9 @@ static const yytype_int16 yydefgoto[] =
       38,     2,     3
 };
 
-  /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
-     positive, shift that token.  If negative, reduce the rule whose
-     number is the opposite.  If YYTABLE_NINF, syntax error.  */
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
 static const yytype_int16 yytable[] =
 {
        1,   191,   150,   139,    67,   124,    69,    64,    65,    72,
@@ -817,9 +1450,9 @@ static const yytype_int16 yycheck[] =
       35,    36,    37,    38,    19,    20,    -1,    22,    23
 };
 
-  /* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-     symbol of state STATE-NUM.  */
-static const yytype_uint8 yystos[] =
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
 {
        0,    58,   108,   109,     1,     4,     5,     6,     7,    39,
       40,    41,    42,    43,    44,    45,    48,    61,    65,    75,
@@ -847,8 +1480,8 @@ static const yytype_uint8 yystos[] =
       16,    14,    67,    90,    67,    87,    93,    60,    60,    50
 };
 
-  /* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
-static const yytype_uint8 yyr1[] =
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
 {
        0,    57,    58,    59,    59,    59,    59,    60,    60,    61,
       61,    61,    61,    62,    62,    62,    62,    62,    62,    62,
@@ -866,8 +1499,8 @@ static const yytype_uint8 yyr1[] =
      108,   108,   108,   108,   109
 };
 
-  /* YYR2[YYN] -- Number of symbols on the right hand side of rule YYN.  */
-static const yytype_uint8 yyr2[] =
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
 {
        0,     2,     0,     1,     1,     1,     1,     1,     2,     1,
        1,     1,     1,     1,     3,     3,     3,     3,     2,     2,
@@ -886,14 +1519,15 @@ static const yytype_uint8 yyr2[] =
 };
 
 
+enum { YYENOMEM = -2 };
+
 #define yyerrok         (yyerrstatus = 0)
 #define yyclearin       (yychar = YYEMPTY)
-#define YYEMPTY         (-2)
-#define YYEOF           0
 
 #define YYACCEPT        goto yyacceptlab
 #define YYABORT         goto yyabortlab
 #define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
 
 
 #define YYRECOVERING()  (!!yyerrstatus)
@@ -910,15 +1544,14 @@ static const yytype_uint8 yyr2[] =
       }                                                           \
     else                                                          \
       {                                                           \
-        yyerror (YY_("syntax error: cannot back up")); \
+        yyerror (&yylloc, scanner, builder, YY_("syntax error: cannot back up")); \
         YYERROR;                                                  \
       }                                                           \
   while (0)
 
-/* Error token number */
-#define YYTERROR        1
-#define YYERRCODE       256
-
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
 
 /* YYLLOC_DEFAULT -- Set CURRENT to span from RHS[1] to RHS[N].
    If N is 0, then set CURRENT to the empty location which ends
@@ -962,12 +1595,19 @@ do {                                            \
 } while (0)
 
 
-/* YY_LOCATION_PRINT -- Print the location on the stream.
+/* YYLOCATION_PRINT -- Print the location on the stream.
    This macro was not mandated originally: define only if we know
    we won't break user code: when these are the locations we know.  */
 
-#ifndef YY_LOCATION_PRINT
-# if defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
+# ifndef YYLOCATION_PRINT
+
+#  if defined YY_LOCATION_PRINT
+
+   /* Temporary convenience wrapper in case some people defined the
+      undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YYLOCATION_PRINT(File, Loc)  YY_LOCATION_PRINT(File, *(Loc))
+
+#  elif defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
 
 /* Print *YYLOCP on YYO.  Private, do not rely on its existence. */
 
@@ -995,24 +1635,32 @@ yy_location_print_ (FILE *yyo, YYLTYPE const * const yylocp)
         res += YYFPRINTF (yyo, "-%d", end_col);
     }
   return res;
- }
+}
 
-#  define YY_LOCATION_PRINT(File, Loc)          \
-  yy_location_print_ (File, &(Loc))
+#   define YYLOCATION_PRINT  yy_location_print_
 
-# else
-#  define YY_LOCATION_PRINT(File, Loc) ((void) 0)
-# endif
-#endif
+    /* Temporary convenience wrapper in case some people defined the
+       undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YY_LOCATION_PRINT(File, Loc)  YYLOCATION_PRINT(File, &(Loc))
 
+#  else
 
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)                    \
+#   define YYLOCATION_PRINT(File, Loc) ((void) 0)
+    /* Temporary convenience wrapper in case some people defined the
+       undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YY_LOCATION_PRINT  YYLOCATION_PRINT
+
+#  endif
+# endif /* !defined YYLOCATION_PRINT */
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
 do {                                                                      \
   if (yydebug)                                                            \
     {                                                                     \
       YYFPRINTF (stderr, "%s ", Title);                                   \
       yy_symbol_print (stderr,                                            \
-                  Type, Value, Location); \
+                  Kind, Value, Location, scanner, builder); \
       YYFPRINTF (stderr, "\n");                                           \
     }                                                                     \
 } while (0)
@@ -1023,18 +1671,19 @@ do {                                                                      \
 `-----------------------------------*/
 
 static void
-yy_symbol_value_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep, YYLTYPE const * const yylocationp)
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, YYLTYPE const * const yylocationp, yyscan_t scanner, PyObject* builder)
 {
   FILE *yyoutput = yyo;
-  YYUSE (yyoutput);
-  YYUSE (yylocationp);
+  YY_USE (yyoutput);
+  YY_USE (yylocationp);
+  YY_USE (scanner);
+  YY_USE (builder);
   if (!yyvaluep)
     return;
-# ifdef YYPRINT
-  if (yytype < YYNTOKENS)
-    YYPRINT (yyo, yytoknum[yytype], *yyvaluep);
-# endif
-  YYUSE (yytype);
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
 
@@ -1043,14 +1692,15 @@ yy_symbol_value_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep, YY
 `---------------------------*/
 
 static void
-yy_symbol_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep, YYLTYPE const * const yylocationp)
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, YYLTYPE const * const yylocationp, yyscan_t scanner, PyObject* builder)
 {
   YYFPRINTF (yyo, "%s %s (",
-             yytype < YYNTOKENS ? "token" : "nterm", yytname[yytype]);
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  YY_LOCATION_PRINT (yyo, *yylocationp);
+  YYLOCATION_PRINT (yyo, yylocationp);
   YYFPRINTF (yyo, ": ");
-  yy_symbol_value_print (yyo, yytype, yyvaluep, yylocationp);
+  yy_symbol_value_print (yyo, yykind, yyvaluep, yylocationp, scanner, builder);
   YYFPRINTF (yyo, ")");
 }
 
@@ -1060,7 +1710,7 @@ yy_symbol_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep, YYLTYPE
 `------------------------------------------------------------------*/
 
 static void
-yy_stack_print (yytype_int16 *yybottom, yytype_int16 *yytop)
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
 {
   YYFPRINTF (stderr, "Stack now");
   for (; yybottom <= yytop; yybottom++)
@@ -1083,21 +1733,22 @@ do {                                                            \
 `------------------------------------------------*/
 
 static void
-yy_reduce_print (yytype_int16 *yyssp, YYSTYPE *yyvsp, YYLTYPE *yylsp, int yyrule)
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp, YYLTYPE *yylsp,
+                 int yyrule, yyscan_t scanner, PyObject* builder)
 {
-  unsigned long yylno = yyrline[yyrule];
+  int yylno = yyrline[yyrule];
   int yynrhs = yyr2[yyrule];
   int yyi;
-  YYFPRINTF (stderr, "Reducing stack by rule %d (line %lu):\n",
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
              yyrule - 1, yylno);
   /* The symbols being reduced.  */
   for (yyi = 0; yyi < yynrhs; yyi++)
     {
       YYFPRINTF (stderr, "   $%d = ", yyi + 1);
       yy_symbol_print (stderr,
-                       yystos[yyssp[yyi + 1 - yynrhs]],
-                       &yyvsp[(yyi + 1) - (yynrhs)]
-                       , &(yylsp[(yyi + 1) - (yynrhs)])                       );
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)],
+                       &(yylsp[(yyi + 1) - (yynrhs)]), scanner, builder);
       YYFPRINTF (stderr, "\n");
     }
 }
@@ -1105,15 +1756,15 @@ yy_reduce_print (yytype_int16 *yyssp, YYSTYPE *yyvsp, YYLTYPE *yylsp, int yyrule
 # define YY_REDUCE_PRINT(Rule)          \
 do {                                    \
   if (yydebug)                          \
-    yy_reduce_print (yyssp, yyvsp, yylsp, Rule); \
+    yy_reduce_print (yyssp, yyvsp, yylsp, Rule, scanner, builder); \
 } while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
    multiple parsers can coexist.  */
 int yydebug;
 #else /* !YYDEBUG */
-# define YYDPRINTF(Args)
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
 # define YY_STACK_PRINT(Bottom, Top)
 # define YY_REDUCE_PRINT(Rule)
 #endif /* !YYDEBUG */
@@ -1134,30 +1785,120 @@ int yydebug;
 #ifndef YYMAXDEPTH
 # define YYMAXDEPTH 10000
 #endif
+/* Parser data structure.  */
+struct yypstate
+  {
+    /* Number of syntax errors so far.  */
+    int yynerrs;
+
+    yy_state_fast_t yystate;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus;
 
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
 
-#if YYERROR_VERBOSE
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize;
 
-# ifndef yystrlen
-#  if defined __GLIBC__ && defined _STRING_H
-#   define yystrlen strlen
-#  else
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss;
+    yy_state_t *yyssp;
+
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs;
+    YYSTYPE *yyvsp;
+
+    /* The location stack: array, bottom, top.  */
+    YYLTYPE yylsa[YYINITDEPTH];
+    YYLTYPE *yyls;
+    YYLTYPE *yylsp;
+    /* Whether this instance has not started parsing yet.
+     * If 2, it corresponds to a finished parsing.  */
+    int yynew;
+  };
+
+
+/* Context of a parse error.  */
+typedef struct
+{
+  yypstate* yyps;
+  yysymbol_kind_t yytoken;
+  YYLTYPE *yylloc;
+} yypcontext_t;
+
+/* Put in YYARG at most YYARGN of the expected tokens given the
+   current YYCTX, and return the number of tokens stored in YYARG.  If
+   YYARG is null, return the number of expected tokens (guaranteed to
+   be less than YYNTOKENS).  Return YYENOMEM on memory exhaustion.
+   Return 0 if there are more than YYARGN expected tokens, yet fill
+   YYARG up to YYARGN. */
+static int
+yypstate_expected_tokens (yypstate *yyps,
+                          yysymbol_kind_t yyarg[], int yyargn)
+{
+  /* Actual size of YYARG. */
+  int yycount = 0;
+  int yyn = yypact[+*yyps->yyssp];
+  if (!yypact_value_is_default (yyn))
+    {
+      /* Start YYX at -YYN if negative to avoid negative indexes in
+         YYCHECK.  In other words, skip the first -YYN actions for
+         this state because they are default actions.  */
+      int yyxbegin = yyn < 0 ? -yyn : 0;
+      /* Stay within bounds of both yycheck and yytname.  */
+      int yychecklim = YYLAST - yyn + 1;
+      int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
+      int yyx;
+      for (yyx = yyxbegin; yyx < yyxend; ++yyx)
+        if (yycheck[yyx + yyn] == yyx && yyx != YYSYMBOL_YYerror
+            && !yytable_value_is_error (yytable[yyx + yyn]))
+          {
+            if (!yyarg)
+              ++yycount;
+            else if (yycount == yyargn)
+              return 0;
+            else
+              yyarg[yycount++] = YY_CAST (yysymbol_kind_t, yyx);
+          }
+    }
+  if (yyarg && yycount == 0 && 0 < yyargn)
+    yyarg[0] = YYSYMBOL_YYEMPTY;
+  return yycount;
+}
+
+
+/* Similar to the previous function.  */
+static int
+yypcontext_expected_tokens (const yypcontext_t *yyctx,
+                            yysymbol_kind_t yyarg[], int yyargn)
+{
+  return yypstate_expected_tokens (yyctx->yyps, yyarg, yyargn);
+}
+
+
+#ifndef yystrlen
+# if defined __GLIBC__ && defined _STRING_H
+#  define yystrlen(S) (YY_CAST (YYPTRDIFF_T, strlen (S)))
+# else
 /* Return the length of YYSTR.  */
-static YYSIZE_T
+static YYPTRDIFF_T
 yystrlen (const char *yystr)
 {
-  YYSIZE_T yylen;
+  YYPTRDIFF_T yylen;
   for (yylen = 0; yystr[yylen]; yylen++)
     continue;
   return yylen;
 }
-#  endif
 # endif
+#endif
 
-# ifndef yystpcpy
-#  if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
-#   define yystpcpy stpcpy
-#  else
+#ifndef yystpcpy
+# if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
+#  define yystpcpy stpcpy
+# else
 /* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
    YYDEST.  */
 static char *
@@ -1171,10 +1912,10 @@ yystpcpy (char *yydest, const char *yysrc)
 
   return yyd - 1;
 }
-#  endif
 # endif
+#endif
 
-# ifndef yytnamerr
+#ifndef yytnamerr
 /* Copy to YYRES the contents of YYSTR after stripping away unnecessary
    quotes and backslashes, so that it's suitable for yyerror.  The
    heuristic is that double-quoting is unnecessary unless the string
@@ -1182,14 +1923,13 @@ yystpcpy (char *yydest, const char *yysrc)
    backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
    null, do not copy; instead, return the length of what the result
    would have been.  */
-static YYSIZE_T
+static YYPTRDIFF_T
 yytnamerr (char *yyres, const char *yystr)
 {
   if (*yystr == '"')
     {
-      YYSIZE_T yyn = 0;
+      YYPTRDIFF_T yyn = 0;
       char const *yyp = yystr;
-
       for (;;)
         switch (*++yyp)
           {
@@ -1218,36 +1958,20 @@ yytnamerr (char *yyres, const char *yystr)
     do_not_strip_quotes: ;
     }
 
-  if (! yyres)
+  if (yyres)
+    return yystpcpy (yyres, yystr) - yyres;
+  else
     return yystrlen (yystr);
-
-  return (YYSIZE_T) (yystpcpy (yyres, yystr) - yyres);
 }
-# endif
+#endif
 
-/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
-   about the unexpected token YYTOKEN for the state stack whose top is
-   YYSSP.
 
-   Return 0 if *YYMSG was successfully written.  Return 1 if *YYMSG is
-   not large enough to hold the message.  In that case, also set
-   *YYMSG_ALLOC to the required number of bytes.  Return 2 if the
-   required number of bytes is too large to store.  */
 static int
-yysyntax_error (YYSIZE_T *yymsg_alloc, char **yymsg,
-                yytype_int16 *yyssp, int yytoken)
+yy_syntax_error_arguments (const yypcontext_t *yyctx,
+                           yysymbol_kind_t yyarg[], int yyargn)
 {
-  YYSIZE_T yysize0 = yytnamerr (YY_NULLPTR, yytname[yytoken]);
-  YYSIZE_T yysize = yysize0;
-  enum { YYERROR_VERBOSE_ARGS_MAXIMUM = 5 };
-  /* Internationalized format string. */
-  const char *yyformat = YY_NULLPTR;
-  /* Arguments of yyformat. */
-  char const *yyarg[YYERROR_VERBOSE_ARGS_MAXIMUM];
-  /* Number of reported tokens (one for the "unexpected", one per
-     "expected"). */
+  /* Actual size of YYARG. */
   int yycount = 0;
-
   /* There are many possibilities here to consider:
      - If this state is a consistent state with a default action, then
        the only way this function was invoked is if the default action
@@ -1271,49 +1995,54 @@ yysyntax_error (YYSIZE_T *yymsg_alloc, char **yymsg,
        one exception: it will still contain any token that will not be
        accepted due to an error action in a later state.
   */
-  if (yytoken != YYEMPTY)
-    {
-      int yyn = yypact[*yyssp];
-      yyarg[yycount++] = yytname[yytoken];
-      if (!yypact_value_is_default (yyn))
-        {
-          /* Start YYX at -YYN if negative to avoid negative indexes in
-             YYCHECK.  In other words, skip the first -YYN actions for
-             this state because they are default actions.  */
-          int yyxbegin = yyn < 0 ? -yyn : 0;
-          /* Stay within bounds of both yycheck and yytname.  */
-          int yychecklim = YYLAST - yyn + 1;
-          int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
-          int yyx;
-
-          for (yyx = yyxbegin; yyx < yyxend; ++yyx)
-            if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR
-                && !yytable_value_is_error (yytable[yyx + yyn]))
-              {
-                if (yycount == YYERROR_VERBOSE_ARGS_MAXIMUM)
-                  {
-                    yycount = 1;
-                    yysize = yysize0;
-                    break;
-                  }
-                yyarg[yycount++] = yytname[yyx];
-                {
-                  YYSIZE_T yysize1 = yysize + yytnamerr (YY_NULLPTR, yytname[yyx]);
-                  if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
-                    yysize = yysize1;
-                  else
-                    return 2;
-                }
-              }
-        }
+  if (yyctx->yytoken != YYSYMBOL_YYEMPTY)
+    {
+      int yyn;
+      if (yyarg)
+        yyarg[yycount] = yyctx->yytoken;
+      ++yycount;
+      yyn = yypcontext_expected_tokens (yyctx,
+                                        yyarg ? yyarg + 1 : yyarg, yyargn - 1);
+      if (yyn == YYENOMEM)
+        return YYENOMEM;
+      else
+        yycount += yyn;
     }
+  return yycount;
+}
+
+/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
+   about the unexpected token YYTOKEN for the state stack whose top is
+   YYSSP.
+
+   Return 0 if *YYMSG was successfully written.  Return -1 if *YYMSG is
+   not large enough to hold the message.  In that case, also set
+   *YYMSG_ALLOC to the required number of bytes.  Return YYENOMEM if the
+   required number of bytes is too large to store.  */
+static int
+yysyntax_error (YYPTRDIFF_T *yymsg_alloc, char **yymsg,
+                const yypcontext_t *yyctx)
+{
+  enum { YYARGS_MAX = 5 };
+  /* Internationalized format string. */
+  const char *yyformat = YY_NULLPTR;
+  /* Arguments of yyformat: reported tokens (one for the "unexpected",
+     one per "expected"). */
+  yysymbol_kind_t yyarg[YYARGS_MAX];
+  /* Cumulated lengths of YYARG.  */
+  YYPTRDIFF_T yysize = 0;
+
+  /* Actual size of YYARG. */
+  int yycount = yy_syntax_error_arguments (yyctx, yyarg, YYARGS_MAX);
+  if (yycount == YYENOMEM)
+    return YYENOMEM;
 
   switch (yycount)
     {
-# define YYCASE_(N, S)                      \
+#define YYCASE_(N, S)                       \
       case N:                               \
         yyformat = S;                       \
-      break
+        break
     default: /* Avoid compiler warnings. */
       YYCASE_(0, YY_("syntax error"));
       YYCASE_(1, YY_("syntax error, unexpected %s"));
@@ -1321,15 +2050,23 @@ yysyntax_error (YYSIZE_T *yymsg_alloc, char **yymsg,
       YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
       YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
       YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
-# undef YYCASE_
+#undef YYCASE_
     }
 
+  /* Compute error message size.  Don't count the "%s"s, but reserve
+     room for the terminator.  */
+  yysize = yystrlen (yyformat) - 2 * yycount + 1;
   {
-    YYSIZE_T yysize1 = yysize + yystrlen (yyformat);
-    if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
-      yysize = yysize1;
-    else
-      return 2;
+    int yyi;
+    for (yyi = 0; yyi < yycount; ++yyi)
+      {
+        YYPTRDIFF_T yysize1
+          = yysize + yytnamerr (YY_NULLPTR, yytname[yyarg[yyi]]);
+        if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
+          yysize = yysize1;
+        else
+          return YYENOMEM;
+      }
   }
 
   if (*yymsg_alloc < yysize)
@@ -1338,7 +2075,7 @@ yysyntax_error (YYSIZE_T *yymsg_alloc, char **yymsg,
       if (! (yysize <= *yymsg_alloc
              && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
         *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
-      return 1;
+      return -1;
     }
 
   /* Avoid sprintf, as that infringes on the user's name space.
@@ -1350,48 +2087,157 @@ yysyntax_error (YYSIZE_T *yymsg_alloc, char **yymsg,
     while ((*yyp = *yyformat) != '\0')
       if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount)
         {
-          yyp += yytnamerr (yyp, yyarg[yyi++]);
+          yyp += yytnamerr (yyp, yytname[yyarg[yyi++]]);
           yyformat += 2;
         }
       else
         {
-          yyp++;
-          yyformat++;
+          ++yyp;
+          ++yyformat;
         }
   }
   return 0;
 }
-#endif /* YYERROR_VERBOSE */
+
 
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
 `-----------------------------------------------*/
 
 static void
-yydestruct (const char *yymsg, int yytype, YYSTYPE *yyvaluep, YYLTYPE *yylocationp)
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, YYLTYPE *yylocationp, yyscan_t scanner, PyObject* builder)
 {
-  YYUSE (yyvaluep);
-  YYUSE (yylocationp);
+  YY_USE (yyvaluep);
+  YY_USE (yylocationp);
+  YY_USE (scanner);
+  YY_USE (builder);
   if (!yymsg)
     yymsg = "Deleting";
-  YY_SYMBOL_PRINT (yymsg, yytype, yyvaluep, yylocationp);
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE (yytype);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
 
 
 
-/*----------.
-| yyparse.  |
-`----------*/
 
 int
-yyparse (void)
+yyparse (yyscan_t scanner, PyObject* builder)
+{
+  yypstate *yyps = yypstate_new ();
+  if (!yyps)
+    {
+      static YYLTYPE yyloc_default
+# if defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
+  = { 1, 1, 1, 1 }
+# endif
+;
+      YYLTYPE yylloc = yyloc_default;
+      yyerror (&yylloc, scanner, builder, YY_("memory exhausted"));
+      return 2;
+    }
+  int yystatus = yypull_parse (yyps, scanner, builder);
+  yypstate_delete (yyps);
+  return yystatus;
+}
+
+int
+yypull_parse (yypstate *yyps, yyscan_t scanner, PyObject* builder)
+{
+  YY_ASSERT (yyps);
+  static YYLTYPE yyloc_default
+# if defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
+  = { 1, 1, 1, 1 }
+# endif
+;
+  YYLTYPE yylloc = yyloc_default;
+  int yystatus;
+  do {
+    YYSTYPE yylval;
+    int yychar = yylex (&yylval, &yylloc, scanner);
+    yystatus = yypush_parse (yyps, yychar, &yylval, &yylloc, scanner, builder);
+  } while (yystatus == YYPUSH_MORE);
+  return yystatus;
+}
+
+#define yynerrs yyps->yynerrs
+#define yystate yyps->yystate
+#define yyerrstatus yyps->yyerrstatus
+#define yyssa yyps->yyssa
+#define yyss yyps->yyss
+#define yyssp yyps->yyssp
+#define yyvsa yyps->yyvsa
+#define yyvs yyps->yyvs
+#define yyvsp yyps->yyvsp
+#define yylsa yyps->yylsa
+#define yyls yyps->yyls
+#define yylsp yyps->yylsp
+#define yystacksize yyps->yystacksize
+
+/* Initialize the parser data structure.  */
+static void
+yypstate_clear (yypstate *yyps)
+{
+  yynerrs = 0;
+  yystate = 0;
+  yyerrstatus = 0;
+
+  yyssp = yyss;
+  yyvsp = yyvs;
+  yylsp = yyls;
+
+  /* Initialize the state stack, in case yypcontext_expected_tokens is
+     called before the first call to yyparse. */
+  *yyssp = 0;
+  yyps->yynew = 1;
+}
+
+/* Initialize the parser data structure.  */
+yypstate *
+yypstate_new (void)
+{
+  yypstate *yyps;
+  yyps = YY_CAST (yypstate *, YYMALLOC (sizeof *yyps));
+  if (!yyps)
+    return YY_NULLPTR;
+  yystacksize = YYINITDEPTH;
+  yyss = yyssa;
+  yyvs = yyvsa;
+  yyls = yylsa;
+  yypstate_clear (yyps);
+  return yyps;
+}
+
+void
+yypstate_delete (yypstate *yyps)
+{
+  if (yyps)
+    {
+#ifndef yyoverflow
+      /* If the stack was reallocated but the parse did not complete, then the
+         stack still needs to be freed.  */
+      if (yyss != yyssa)
+        YYSTACK_FREE (yyss);
+#endif
+      YYFREE (yyps);
+    }
+}
+
+
+
+/*---------------.
+| yypush_parse.  |
+`---------------*/
+
+int
+yypush_parse (yypstate *yyps,
+              int yypushed_char, YYSTYPE const *yypushed_val, YYLTYPE *yypushed_loc, yyscan_t scanner, PyObject* builder)
 {
-/* The lookahead symbol.  */
+/* Lookahead token kind.  */
 int yychar;
 
 
@@ -1409,56 +2255,23 @@ static YYLTYPE yyloc_default
 ;
 YYLTYPE yylloc = yyloc_default;
 
-    /* Number of syntax errors so far.  */
-    int yynerrs;
-
-    int yystate;
-    /* Number of tokens to shift before error messages enabled.  */
-    int yyerrstatus;
-
-    /* The stacks and their tools:
-       'yyss': related to states.
-       'yyvs': related to semantic values.
-       'yyls': related to locations.
-
-       Refer to the stacks through separate pointers, to allow yyoverflow
-       to reallocate them elsewhere.  */
-
-    /* The state stack.  */
-    yytype_int16 yyssa[YYINITDEPTH];
-    yytype_int16 *yyss;
-    yytype_int16 *yyssp;
-
-    /* The semantic value stack.  */
-    YYSTYPE yyvsa[YYINITDEPTH];
-    YYSTYPE *yyvs;
-    YYSTYPE *yyvsp;
-
-    /* The location stack.  */
-    YYLTYPE yylsa[YYINITDEPTH];
-    YYLTYPE *yyls;
-    YYLTYPE *yylsp;
-
-    /* The locations where the error started and ended.  */
-    YYLTYPE yyerror_range[3];
-
-    YYSIZE_T yystacksize;
-
   int yyn;
+  /* The return value of yyparse.  */
   int yyresult;
-  /* Lookahead token as an internal (translated) token number.  */
-  int yytoken = 0;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
   YYLTYPE yyloc;
 
-#if YYERROR_VERBOSE
+  /* The locations where the error started and ended.  */
+  YYLTYPE yyerror_range[3];
+
   /* Buffer for error messages, and its allocated size.  */
   char yymsgbuf[128];
   char *yymsg = yymsgbuf;
-  YYSIZE_T yymsg_alloc = sizeof yymsgbuf;
-#endif
+  YYPTRDIFF_T yymsg_alloc = sizeof yymsgbuf;
 
 #define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N), yylsp -= (N))
 
@@ -1466,18 +2279,25 @@ YYLTYPE yylloc = yyloc_default;
      Keep to zero when no symbol should be popped.  */
   int yylen = 0;
 
-  yyssp = yyss = yyssa;
-  yyvsp = yyvs = yyvsa;
-  yylsp = yyls = yylsa;
-  yystacksize = YYINITDEPTH;
+  switch (yyps->yynew)
+    {
+    case 0:
+      yyn = yypact[yystate];
+      goto yyread_pushed_token;
+
+    case 2:
+      yypstate_clear (yyps);
+      break;
+
+    default:
+      break;
+    }
 
   YYDPRINTF ((stderr, "Starting parse\n"));
 
-  yystate = 0;
-  yyerrstatus = 0;
-  yynerrs = 0;
   yychar = YYEMPTY; /* Cause a token to be read.  */
-  yylsp[0] = yylloc;
+
+  yylsp[0] = *yypushed_loc;
   goto yysetstate;
 
 
@@ -1491,28 +2311,31 @@ yynewstate:
 
 
 /*--------------------------------------------------------------------.
-| yynewstate -- set current state (the top of the stack) to yystate.  |
+| yysetstate -- set current state (the top of the stack) to yystate.  |
 `--------------------------------------------------------------------*/
 yysetstate:
   YYDPRINTF ((stderr, "Entering state %d\n", yystate));
   YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
-  *yyssp = (yytype_int16) yystate;
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
 
   if (yyss + yystacksize - 1 <= yyssp)
 #if !defined yyoverflow && !defined YYSTACK_RELOCATE
-    goto yyexhaustedlab;
+    YYNOMEM;
 #else
     {
       /* Get the current used size of the three stacks, in elements.  */
-      YYSIZE_T yysize = (YYSIZE_T) (yyssp - yyss + 1);
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
 
 # if defined yyoverflow
       {
         /* Give user a chance to reallocate the stack.  Use copies of
            these so that the &'s don't force the real ones into
            memory.  */
+        yy_state_t *yyss1 = yyss;
         YYSTYPE *yyvs1 = yyvs;
-        yytype_int16 *yyss1 = yyss;
         YYLTYPE *yyls1 = yyls;
 
         /* Each stack pointer address is followed by the size of the
@@ -1520,9 +2343,9 @@ yysetstate:
            conditional around just the two extra args, but that might
            be undefined if yyoverflow is a macro.  */
         yyoverflow (YY_("memory exhausted"),
-                    &yyss1, yysize * sizeof (*yyssp),
-                    &yyvs1, yysize * sizeof (*yyvsp),
-                    &yyls1, yysize * sizeof (*yylsp),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yyls1, yysize * YYSIZEOF (*yylsp),
                     &yystacksize);
         yyss = yyss1;
         yyvs = yyvs1;
@@ -1531,21 +2354,22 @@ yysetstate:
 # else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
       if (YYMAXDEPTH <= yystacksize)
-        goto yyexhaustedlab;
+        YYNOMEM;
       yystacksize *= 2;
       if (YYMAXDEPTH < yystacksize)
         yystacksize = YYMAXDEPTH;
 
       {
-        yytype_int16 *yyss1 = yyss;
+        yy_state_t *yyss1 = yyss;
         union yyalloc *yyptr =
-          (union yyalloc *) YYSTACK_ALLOC (YYSTACK_BYTES (yystacksize));
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
         if (! yyptr)
-          goto yyexhaustedlab;
+          YYNOMEM;
         YYSTACK_RELOCATE (yyss_alloc, yyss);
         YYSTACK_RELOCATE (yyvs_alloc, yyvs);
         YYSTACK_RELOCATE (yyls_alloc, yyls);
-# undef YYSTACK_RELOCATE
+#  undef YYSTACK_RELOCATE
         if (yyss1 != yyssa)
           YYSTACK_FREE (yyss1);
       }
@@ -1555,14 +2379,17 @@ yysetstate:
       yyvsp = yyvs + yysize - 1;
       yylsp = yyls + yysize - 1;
 
-      YYDPRINTF ((stderr, "Stack size increased to %lu\n",
-                  (unsigned long) yystacksize));
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
 
       if (yyss + yystacksize - 1 <= yyssp)
         YYABORT;
     }
 #endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
+
   if (yystate == YYFINAL)
     YYACCEPT;
 
@@ -1583,18 +2410,42 @@ yybackup:
 
   /* Not known => get a lookahead token if don't already have one.  */
 
-  /* YYCHAR is either YYEMPTY or YYEOF or a valid lookahead symbol.  */
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
   if (yychar == YYEMPTY)
     {
-      YYDPRINTF ((stderr, "Reading a token: "));
-      yychar = yylex (&yylval, &yylloc);
+      if (!yyps->yynew)
+        {
+          YYDPRINTF ((stderr, "Return for a new token:\n"));
+          yyresult = YYPUSH_MORE;
+          goto yypushreturn;
+        }
+      yyps->yynew = 0;
+yyread_pushed_token:
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yypushed_char;
+      if (yypushed_val)
+        yylval = *yypushed_val;
+      if (yypushed_loc)
+        yylloc = *yypushed_loc;
     }
 
   if (yychar <= YYEOF)
     {
-      yychar = yytoken = YYEOF;
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
       YYDPRINTF ((stderr, "Now at end of input.\n"));
     }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      yyerror_range[1] = yylloc;
+      goto yyerrlab1;
+    }
   else
     {
       yytoken = YYTRANSLATE (yychar);
@@ -1622,15 +2473,14 @@ yybackup:
 
   /* Shift the lookahead token.  */
   YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
-
-  /* Discard the shifted token.  */
-  yychar = YYEMPTY;
-
   yystate = yyn;
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
   YY_IGNORE_MAYBE_UNINITIALIZED_END
   *++yylsp = yylloc;
+
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
   goto yynewstate;
 
 
@@ -1667,850 +2517,867 @@ yyreduce:
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-  case 3:
-#line 264 "beancount/parser/grammar.y"
+  case 3: /* txn: TXN  */
+#line 838 "beancount/parser/grammar.y"
     {
         (yyval.character) = '*';
     }
-#line 1676 "beancount/parser/grammar.c"
+#line 2526 "beancount/parser/grammar.c"
     break;
 
-  case 4:
-#line 268 "beancount/parser/grammar.y"
+  case 4: /* txn: FLAG  */
+#line 842 "beancount/parser/grammar.y"
     {
         (yyval.character) = (yyvsp[0].character);
     }
-#line 1684 "beancount/parser/grammar.c"
+#line 2534 "beancount/parser/grammar.c"
     break;
 
-  case 5:
-#line 272 "beancount/parser/grammar.y"
+  case 5: /* txn: ASTERISK  */
+#line 846 "beancount/parser/grammar.y"
     {
         (yyval.character) = '*';
     }
-#line 1692 "beancount/parser/grammar.c"
+#line 2542 "beancount/parser/grammar.c"
     break;
 
-  case 6:
-#line 276 "beancount/parser/grammar.y"
+  case 6: /* txn: HASH  */
+#line 850 "beancount/parser/grammar.y"
     {
         (yyval.character) = '#';
     }
-#line 1700 "beancount/parser/grammar.c"
+#line 2550 "beancount/parser/grammar.c"
     break;
 
-  case 13:
-#line 295 "beancount/parser/grammar.y"
-    {
+  case 13: /* number_expr: NUMBER  */
+#line 869 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = (yyvsp[0].pyobj);
             }
-#line 1708 "beancount/parser/grammar.c"
+#line 2558 "beancount/parser/grammar.c"
     break;
 
-  case 14:
-#line 299 "beancount/parser/grammar.y"
-    {
+  case 14: /* number_expr: number_expr PLUS number_expr  */
+#line 873 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = PyNumber_Add((yyvsp[-2].pyobj), (yyvsp[0].pyobj));
                 DECREF2((yyvsp[-2].pyobj), (yyvsp[0].pyobj));
             }
-#line 1717 "beancount/parser/grammar.c"
+#line 2567 "beancount/parser/grammar.c"
     break;
 
-  case 15:
-#line 304 "beancount/parser/grammar.y"
-    {
+  case 15: /* number_expr: number_expr MINUS number_expr  */
+#line 878 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = PyNumber_Subtract((yyvsp[-2].pyobj), (yyvsp[0].pyobj));
                 DECREF2((yyvsp[-2].pyobj), (yyvsp[0].pyobj));
             }
-#line 1726 "beancount/parser/grammar.c"
+#line 2576 "beancount/parser/grammar.c"
     break;
 
-  case 16:
-#line 309 "beancount/parser/grammar.y"
-    {
+  case 16: /* number_expr: number_expr ASTERISK number_expr  */
+#line 883 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = PyNumber_Multiply((yyvsp[-2].pyobj), (yyvsp[0].pyobj));
                 DECREF2((yyvsp[-2].pyobj), (yyvsp[0].pyobj));
             }
-#line 1735 "beancount/parser/grammar.c"
+#line 2585 "beancount/parser/grammar.c"
     break;
 
-  case 17:
-#line 314 "beancount/parser/grammar.y"
-    {
+  case 17: /* number_expr: number_expr SLASH number_expr  */
+#line 888 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = PyNumber_TrueDivide((yyvsp[-2].pyobj), (yyvsp[0].pyobj));
                 DECREF2((yyvsp[-2].pyobj), (yyvsp[0].pyobj));
             }
-#line 1744 "beancount/parser/grammar.c"
+#line 2594 "beancount/parser/grammar.c"
     break;
 
-  case 18:
-#line 319 "beancount/parser/grammar.y"
-    {
+  case 18: /* number_expr: MINUS number_expr  */
+#line 893 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = PyNumber_Negative((yyvsp[0].pyobj));
                 DECREF1((yyvsp[0].pyobj));
             }
-#line 1753 "beancount/parser/grammar.c"
+#line 2603 "beancount/parser/grammar.c"
     break;
 
-  case 19:
-#line 324 "beancount/parser/grammar.y"
-    {
+  case 19: /* number_expr: PLUS number_expr  */
+#line 898 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = (yyvsp[0].pyobj);
             }
-#line 1761 "beancount/parser/grammar.c"
+#line 2611 "beancount/parser/grammar.c"
     break;
 
-  case 20:
-#line 328 "beancount/parser/grammar.y"
-    {
+  case 20: /* number_expr: LPAREN number_expr RPAREN  */
+#line 902 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = (yyvsp[-1].pyobj);
             }
-#line 1769 "beancount/parser/grammar.c"
+#line 2619 "beancount/parser/grammar.c"
     break;
 
-  case 21:
-#line 333 "beancount/parser/grammar.y"
-    {
+  case 21: /* txn_strings: empty  */
+#line 907 "beancount/parser/grammar.y"
+            {
                 Py_INCREF(Py_None);
                 (yyval.pyobj) = Py_None;
             }
-#line 1778 "beancount/parser/grammar.c"
+#line 2628 "beancount/parser/grammar.c"
     break;
 
-  case 22:
-#line 338 "beancount/parser/grammar.y"
-    {
-                BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                       (yyval.pyobj), "handle_list", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 22: /* txn_strings: txn_strings STRING  */
+#line 912 "beancount/parser/grammar.y"
+            {
+                BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                       (yyval.pyobj), native_handle_list((yyvsp[-1].pyobj), (yyvsp[0].pyobj)), handle_list, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
             }
-#line 1787 "beancount/parser/grammar.c"
+#line 2637 "beancount/parser/grammar.c"
     break;
 
-  case 23:
-#line 343 "beancount/parser/grammar.y"
-    {
+  case 23: /* txn_strings: txn_strings PIPE  */
+#line 917 "beancount/parser/grammar.y"
+            {
                 BUILDY(,
-                       (yyval.pyobj), "pipe_deprecated_error", "si", FILE_LINE_ARGS);
+                       (yyval.pyobj), pipe_deprecated_error, "si", FILE_LINE_ARGS);
                 (yyval.pyobj) = (yyvsp[-1].pyobj);
             }
-#line 1797 "beancount/parser/grammar.c"
+#line 2647 "beancount/parser/grammar.c"
     break;
 
-  case 24:
-#line 350 "beancount/parser/grammar.y"
-    {
+  case 24: /* tags_links: empty  */
+#line 924 "beancount/parser/grammar.y"
+           {
                /* Note: We're passing a bogus value here in order to avoid
                 * having to declare a second macro just for this one special
                 * case. */
-               BUILDY(,
-                      (yyval.pyobj), "tag_link_new", "O", Py_None);
+               BUILDN(,
+                      (yyval.pyobj), native_tag_link_new(NATIVE), tag_link_new, "O", Py_None);
            }
-#line 1809 "beancount/parser/grammar.c"
+#line 2659 "beancount/parser/grammar.c"
     break;
 
-  case 25:
-#line 358 "beancount/parser/grammar.y"
-    {
-               BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                      (yyval.pyobj), "tag_link_LINK", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 25: /* tags_links: tags_links LINK  */
+#line 932 "beancount/parser/grammar.y"
+           {
+               BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                      (yyval.pyobj), native_tag_link_add(NATIVE, (yyvsp[-1].pyobj), 1, (yyvsp[0].pyobj)), tag_link_LINK, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
            }
-#line 1818 "beancount/parser/grammar.c"
+#line 2668 "beancount/parser/grammar.c"
     break;
 
-  case 26:
-#line 363 "beancount/parser/grammar.y"
-    {
-               BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                      (yyval.pyobj), "tag_link_TAG", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 26: /* tags_links: tags_links TAG  */
+#line 937 "beancount/parser/grammar.y"
+           {
+               BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                      (yyval.pyobj), native_tag_link_add(NATIVE, (yyvsp[-1].pyobj), 0, (yyvsp[0].pyobj)), tag_link_TAG, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
            }
-#line 1827 "beancount/parser/grammar.c"
+#line 2677 "beancount/parser/grammar.c"
     break;
 
-  case 27:
-#line 369 "beancount/parser/grammar.y"
-    {
-                BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                       (yyval.pyobj), "transaction", "siObOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-4].character), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+  case 27: /* transaction: DATE txn txn_strings tags_links eol posting_or_kv_list  */
+#line 943 "beancount/parser/grammar.y"
+            {
+                BUILDN(DECREF4((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
+                       (yyval.pyobj), native_transaction(NATIVE, LINE_ARG, (yyvsp[-5].pyobj), (yyvsp[-4].character), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
+                       transaction, "siObOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-4].character), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
             }
-#line 1836 "beancount/parser/grammar.c"
+#line 2687 "beancount/parser/grammar.c"
     break;
 
-  case 28:
-#line 375 "beancount/parser/grammar.y"
-    {
+  case 28: /* optflag: empty  */
+#line 950 "beancount/parser/grammar.y"
+        {
             (yyval.character) = '\0';
         }
-#line 1844 "beancount/parser/grammar.c"
+#line 2695 "beancount/parser/grammar.c"
     break;
 
-  case 29:
-#line 379 "beancount/parser/grammar.y"
-    {
+  case 29: /* optflag: ASTERISK  */
+#line 954 "beancount/parser/grammar.y"
+        {
             (yyval.character) = '*';
         }
-#line 1852 "beancount/parser/grammar.c"
+#line 2703 "beancount/parser/grammar.c"
     break;
 
-  case 30:
-#line 383 "beancount/parser/grammar.y"
-    {
+  case 30: /* optflag: HASH  */
+#line 958 "beancount/parser/grammar.y"
+        {
             (yyval.character) = '#';
         }
-#line 1860 "beancount/parser/grammar.c"
+#line 2711 "beancount/parser/grammar.c"
     break;
 
-  case 32:
-#line 389 "beancount/parser/grammar.y"
-    {
+  case 32: /* price_annotation: incomplete_amount  */
+#line 964 "beancount/parser/grammar.y"
+                 {
                      (yyval.pyobj) = (yyvsp[0].pyobj);
                  }
-#line 1868 "beancount/parser/grammar.c"
+#line 2719 "beancount/parser/grammar.c"
     break;
 
-  case 33:
-#line 394 "beancount/parser/grammar.y"
-    {
-            BUILDY(DECREF3((yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[-1].pyobj)),
-                   (yyval.pyobj), "posting", "siOOOOOb", FILE_LINE_ARGS, (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[-1].pyobj), Py_None, Py_False, (yyvsp[-4].character));
+  case 33: /* posting: INDENT optflag ACCOUNT incomplete_amount cost_spec eol  */
+#line 969 "beancount/parser/grammar.y"
+        {
+            BUILDN(DECREF3((yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[-1].pyobj)),
+                   (yyval.pyobj), native_posting(NATIVE, LINE_ARG, (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[-1].pyobj), (yyvsp[-4].character)),
+                   posting, "siOOOOOb", FILE_LINE_ARGS, (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[-1].pyobj), Py_None, Py_False, (yyvsp[-4].character));
         }
-#line 1877 "beancount/parser/grammar.c"
+#line 2729 "beancount/parser/grammar.c"
     break;
 
-  case 34:
-#line 399 "beancount/parser/grammar.y"
-    {
+  case 34: /* posting: INDENT optflag ACCOUNT incomplete_amount cost_spec AT price_annotation eol  */
+#line 975 "beancount/parser/grammar.y"
+        {
             BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-1].pyobj)),
-                   (yyval.pyobj), "posting", "siOOOOOb", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-1].pyobj), Py_False, (yyvsp[-6].character));
+                   (yyval.pyobj), posting, "siOOOOOb", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-1].pyobj), Py_False, (yyvsp[-6].character));
         }
-#line 1886 "beancount/parser/grammar.c"
+#line 2738 "beancount/parser/grammar.c"
     break;
 
-  case 35:
-#line 404 "beancount/parser/grammar.y"
-    {
+  case 35: /* posting: INDENT optflag ACCOUNT incomplete_amount cost_spec ATAT price_annotation eol  */
+#line 980 "beancount/parser/grammar.y"
+        {
             BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-1].pyobj)),
-                   (yyval.pyobj), "posting", "siOOOOOb", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-1].pyobj), Py_True, (yyvsp[-6].character));
+                   (yyval.pyobj), posting, "siOOOOOb", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-1].pyobj), Py_True, (yyvsp[-6].character));
         }
-#line 1895 "beancount/parser/grammar.c"
+#line 2747 "beancount/parser/grammar.c"
     break;
 
-  case 36:
-#line 409 "beancount/parser/grammar.y"
-    {
-            BUILDY(DECREF1((yyvsp[-1].pyobj)),
-                   (yyval.pyobj), "posting", "siOOOOOb", FILE_LINE_ARGS, (yyvsp[-1].pyobj), missing_obj, Py_None, Py_None, Py_False, (yyvsp[-2].character));
+  case 36: /* posting: INDENT optflag ACCOUNT eol  */
+#line 985 "beancount/parser/grammar.y"
+        {
+            BUILDN(DECREF1((yyvsp[-1].pyobj)),
+                   (yyval.pyobj), native_posting(NATIVE, LINE_ARG, (yyvsp[-1].pyobj), missing_obj, Py_None, (yyvsp[-2].character)),
+                   posting, "siOOOOOb", FILE_LINE_ARGS, (yyvsp[-1].pyobj), missing_obj, Py_None, Py_None, Py_False, (yyvsp[-2].character));
         }
-#line 1904 "beancount/parser/grammar.c"
+#line 2757 "beancount/parser/grammar.c"
     break;
 
-  case 37:
-#line 415 "beancount/parser/grammar.y"
-    {
-              BUILDY(DECREF2((yyvsp[-1].string), (yyvsp[0].pyobj)),
-                     (yyval.pyobj), "key_value", "OO", (yyvsp[-1].string), (yyvsp[0].pyobj));
+  case 37: /* key_value: KEY COLON key_value_value  */
+#line 992 "beancount/parser/grammar.y"
+          {
+              BUILDN(DECREF2((yyvsp[-1].string), (yyvsp[0].pyobj)),
+                     (yyval.pyobj), native_tuple(key_value_type, 2, (yyvsp[-1].string), (yyvsp[0].pyobj)), key_value, "OO", (yyvsp[-1].string), (yyvsp[0].pyobj));
           }
-#line 1913 "beancount/parser/grammar.c"
+#line 2766 "beancount/parser/grammar.c"
     break;
 
-  case 38:
-#line 421 "beancount/parser/grammar.y"
-    {
+  case 38: /* key_value_line: INDENT key_value eol  */
+#line 998 "beancount/parser/grammar.y"
+               {
                    (yyval.pyobj) = (yyvsp[-1].pyobj);
                }
-#line 1921 "beancount/parser/grammar.c"
+#line 2774 "beancount/parser/grammar.c"
     break;
 
-  case 47:
-#line 434 "beancount/parser/grammar.y"
-    {
+  case 47: /* key_value_value: amount  */
+#line 1011 "beancount/parser/grammar.y"
+                {
                     (yyval.pyobj) = (yyvsp[0].pyobj);
                 }
-#line 1929 "beancount/parser/grammar.c"
+#line 2782 "beancount/parser/grammar.c"
     break;
 
-  case 48:
-#line 438 "beancount/parser/grammar.y"
-    {
+  case 48: /* key_value_value: empty  */
+#line 1015 "beancount/parser/grammar.y"
+                {
                     Py_INCREF(Py_None);
                     (yyval.pyobj) = Py_None;
                 }
-#line 1938 "beancount/parser/grammar.c"
+#line 2791 "beancount/parser/grammar.c"
     break;
 
-  case 49:
-#line 444 "beancount/parser/grammar.y"
-    {
+  case 49: /* posting_or_kv_list: empty  */
+#line 1021 "beancount/parser/grammar.y"
+                   {
                        Py_INCREF(Py_None);
                        (yyval.pyobj) = Py_None;
                    }
-#line 1947 "beancount/parser/grammar.c"
+#line 2800 "beancount/parser/grammar.c"
     break;
 
-  case 50:
-#line 449 "beancount/parser/grammar.y"
-    {
+  case 50: /* posting_or_kv_list: posting_or_kv_list INDENT COMMENT EOL  */
+#line 1026 "beancount/parser/grammar.y"
+                   {
                        (yyval.pyobj) = (yyvsp[-3].pyobj);
                    }
-#line 1955 "beancount/parser/grammar.c"
+#line 2808 "beancount/parser/grammar.c"
     break;
 
-  case 51:
-#line 453 "beancount/parser/grammar.y"
-    {
-                       BUILDY(DECREF2((yyvsp[-3].pyobj), (yyvsp[-1].pyobj)),
-                              (yyval.pyobj), "handle_list", "OO", (yyvsp[-3].pyobj), (yyvsp[-1].pyobj));
+  case 51: /* posting_or_kv_list: posting_or_kv_list INDENT tags_links EOL  */
+#line 1030 "beancount/parser/grammar.y"
+                   {
+                       BUILDN(DECREF2((yyvsp[-3].pyobj), (yyvsp[-1].pyobj)),
+                              (yyval.pyobj), native_handle_list((yyvsp[-3].pyobj), (yyvsp[-1].pyobj)), handle_list, "OO", (yyvsp[-3].pyobj), (yyvsp[-1].pyobj));
                    }
-#line 1964 "beancount/parser/grammar.c"
+#line 2817 "beancount/parser/grammar.c"
     break;
 
-  case 52:
-#line 458 "beancount/parser/grammar.y"
-    {
-                       BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                              (yyval.pyobj), "handle_list", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 52: /* posting_or_kv_list: posting_or_kv_list key_value_line  */
+#line 1035 "beancount/parser/grammar.y"
+                   {
+                       BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                              (yyval.pyobj), native_handle_list((yyvsp[-1].pyobj), (yyvsp[0].pyobj)), handle_list, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
                    }
-#line 1973 "beancount/parser/grammar.c"
+#line 2826 "beancount/parser/grammar.c"
     break;
 
-  case 53:
-#line 463 "beancount/parser/grammar.y"
-    {
-                       BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                              (yyval.pyobj), "handle_list", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 53: /* posting_or_kv_list: posting_or_kv_list posting  */
+#line 1040 "beancount/parser/grammar.y"
+                   {
+                       BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                              (yyval.pyobj), native_handle_list((yyvsp[-1].pyobj), (yyvsp[0].pyobj)), handle_list, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
                    }
-#line 1982 "beancount/parser/grammar.c"
+#line 2835 "beancount/parser/grammar.c"
     break;
 
-  case 54:
-#line 469 "beancount/parser/grammar.y"
-    {
+  case 54: /* key_value_list: empty  */
+#line 1046 "beancount/parser/grammar.y"
+               {
                    Py_INCREF(Py_None);
                    (yyval.pyobj) = Py_None;
                }
-#line 1991 "beancount/parser/grammar.c"
+#line 2844 "beancount/parser/grammar.c"
     break;
 
-  case 55:
-#line 474 "beancount/parser/grammar.y"
-    {
-                   BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                          (yyval.pyobj), "handle_list", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 55: /* key_value_list: key_value_list key_value_line  */
+#line 1051 "beancount/parser/grammar.y"
+               {
+                   BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                          (yyval.pyobj), native_handle_list((yyvsp[-1].pyobj), (yyvsp[0].pyobj)), handle_list, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
                }
-#line 2000 "beancount/parser/grammar.c"
+#line 2853 "beancount/parser/grammar.c"
     break;
 
-  case 56:
-#line 480 "beancount/parser/grammar.y"
-    {
+  case 56: /* currency_list: empty  */
+#line 1057 "beancount/parser/grammar.y"
+              {
                   Py_INCREF(Py_None);
                   (yyval.pyobj) = Py_None;
               }
-#line 2009 "beancount/parser/grammar.c"
+#line 2862 "beancount/parser/grammar.c"
     break;
 
-  case 57:
-#line 485 "beancount/parser/grammar.y"
-    {
-                  BUILDY(DECREF1((yyvsp[0].pyobj)),
-                         (yyval.pyobj), "handle_list", "OO", Py_None, (yyvsp[0].pyobj));
+  case 57: /* currency_list: CURRENCY  */
+#line 1062 "beancount/parser/grammar.y"
+              {
+                  BUILDN(DECREF1((yyvsp[0].pyobj)),
+                         (yyval.pyobj), native_handle_list(Py_None, (yyvsp[0].pyobj)), handle_list, "OO", Py_None, (yyvsp[0].pyobj));
               }
-#line 2018 "beancount/parser/grammar.c"
+#line 2871 "beancount/parser/grammar.c"
     break;
 
-  case 58:
-#line 490 "beancount/parser/grammar.y"
-    {
-                  BUILDY(DECREF2((yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                         (yyval.pyobj), "handle_list", "OO", (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+  case 58: /* currency_list: currency_list COMMA CURRENCY  */
+#line 1067 "beancount/parser/grammar.y"
+              {
+                  BUILDN(DECREF2((yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
+                         (yyval.pyobj), native_handle_list((yyvsp[-2].pyobj), (yyvsp[0].pyobj)), handle_list, "OO", (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
               }
-#line 2027 "beancount/parser/grammar.c"
+#line 2880 "beancount/parser/grammar.c"
     break;
 
-  case 59:
-#line 496 "beancount/parser/grammar.y"
-    {
+  case 59: /* pushtag: PUSHTAG TAG eol  */
+#line 1073 "beancount/parser/grammar.y"
+         {
              BUILDY(DECREF1((yyvsp[-1].pyobj)),
-                    (yyval.pyobj), "pushtag", "O", (yyvsp[-1].pyobj));
+                    (yyval.pyobj), pushtag, "O", (yyvsp[-1].pyobj));
          }
-#line 2036 "beancount/parser/grammar.c"
+#line 2889 "beancount/parser/grammar.c"
     break;
 
-  case 60:
-#line 502 "beancount/parser/grammar.y"
-    {
+  case 60: /* poptag: POPTAG TAG eol  */
+#line 1079 "beancount/parser/grammar.y"
+       {
            BUILDY(DECREF1((yyvsp[-1].pyobj)),
-                  (yyval.pyobj), "poptag", "O", (yyvsp[-1].pyobj));
+                  (yyval.pyobj), poptag, "O", (yyvsp[-1].pyobj));
        }
-#line 2045 "beancount/parser/grammar.c"
+#line 2898 "beancount/parser/grammar.c"
     break;
 
-  case 61:
-#line 508 "beancount/parser/grammar.y"
-    {
+  case 61: /* pushmeta: PUSHMETA key_value eol  */
+#line 1085 "beancount/parser/grammar.y"
+         {
              /* Note: key_value is a tuple, Py_BuildValue() won't wrap it up
               * within a tuple, so expand in the method (it receives two
               * objects). See https://docs.python.org/3.4/c-api/arg.html. */
              BUILDY(DECREF1((yyvsp[-1].pyobj)),
-                    (yyval.pyobj), "pushmeta", "O", (yyvsp[-1].pyobj));
+                    (yyval.pyobj), pushmeta, "O", (yyvsp[-1].pyobj));
          }
-#line 2057 "beancount/parser/grammar.c"
+#line 2910 "beancount/parser/grammar.c"
     break;
 
-  case 62:
-#line 517 "beancount/parser/grammar.y"
-    {
+  case 62: /* popmeta: POPMETA KEY COLON eol  */
+#line 1094 "beancount/parser/grammar.y"
+        {
             BUILDY(DECREF1((yyvsp[-2].pyobj)),
-                   (yyval.pyobj), "popmeta", "O", (yyvsp[-2].pyobj));
+                   (yyval.pyobj), popmeta, "O", (yyvsp[-2].pyobj));
         }
-#line 2066 "beancount/parser/grammar.c"
+#line 2919 "beancount/parser/grammar.c"
     break;
 
-  case 63:
-#line 523 "beancount/parser/grammar.y"
-    {
+  case 63: /* open: DATE OPEN ACCOUNT currency_list opt_booking eol key_value_list  */
+#line 1100 "beancount/parser/grammar.y"
+     {
          BUILDY(DECREF5((yyvsp[-6].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                (yyval.pyobj), "open", "siOOOOO", FILE_LINE_ARGS, (yyvsp[-6].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                (yyval.pyobj), open, "siOOOOO", FILE_LINE_ARGS, (yyvsp[-6].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
          ;
      }
-#line 2076 "beancount/parser/grammar.c"
+#line 2929 "beancount/parser/grammar.c"
     break;
 
-  case 64:
-#line 530 "beancount/parser/grammar.y"
-    {
+  case 64: /* opt_booking: STRING  */
+#line 1107 "beancount/parser/grammar.y"
+            {
                 (yyval.pyobj) = (yyvsp[0].pyobj);
             }
-#line 2084 "beancount/parser/grammar.c"
+#line 2937 "beancount/parser/grammar.c"
     break;
 
-  case 65:
-#line 534 "beancount/parser/grammar.y"
-    {
+  case 65: /* opt_booking: empty  */
+#line 1111 "beancount/parser/grammar.y"
+            {
                 Py_INCREF(Py_None);
                 (yyval.pyobj) = Py_None;
             }
-#line 2093 "beancount/parser/grammar.c"
+#line 2946 "beancount/parser/grammar.c"
     break;
 
-  case 66:
-#line 540 "beancount/parser/grammar.y"
-    {
+  case 66: /* close: DATE CLOSE ACCOUNT eol key_value_list  */
+#line 1117 "beancount/parser/grammar.y"
+      {
           BUILDY(DECREF3((yyvsp[-4].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                 (yyval.pyobj), "close", "siOOO", FILE_LINE_ARGS, (yyvsp[-4].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                 (yyval.pyobj), close, "siOOO", FILE_LINE_ARGS, (yyvsp[-4].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
       }
-#line 2102 "beancount/parser/grammar.c"
+#line 2955 "beancount/parser/grammar.c"
     break;
 
-  case 67:
-#line 546 "beancount/parser/grammar.y"
-    {
+  case 67: /* commodity: DATE COMMODITY CURRENCY eol key_value_list  */
+#line 1123 "beancount/parser/grammar.y"
+          {
               BUILDY(DECREF3((yyvsp[-4].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                     (yyval.pyobj), "commodity", "siOOO", FILE_LINE_ARGS, (yyvsp[-4].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                     (yyval.pyobj), commodity, "siOOO", FILE_LINE_ARGS, (yyvsp[-4].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
           }
-#line 2111 "beancount/parser/grammar.c"
+#line 2964 "beancount/parser/grammar.c"
     break;
 
-  case 68:
-#line 552 "beancount/parser/grammar.y"
+  case 68: /* pad: DATE PAD ACCOUNT ACCOUNT eol key_value_list  */
+#line 1129 "beancount/parser/grammar.y"
     {
         BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-               (yyval.pyobj), "pad", "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+               (yyval.pyobj), pad, "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
     }
-#line 2120 "beancount/parser/grammar.c"
+#line 2973 "beancount/parser/grammar.c"
     break;
 
-  case 69:
-#line 558 "beancount/parser/grammar.y"
-    {
+  case 69: /* balance: DATE BALANCE ACCOUNT amount_tolerance eol key_value_list  */
+#line 1135 "beancount/parser/grammar.y"
+        {
             BUILDY(DECREF5((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[0].pyobj), (yyvsp[-2].pairobj).pyobj1, (yyvsp[-2].pairobj).pyobj2),
-                   (yyval.pyobj), "balance", "siOOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pairobj).pyobj1, (yyvsp[-2].pairobj).pyobj2, (yyvsp[0].pyobj));
+                   (yyval.pyobj), balance, "siOOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pairobj).pyobj1, (yyvsp[-2].pairobj).pyobj2, (yyvsp[0].pyobj));
         }
-#line 2129 "beancount/parser/grammar.c"
+#line 2982 "beancount/parser/grammar.c"
     break;
 
-  case 70:
-#line 564 "beancount/parser/grammar.y"
-    {
-           BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                  (yyval.pyobj), "amount", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 70: /* amount: number_expr CURRENCY  */
+#line 1141 "beancount/parser/grammar.y"
+       {
+           BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                  (yyval.pyobj), native_amount(NATIVE, (yyvsp[-1].pyobj), (yyvsp[0].pyobj)), amount, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
        }
-#line 2138 "beancount/parser/grammar.c"
+#line 2991 "beancount/parser/grammar.c"
     break;
 
-  case 71:
-#line 570 "beancount/parser/grammar.y"
-    {
-                     BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                            (yyval.pairobj).pyobj1, "amount", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 71: /* amount_tolerance: number_expr CURRENCY  */
+#line 1147 "beancount/parser/grammar.y"
+                 {
+                     BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                            (yyval.pairobj).pyobj1, native_amount(NATIVE, (yyvsp[-1].pyobj), (yyvsp[0].pyobj)), amount, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
                      (yyval.pairobj).pyobj2 = Py_None;
                      Py_INCREF(Py_None);
                      ;
                  }
-#line 2150 "beancount/parser/grammar.c"
+#line 3003 "beancount/parser/grammar.c"
     break;
 
-  case 72:
-#line 578 "beancount/parser/grammar.y"
-    {
-                     BUILDY(DECREF2((yyvsp[-3].pyobj), (yyvsp[0].pyobj)),
-                            (yyval.pairobj).pyobj1, "amount", "OO", (yyvsp[-3].pyobj), (yyvsp[0].pyobj));
+  case 72: /* amount_tolerance: number_expr TILDE number_expr CURRENCY  */
+#line 1155 "beancount/parser/grammar.y"
+                 {
+                     BUILDN(DECREF2((yyvsp[-3].pyobj), (yyvsp[0].pyobj)),
+                            (yyval.pairobj).pyobj1, native_amount(NATIVE, (yyvsp[-3].pyobj), (yyvsp[0].pyobj)), amount, "OO", (yyvsp[-3].pyobj), (yyvsp[0].pyobj));
                      (yyval.pairobj).pyobj2 = (yyvsp[-1].pyobj);
                  }
-#line 2160 "beancount/parser/grammar.c"
+#line 3013 "beancount/parser/grammar.c"
     break;
 
-  case 73:
-#line 585 "beancount/parser/grammar.y"
-    {
+  case 73: /* maybe_number: empty  */
+#line 1162 "beancount/parser/grammar.y"
+             {
                  Py_INCREF(missing_obj);
                  (yyval.pyobj) = missing_obj;
              }
-#line 2169 "beancount/parser/grammar.c"
+#line 3022 "beancount/parser/grammar.c"
     break;
 
-  case 74:
-#line 590 "beancount/parser/grammar.y"
-    {
+  case 74: /* maybe_number: number_expr  */
+#line 1167 "beancount/parser/grammar.y"
+             {
                  (yyval.pyobj) = (yyvsp[0].pyobj);
              }
-#line 2177 "beancount/parser/grammar.c"
+#line 3030 "beancount/parser/grammar.c"
     break;
 
-  case 75:
-#line 595 "beancount/parser/grammar.y"
-    {
+  case 75: /* maybe_currency: empty  */
+#line 1172 "beancount/parser/grammar.y"
+             {
                  Py_INCREF(missing_obj);
                  (yyval.pyobj) = missing_obj;
              }
-#line 2186 "beancount/parser/grammar.c"
+#line 3039 "beancount/parser/grammar.c"
     break;
 
-  case 76:
-#line 600 "beancount/parser/grammar.y"
-    {
+  case 76: /* maybe_currency: CURRENCY  */
+#line 1177 "beancount/parser/grammar.y"
+             {
                  (yyval.pyobj) = (yyvsp[0].pyobj);
              }
-#line 2194 "beancount/parser/grammar.c"
+#line 3047 "beancount/parser/grammar.c"
     break;
 
-  case 77:
-#line 605 "beancount/parser/grammar.y"
-    {
+  case 77: /* compound_amount: maybe_number CURRENCY  */
+#line 1182 "beancount/parser/grammar.y"
+                {
                     BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                           (yyval.pyobj), "compound_amount", "OOO", (yyvsp[-1].pyobj), Py_None, (yyvsp[0].pyobj));
+                           (yyval.pyobj), compound_amount, "OOO", (yyvsp[-1].pyobj), Py_None, (yyvsp[0].pyobj));
                 }
-#line 2203 "beancount/parser/grammar.c"
+#line 3056 "beancount/parser/grammar.c"
     break;
 
-  case 78:
-#line 610 "beancount/parser/grammar.y"
-    {
+  case 78: /* compound_amount: number_expr maybe_currency  */
+#line 1187 "beancount/parser/grammar.y"
+                {
                     BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                           (yyval.pyobj), "compound_amount", "OOO", (yyvsp[-1].pyobj), Py_None, (yyvsp[0].pyobj));
+                           (yyval.pyobj), compound_amount, "OOO", (yyvsp[-1].pyobj), Py_None, (yyvsp[0].pyobj));
                 }
-#line 2212 "beancount/parser/grammar.c"
+#line 3065 "beancount/parser/grammar.c"
     break;
 
-  case 79:
-#line 615 "beancount/parser/grammar.y"
-    {
+  case 79: /* compound_amount: maybe_number HASH maybe_number CURRENCY  */
+#line 1192 "beancount/parser/grammar.y"
+                {
                     BUILDY(DECREF3((yyvsp[-3].pyobj), (yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                           (yyval.pyobj), "compound_amount", "OOO", (yyvsp[-3].pyobj), (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+                           (yyval.pyobj), compound_amount, "OOO", (yyvsp[-3].pyobj), (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
                     ;
                 }
-#line 2222 "beancount/parser/grammar.c"
+#line 3075 "beancount/parser/grammar.c"
     break;
 
-  case 80:
-#line 622 "beancount/parser/grammar.y"
-    {
-                      BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                             (yyval.pyobj), "amount", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 80: /* incomplete_amount: maybe_number maybe_currency  */
+#line 1199 "beancount/parser/grammar.y"
+                  {
+                      BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                             (yyval.pyobj), native_amount(NATIVE, (yyvsp[-1].pyobj), (yyvsp[0].pyobj)), amount, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
                  }
-#line 2231 "beancount/parser/grammar.c"
+#line 3084 "beancount/parser/grammar.c"
     break;
 
-  case 81:
-#line 628 "beancount/parser/grammar.y"
-    {
+  case 81: /* cost_spec: LCURL cost_comp_list RCURL  */
+#line 1205 "beancount/parser/grammar.y"
+          {
               BUILDY(DECREF1((yyvsp[-1].pyobj)),
-                     (yyval.pyobj), "cost_spec", "OO", (yyvsp[-1].pyobj), Py_False);
+                     (yyval.pyobj), cost_spec, "OO", (yyvsp[-1].pyobj), Py_False);
           }
-#line 2240 "beancount/parser/grammar.c"
+#line 3093 "beancount/parser/grammar.c"
     break;
 
-  case 82:
-#line 633 "beancount/parser/grammar.y"
-    {
+  case 82: /* cost_spec: LCURLCURL cost_comp_list RCURLCURL  */
+#line 1210 "beancount/parser/grammar.y"
+          {
               BUILDY(DECREF1((yyvsp[-1].pyobj)),
-                     (yyval.pyobj), "cost_spec", "OO", (yyvsp[-1].pyobj), Py_True);
+                     (yyval.pyobj), cost_spec, "OO", (yyvsp[-1].pyobj), Py_True);
           }
-#line 2249 "beancount/parser/grammar.c"
+#line 3102 "beancount/parser/grammar.c"
     break;
 
-  case 83:
-#line 638 "beancount/parser/grammar.y"
-    {
+  case 83: /* cost_spec: empty  */
+#line 1215 "beancount/parser/grammar.y"
+          {
               Py_INCREF(Py_None);
               (yyval.pyobj) = Py_None;
           }
-#line 2258 "beancount/parser/grammar.c"
+#line 3111 "beancount/parser/grammar.c"
     break;
 
-  case 84:
-#line 644 "beancount/parser/grammar.y"
-    {
+  case 84: /* cost_comp_list: empty  */
+#line 1221 "beancount/parser/grammar.y"
+               {
                    /* We indicate that there was a cost if there */
                    (yyval.pyobj) = PyList_New(0);
                }
-#line 2267 "beancount/parser/grammar.c"
+#line 3120 "beancount/parser/grammar.c"
     break;
 
-  case 85:
-#line 649 "beancount/parser/grammar.y"
-    {
-                   BUILDY(DECREF1((yyvsp[0].pyobj)),
-                          (yyval.pyobj), "handle_list", "OO", Py_None, (yyvsp[0].pyobj));
+  case 85: /* cost_comp_list: cost_comp  */
+#line 1226 "beancount/parser/grammar.y"
+               {
+                   BUILDN(DECREF1((yyvsp[0].pyobj)),
+                          (yyval.pyobj), native_handle_list(Py_None, (yyvsp[0].pyobj)), handle_list, "OO", Py_None, (yyvsp[0].pyobj));
                }
-#line 2276 "beancount/parser/grammar.c"
+#line 3129 "beancount/parser/grammar.c"
     break;
 
-  case 86:
-#line 654 "beancount/parser/grammar.y"
-    {
-                   BUILDY(DECREF2((yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                          (yyval.pyobj), "handle_list", "OO", (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+  case 86: /* cost_comp_list: cost_comp_list COMMA cost_comp  */
+#line 1231 "beancount/parser/grammar.y"
+               {
+                   BUILDN(DECREF2((yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
+                          (yyval.pyobj), native_handle_list((yyvsp[-2].pyobj), (yyvsp[0].pyobj)), handle_list, "OO", (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
                }
-#line 2285 "beancount/parser/grammar.c"
+#line 3138 "beancount/parser/grammar.c"
     break;
 
-  case 87:
-#line 660 "beancount/parser/grammar.y"
-    {
+  case 87: /* cost_comp: compound_amount  */
+#line 1237 "beancount/parser/grammar.y"
+          {
               (yyval.pyobj) = (yyvsp[0].pyobj);
           }
-#line 2293 "beancount/parser/grammar.c"
+#line 3146 "beancount/parser/grammar.c"
     break;
 
-  case 88:
-#line 664 "beancount/parser/grammar.y"
-    {
+  case 88: /* cost_comp: DATE  */
+#line 1241 "beancount/parser/grammar.y"
+          {
               (yyval.pyobj) = (yyvsp[0].pyobj);
           }
-#line 2301 "beancount/parser/grammar.c"
+#line 3154 "beancount/parser/grammar.c"
     break;
 
-  case 89:
-#line 668 "beancount/parser/grammar.y"
-    {
+  case 89: /* cost_comp: STRING  */
+#line 1245 "beancount/parser/grammar.y"
+          {
               (yyval.pyobj) = (yyvsp[0].pyobj);
           }
-#line 2309 "beancount/parser/grammar.c"
+#line 3162 "beancount/parser/grammar.c"
     break;
 
-  case 90:
-#line 672 "beancount/parser/grammar.y"
-    {
+  case 90: /* cost_comp: ASTERISK  */
+#line 1249 "beancount/parser/grammar.y"
+          {
               BUILDY(,
-                     (yyval.pyobj), "cost_merge", "O", Py_None);
+                     (yyval.pyobj), cost_merge, "O", Py_None);
           }
-#line 2318 "beancount/parser/grammar.c"
+#line 3171 "beancount/parser/grammar.c"
     break;
 
-  case 91:
-#line 679 "beancount/parser/grammar.y"
-    {
+  case 91: /* price: DATE PRICE CURRENCY amount eol key_value_list  */
+#line 1256 "beancount/parser/grammar.y"
+      {
           BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                 (yyval.pyobj), "price", "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                 (yyval.pyobj), price, "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
       }
-#line 2327 "beancount/parser/grammar.c"
+#line 3180 "beancount/parser/grammar.c"
     break;
 
-  case 92:
-#line 685 "beancount/parser/grammar.y"
-    {
+  case 92: /* event: DATE EVENT STRING STRING eol key_value_list  */
+#line 1262 "beancount/parser/grammar.y"
+      {
           BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                 (yyval.pyobj), "event", "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                 (yyval.pyobj), event, "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
       }
-#line 2336 "beancount/parser/grammar.c"
+#line 3189 "beancount/parser/grammar.c"
     break;
 
-  case 93:
-#line 691 "beancount/parser/grammar.y"
-    {
+  case 93: /* query: DATE QUERY STRING STRING eol key_value_list  */
+#line 1268 "beancount/parser/grammar.y"
+         {
              BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                    (yyval.pyobj), "query", "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                    (yyval.pyobj), query, "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
          }
-#line 2345 "beancount/parser/grammar.c"
+#line 3198 "beancount/parser/grammar.c"
     break;
 
-  case 94:
-#line 697 "beancount/parser/grammar.y"
-    {
+  case 94: /* note: DATE NOTE ACCOUNT STRING eol key_value_list  */
+#line 1274 "beancount/parser/grammar.y"
+      {
           BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                 (yyval.pyobj), "note", "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                 (yyval.pyobj), note, "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
       }
-#line 2354 "beancount/parser/grammar.c"
+#line 3207 "beancount/parser/grammar.c"
     break;
 
-  case 96:
-#line 705 "beancount/parser/grammar.y"
-    {
+  case 96: /* document: DATE DOCUMENT ACCOUNT filename tags_links eol key_value_list  */
+#line 1282 "beancount/parser/grammar.y"
+         {
              BUILDY(DECREF5((yyvsp[-6].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                    (yyval.pyobj), "document", "siOOOOO", FILE_LINE_ARGS, (yyvsp[-6].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                    (yyval.pyobj), document, "siOOOOO", FILE_LINE_ARGS, (yyvsp[-6].pyobj), (yyvsp[-4].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
          }
-#line 2363 "beancount/parser/grammar.c"
+#line 3216 "beancount/parser/grammar.c"
     break;
 
-  case 97:
-#line 712 "beancount/parser/grammar.y"
-    {
+  case 97: /* custom_value: STRING  */
+#line 1289 "beancount/parser/grammar.y"
+             {
                  BUILDY(DECREF1((yyvsp[0].pyobj)),
-                        (yyval.pyobj), "custom_value", "OO", (yyvsp[0].pyobj), Py_None);
+                        (yyval.pyobj), custom_value, "OO", (yyvsp[0].pyobj), Py_None);
              }
-#line 2372 "beancount/parser/grammar.c"
+#line 3225 "beancount/parser/grammar.c"
     break;
 
-  case 98:
-#line 717 "beancount/parser/grammar.y"
-    {
+  case 98: /* custom_value: DATE  */
+#line 1294 "beancount/parser/grammar.y"
+             {
                  BUILDY(DECREF1((yyvsp[0].pyobj)),
-                        (yyval.pyobj), "custom_value", "OO", (yyvsp[0].pyobj), Py_None);
+                        (yyval.pyobj), custom_value, "OO", (yyvsp[0].pyobj), Py_None);
              }
-#line 2381 "beancount/parser/grammar.c"
+#line 3234 "beancount/parser/grammar.c"
     break;
 
-  case 99:
-#line 722 "beancount/parser/grammar.y"
-    {
+  case 99: /* custom_value: BOOL  */
+#line 1299 "beancount/parser/grammar.y"
+             {
                  BUILDY(DECREF1((yyvsp[0].pyobj)),
-                        (yyval.pyobj), "custom_value", "OO", (yyvsp[0].pyobj), Py_None);
+                        (yyval.pyobj), custom_value, "OO", (yyvsp[0].pyobj), Py_None);
              }
-#line 2390 "beancount/parser/grammar.c"
+#line 3243 "beancount/parser/grammar.c"
     break;
 
-  case 100:
-#line 727 "beancount/parser/grammar.y"
-    {
+  case 100: /* custom_value: amount  */
+#line 1304 "beancount/parser/grammar.y"
+             {
                  BUILDY(DECREF1((yyvsp[0].pyobj)),
-                        (yyval.pyobj), "custom_value", "OO", (yyvsp[0].pyobj), Py_None);
+                        (yyval.pyobj), custom_value, "OO", (yyvsp[0].pyobj), Py_None);
              }
-#line 2399 "beancount/parser/grammar.c"
+#line 3252 "beancount/parser/grammar.c"
     break;
 
-  case 101:
-#line 732 "beancount/parser/grammar.y"
-    {
+  case 101: /* custom_value: number_expr  */
+#line 1309 "beancount/parser/grammar.y"
+             {
                  BUILDY(DECREF1((yyvsp[0].pyobj)),
-                        (yyval.pyobj), "custom_value", "OO", (yyvsp[0].pyobj), Py_None);
+                        (yyval.pyobj), custom_value, "OO", (yyvsp[0].pyobj), Py_None);
              }
-#line 2408 "beancount/parser/grammar.c"
+#line 3261 "beancount/parser/grammar.c"
     break;
 
-  case 102:
-#line 737 "beancount/parser/grammar.y"
-    {
+  case 102: /* custom_value: ACCOUNT  */
+#line 1314 "beancount/parser/grammar.y"
+             {
                  /* Obtain beancount.core.account.TYPE */
                  PyObject* module = PyImport_ImportModule("beancount.core.account");
                  PyObject* dtype = PyObject_GetAttrString(module, "TYPE");
                  Py_DECREF(module);
                  BUILDY(DECREF2((yyvsp[0].pyobj), dtype),
-                        (yyval.pyobj), "custom_value", "OO", (yyvsp[0].pyobj), dtype);
+                        (yyval.pyobj), custom_value, "OO", (yyvsp[0].pyobj), dtype);
              }
-#line 2421 "beancount/parser/grammar.c"
+#line 3274 "beancount/parser/grammar.c"
     break;
 
-  case 103:
-#line 747 "beancount/parser/grammar.y"
-    {
+  case 103: /* custom_value_list: empty  */
+#line 1324 "beancount/parser/grammar.y"
+                  {
                       Py_INCREF(Py_None);
                       (yyval.pyobj) = Py_None;
                   }
-#line 2430 "beancount/parser/grammar.c"
+#line 3283 "beancount/parser/grammar.c"
     break;
 
-  case 104:
-#line 752 "beancount/parser/grammar.y"
-    {
-                      BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                             (yyval.pyobj), "handle_list", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+  case 104: /* custom_value_list: custom_value_list custom_value  */
+#line 1329 "beancount/parser/grammar.y"
+                  {
+                      BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                             (yyval.pyobj), native_handle_list((yyvsp[-1].pyobj), (yyvsp[0].pyobj)), handle_list, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
                   }
-#line 2439 "beancount/parser/grammar.c"
+#line 3292 "beancount/parser/grammar.c"
     break;
 
-  case 105:
-#line 758 "beancount/parser/grammar.y"
-    {
+  case 105: /* custom: DATE CUSTOM STRING custom_value_list eol key_value_list  */
+#line 1335 "beancount/parser/grammar.y"
+       {
            BUILDY(DECREF4((yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj)),
-                  (yyval.pyobj), "custom", "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
+                  (yyval.pyobj), custom, "siOOOO", FILE_LINE_ARGS, (yyvsp[-5].pyobj), (yyvsp[-3].pyobj), (yyvsp[-2].pyobj), (yyvsp[0].pyobj));
        }
-#line 2448 "beancount/parser/grammar.c"
+#line 3301 "beancount/parser/grammar.c"
     break;
 
-  case 117:
-#line 776 "beancount/parser/grammar.y"
-    {
+  case 117: /* entry: custom  */
+#line 1353 "beancount/parser/grammar.y"
+      {
           (yyval.pyobj) = (yyvsp[0].pyobj);
       }
-#line 2456 "beancount/parser/grammar.c"
+#line 3309 "beancount/parser/grammar.c"
     break;
 
-  case 118:
-#line 781 "beancount/parser/grammar.y"
-    {
+  case 118: /* option: OPTION STRING STRING eol  */
+#line 1358 "beancount/parser/grammar.y"
+       {
            BUILDY(DECREF2((yyvsp[-2].pyobj), (yyvsp[-1].pyobj)),
-                  (yyval.pyobj), "option", "siOO", FILE_LINE_ARGS, (yyvsp[-2].pyobj), (yyvsp[-1].pyobj));
+                  (yyval.pyobj), option, "siOO", FILE_LINE_ARGS, (yyvsp[-2].pyobj), (yyvsp[-1].pyobj));
+           /* Options may change the set of valid account names; revalidate the
+            * accounts seen from now on. */
+           intern_clear(&yyget_extra(scanner)->accounts);
        }
-#line 2465 "beancount/parser/grammar.c"
+#line 3321 "beancount/parser/grammar.c"
     break;
 
-  case 119:
-#line 787 "beancount/parser/grammar.y"
-    {
+  case 119: /* include: INCLUDE STRING eol  */
+#line 1367 "beancount/parser/grammar.y"
+       {
            BUILDY(DECREF1((yyvsp[-1].pyobj)),
-                  (yyval.pyobj), "include", "siO", FILE_LINE_ARGS, (yyvsp[-1].pyobj));
+                  (yyval.pyobj), include, "siO", FILE_LINE_ARGS, (yyvsp[-1].pyobj));
        }
-#line 2474 "beancount/parser/grammar.c"
+#line 3330 "beancount/parser/grammar.c"
     break;
 
-  case 120:
-#line 793 "beancount/parser/grammar.y"
-    {
+  case 120: /* plugin: PLUGIN STRING eol  */
+#line 1373 "beancount/parser/grammar.y"
+       {
            BUILDY(DECREF1((yyvsp[-1].pyobj)),
-                  (yyval.pyobj), "plugin", "siOO", FILE_LINE_ARGS, (yyvsp[-1].pyobj), Py_None);
+                  (yyval.pyobj), plugin, "siOO", FILE_LINE_ARGS, (yyvsp[-1].pyobj), Py_None);
        }
-#line 2483 "beancount/parser/grammar.c"
+#line 3339 "beancount/parser/grammar.c"
     break;
 
-  case 121:
-#line 798 "beancount/parser/grammar.y"
-    {
+  case 121: /* plugin: PLUGIN STRING STRING eol  */
+#line 1378 "beancount/parser/grammar.y"
+       {
            BUILDY(DECREF2((yyvsp[-2].pyobj), (yyvsp[-1].pyobj)),
-                  (yyval.pyobj), "plugin", "siOO", FILE_LINE_ARGS, (yyvsp[-2].pyobj), (yyvsp[-1].pyobj));
+                  (yyval.pyobj), plugin, "siOO", FILE_LINE_ARGS, (yyvsp[-2].pyobj), (yyvsp[-1].pyobj));
        }
-#line 2492 "beancount/parser/grammar.c"
+#line 3348 "beancount/parser/grammar.c"
     break;
 
-  case 130:
-#line 814 "beancount/parser/grammar.y"
-    {
+  case 130: /* declarations: declarations directive  */
+#line 1394 "beancount/parser/grammar.y"
+             {
                  (yyval.pyobj) = (yyvsp[-1].pyobj);
              }
-#line 2500 "beancount/parser/grammar.c"
-    break;
-
-  case 131:
-#line 818 "beancount/parser/grammar.y"
-    {
-                 BUILDY(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
-                        (yyval.pyobj), "handle_list", "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+#line 3356 "beancount/parser/grammar.c"
+    break;
+
+  case 131: /* declarations: declarations entry  */
+#line 1398 "beancount/parser/grammar.y"
+             {
+                 if ( STREAM != NULL ) {
+                     /* Hand the entry over instead of accumulating it. */
+                     (yyval.pyobj) = stream_entry(STREAM, (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+                     DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+                     if ( (yyval.pyobj) == NULL ) {
+                         build_grammar_error_from_exception(scanner, builder);
+                         YYERROR;
+                     }
+                 }
+                 else {
+                     BUILDN(DECREF2((yyvsp[-1].pyobj), (yyvsp[0].pyobj)),
+                            (yyval.pyobj), native_handle_list((yyvsp[-1].pyobj), (yyvsp[0].pyobj)), handle_list, "OO", (yyvsp[-1].pyobj), (yyvsp[0].pyobj));
+                 }
              }
-#line 2509 "beancount/parser/grammar.c"
+#line 3376 "beancount/parser/grammar.c"
     break;
 
-  case 132:
-#line 823 "beancount/parser/grammar.y"
-    {
+  case 132: /* declarations: declarations error  */
+#line 1414 "beancount/parser/grammar.y"
+             {
                  /*
                   * Ignore the error and continue reducing ({3d95e55b654e}).
                   * Note that with the matching rule above, "error" will
@@ -2527,29 +3394,29 @@ yyreduce:
                   */
                  (yyval.pyobj) = (yyvsp[-1].pyobj);
              }
-#line 2531 "beancount/parser/grammar.c"
+#line 3398 "beancount/parser/grammar.c"
     break;
 
-  case 133:
-#line 841 "beancount/parser/grammar.y"
-    {
+  case 133: /* declarations: empty  */
+#line 1432 "beancount/parser/grammar.y"
+             {
                   Py_INCREF(Py_None);
                   (yyval.pyobj) = Py_None;
              }
-#line 2540 "beancount/parser/grammar.c"
+#line 3407 "beancount/parser/grammar.c"
     break;
 
-  case 134:
-#line 848 "beancount/parser/grammar.y"
-    {
+  case 134: /* file: declarations  */
+#line 1439 "beancount/parser/grammar.y"
+     {
          BUILDY(DECREF1((yyvsp[0].pyobj)),
-                (yyval.pyobj), "store_result", "O", (yyvsp[0].pyobj));
+                (yyval.pyobj), store_result, "O", (yyvsp[0].pyobj));
      }
-#line 2549 "beancount/parser/grammar.c"
+#line 3416 "beancount/parser/grammar.c"
     break;
 
 
-#line 2553 "beancount/parser/grammar.c"
+#line 3420 "beancount/parser/grammar.c"
 
       default: break;
     }
@@ -2564,11 +3431,10 @@ yyreduce:
      case of YYERROR or YYBACKUP, subsequent parser actions might lead
      to an incorrect destructor call or verbose syntax error message
      before the lookahead is translated.  */
-  YY_SYMBOL_PRINT ("-> $$ =", yyr1[yyn], &yyval, &yyloc);
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
 
   YYPOPSTACK (yylen);
   yylen = 0;
-  YY_STACK_PRINT (yyss, yyssp);
 
   *++yyvsp = yyval;
   *++yylsp = yyloc;
@@ -2593,50 +3459,45 @@ yyreduce:
 yyerrlab:
   /* Make sure we have latest lookahead translation.  See comments at
      user semantic actions for why this is necessary.  */
-  yytoken = yychar == YYEMPTY ? YYEMPTY : YYTRANSLATE (yychar);
-
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
   /* If not already recovering from an error, report this error.  */
   if (!yyerrstatus)
     {
       ++yynerrs;
-#if ! YYERROR_VERBOSE
-      yyerror (YY_("syntax error"));
-#else
-# define YYSYNTAX_ERROR yysyntax_error (&yymsg_alloc, &yymsg, \
-                                        yyssp, yytoken)
       {
+        yypcontext_t yyctx
+          = {yyps, yytoken, &yylloc};
         char const *yymsgp = YY_("syntax error");
         int yysyntax_error_status;
-        yysyntax_error_status = YYSYNTAX_ERROR;
+        yysyntax_error_status = yysyntax_error (&yymsg_alloc, &yymsg, &yyctx);
         if (yysyntax_error_status == 0)
           yymsgp = yymsg;
-        else if (yysyntax_error_status == 1)
+        else if (yysyntax_error_status == -1)
           {
             if (yymsg != yymsgbuf)
               YYSTACK_FREE (yymsg);
-            yymsg = (char *) YYSTACK_ALLOC (yymsg_alloc);
-            if (!yymsg)
+            yymsg = YY_CAST (char *,
+                             YYSTACK_ALLOC (YY_CAST (YYSIZE_T, yymsg_alloc)));
+            if (yymsg)
               {
-                yymsg = yymsgbuf;
-                yymsg_alloc = sizeof yymsgbuf;
-                yysyntax_error_status = 2;
+                yysyntax_error_status
+                  = yysyntax_error (&yymsg_alloc, &yymsg, &yyctx);
+                yymsgp = yymsg;
               }
             else
               {
-                yysyntax_error_status = YYSYNTAX_ERROR;
-                yymsgp = yymsg;
+                yymsg = yymsgbuf;
+                yymsg_alloc = sizeof yymsgbuf;
+                yysyntax_error_status = YYENOMEM;
               }
           }
-        yyerror (yymsgp);
-        if (yysyntax_error_status == 2)
-          goto yyexhaustedlab;
+        yyerror (&yylloc, scanner, builder, yymsgp);
+        if (yysyntax_error_status == YYENOMEM)
+          YYNOMEM;
       }
-# undef YYSYNTAX_ERROR
-#endif
     }
 
   yyerror_range[1] = yylloc;
-
   if (yyerrstatus == 3)
     {
       /* If just tried and failed to reuse lookahead token after an
@@ -2651,7 +3512,7 @@ yyerrlab:
       else
         {
           yydestruct ("Error: discarding",
-                      yytoken, &yylval, &yylloc);
+                      yytoken, &yylval, &yylloc, scanner, builder);
           yychar = YYEMPTY;
         }
     }
@@ -2669,6 +3530,7 @@ yyerrorlab:
      label yyerrorlab therefore never appears in user code.  */
   if (0)
     YYERROR;
+  ++yynerrs;
 
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYERROR.  */
@@ -2685,13 +3547,14 @@ yyerrorlab:
 yyerrlab1:
   yyerrstatus = 3;      /* Each real token shifted decrements this.  */
 
+  /* Pop stack until we find a state that shifts the error token.  */
   for (;;)
     {
       yyn = yypact[yystate];
       if (!yypact_value_is_default (yyn))
         {
-          yyn += YYTERROR;
-          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYTERROR)
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
             {
               yyn = yytable[yyn];
               if (0 < yyn)
@@ -2705,7 +3568,7 @@ yyerrlab1:
 
       yyerror_range[1] = *yylsp;
       yydestruct ("Error: popping",
-                  yystos[yystate], yyvsp, yylsp);
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, yylsp, scanner, builder);
       YYPOPSTACK (1);
       yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
@@ -2716,13 +3579,11 @@ yyerrlab1:
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 
   yyerror_range[2] = yylloc;
-  /* Using YYLLOC is tempting, but would change the location of
-     the lookahead.  YYLOC is available though.  */
-  YYLLOC_DEFAULT (yyloc, yyerror_range, 2);
-  *++yylsp = yyloc;
+  ++yylsp;
+  YYLLOC_DEFAULT (*yylsp, yyerror_range, 2);
 
   /* Shift the error token.  */
-  YY_SYMBOL_PRINT ("Shifting", yystos[yyn], yyvsp, yylsp);
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
 
   yystate = yyn;
   goto yynewstate;
@@ -2733,7 +3594,7 @@ yyerrlab1:
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
 
 
 /*-----------------------------------.
@@ -2741,31 +3602,29 @@ yyacceptlab:
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
 
 
-#if !defined yyoverflow || YYERROR_VERBOSE
-/*-------------------------------------------------.
-| yyexhaustedlab -- memory exhaustion comes here.  |
-`-------------------------------------------------*/
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
 yyexhaustedlab:
-  yyerror (YY_("memory exhausted"));
+  yyerror (&yylloc, scanner, builder, YY_("memory exhausted"));
   yyresult = 2;
-  /* Fall through.  */
-#endif
+  goto yyreturnlab;
 
 
-/*-----------------------------------------------------.
-| yyreturn -- parsing is finished, return the result.  |
-`-----------------------------------------------------*/
-yyreturn:
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
   if (yychar != YYEMPTY)
     {
       /* Make sure we have latest lookahead translation.  See comments at
          user semantic actions for why this is necessary.  */
       yytoken = YYTRANSLATE (yychar);
       yydestruct ("Cleanup: discarding lookahead",
-                  yytoken, &yylval, &yylloc);
+                  yytoken, &yylval, &yylloc, scanner, builder);
     }
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYABORT or YYACCEPT.  */
@@ -2774,20 +3633,35 @@ yyreturn:
   while (yyssp != yyss)
     {
       yydestruct ("Cleanup: popping",
-                  yystos[*yyssp], yyvsp, yylsp);
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, yylsp, scanner, builder);
       YYPOPSTACK (1);
     }
-#ifndef yyoverflow
-  if (yyss != yyssa)
-    YYSTACK_FREE (yyss);
-#endif
-#if YYERROR_VERBOSE
+  yyps->yynew = 2;
+  goto yypushreturn;
+
+
+/*-------------------------.
+| yypushreturn -- return.  |
+`-------------------------*/
+yypushreturn:
   if (yymsg != yymsgbuf)
     YYSTACK_FREE (yymsg);
-#endif
   return yyresult;
 }
-#line 856 "beancount/parser/grammar.y"
+#undef yynerrs
+#undef yystate
+#undef yyerrstatus
+#undef yyssa
+#undef yyss
+#undef yyssp
+#undef yyvsa
+#undef yyvs
+#undef yyvsp
+#undef yylsa
+#undef yyls
+#undef yylsp
+#undef yystacksize
+#line 1447 "beancount/parser/grammar.y"
 
 
 /* A function that will convert a token name to a string, used in debugging. */
@@ -2802,6 +3676,8 @@ const char* getTokenName(int token)
         case PIPE      : return "PIPE";
         case ATAT      : return "ATAT";
         case AT        : return "AT";
+        case LCURLCURL : return "LCURLCURL";
+        case RCURLCURL : return "RCURLCURL";
         case LCURL     : return "LCURL";
         case RCURL     : return "RCURL";
         case EQUAL     : return "EQUAL";
@@ -2820,6 +3696,7 @@ const char* getTokenName(int token)
         case BALANCE   : return "BALANCE";
         case OPEN      : return "OPEN";
         case CLOSE     : return "CLOSE";
+        case COMMODITY : return "COMMODITY";
         case PAD       : return "PAD";
         case EVENT     : return "EVENT";
         case QUERY     : return "QUERY";
@@ -2832,6 +3709,7 @@ const char* getTokenName(int token)
         case PUSHMETA  : return "PUSHMETA";
         case POPMETA   : return "POPMETA";
         case OPTION    : return "OPTION";
+        case INCLUDE   : return "INCLUDE";
         case PLUGIN    : return "PLUGIN";
         case DATE      : return "DATE";
         case ACCOUNT   : return "ACCOUNT";
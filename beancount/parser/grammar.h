@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.4.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2019 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -31,8 +31,9 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
 
 #ifndef YY_YY_BEANCOUNT_PARSER_GRAMMAR_H_INCLUDED
 # define YY_YY_BEANCOUNT_PARSER_GRAMMAR_H_INCLUDED
@@ -43,74 +44,90 @@
 #if YYDEBUG
 extern int yydebug;
 #endif
+/* "%code requires" blocks.  */
+#line 687 "beancount/parser/grammar.y"
 
-/* Token type.  */
+#include "parser.h"
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
+#line 58 "beancount/parser/grammar.h"
+
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
   enum yytokentype
   {
-    LEX_ERROR = 258,
-    INDENT = 259,
-    EOL = 260,
-    COMMENT = 261,
-    SKIPPED = 262,
-    PIPE = 263,
-    ATAT = 264,
-    AT = 265,
-    LCURLCURL = 266,
-    RCURLCURL = 267,
-    LCURL = 268,
-    RCURL = 269,
-    EQUAL = 270,
-    COMMA = 271,
-    TILDE = 272,
-    HASH = 273,
-    ASTERISK = 274,
-    SLASH = 275,
-    COLON = 276,
-    PLUS = 277,
-    MINUS = 278,
-    LPAREN = 279,
-    RPAREN = 280,
-    FLAG = 281,
-    TXN = 282,
-    BALANCE = 283,
-    OPEN = 284,
-    CLOSE = 285,
-    COMMODITY = 286,
-    PAD = 287,
-    EVENT = 288,
-    PRICE = 289,
-    NOTE = 290,
-    DOCUMENT = 291,
-    QUERY = 292,
-    CUSTOM = 293,
-    PUSHTAG = 294,
-    POPTAG = 295,
-    PUSHMETA = 296,
-    POPMETA = 297,
-    OPTION = 298,
-    INCLUDE = 299,
-    PLUGIN = 300,
-    NONE = 301,
-    BOOL = 302,
-    DATE = 303,
-    ACCOUNT = 304,
-    CURRENCY = 305,
-    STRING = 306,
-    NUMBER = 307,
-    TAG = 308,
-    LINK = 309,
-    KEY = 310,
-    NEGATIVE = 311
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    LEX_ERROR = 258,               /* LEX_ERROR  */
+    INDENT = 259,                  /* INDENT  */
+    EOL = 260,                     /* EOL  */
+    COMMENT = 261,                 /* COMMENT  */
+    SKIPPED = 262,                 /* SKIPPED  */
+    PIPE = 263,                    /* PIPE  */
+    ATAT = 264,                    /* ATAT  */
+    AT = 265,                      /* AT  */
+    LCURLCURL = 266,               /* LCURLCURL  */
+    RCURLCURL = 267,               /* RCURLCURL  */
+    LCURL = 268,                   /* LCURL  */
+    RCURL = 269,                   /* RCURL  */
+    EQUAL = 270,                   /* EQUAL  */
+    COMMA = 271,                   /* COMMA  */
+    TILDE = 272,                   /* TILDE  */
+    HASH = 273,                    /* HASH  */
+    ASTERISK = 274,                /* ASTERISK  */
+    SLASH = 275,                   /* SLASH  */
+    COLON = 276,                   /* COLON  */
+    PLUS = 277,                    /* PLUS  */
+    MINUS = 278,                   /* MINUS  */
+    LPAREN = 279,                  /* LPAREN  */
+    RPAREN = 280,                  /* RPAREN  */
+    FLAG = 281,                    /* FLAG  */
+    TXN = 282,                     /* TXN  */
+    BALANCE = 283,                 /* BALANCE  */
+    OPEN = 284,                    /* OPEN  */
+    CLOSE = 285,                   /* CLOSE  */
+    COMMODITY = 286,               /* COMMODITY  */
+    PAD = 287,                     /* PAD  */
+    EVENT = 288,                   /* EVENT  */
+    PRICE = 289,                   /* PRICE  */
+    NOTE = 290,                    /* NOTE  */
+    DOCUMENT = 291,                /* DOCUMENT  */
+    QUERY = 292,                   /* QUERY  */
+    CUSTOM = 293,                  /* CUSTOM  */
+    PUSHTAG = 294,                 /* PUSHTAG  */
+    POPTAG = 295,                  /* POPTAG  */
+    PUSHMETA = 296,                /* PUSHMETA  */
+    POPMETA = 297,                 /* POPMETA  */
+    OPTION = 298,                  /* OPTION  */
+    INCLUDE = 299,                 /* INCLUDE  */
+    PLUGIN = 300,                  /* PLUGIN  */
+    NONE = 301,                    /* NONE  */
+    BOOL = 302,                    /* BOOL  */
+    DATE = 303,                    /* DATE  */
+    ACCOUNT = 304,                 /* ACCOUNT  */
+    CURRENCY = 305,                /* CURRENCY  */
+    STRING = 306,                  /* STRING  */
+    NUMBER = 307,                  /* NUMBER  */
+    TAG = 308,                     /* TAG  */
+    LINK = 309,                    /* LINK  */
+    KEY = 310,                     /* KEY  */
+    NEGATIVE = 311                 /* NEGATIVE  */
   };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
 
 /* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
 union YYSTYPE
 {
-#line 126 "beancount/parser/grammar.y"
+#line 700 "beancount/parser/grammar.y"
 
     char character;
     const char* string;
@@ -120,7 +137,7 @@ union YYSTYPE
         PyObject* pyobj2;
     } pairobj;
 
-#line 124 "beancount/parser/grammar.h"
+#line 141 "beancount/parser/grammar.h"
 
 };
 typedef union YYSTYPE YYSTYPE;
@@ -144,6 +161,21 @@ struct YYLTYPE
 
 
 
-int yyparse (void);
+
+#ifndef YYPUSH_MORE_DEFINED
+# define YYPUSH_MORE_DEFINED
+enum { YYPUSH_MORE = 4 };
+#endif
+
+typedef struct yypstate yypstate;
+
+
+int yyparse (yyscan_t scanner, PyObject* builder);
+int yypush_parse (yypstate *ps,
+                  int pushed_char, YYSTYPE const *pushed_val, YYLTYPE *pushed_loc, yyscan_t scanner, PyObject* builder);
+int yypull_parse (yypstate *ps, yyscan_t scanner, PyObject* builder);
+yypstate *yypstate_new (void);
+void yypstate_delete (yypstate *ps);
+
 
 #endif /* !YY_YY_BEANCOUNT_PARSER_GRAMMAR_H_INCLUDED  */
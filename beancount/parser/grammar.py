@@ -110,7 +110,13 @@ TagsLinks = collections.namedtuple('TagsLinks', 'tags links')
 
 class Builder(lexer.LexBuilder):
     """A builder used by the lexer and grammar parser as callbacks to create
-    the data objects corresponding to rules parsed from the input file."""
+    the data objects corresponding to rules parsed from the input file.
+
+    Note: Unless a subclass overrides them, the transactions, postings, amounts,
+    key-values, tags & links and lists are created natively by the grammar
+    without calling the corresponding methods below (see grammar.y). Keep both
+    implementations in sync.
+    """
 
     def __init__(self, filename):
         lexer.LexBuilder.__init__(self)
@@ -138,6 +144,24 @@ class Builder(lexer.LexBuilder):
         self.dcontext = display_context.DisplayContext()
         self._dcupdate = self.dcontext.update
 
+    def resume(self, options_map, tags, meta):
+        """Continue from the state of another parse, to parse a part of its input.
+
+        Args:
+          options_map: The options of the other parse. Its display context and
+            set of commodities are updated with those of the part.
+          tags: A list of the tags pushed at the beginning of the part.
+          meta: A dict of the lists of metadata values pushed there, by key.
+        """
+        self.options = options_map
+        self.account_regexp = valid_account_regexp(options_map)
+        self.commodities = options_map['commodities']
+        self.dcontext = options_map['dcontext']
+        self._dcupdate = self.dcontext.update
+        self.tags = list(tags)
+        self.meta = collections.defaultdict(list, {key: list(value_list)
+                                                   for key, value_list in meta.items()})
+
     def dcupdate(self, number, currency):
         """Update the display context."""
         if isinstance(number, Decimal) and currency and currency is not MISSING:
@@ -229,14 +253,18 @@ class Builder(lexer.LexBuilder):
           lineno: The current line number
           excvalue: The exception value, or a str, the message of the error.
           exc_type: An exception type, if an exception occurred.
-          exc_traceback: A traceback object.
+          exc_traceback: A traceback object, or None if the exception was raised
+            from the parser itself.
         """
         if exc_type is not None:
             assert not isinstance(exc_value, str)
             strings = traceback.format_exception_only(exc_type, exc_value)
             tblist = traceback.extract_tb(exc_traceback)
-            filename, lineno, _, __ = tblist[0]
-            message = '{} ({}:{})'.format(strings[0], filename, lineno)
+            if tblist:
+                filename, lineno, _, __ = tblist[0]
+                message = '{} ({}:{})'.format(strings[0], filename, lineno)
+            else:
+                message = strings[0]
         else:
             message = str(exc_value)
         meta = new_metadata(filename, lineno)
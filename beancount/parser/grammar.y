@@ -11,6 +11,7 @@
 %{
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <assert.h>
 #include "parser.h"
 #include "lexer.h"
@@ -21,23 +22,51 @@
  * in the handler. Always run the code to clean the references provided by the
  * reduced rule. {05bb0fb60e86}
  */
-#define BUILDY(clean, target, method_name, format, ...)                         \
-    target = PyObject_CallMethod(builder, method_name, format, __VA_ARGS__);    \
+#define BUILDY(clean, target, method, format, ...)                              \
+    target = CALL_BUILDER(DISPATCH, builder, method, format, __VA_ARGS__);      \
     clean;                                                                      \
     if (target == NULL) {                                                       \
-        build_grammar_error_from_exception();                                   \
+        build_grammar_error_from_exception(scanner, builder);                   \
         YYERROR;                                                                \
     }
 
 
-/* First line of reported file/line string. This is used as #line. */
-int yy_firstline;
+/*
+ * Like BUILDY, but create the object by evaluating the given C expression
+ * instead of calling the builder method, if the builder does not override the
+ * methods of grammar.Builder (see native_builder_initialize()). The expression
+ * must behave like the method call: borrow its arguments and return a new
+ * reference, or NULL with an exception set.
+ */
+#define BUILDN(clean, target, native_expr, method, format, ...)                \
+    target = (NATIVE->enabled ?                                                 \
+              (native_expr) :                                                   \
+              CALL_BUILDER(DISPATCH, builder, method, format, __VA_ARGS__));    \
+    clean;                                                                      \
+    if (target == NULL) {                                                       \
+        build_grammar_error_from_exception(scanner, builder);                   \
+        YYERROR;                                                                \
+    }
+
+/* The state for creating objects natively in the current parse. */
+#define NATIVE  (&yyget_extra(scanner)->native)
+
+/* The dispatch table of the builder methods in the current parse. */
+#define DISPATCH  (&yyget_extra(scanner)->dispatch)
+
+/* The list receiving the entries as they are reduced, when streaming. */
+#define STREAM  (yyget_extra(scanner)->stream)
+
 
-#define FILE_LINE_ARGS  yy_filename, ((yyloc).first_line + yy_firstline)
+/* The filename and line number of the current rule, for the builder methods.
+ * The first line of the reported file/line string is stored on the lexer
+ * state and is used as #line. */
+#define LINE_ARG        ((yyloc).first_line + yyget_extra(scanner)->firstline)
+#define FILE_LINE_ARGS  yyget_extra(scanner)->filename, LINE_ARG
 
 
 /* Build a grammar error from the exception context. */
-void build_grammar_error_from_exception(void)
+void build_grammar_error_from_exception(yyscan_t scanner, PyObject* builder)
 {
     TRACE_ERROR("Grammar Builder Exception");
 
@@ -53,12 +82,17 @@ void build_grammar_error_from_exception(void)
 
     if (pvalue != NULL) {
         /* Build and accumulate a new error object. {27d1d459c5cd} */
-        PyObject* rv = PyObject_CallMethod(builder, "build_grammar_error", "siOOO",
-                                           yy_filename, yylineno + yy_firstline,
-                                           pvalue, ptype, ptraceback);
+        yyextra_t* extra = yyget_extra(scanner);
+        /* Exceptions raised from C code may not have a traceback. */
+        PyObject* rv = CALL_BUILDER(&extra->dispatch, builder, build_grammar_error,
+                                    "siOOO",
+                                    extra->filename,
+                                    yyget_lineno(scanner) + extra->firstline,
+                                    pvalue, ptype,
+                                    ptraceback != NULL ? ptraceback : Py_None);
         Py_DECREF(ptype);
         Py_DECREF(pvalue);
-        Py_DECREF(ptraceback);
+        Py_XDECREF(ptraceback);
 
         if (rv == NULL) {
             /* Note: Leave the internal error trickling up its detail. */
@@ -75,7 +109,7 @@ void build_grammar_error_from_exception(void)
 
 
 /* Error-handling function. {ca6aab8b9748} */
-void yyerror(char const* message)
+void yyerror(YYLTYPE* locp, yyscan_t scanner, PyObject* builder, char const* message)
 {
     /* Skip lex errors: they have already been registered the lexer itself. */
     if (strstr(message, "LEX_ERROR") != NULL) {
@@ -83,9 +117,12 @@ void yyerror(char const* message)
     }
     else {
         /* Register a syntax error with the builder. */
-        PyObject* rv = PyObject_CallMethod(builder, "build_grammar_error", "sis",
-                                           yy_filename, yylineno + yy_firstline,
-                                           message);
+        yyextra_t* extra = yyget_extra(scanner);
+        PyObject* rv = CALL_BUILDER(&extra->dispatch, builder, build_grammar_error,
+                                    "sis",
+                                    extra->filename,
+                                    yyget_lineno(scanner) + extra->firstline,
+                                    message);
         if (rv == NULL) {
             PyErr_SetString(PyExc_RuntimeError,
                             "Internal error: Building exception from yyerror()");
@@ -106,6 +143,529 @@ const char* getTokenName(int token);
 #define DECREF5(x1, x2, x3, x4, x5)        DECREF4(x1, x2, x3, x4); Py_DECREF(x5);
 #define DECREF6(x1, x2, x3, x4, x5, x6)    DECREF5(x1, x2, x3, x4, x5); Py_DECREF(x6);
 
+
+/*
+ * Native creation of the most common objects.
+ *
+ * Transactions, their postings, amounts, metadata and the temporary lists are
+ * by far the most frequent reductions. When the builder uses the stock
+ * grammar.Builder methods for them, they are created here directly as the
+ * same namedtuple types those methods return, which avoids a Python call for
+ * each. The functions below mirror these methods; keep them in sync.
+ */
+
+/* The types of the objects created natively, imported on first use. */
+static PyObject* amount_type = NULL;
+static PyObject* posting_type = NULL;
+static PyObject* transaction_type = NULL;
+static PyObject* key_value_type = NULL;
+static PyObject* tags_links_type = NULL;
+static PyObject* parser_error_type = NULL;
+static PyObject* builder_type = NULL;
+static PyObject* empty_set = NULL;
+static PyObject* empty_string = NULL;
+static PyObject* filename_key = NULL;
+static PyObject* lineno_key = NULL;
+
+/* Import an attribute from a module. Returns a new reference. */
+static PyObject* import_attribute(const char* module_name, const char* name)
+{
+    PyObject* module = PyImport_ImportModule(module_name);
+    PyObject* attribute;
+    if ( module == NULL ) {
+        return NULL;
+    }
+    attribute = PyObject_GetAttrString(module, name);
+    Py_DECREF(module);
+    return attribute;
+}
+
+/* Import the types used to create objects natively. These modules cannot be
+ * imported when this extension module is initialized, since they import it. */
+static int import_native_types(void)
+{
+    if ( builder_type != NULL ) {
+        return 0;
+    }
+    amount_type = import_attribute("beancount.core.amount", "Amount");
+    posting_type = import_attribute("beancount.core.data", "Posting");
+    transaction_type = import_attribute("beancount.core.data", "Transaction");
+    empty_set = import_attribute("beancount.core.data", "EMPTY_SET");
+    key_value_type = import_attribute("beancount.parser.grammar", "KeyValue");
+    tags_links_type = import_attribute("beancount.parser.grammar", "TagsLinks");
+    parser_error_type = import_attribute("beancount.parser.grammar", "ParserError");
+    empty_string = PyUnicode_FromString("");
+    filename_key = PyUnicode_InternFromString("filename");
+    lineno_key = PyUnicode_InternFromString("lineno");
+    if ( amount_type == NULL || posting_type == NULL || transaction_type == NULL ||
+         empty_set == NULL || key_value_type == NULL || tags_links_type == NULL ||
+         parser_error_type == NULL || empty_string == NULL ||
+         filename_key == NULL || lineno_key == NULL ) {
+        Py_CLEAR(amount_type);
+        Py_CLEAR(posting_type);
+        Py_CLEAR(transaction_type);
+        Py_CLEAR(empty_set);
+        Py_CLEAR(key_value_type);
+        Py_CLEAR(tags_links_type);
+        Py_CLEAR(parser_error_type);
+        Py_CLEAR(empty_string);
+        Py_CLEAR(filename_key);
+        Py_CLEAR(lineno_key);
+        return -1;
+    }
+    builder_type = import_attribute("beancount.parser.grammar", "Builder");
+    return builder_type == NULL ? -1 : 0;
+}
+
+/* Return true if the builder's method is the one defined by grammar.Builder.
+ * The function is checked by name too, in case it has been replaced on the
+ * class itself, e.g., by tests. */
+static int is_default_builder_method(PyObject* builder, const char* method_name)
+{
+    PyObject* default_function = PyObject_GetAttrString(builder_type, method_name);
+    PyObject* method = PyObject_GetAttrString(builder, method_name);
+    PyObject* qualname = NULL;
+    const char* qualname_str = NULL;
+    int result = (default_function != NULL && method != NULL &&
+                  PyMethod_Check(method) &&
+                  PyMethod_GET_FUNCTION(method) == default_function &&
+                  PyMethod_GET_SELF(method) == builder &&
+                  PyFunction_Check(default_function) &&
+                  (qualname = PyObject_GetAttrString(default_function,
+                                                     "__qualname__")) != NULL &&
+                  PyUnicode_Check(qualname) &&
+                  (qualname_str = PyUnicode_AsUTF8(qualname)) != NULL &&
+                  strncmp(qualname_str, "Builder.", 8) == 0 &&
+                  strcmp(qualname_str + 8, method_name) == 0);
+    Py_XDECREF(qualname);
+    Py_XDECREF(default_function);
+    Py_XDECREF(method);
+    PyErr_Clear();
+    return result;
+}
+
+static PyObject* new_tags_links(void);
+
+/* Enable creating objects natively if the builder allows it. */
+void native_builder_initialize(native_builder_t* native, PyObject* builder,
+                               const char* filename)
+{
+    static const char* method_names[] = {
+        "amount", "dcupdate", "handle_list", "key_value", "posting",
+        "tag_link_new", "tag_link_TAG", "tag_link_LINK",
+        "transaction", "finalize_tags_links", "unpack_txn_strings", NULL};
+    const char** name;
+
+    memset(native, 0, sizeof(native_builder_t));
+    if ( import_native_types() < 0 ) {
+        PyErr_Clear();
+        return;
+    }
+    for ( name = method_names; *name != NULL; ++name ) {
+        if ( !is_default_builder_method(builder, *name) ) {
+            return;
+        }
+    }
+
+    native->filename = PyUnicode_FromString(filename);
+    native->errors = PyObject_GetAttrString(builder, "errors");
+    native->tags = PyObject_GetAttrString(builder, "tags");
+    native->meta = PyObject_GetAttrString(builder, "meta");
+    native->dcupdate = PyObject_GetAttrString(builder, "_dcupdate");
+    if ( native->filename == NULL ||
+         native->errors == NULL || !PyList_Check(native->errors) ||
+         native->tags == NULL || !PyList_Check(native->tags) ||
+         native->meta == NULL || !PyDict_Check(native->meta) ||
+         native->dcupdate == NULL ||
+         (native->empty_tags_links = new_tags_links()) == NULL ) {
+        native_builder_finalize(native);
+        PyErr_Clear();
+        return;
+    }
+    native->enabled = 1;
+}
+
+void native_builder_finalize(native_builder_t* native)
+{
+    Py_CLEAR(native->filename);
+    Py_CLEAR(native->errors);
+    Py_CLEAR(native->tags);
+    Py_CLEAR(native->meta);
+    Py_CLEAR(native->dcupdate);
+    Py_CLEAR(native->empty_tags_links);
+    native->enabled = 0;
+}
+
+/* Create an instance of a namedtuple type from borrowed references to its
+ * fields, bypassing its Python constructor. */
+static PyObject* native_tuple(PyObject* type, Py_ssize_t size, ...)
+{
+    PyObject* tuple = ((PyTypeObject*)type)->tp_alloc((PyTypeObject*)type, size);
+    va_list args;
+    Py_ssize_t i;
+    if ( tuple == NULL ) {
+        return NULL;
+    }
+    va_start(args, size);
+    for ( i = 0; i < size; ++i ) {
+        PyObject* item = va_arg(args, PyObject*);
+        Py_INCREF(item);
+        PyTuple_SET_ITEM(tuple, i, item);
+    }
+    va_end(args);
+    return tuple;
+}
+
+/* See data.new_metadata(). */
+static PyObject* native_metadata(native_builder_t* native, int lineno)
+{
+    PyObject* meta = PyDict_New();
+    PyObject* pylineno = PyLong_FromLong(lineno);
+    if ( meta == NULL || pylineno == NULL ||
+         PyDict_SetItem(meta, filename_key, native->filename) < 0 ||
+         PyDict_SetItem(meta, lineno_key, pylineno) < 0 ) {
+        Py_XDECREF(meta);
+        Py_XDECREF(pylineno);
+        return NULL;
+    }
+    Py_DECREF(pylineno);
+    return meta;
+}
+
+/* Append a ParserError to the builder's errors. Steals the message. */
+static int native_error(native_builder_t* native, PyObject* meta, PyObject* message)
+{
+    PyObject* error;
+    int result;
+    if ( message == NULL ) {
+        return -1;
+    }
+    error = native_tuple(parser_error_type, 3, meta, message, Py_None);
+    Py_DECREF(message);
+    if ( error == NULL ) {
+        return -1;
+    }
+    result = PyList_Append(native->errors, error);
+    Py_DECREF(error);
+    return result;
+}
+
+/* Add all the elements of an iterable to a set. */
+static int set_update(PyObject* set, PyObject* iterable)
+{
+    PyObject* iterator = PyObject_GetIter(iterable);
+    PyObject* item;
+    if ( iterator == NULL ) {
+        return -1;
+    }
+    while ( (item = PyIter_Next(iterator)) != NULL ) {
+        int result = PySet_Add(set, item);
+        Py_DECREF(item);
+        if ( result < 0 ) {
+            break;
+        }
+    }
+    Py_DECREF(iterator);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+/* See Builder.handle_list(). */
+static PyObject* native_handle_list(PyObject* object_list, PyObject* new_object)
+{
+    if ( object_list == Py_None ) {
+        object_list = PyList_New(0);
+        if ( object_list == NULL ) {
+            return NULL;
+        }
+    }
+    else {
+        Py_INCREF(object_list);
+    }
+    if ( new_object != Py_None && PyList_Append(object_list, new_object) < 0 ) {
+        Py_DECREF(object_list);
+        return NULL;
+    }
+    return object_list;
+}
+
+/* Append a new entry to the list of streamed entries and return the list of
+ * declarations unchanged, which therefore remains None. */
+static PyObject* stream_entry(PyObject* stream, PyObject* object_list,
+                              PyObject* new_object)
+{
+    if ( new_object != Py_None && PyList_Append(stream, new_object) < 0 ) {
+        return NULL;
+    }
+    Py_INCREF(object_list);
+    return object_list;
+}
+
+/* Create a new TagsLinks instance with empty sets. */
+static PyObject* new_tags_links(void)
+{
+    PyObject* tags = PySet_New(NULL);
+    PyObject* links = PySet_New(NULL);
+    PyObject* tags_links = NULL;
+    if ( tags != NULL && links != NULL ) {
+        tags_links = native_tuple(tags_links_type, 2, tags, links);
+    }
+    Py_XDECREF(tags);
+    Py_XDECREF(links);
+    return tags_links;
+}
+
+/* See Builder.tag_link_new(). Most entries have no tags nor links, so they all
+ * share the same empty instance for the duration of the parse, which is only
+ * replaced by a new one when something is added to it. */
+static PyObject* native_tag_link_new(native_builder_t* native)
+{
+    Py_INCREF(native->empty_tags_links);
+    return native->empty_tags_links;
+}
+
+/* See Builder.tag_link_TAG() and Builder.tag_link_LINK(). The index selects
+ * the set of tags (0) or links (1). */
+static PyObject* native_tag_link_add(native_builder_t* native, PyObject* tags_links,
+                                     Py_ssize_t index, PyObject* value)
+{
+    if ( tags_links == native->empty_tags_links ) {
+        tags_links = new_tags_links();
+        if ( tags_links == NULL ) {
+            return NULL;
+        }
+    }
+    else {
+        Py_INCREF(tags_links);
+    }
+    if ( PySet_Add(PyTuple_GET_ITEM(tags_links, index), value) < 0 ) {
+        Py_DECREF(tags_links);
+        return NULL;
+    }
+    return tags_links;
+}
+
+/* See Builder.amount() and Builder.dcupdate(). */
+static PyObject* native_amount(native_builder_t* native,
+                               PyObject* number, PyObject* currency)
+{
+    if ( PyUnicode_Check(currency) && PyUnicode_GET_LENGTH(currency) > 0 ) {
+        int is_decimal = PyObject_IsInstance(number, decimal_type);
+        if ( is_decimal < 0 ) {
+            return NULL;
+        }
+        if ( is_decimal ) {
+            PyObject* rv = PyObject_CallFunctionObjArgs(native->dcupdate,
+                                                        number, currency, NULL);
+            if ( rv == NULL ) {
+                return NULL;
+            }
+            Py_DECREF(rv);
+        }
+    }
+    return native_tuple(amount_type, 2, number, currency);
+}
+
+/* See Builder.posting(). This only handles postings without a price, which
+ * require no validation; the others are left to the builder. */
+static PyObject* native_posting(native_builder_t* native, int lineno,
+                                PyObject* account, PyObject* units, PyObject* cost,
+                                char flag)
+{
+    PyObject* meta = native_metadata(native, lineno);
+    PyObject* pyflag;
+    PyObject* posting;
+    if ( meta == NULL ) {
+        return NULL;
+    }
+    if ( flag ) {
+        pyflag = PyUnicode_FromOrdinal((unsigned char)flag);
+        if ( pyflag == NULL ) {
+            Py_DECREF(meta);
+            return NULL;
+        }
+    }
+    else {
+        pyflag = Py_None;
+        Py_INCREF(pyflag);
+    }
+    posting = native_tuple(posting_type, 6, account, units, cost, Py_None, pyflag, meta);
+    Py_DECREF(pyflag);
+    Py_DECREF(meta);
+    return posting;
+}
+
+/* See Builder.transaction(). */
+static PyObject* native_transaction(native_builder_t* native, int lineno,
+                                    PyObject* date, char flag, PyObject* txn_strings,
+                                    PyObject* tags_links, PyObject* posting_or_kv_list)
+{
+    PyObject* meta = native_metadata(native, lineno);
+    PyObject* explicit_meta = NULL;
+    PyObject* postings = PyList_New(0);
+    PyObject* owned_tags_links = NULL;
+    PyObject* last_meta = NULL;
+    PyObject* tags;
+    PyObject* links;
+    PyObject* frozen_tags = NULL;
+    PyObject* frozen_links = NULL;
+    PyObject* pyflag = NULL;
+    PyObject* payee;
+    PyObject* narration;
+    PyObject* result = NULL;
+    Py_ssize_t num_strings;
+    Py_ssize_t i;
+
+    if ( meta == NULL || postings == NULL ) {
+        goto done;
+    }
+
+    /* Separate postings and key-values. */
+    if ( posting_or_kv_list != Py_None ) {
+        for ( i = 0; i < PyList_GET_SIZE(posting_or_kv_list); ++i ) {
+            PyObject* item = PyList_GET_ITEM(posting_or_kv_list, i);
+            if ( Py_TYPE(item) == (PyTypeObject*)posting_type ) {
+                if ( PyList_Append(postings, item) < 0 ) {
+                    goto done;
+                }
+                last_meta = PyTuple_GET_ITEM(item, 5);
+            }
+            else if ( Py_TYPE(item) == (PyTypeObject*)tags_links_type ) {
+                if ( PyList_GET_SIZE(postings) > 0 ) {
+                    if ( native_error(native, meta, PyUnicode_FromFormat(
+                             "Tags or links not allowed after first Posting: %S",
+                             item)) < 0 ) {
+                        goto done;
+                    }
+                }
+                else if ( item != native->empty_tags_links ) {
+                    if ( tags_links == native->empty_tags_links ) {
+                        tags_links = owned_tags_links = new_tags_links();
+                        if ( tags_links == NULL ) {
+                            goto done;
+                        }
+                    }
+                    if ( set_update(PyTuple_GET_ITEM(tags_links, 0),
+                                    PyTuple_GET_ITEM(item, 0)) < 0 ||
+                         set_update(PyTuple_GET_ITEM(tags_links, 1),
+                                    PyTuple_GET_ITEM(item, 1)) < 0 ) {
+                        goto done;
+                    }
+                }
+            }
+            else if ( Py_TYPE(item) == (PyTypeObject*)key_value_type ) {
+                PyObject* value = PyTuple_GET_ITEM(item, 1);
+                PyObject* existing;
+                if ( last_meta == NULL && explicit_meta == NULL &&
+                     (explicit_meta = PyDict_New()) == NULL ) {
+                    goto done;
+                }
+                existing = PyDict_SetDefault(
+                    last_meta != NULL ? last_meta : explicit_meta,
+                    PyTuple_GET_ITEM(item, 0), value);
+                if ( existing == NULL ) {
+                    goto done;
+                }
+                if ( existing != value &&
+                     native_error(native, meta, PyUnicode_FromFormat(
+                         last_meta != NULL ?
+                         "Duplicate posting metadata field: %S" :
+                         "Duplicate metadata field on entry: %S", item)) < 0 ) {
+                    goto done;
+                }
+            }
+            else {
+                PyErr_Format(PyExc_TypeError, "Unexpected transaction item: %R", item);
+                goto done;
+            }
+        }
+    }
+
+    /* Freeze the tags & links or set to default empty values. */
+    if ( PyList_GET_SIZE(native->tags) > 0 ) {
+        if ( tags_links == native->empty_tags_links ) {
+            tags_links = owned_tags_links = new_tags_links();
+            if ( tags_links == NULL ) {
+                goto done;
+            }
+        }
+        if ( set_update(PyTuple_GET_ITEM(tags_links, 0), native->tags) < 0 ) {
+            goto done;
+        }
+    }
+    tags = PyTuple_GET_ITEM(tags_links, 0);
+    links = PyTuple_GET_ITEM(tags_links, 1);
+    frozen_tags = PySet_GET_SIZE(tags) > 0 ? PyFrozenSet_New(tags) : (Py_INCREF(empty_set), empty_set);
+    frozen_links = PySet_GET_SIZE(links) > 0 ? PyFrozenSet_New(links) : (Py_INCREF(empty_set), empty_set);
+    if ( frozen_tags == NULL || frozen_links == NULL ) {
+        goto done;
+    }
+
+    /* Initialize the metadata fields from the set of active values. */
+    if ( PyDict_GET_SIZE(native->meta) > 0 ) {
+        PyObject* key;
+        PyObject* value_list;
+        Py_ssize_t pos = 0;
+        while ( PyDict_Next(native->meta, &pos, &key, &value_list) ) {
+            PyObject* value = PySequence_GetItem(value_list, -1);
+            int rv;
+            if ( value == NULL ) {
+                goto done;
+            }
+            rv = PyDict_SetItem(meta, key, value);
+            Py_DECREF(value);
+            if ( rv < 0 ) {
+                goto done;
+            }
+        }
+    }
+
+    /* Add on explicitly defined values. */
+    if ( explicit_meta != NULL && PyDict_Update(meta, explicit_meta) < 0 ) {
+        goto done;
+    }
+
+    /* Unpack the transaction fields. */
+    num_strings = txn_strings == Py_None ? 0 : PyList_GET_SIZE(txn_strings);
+    if ( num_strings == 1 ) {
+        payee = Py_None;
+        narration = PyList_GET_ITEM(txn_strings, 0);
+    }
+    else if ( num_strings == 2 ) {
+        payee = PyList_GET_ITEM(txn_strings, 0);
+        narration = PyList_GET_ITEM(txn_strings, 1);
+    }
+    else if ( num_strings == 0 ) {
+        payee = Py_None;
+        narration = empty_string;
+    }
+    else {
+        if ( native_error(native, meta, PyUnicode_FromFormat(
+                 "Too many strings on transaction description: %S",
+                 txn_strings)) == 0 ) {
+            result = Py_None;
+            Py_INCREF(result);
+        }
+        goto done;
+    }
+
+    /* Create the transaction. */
+    pyflag = PyUnicode_FromOrdinal((unsigned char)flag);
+    if ( pyflag != NULL ) {
+        result = native_tuple(transaction_type, 8, meta, date, pyflag, payee, narration,
+                              frozen_tags, frozen_links, postings);
+    }
+
+  done:
+    Py_XDECREF(meta);
+    Py_XDECREF(explicit_meta);
+    Py_XDECREF(postings);
+    Py_XDECREF(owned_tags_links);
+    Py_XDECREF(frozen_tags);
+    Py_XDECREF(frozen_links);
+    Py_XDECREF(pyflag);
+    return result;
+}
+
 %}
 
 
@@ -117,10 +677,24 @@ const char* getTokenName(int token);
 %defines
 %error-verbose
 %debug
-%pure-parser
+%define api.pure full
+%define api.push-pull both
 %locations
 /* %glr-parser */
 
+/* The parser is reentrant: the lexer state is held by the scanner object and
+ * the builder is passed explicitly instead of being stored in globals. */
+%code requires {
+#include "parser.h"
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+}
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {PyObject* builder}
+
 
 /* Collection of value types. */
 %union {
@@ -336,13 +910,13 @@ txn_strings : empty
             }
             | txn_strings STRING
             {
-                BUILDY(DECREF2($1, $2),
-                       $$, "handle_list", "OO", $1, $2);
+                BUILDN(DECREF2($1, $2),
+                       $$, native_handle_list($1, $2), handle_list, "OO", $1, $2);
             }
             | txn_strings PIPE
             {
                 BUILDY(,
-                       $$, "pipe_deprecated_error", "si", FILE_LINE_ARGS);
+                       $$, pipe_deprecated_error, "si", FILE_LINE_ARGS);
                 $$ = $1;
             }
 
@@ -351,24 +925,25 @@ tags_links : empty
                /* Note: We're passing a bogus value here in order to avoid
                 * having to declare a second macro just for this one special
                 * case. */
-               BUILDY(,
-                      $$, "tag_link_new", "O", Py_None);
+               BUILDN(,
+                      $$, native_tag_link_new(NATIVE), tag_link_new, "O", Py_None);
            }
            | tags_links LINK
            {
-               BUILDY(DECREF2($1, $2),
-                      $$, "tag_link_LINK", "OO", $1, $2);
+               BUILDN(DECREF2($1, $2),
+                      $$, native_tag_link_add(NATIVE, $1, 1, $2), tag_link_LINK, "OO", $1, $2);
            }
            | tags_links TAG
            {
-               BUILDY(DECREF2($1, $2),
-                      $$, "tag_link_TAG", "OO", $1, $2);
+               BUILDN(DECREF2($1, $2),
+                      $$, native_tag_link_add(NATIVE, $1, 0, $2), tag_link_TAG, "OO", $1, $2);
            }
 
 transaction : DATE txn txn_strings tags_links eol posting_or_kv_list
             {
-                BUILDY(DECREF4($1, $3, $4, $6),
-                       $$, "transaction", "siObOOO", FILE_LINE_ARGS, $1, $2, $3, $4, $6);
+                BUILDN(DECREF4($1, $3, $4, $6),
+                       $$, native_transaction(NATIVE, LINE_ARG, $1, $2, $3, $4, $6),
+                       transaction, "siObOOO", FILE_LINE_ARGS, $1, $2, $3, $4, $6);
             }
 
 optflag : empty
@@ -392,29 +967,31 @@ price_annotation : incomplete_amount
 
 posting : INDENT optflag ACCOUNT incomplete_amount cost_spec eol
         {
-            BUILDY(DECREF3($3, $4, $5),
-                   $$, "posting", "siOOOOOb", FILE_LINE_ARGS, $3, $4, $5, Py_None, Py_False, $2);
+            BUILDN(DECREF3($3, $4, $5),
+                   $$, native_posting(NATIVE, LINE_ARG, $3, $4, $5, $2),
+                   posting, "siOOOOOb", FILE_LINE_ARGS, $3, $4, $5, Py_None, Py_False, $2);
         }
         | INDENT optflag ACCOUNT incomplete_amount cost_spec AT price_annotation eol
         {
             BUILDY(DECREF4($3, $4, $5, $7),
-                   $$, "posting", "siOOOOOb", FILE_LINE_ARGS, $3, $4, $5, $7, Py_False, $2);
+                   $$, posting, "siOOOOOb", FILE_LINE_ARGS, $3, $4, $5, $7, Py_False, $2);
         }
         | INDENT optflag ACCOUNT incomplete_amount cost_spec ATAT price_annotation eol
         {
             BUILDY(DECREF4($3, $4, $5, $7),
-                   $$, "posting", "siOOOOOb", FILE_LINE_ARGS, $3, $4, $5, $7, Py_True, $2);
+                   $$, posting, "siOOOOOb", FILE_LINE_ARGS, $3, $4, $5, $7, Py_True, $2);
         }
         | INDENT optflag ACCOUNT eol
         {
-            BUILDY(DECREF1($3),
-                   $$, "posting", "siOOOOOb", FILE_LINE_ARGS, $3, missing_obj, Py_None, Py_None, Py_False, $2);
+            BUILDN(DECREF1($3),
+                   $$, native_posting(NATIVE, LINE_ARG, $3, missing_obj, Py_None, $2),
+                   posting, "siOOOOOb", FILE_LINE_ARGS, $3, missing_obj, Py_None, Py_None, Py_False, $2);
         }
 
 key_value : KEY COLON key_value_value
           {
-              BUILDY(DECREF2($2, $3),
-                     $$, "key_value", "OO", $2, $3);
+              BUILDN(DECREF2($2, $3),
+                     $$, native_tuple(key_value_type, 2, $2, $3), key_value, "OO", $2, $3);
           }
 
 key_value_line : INDENT key_value eol
@@ -451,18 +1028,18 @@ posting_or_kv_list : empty
                    }
                    | posting_or_kv_list INDENT tags_links EOL
                    {
-                       BUILDY(DECREF2($1, $3),
-                              $$, "handle_list", "OO", $1, $3);
+                       BUILDN(DECREF2($1, $3),
+                              $$, native_handle_list($1, $3), handle_list, "OO", $1, $3);
                    }
                    | posting_or_kv_list key_value_line
                    {
-                       BUILDY(DECREF2($1, $2),
-                              $$, "handle_list", "OO", $1, $2);
+                       BUILDN(DECREF2($1, $2),
+                              $$, native_handle_list($1, $2), handle_list, "OO", $1, $2);
                    }
                    | posting_or_kv_list posting
                    {
-                       BUILDY(DECREF2($1, $2),
-                              $$, "handle_list", "OO", $1, $2);
+                       BUILDN(DECREF2($1, $2),
+                              $$, native_handle_list($1, $2), handle_list, "OO", $1, $2);
                    }
 
 key_value_list : empty
@@ -472,8 +1049,8 @@ key_value_list : empty
                }
                | key_value_list key_value_line
                {
-                   BUILDY(DECREF2($1, $2),
-                          $$, "handle_list", "OO", $1, $2);
+                   BUILDN(DECREF2($1, $2),
+                          $$, native_handle_list($1, $2), handle_list, "OO", $1, $2);
                }
 
 currency_list : empty
@@ -483,25 +1060,25 @@ currency_list : empty
               }
               | CURRENCY
               {
-                  BUILDY(DECREF1($1),
-                         $$, "handle_list", "OO", Py_None, $1);
+                  BUILDN(DECREF1($1),
+                         $$, native_handle_list(Py_None, $1), handle_list, "OO", Py_None, $1);
               }
               | currency_list COMMA CURRENCY
               {
-                  BUILDY(DECREF2($1, $3),
-                         $$, "handle_list", "OO", $1, $3);
+                  BUILDN(DECREF2($1, $3),
+                         $$, native_handle_list($1, $3), handle_list, "OO", $1, $3);
               }
 
 pushtag : PUSHTAG TAG eol
          {
              BUILDY(DECREF1($2),
-                    $$, "pushtag", "O", $2);
+                    $$, pushtag, "O", $2);
          }
 
 poptag : POPTAG TAG eol
        {
            BUILDY(DECREF1($2),
-                  $$, "poptag", "O", $2);
+                  $$, poptag, "O", $2);
        }
 
 pushmeta : PUSHMETA key_value eol
@@ -510,19 +1087,19 @@ pushmeta : PUSHMETA key_value eol
               * within a tuple, so expand in the method (it receives two
               * objects). See https://docs.python.org/3.4/c-api/arg.html. */
              BUILDY(DECREF1($2),
-                    $$, "pushmeta", "O", $2);
+                    $$, pushmeta, "O", $2);
          }
 
 popmeta : POPMETA KEY COLON eol
         {
             BUILDY(DECREF1($2),
-                   $$, "popmeta", "O", $2);
+                   $$, popmeta, "O", $2);
         }
 
 open : DATE OPEN ACCOUNT currency_list opt_booking eol key_value_list
      {
          BUILDY(DECREF5($1, $3, $4, $5, $7),
-                $$, "open", "siOOOOO", FILE_LINE_ARGS, $1, $3, $4, $5, $7);
+                $$, open, "siOOOOO", FILE_LINE_ARGS, $1, $3, $4, $5, $7);
          ;
      }
 
@@ -539,45 +1116,45 @@ opt_booking : STRING
 close : DATE CLOSE ACCOUNT eol key_value_list
       {
           BUILDY(DECREF3($1, $3, $5),
-                 $$, "close", "siOOO", FILE_LINE_ARGS, $1, $3, $5);
+                 $$, close, "siOOO", FILE_LINE_ARGS, $1, $3, $5);
       }
 
 commodity : DATE COMMODITY CURRENCY eol key_value_list
           {
               BUILDY(DECREF3($1, $3, $5),
-                     $$, "commodity", "siOOO", FILE_LINE_ARGS, $1, $3, $5);
+                     $$, commodity, "siOOO", FILE_LINE_ARGS, $1, $3, $5);
           }
 
 pad : DATE PAD ACCOUNT ACCOUNT eol key_value_list
     {
         BUILDY(DECREF4($1, $3, $4, $6),
-               $$, "pad", "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
+               $$, pad, "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
     }
 
 balance : DATE BALANCE ACCOUNT amount_tolerance eol key_value_list
         {
             BUILDY(DECREF5($1, $3, $6, $4.pyobj1, $4.pyobj2),
-                   $$, "balance", "siOOOOO", FILE_LINE_ARGS, $1, $3, $4.pyobj1, $4.pyobj2, $6);
+                   $$, balance, "siOOOOO", FILE_LINE_ARGS, $1, $3, $4.pyobj1, $4.pyobj2, $6);
         }
 
 amount : number_expr CURRENCY
        {
-           BUILDY(DECREF2($1, $2),
-                  $$, "amount", "OO", $1, $2);
+           BUILDN(DECREF2($1, $2),
+                  $$, native_amount(NATIVE, $1, $2), amount, "OO", $1, $2);
        }
 
 amount_tolerance : number_expr CURRENCY
                  {
-                     BUILDY(DECREF2($1, $2),
-                            $$.pyobj1, "amount", "OO", $1, $2);
+                     BUILDN(DECREF2($1, $2),
+                            $$.pyobj1, native_amount(NATIVE, $1, $2), amount, "OO", $1, $2);
                      $$.pyobj2 = Py_None;
                      Py_INCREF(Py_None);
                      ;
                  }
                  | number_expr TILDE number_expr CURRENCY
                  {
-                     BUILDY(DECREF2($1, $4),
-                            $$.pyobj1, "amount", "OO", $1, $4);
+                     BUILDN(DECREF2($1, $4),
+                            $$.pyobj1, native_amount(NATIVE, $1, $4), amount, "OO", $1, $4);
                      $$.pyobj2 = $3;
                  }
 
@@ -604,35 +1181,35 @@ maybe_currency : empty
 compound_amount : maybe_number CURRENCY
                 {
                     BUILDY(DECREF2($1, $2),
-                           $$, "compound_amount", "OOO", $1, Py_None, $2);
+                           $$, compound_amount, "OOO", $1, Py_None, $2);
                 }
                 | number_expr maybe_currency
                 {
                     BUILDY(DECREF2($1, $2),
-                           $$, "compound_amount", "OOO", $1, Py_None, $2);
+                           $$, compound_amount, "OOO", $1, Py_None, $2);
                 }
                 | maybe_number HASH maybe_number CURRENCY
                 {
                     BUILDY(DECREF3($1, $3, $4),
-                           $$, "compound_amount", "OOO", $1, $3, $4);
+                           $$, compound_amount, "OOO", $1, $3, $4);
                     ;
                 }
 
 incomplete_amount : maybe_number maybe_currency
                   {
-                      BUILDY(DECREF2($1, $2),
-                             $$, "amount", "OO", $1, $2);
+                      BUILDN(DECREF2($1, $2),
+                             $$, native_amount(NATIVE, $1, $2), amount, "OO", $1, $2);
                  }
 
 cost_spec : LCURL cost_comp_list RCURL
           {
               BUILDY(DECREF1($2),
-                     $$, "cost_spec", "OO", $2, Py_False);
+                     $$, cost_spec, "OO", $2, Py_False);
           }
           | LCURLCURL cost_comp_list RCURLCURL
           {
               BUILDY(DECREF1($2),
-                     $$, "cost_spec", "OO", $2, Py_True);
+                     $$, cost_spec, "OO", $2, Py_True);
           }
           | empty
           {
@@ -647,13 +1224,13 @@ cost_comp_list : empty
                }
                | cost_comp
                {
-                   BUILDY(DECREF1($1),
-                          $$, "handle_list", "OO", Py_None, $1);
+                   BUILDN(DECREF1($1),
+                          $$, native_handle_list(Py_None, $1), handle_list, "OO", Py_None, $1);
                }
                | cost_comp_list COMMA cost_comp
                {
-                   BUILDY(DECREF2($1, $3),
-                          $$, "handle_list", "OO", $1, $3);
+                   BUILDN(DECREF2($1, $3),
+                          $$, native_handle_list($1, $3), handle_list, "OO", $1, $3);
                }
 
 cost_comp : compound_amount
@@ -671,32 +1248,32 @@ cost_comp : compound_amount
           | ASTERISK
           {
               BUILDY(,
-                     $$, "cost_merge", "O", Py_None);
+                     $$, cost_merge, "O", Py_None);
           }
 
 
 price : DATE PRICE CURRENCY amount eol key_value_list
       {
           BUILDY(DECREF4($1, $3, $4, $6),
-                 $$, "price", "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
+                 $$, price, "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
       }
 
 event : DATE EVENT STRING STRING eol key_value_list
       {
           BUILDY(DECREF4($1, $3, $4, $6),
-                 $$, "event", "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
+                 $$, event, "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
       }
 
 query : DATE QUERY STRING STRING eol key_value_list
          {
              BUILDY(DECREF4($1, $3, $4, $6),
-                    $$, "query", "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
+                    $$, query, "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
          }
 
 note : DATE NOTE ACCOUNT STRING eol key_value_list
       {
           BUILDY(DECREF4($1, $3, $4, $6),
-                 $$, "note", "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
+                 $$, note, "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
       }
 
 filename : STRING
@@ -704,34 +1281,34 @@ filename : STRING
 document : DATE DOCUMENT ACCOUNT filename tags_links eol key_value_list
          {
              BUILDY(DECREF5($1, $3, $4, $5, $7),
-                    $$, "document", "siOOOOO", FILE_LINE_ARGS, $1, $3, $4, $5, $7);
+                    $$, document, "siOOOOO", FILE_LINE_ARGS, $1, $3, $4, $5, $7);
          }
 
 
 custom_value : STRING
              {
                  BUILDY(DECREF1($1),
-                        $$, "custom_value", "OO", $1, Py_None);
+                        $$, custom_value, "OO", $1, Py_None);
              }
              | DATE
              {
                  BUILDY(DECREF1($1),
-                        $$, "custom_value", "OO", $1, Py_None);
+                        $$, custom_value, "OO", $1, Py_None);
              }
              | BOOL
              {
                  BUILDY(DECREF1($1),
-                        $$, "custom_value", "OO", $1, Py_None);
+                        $$, custom_value, "OO", $1, Py_None);
              }
              | amount
              {
                  BUILDY(DECREF1($1),
-                        $$, "custom_value", "OO", $1, Py_None);
+                        $$, custom_value, "OO", $1, Py_None);
              }
              | number_expr
              {
                  BUILDY(DECREF1($1),
-                        $$, "custom_value", "OO", $1, Py_None);
+                        $$, custom_value, "OO", $1, Py_None);
              }
              | ACCOUNT
              {
@@ -740,7 +1317,7 @@ custom_value : STRING
                  PyObject* dtype = PyObject_GetAttrString(module, "TYPE");
                  Py_DECREF(module);
                  BUILDY(DECREF2($1, dtype),
-                        $$, "custom_value", "OO", $1, dtype);
+                        $$, custom_value, "OO", $1, dtype);
              }
 
 custom_value_list : empty
@@ -750,14 +1327,14 @@ custom_value_list : empty
                   }
                   | custom_value_list custom_value
                   {
-                      BUILDY(DECREF2($1, $2),
-                             $$, "handle_list", "OO", $1, $2);
+                      BUILDN(DECREF2($1, $2),
+                             $$, native_handle_list($1, $2), handle_list, "OO", $1, $2);
                   }
 
 custom : DATE CUSTOM STRING custom_value_list eol key_value_list
        {
            BUILDY(DECREF4($1, $3, $4, $6),
-                  $$, "custom", "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
+                  $$, custom, "siOOOO", FILE_LINE_ARGS, $1, $3, $4, $6);
        }
 
 
@@ -780,24 +1357,27 @@ entry : transaction
 option : OPTION STRING STRING eol
        {
            BUILDY(DECREF2($2, $3),
-                  $$, "option", "siOO", FILE_LINE_ARGS, $2, $3);
+                  $$, option, "siOO", FILE_LINE_ARGS, $2, $3);
+           /* Options may change the set of valid account names; revalidate the
+            * accounts seen from now on. */
+           intern_clear(&yyget_extra(scanner)->accounts);
        }
 
 include : INCLUDE STRING eol
        {
            BUILDY(DECREF1($2),
-                  $$, "include", "siO", FILE_LINE_ARGS, $2);
+                  $$, include, "siO", FILE_LINE_ARGS, $2);
        }
 
 plugin : PLUGIN STRING eol
        {
            BUILDY(DECREF1($2),
-                  $$, "plugin", "siOO", FILE_LINE_ARGS, $2, Py_None);
+                  $$, plugin, "siOO", FILE_LINE_ARGS, $2, Py_None);
        }
        | PLUGIN STRING STRING eol
        {
            BUILDY(DECREF2($2, $3),
-                  $$, "plugin", "siOO", FILE_LINE_ARGS, $2, $3);
+                  $$, plugin, "siOO", FILE_LINE_ARGS, $2, $3);
        }
 
 directive : empty_line
@@ -816,8 +1396,19 @@ declarations : declarations directive
              }
              | declarations entry
              {
-                 BUILDY(DECREF2($1, $2),
-                        $$, "handle_list", "OO", $1, $2);
+                 if ( STREAM != NULL ) {
+                     /* Hand the entry over instead of accumulating it. */
+                     $$ = stream_entry(STREAM, $1, $2);
+                     DECREF2($1, $2);
+                     if ( $$ == NULL ) {
+                         build_grammar_error_from_exception(scanner, builder);
+                         YYERROR;
+                     }
+                 }
+                 else {
+                     BUILDN(DECREF2($1, $2),
+                            $$, native_handle_list($1, $2), handle_list, "OO", $1, $2);
+                 }
              }
              | declarations error
              {
@@ -847,7 +1438,7 @@ declarations : declarations directive
 file : declarations
      {
          BUILDY(DECREF1($1),
-                $$, "store_result", "O", $1);
+                $$, store_result, "O", $1);
      }
 
 
@@ -867,6 +1458,8 @@ const char* getTokenName(int token)
         case PIPE      : return "PIPE";
         case ATAT      : return "ATAT";
         case AT        : return "AT";
+        case LCURLCURL : return "LCURLCURL";
+        case RCURLCURL : return "RCURLCURL";
         case LCURL     : return "LCURL";
         case RCURL     : return "RCURL";
         case EQUAL     : return "EQUAL";
@@ -885,6 +1478,7 @@ const char* getTokenName(int token)
         case BALANCE   : return "BALANCE";
         case OPEN      : return "OPEN";
         case CLOSE     : return "CLOSE";
+        case COMMODITY : return "COMMODITY";
         case PAD       : return "PAD";
         case EVENT     : return "EVENT";
         case QUERY     : return "QUERY";
@@ -897,6 +1491,7 @@ const char* getTokenName(int token)
         case PUSHMETA  : return "PUSHMETA";
         case POPMETA   : return "POPMETA";
         case OPTION    : return "OPTION";
+        case INCLUDE   : return "INCLUDE";
         case PLUGIN    : return "PLUGIN";
         case DATE      : return "DATE";
         case ACCOUNT   : return "ACCOUNT";
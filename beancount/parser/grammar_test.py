@@ -5,6 +5,7 @@ __copyright__ = "Copyright (C) 2015-2016  Martin Blais"
 __license__ = "GNU GPLv2"
 
 import datetime
+import json
 import unittest
 import inspect
 import textwrap
@@ -19,6 +20,8 @@ from beancount.core.amount import from_string as A
 from beancount.core.amount import Amount
 from beancount.core.position import CostSpec
 from beancount.parser import parser
+from beancount.parser import grammar
+from beancount.parser import _parser
 from beancount.parser import lexer
 from beancount.core import data
 from beancount.core import amount
@@ -624,6 +627,24 @@ class TestParserOptions(unittest.TestCase):
         check_list(self, errors, [parser.ParserError])
         self.assertNotEqual("filename", "gniagniagniagniagnia")
 
+    @parser.parse_doc(expect_errors=True)
+    def test_option_account_names_revalidated(self, entries, errors, options_map):
+        """
+          2014-01-01 open Actifs:Cash
+          2014-01-01 open Assets:Cash
+
+          option "name_assets" "Actifs"
+
+          2014-01-02 open Actifs:Cash
+          2014-01-02 open Assets:Cash
+        """
+        # Accounts are validated against the account names in effect when they
+        # are lexed, even if they were seen earlier.
+        self.assertEqual([('Assets:Cash', datetime.date(2014, 1, 1)),
+                          ('Actifs:Cash', datetime.date(2014, 1, 2))],
+                         [(entry.account, entry.date) for entry in entries])
+        self.assertEqual(2, len(errors))
+
 
 class TestParserInclude(unittest.TestCase):
 
@@ -2539,5 +2560,132 @@ class TestDocument(unittest.TestCase):
         self.assertEqual({'something'}, entries[0].links)
 
 
+class TestNativeBuilder(unittest.TestCase):
+    """Objects created natively by the grammar must match the builder's."""
+
+    class PythonBuilder(grammar.Builder):
+        # Overriding any of the methods disables native creation.
+        def transaction(self, *args):
+            return super().transaction(*args)
+
+    INPUT = textwrap.dedent("""
+      option "operating_currency" "USD"
+      2014-01-01 open Assets:Cash  USD,CAD
+      2014-01-01 open Assets:Invest  "FIFO"
+
+      pushtag #trip
+      pushmeta location: "Paris"
+
+      2014-02-01 * "Payee" "Narration" #tag ^link
+        #other ^link2
+        key: "value"
+        number: 2 + 3
+        Expenses:Food   10.00 USD
+          sub: 2014-02-02
+        ! Assets:Cash  -10.00 USD
+
+      2014-02-02 txn "Only narration"
+        Assets:Invest   10 HOOL {100.00 # 9.95 USD, 2014-01-01, "lot"}
+        Assets:Cash     -10 HOOL @ 101.00 USD
+        Assets:Cash     -1 HOOL @@ 101.00 USD
+        Assets:Cash
+
+      2014-02-03 *
+        key: "first"
+        key: "second"
+        Assets:Cash   1 USD
+          sub: "first"
+          sub: "second"
+        #late
+        Assets:Cash  -1 USD
+
+      2014-02-04 * "One" "Two" "Three"
+        Assets:Cash   1 USD
+        Assets:Cash  -1 USD
+
+      popmeta location:
+      poptag #trip
+
+      2014-03-01 balance Assets:Cash  0.00 ~ 0.01 USD
+      2014-03-01 price HOOL  101.00 USD
+      2014-03-01 custom "budget" Assets:Cash 10.00 USD "monthly" TRUE
+    """)
+
+    def test_native_matches_builder(self):
+        native_builder = grammar.Builder('/input')
+        _parser.parse_string(self.INPUT, native_builder, report_filename='/input')
+        python_builder = self.PythonBuilder('/input')
+        _parser.parse_string(self.INPUT, python_builder, report_filename='/input')
+
+        native_entries, native_errors, native_options = native_builder.finalize()
+        entries, errors, options_map = python_builder.finalize()
+        self.assertEqual(8, len(entries))
+        self.assertEqual(entries, native_entries)
+        self.assertEqual([type(entry) for entry in entries],
+                         [type(entry) for entry in native_entries])
+        self.assertEqual([(error.source['lineno'], error.message) for error in errors],
+                         [(error.source['lineno'], error.message)
+                          for error in native_errors])
+        self.assertEqual(4, len(errors))
+        self.assertEqual(str(options_map['dcontext']),
+                         str(native_options['dcontext']))
+
+        txn = native_entries[2]
+        self.assertIsInstance(txn.postings[0].units, Amount)
+        self.assertEqual({'filename': '/input', 'lineno': 9, 'location': 'Paris',
+                          'key': 'value', 'number': D('5')}, txn.meta)
+        self.assertEqual({'tag', 'other', 'trip'}, txn.tags)
+        self.assertEqual('!', txn.postings[1].flag)
+        self.assertIs(data.EMPTY_SET, native_entries[3].links)
+
+    @parser.parse_doc(expect_errors=False)
+    def test_native_tags_links_not_shared(self, entries, _, __):
+        """
+          2014-01-01 * "No tags"
+            Assets:Cash   1 USD
+            Assets:Cash  -1 USD
+
+          2014-01-02 * "Indented tag"
+            #indented
+            Assets:Cash   1 USD
+            Assets:Cash  -1 USD
+
+          2014-01-03 * "Link" ^link
+            Assets:Cash   1 USD
+            Assets:Cash  -1 USD
+
+          2014-01-04 * "No tags again"
+            key: "value"
+            Assets:Cash   1 USD
+            Assets:Cash  -1 USD
+        """
+        self.assertEqual([set(), {'indented'}, set(), set()],
+                         [entry.tags for entry in entries])
+        self.assertEqual([set(), set(), {'link'}, set()],
+                         [entry.links for entry in entries])
+        self.assertIs(data.EMPTY_SET, entries[0].tags)
+        self.assertIs(data.EMPTY_SET, entries[3].links)
+
+    @parser.parse_doc(expect_errors=False)
+    def test_native_metadata_plain_dicts(self, entries, _, __):
+        """
+          2014-01-01 * "Payee"
+            key: "value"
+            Assets:Cash   1 USD
+            Assets:Cash  -1 USD
+        """
+        txn = entries[0]
+        for meta in [txn.meta, txn.postings[0].meta]:
+            self.assertIs(dict, type(meta))
+            self.assertTrue(dict.__contains__(meta, 'lineno'))
+            self.assertEqual(meta['filename'], dict.get(meta, 'filename'))
+            self.assertEqual(list(meta.items()), list(dict.items(meta)))
+            self.assertEqual(len(meta), dict.__len__(meta))
+            self.assertEqual(meta, json.loads(json.dumps(meta)))
+        self.assertEqual(3, dict.__len__(txn.meta))
+        self.assertEqual('value', dict.get(txn.meta, 'key'))
+        self.assertIs(txn.meta['filename'], txn.postings[0].meta['filename'])
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -7,71 +7,243 @@
 #include "parser.h"
 #include "grammar.h"
 
+/* A block of memory of an arena, followed by its data. */
+typedef struct arena_block {
+    struct arena_block* next;
+} arena_block_t;
+
+/* A region from which many small blocks of memory are allocated for the
+ * duration of a parse, and released all at once at the end of it. */
+typedef struct {
+    arena_block_t* blocks;  /* The list of blocks, most recent first. */
+    char* ptr;              /* Free space in the current block. */
+    char* end;              /* End of the current block. */
+} arena_t;
+
+/* Allocate memory from the arena. Returns NULL if out of memory. */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/* Release all the memory allocated from the arena. */
+void arena_clear(arena_t* arena);
+
+/* An entry of a token intern table. */
+typedef struct {
+    char* key;        /* Copy of the token text in the arena (not nul-terminated). */
+    size_t length;    /* Length of the token text. */
+    size_t hash;      /* Hash of the token text. */
+    PyObject* value;  /* Reference to the value returned by the builder. */
+} intern_entry_t;
+
+/* A hash table of the values returned by the builder for repeated tokens, keyed
+ * by the token text, so that each distinct token is converted only once and
+ * all its occurrences share the same Python object. */
+typedef struct {
+    int enabled;              /* False if the builder method is overridden. */
+    arena_t* arena;           /* The arena holding the keys. */
+    size_t capacity;          /* Number of slots, a power of two (or zero). */
+    size_t size;              /* Number of occupied slots. */
+    intern_entry_t* entries;  /* Open-addressed array of slots. */
+} intern_table_t;
+
+/* Look up a token in the table. Returns a borrowed reference or NULL. */
+PyObject* intern_lookup(intern_table_t* table, const char* key, size_t length);
+
+/* Insert a token value in the table. Failures are ignored, as it is only a
+ * cache. */
+void intern_insert(intern_table_t* table, const char* key, size_t length,
+                   PyObject* value);
+
+/* Remove all the tokens from the table. */
+void intern_clear(intern_table_t* table);
+
+/* The state of a single lexer instance. This is attached to the scanner as its
+ * "extra" data, so that multiple inputs may be tokenized concurrently. */
+typedef struct {
+    /* The builder object receiving the callbacks (borrowed reference). */
+    PyObject* builder;
+
+    /* The filename being tokenized (owned copy). */
+    char* filename;
+
+    /* Offset added to the line numbers when reporting locations. */
+    int firstline;
+
+    /* The number of times EOF has been hit. This is used to synthesize an EOL
+     * at the end of the file. */
+    int eof_times;
+
+    /* Number of tokens since the beginning of the line. */
+    int line_tokens;
+
+    /* The encoding to use for converting strings (owned copy). */
+    char* encoding;
+
+    /* True if the builder uses the default LexBuilder.NUMBER() method, in
+     * which case NUMBER tokens are converted to Decimal natively. */
+    int native_number;
+
+    /* True if the builder uses the default LexBuilder.STRING() method, in
+     * which case STRING tokens are created natively, warning about strings
+     * with more lines than the builder's long_string_maxlines_default. */
+    int native_string;
+    long string_maxlines;
+
+    /* The memory allocated for the duration of the parse. */
+    arena_t arena;
+
+    /* Values of the repeated tokens. */
+    intern_table_t dates;
+    intern_table_t accounts;
+    intern_table_t currencies;
+    intern_table_t tags;
+    intern_table_t links;
+    intern_table_t keys;
+
+    /* State for building the common grammar objects natively. */
+    native_builder_t native;
+
+    /* The builder methods, if bound once for the whole parse. */
+    builder_dispatch_t dispatch;
+
+    /* If not NULL, the list the entries are appended to as they are reduced,
+     * instead of being accumulated by the grammar (borrowed; see
+     * parser_next()). */
+    PyObject* stream;
+
+    /* If true, the values of the tokens are not built and are left NULL, for
+     * callers which only need the types and positions of the tokens (see
+     * lexer_tokenize()). */
+    int skip_values;
+
+    /* The number of bytes of input consumed so far. */
+    size_t offset;
+
+    /* The byte offset of the beginning of the last token. For string literals,
+     * this is the offset of the opening quote. */
+    size_t token_offset;
+
+    /* The state of the thread while the GIL is released for the scan, or NULL
+     * if it is held. This is only done when the values of the tokens are not
+     * built; build_lexer_error() reacquires the GIL around its callback. See
+     * lexer_tokenize(). */
+    PyThreadState* thread_state;
+
+    /* A buffer for parsing string literals. It is reused and its size is
+     * dynamically allocated. */
+    size_t strbuf_size;  /* Current buffer size (not including final nul). */
+    char* strbuf;        /* Current buffer head. */
+    char* strbuf_end;    /* Current buffer sentinel (points to the final nul). */
+    char* strbuf_ptr;    /* Current insertion point in buffer. */
+} yyextra_t;
+
 /* Build and accumulate an error on the builder object. */
-void build_lexer_error(const char* string, size_t length);
+void build_lexer_error(void* scanner, const char* string, size_t length);
 
 /* Build and accumulate an error on the builder object using the current
  * exception state. */
-void build_lexer_error_from_exception(void);
+void build_lexer_error_from_exception(void* scanner);
 
 /* Callback call site with error handling. */
-#define BUILD_LEX(method_name, format, ...)                                             \
-    yylval->pyobj = PyObject_CallMethod(builder, method_name, format, __VA_ARGS__);     \
-    /* Handle a Python exception raised by the handler {3cfb2739349a} */                \
-    if (yylval->pyobj == NULL) {                                                        \
-       build_lexer_error_from_exception();                                              \
-       return LEX_ERROR;                                                                \
+#define BUILD_LEX(method, format, ...)                                                  \
+    if (yyextra->skip_values) {                                                         \
+        yylval->pyobj = NULL;                                                           \
+    }                                                                                   \
+    else {                                                                              \
+        yylval->pyobj = CALL_BUILDER(&yyextra->dispatch, yyextra->builder,              \
+                                     method, format, __VA_ARGS__);                      \
+        /* Handle a Python exception raised by the handler {3cfb2739349a} */            \
+        if (yylval->pyobj == NULL) {                                                    \
+            build_lexer_error_from_exception(yyscanner);                                \
+            return LEX_ERROR;                                                           \
+        }                                                                               \
+        /* Lexer builder methods should never return None, check for it. */             \
+        else if (yylval->pyobj == Py_None) {                                            \
+            Py_DECREF(Py_None);                                                         \
+            build_lexer_error(yyscanner, "Unexpected None result from lexer", 34);      \
+            return LEX_ERROR;                                                           \
+        }                                                                               \
+    }
+
+/* Callback call site for tokens with interned values: the builder is only called
+ * the first time a particular token text is seen. */
+#define BUILD_LEX_INTERNED(table, method, string, length)                               \
+    if (yyextra->skip_values) {                                                         \
+        yylval->pyobj = NULL;                                                           \
+    }                                                                                   \
+    else if ((yylval->pyobj = intern_lookup(&yyextra->table, string, length)) != NULL) { \
+        Py_INCREF(yylval->pyobj);                                                       \
     }                                                                                   \
-    /* Lexer builder methods should never return None, check for it. */                 \
-    else if (yylval->pyobj == Py_None) {                                                \
-        Py_DECREF(Py_None);                                                             \
-        build_lexer_error("Unexpected None result from lexer", 34);                     \
-        return LEX_ERROR;                                                               \
+    else {                                                                              \
+        BUILD_LEX(method, "s#", string, (Py_ssize_t)(length));                          \
+        intern_insert(&yyextra->table, string, length, yylval->pyobj);                  \
     }
 
 /* Initialization/finalization methods. These are separate from the yylex_init()
- * and yylex_destroy() and they call them. */
-void yylex_initialize(const char* filename, const char* encoding);
-void yylex_finalize(void);
-
-/* Global declarations; defined below. */
-extern int yy_eof_times;
-extern const char* yy_filename;
-extern int yycolumn;
-extern const char* yy_encoding;
-
-/* String buffer statics. */
-extern size_t strbuf_size; /* Current buffer size (not including final nul). */
-extern char* strbuf;       /* Current buffer head. */
-extern char* strbuf_end;   /* Current buffer sentinel (points to the final nul). */
-extern char* strbuf_ptr;   /* Current insertion point in buffer. */
-void strbuf_realloc(size_t num_new_chars);
-
-/* Handle detecting the beginning of line. */
-extern int yy_line_tokens; /* Number of tokens since the bol. */
+ * and yylex_destroy() and they call them. yylex_initialize() returns a new
+ * scanner, or NULL (with a Python exception set) on failure. */
+void* yylex_initialize(PyObject* builder, const char* filename,
+                       const char* encoding, int firstline);
+void yylex_finalize(void* scanner);
+
+/* Reallocate the string buffer to accomodate some new characters. */
+void strbuf_realloc(yyextra_t* extra, size_t num_new_chars);
+
+/* Read the input from a file as flex does by default, but without holding the
+ * GIL while waiting for it. Returns the number of bytes read, or -1 on error. */
+int yy_read_input(yyextra_t* extra, FILE* fp, char* buf, size_t max_size);
+
+#define YY_INPUT(buf, result, max_size)                                 \
+    if ( ((result) = yy_read_input(yyextra, yyin, (buf), (max_size))) < 0 ) { \
+        YY_FATAL_ERROR("input in flex scanner failed");                 \
+    }
 
+/* Handle detecting the beginning of line, and track the offset of the
+ * beginning of the tokens. The rules continuing a string literal are part of
+ * the token started by its opening quote. */
 #define YY_USER_ACTION  {                               \
-    yy_line_tokens++;                                   \
+    yyextra->line_tokens++;                             \
     yylloc->first_line = yylloc->last_line = yylineno;  \
     yylloc->first_column = yycolumn;                    \
     yylloc->last_column = yycolumn+yyleng-1;            \
+    if ( YY_START != STRLIT ) {                         \
+        yyextra->token_offset = yyextra->offset;        \
+    }                                                   \
+    yyextra->offset += yyleng;                          \
     yycolumn += yyleng;                                 \
   }
 
-/* Skip the rest of the input line. */
-int yy_skip_line(void);
+/* Skip the rest of the input line, up to its newline. Returns the number of
+ * characters skipped. */
+int yy_skip_line(void* scanner);
+
+/* Consume a string literal from the input buffer, decoding its escape sequences
+ * if it has any. */
+const char* yy_consume_string_literal(void* scanner, size_t* length);
 
 /* Utility functions. */
 int strtonl(const char* buf, size_t nchars);
 
-/* Append characters to the static string buffer and verify. */
-#define SAFE_COPY_CHAR(value)                    \
-	if (strbuf_ptr >= strbuf_end) {         \
-            strbuf_realloc(1);                  \
-	}                                       \
-        *strbuf_ptr++ = value;
+/* Return true if the builder's method of the given name is the default one from
+ * LexBuilder, which means that the lexer may handle the token natively. */
+int is_default_lex_method(PyObject* builder, const char* method_name);
+
+/* Build a Decimal instance from the text of a NUMBER token. */
+PyObject* build_number(const char* text, size_t length);
+
+/* Build a datetime.date instance, as LexBuilder.DATE() does. */
+PyObject* build_date(int year, int month, int day);
+
+/* Warn about a string with too many lines, as LexBuilder.STRING() does. */
+void check_string_lines(void* scanner, const char* contents, size_t length);
 
-#line 75 "beancount/parser/lexer.c"
+/* Append characters to the string buffer and verify. */
+#define SAFE_COPY_CHAR(value)                                   \
+	if (yyextra->strbuf_ptr >= yyextra->strbuf_end) {       \
+            strbuf_realloc(yyextra, 1);                         \
+	}                                                       \
+        *yyextra->strbuf_ptr++ = value;
+
+#line 247 "beancount/parser/lexer.c"
 
 #define  YY_INT_ALIGNED short int
 
@@ -206,21 +378,38 @@ typedef unsigned int flex_uint32_t;
  */
 #define YY_SC_TO_UI(c) ((YY_CHAR) (c))
 
+/* An opaque pointer. */
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
+/* For convenience, these vars (plus the bison vars far below)
+   are macros in the reentrant scanner. */
+#define yyin yyg->yyin_r
+#define yyout yyg->yyout_r
+#define yyextra yyg->yyextra_r
+#define yyleng yyg->yyleng_r
+#define yytext yyg->yytext_r
+#define yylineno (YY_CURRENT_BUFFER_LVALUE->yy_bs_lineno)
+#define yycolumn (YY_CURRENT_BUFFER_LVALUE->yy_bs_column)
+#define yy_flex_debug yyg->yy_flex_debug_r
+
 /* Enter a start condition.  This macro really ought to take a parameter,
  * but we do it the disgusting crufty way forced on us by the ()-less
  * definition of BEGIN.
  */
-#define BEGIN (yy_start) = 1 + 2 *
+#define BEGIN yyg->yy_start = 1 + 2 *
 /* Translate the current start state into a value that can be later handed
  * to BEGIN to return to the state.  The YYSTATE alias is for lex
  * compatibility.
  */
-#define YY_START (((yy_start) - 1) / 2)
+#define YY_START ((yyg->yy_start - 1) / 2)
 #define YYSTATE YY_START
 /* Action number for EOF rule of a given start state. */
 #define YY_STATE_EOF(state) (YY_END_OF_BUFFER + state + 1)
 /* Special action meaning "start processing a new file". */
-#define YY_NEW_FILE yyrestart( yyin  )
+#define YY_NEW_FILE yyrestart( yyin , yyscanner )
 #define YY_END_OF_BUFFER_CHAR 0
 
 /* Size of default input buffer. */
@@ -250,10 +439,6 @@ typedef struct yy_buffer_state *YY_BUFFER_STATE;
 typedef size_t yy_size_t;
 #endif
 
-extern int yyleng;
-
-extern FILE *yyin, *yyout;
-
 #define EOB_ACT_CONTINUE_SCAN 0
 #define EOB_ACT_END_OF_FILE 1
 #define EOB_ACT_LAST_MATCH 2
@@ -287,13 +472,13 @@ extern FILE *yyin, *yyout;
 		/* Undo effects of setting up yytext. */ \
         int yyless_macro_arg = (n); \
         YY_LESS_LINENO(yyless_macro_arg);\
-		*yy_cp = (yy_hold_char); \
+		*yy_cp = yyg->yy_hold_char; \
 		YY_RESTORE_YY_MORE_OFFSET \
-		(yy_c_buf_p) = yy_cp = yy_bp + yyless_macro_arg - YY_MORE_ADJ; \
+		yyg->yy_c_buf_p = yy_cp = yy_bp + yyless_macro_arg - YY_MORE_ADJ; \
 		YY_DO_BEFORE_ACTION; /* set up yytext again */ \
 		} \
 	while ( 0 )
-#define unput(c) yyunput( c, (yytext_ptr)  )
+#define unput(c) yyunput( c, yyg->yytext_ptr , yyscanner )
 
 #ifndef YY_STRUCT_YY_BUFFER_STATE
 #define YY_STRUCT_YY_BUFFER_STATE
@@ -360,77 +545,57 @@ struct yy_buffer_state
 	};
 #endif /* !YY_STRUCT_YY_BUFFER_STATE */
 
-/* Stack of input buffers. */
-static size_t yy_buffer_stack_top = 0; /**< index of top of stack. */
-static size_t yy_buffer_stack_max = 0; /**< capacity of stack. */
-static YY_BUFFER_STATE * yy_buffer_stack = NULL; /**< Stack as an array. */
-
 /* We provide macros for accessing buffer states in case in the
  * future we want to put the buffer states in a more general
  * "scanner state".
  *
  * Returns the top of the stack, or NULL.
  */
-#define YY_CURRENT_BUFFER ( (yy_buffer_stack) \
-                          ? (yy_buffer_stack)[(yy_buffer_stack_top)] \
+#define YY_CURRENT_BUFFER ( yyg->yy_buffer_stack \
+                          ? yyg->yy_buffer_stack[yyg->yy_buffer_stack_top] \
                           : NULL)
 /* Same as previous macro, but useful when we know that the buffer stack is not
  * NULL or when we need an lvalue. For internal use only.
  */
-#define YY_CURRENT_BUFFER_LVALUE (yy_buffer_stack)[(yy_buffer_stack_top)]
-
-/* yy_hold_char holds the character lost when yytext is formed. */
-static char yy_hold_char;
-static int yy_n_chars;		/* number of characters read into yy_ch_buf */
-int yyleng;
-
-/* Points to current character in buffer. */
-static char *yy_c_buf_p = NULL;
-static int yy_init = 0;		/* whether we need to initialize */
-static int yy_start = 0;	/* start state number */
-
-/* Flag which is used to allow yywrap()'s to do buffer switches
- * instead of setting up a fresh yyin.  A bit of a hack ...
- */
-static int yy_did_buffer_switch_on_eof;
+#define YY_CURRENT_BUFFER_LVALUE yyg->yy_buffer_stack[yyg->yy_buffer_stack_top]
 
-void yyrestart ( FILE *input_file  );
-void yy_switch_to_buffer ( YY_BUFFER_STATE new_buffer  );
-YY_BUFFER_STATE yy_create_buffer ( FILE *file, int size  );
-void yy_delete_buffer ( YY_BUFFER_STATE b  );
-void yy_flush_buffer ( YY_BUFFER_STATE b  );
-void yypush_buffer_state ( YY_BUFFER_STATE new_buffer  );
-void yypop_buffer_state ( void );
+void yyrestart ( FILE *input_file , yyscan_t yyscanner );
+void yy_switch_to_buffer ( YY_BUFFER_STATE new_buffer , yyscan_t yyscanner );
+YY_BUFFER_STATE yy_create_buffer ( FILE *file, int size , yyscan_t yyscanner );
+void yy_delete_buffer ( YY_BUFFER_STATE b , yyscan_t yyscanner );
+void yy_flush_buffer ( YY_BUFFER_STATE b , yyscan_t yyscanner );
+void yypush_buffer_state ( YY_BUFFER_STATE new_buffer , yyscan_t yyscanner );
+void yypop_buffer_state ( yyscan_t yyscanner );
 
-static void yyensure_buffer_stack ( void );
-static void yy_load_buffer_state ( void );
-static void yy_init_buffer ( YY_BUFFER_STATE b, FILE *file  );
-#define YY_FLUSH_BUFFER yy_flush_buffer( YY_CURRENT_BUFFER )
+static void yyensure_buffer_stack ( yyscan_t yyscanner );
+static void yy_load_buffer_state ( yyscan_t yyscanner );
+static void yy_init_buffer ( YY_BUFFER_STATE b, FILE *file , yyscan_t yyscanner );
+#define YY_FLUSH_BUFFER yy_flush_buffer( YY_CURRENT_BUFFER , yyscanner)
 
-YY_BUFFER_STATE yy_scan_buffer ( char *base, yy_size_t size  );
-YY_BUFFER_STATE yy_scan_string ( const char *yy_str  );
-YY_BUFFER_STATE yy_scan_bytes ( const char *bytes, int len  );
+YY_BUFFER_STATE yy_scan_buffer ( char *base, yy_size_t size , yyscan_t yyscanner );
+YY_BUFFER_STATE yy_scan_string ( const char *yy_str , yyscan_t yyscanner );
+YY_BUFFER_STATE yy_scan_bytes ( const char *bytes, int len , yyscan_t yyscanner );
 
-void *yyalloc ( yy_size_t  );
-void *yyrealloc ( void *, yy_size_t  );
-void yyfree ( void *  );
+void *yyalloc ( yy_size_t , yyscan_t yyscanner );
+void *yyrealloc ( void *, yy_size_t , yyscan_t yyscanner );
+void yyfree ( void * , yyscan_t yyscanner );
 
 #define yy_new_buffer yy_create_buffer
 #define yy_set_interactive(is_interactive) \
 	{ \
 	if ( ! YY_CURRENT_BUFFER ){ \
-        yyensure_buffer_stack (); \
+        yyensure_buffer_stack (yyscanner); \
 		YY_CURRENT_BUFFER_LVALUE =    \
-            yy_create_buffer( yyin, YY_BUF_SIZE ); \
+            yy_create_buffer( yyin, YY_BUF_SIZE , yyscanner); \
 	} \
 	YY_CURRENT_BUFFER_LVALUE->yy_is_interactive = is_interactive; \
 	}
 #define yy_set_bol(at_bol) \
 	{ \
 	if ( ! YY_CURRENT_BUFFER ){\
-        yyensure_buffer_stack (); \
+        yyensure_buffer_stack (yyscanner); \
 		YY_CURRENT_BUFFER_LVALUE =    \
-            yy_create_buffer( yyin, YY_BUF_SIZE ); \
+            yy_create_buffer( yyin, YY_BUF_SIZE , yyscanner); \
 	} \
 	YY_CURRENT_BUFFER_LVALUE->yy_at_bol = at_bol; \
 	}
@@ -438,37 +603,28 @@ void yyfree ( void *  );
 
 /* Begin user sect3 */
 
-#define yywrap() (/*CONSTCOND*/1)
+#define yywrap(yyscanner) (/*CONSTCOND*/1)
 #define YY_SKIP_YYWRAP
 typedef flex_uint8_t YY_CHAR;
 
-FILE *yyin = NULL, *yyout = NULL;
-
 typedef int yy_state_type;
 
-extern int yylineno;
-int yylineno = 1;
-
-extern char *yytext;
-#ifdef yytext_ptr
-#undef yytext_ptr
-#endif
-#define yytext_ptr yytext
+#define yytext_ptr yytext_r
 
-static yy_state_type yy_get_previous_state ( void );
-static yy_state_type yy_try_NUL_trans ( yy_state_type current_state  );
-static int yy_get_next_buffer ( void );
-static void yynoreturn yy_fatal_error ( const char* msg  );
+static yy_state_type yy_get_previous_state ( yyscan_t yyscanner );
+static yy_state_type yy_try_NUL_trans ( yy_state_type current_state  , yyscan_t yyscanner);
+static int yy_get_next_buffer ( yyscan_t yyscanner );
+static void yynoreturn yy_fatal_error ( const char* msg , yyscan_t yyscanner );
 
 /* Done after the current pattern has been matched and before the
  * corresponding action - sets up yytext.
  */
 #define YY_DO_BEFORE_ACTION \
-	(yytext_ptr) = yy_bp; \
+	yyg->yytext_ptr = yy_bp; \
 	yyleng = (int) (yy_cp - yy_bp); \
-	(yy_hold_char) = *yy_cp; \
+	yyg->yy_hold_char = *yy_cp; \
 	*yy_cp = '\0'; \
-	(yy_c_buf_p) = yy_cp;
+	yyg->yy_c_buf_p = yy_cp;
 #define YY_NUM_RULES 62
 #define YY_END_OF_BUFFER 63
 /* This struct is not used in this scanner,
@@ -1022,12 +1178,6 @@ static const flex_int32_t yy_rule_can_match_eol[63] =
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 
     0, 0, 0,     };
 
-static yy_state_type yy_last_accepting_state;
-static char *yy_last_accepting_cpos;
-
-extern int yy_flex_debug;
-int yy_flex_debug = 0;
-
 /* The intent behind this definition is that it'll catch
  * any uses of REJECT which flex missed.
  */
@@ -1035,7 +1185,6 @@ int yy_flex_debug = 0;
 #define yymore() yymore_used_but_not_detected
 #define YY_MORE_ADJ 0
 #define YY_RESTORE_YY_MORE_OFFSET
-char *yytext;
 #line 1 "beancount/parser/lexer.l"
 /* -*- mode: c -*- */
 /* A flex lexer for Beancount. */
@@ -1043,7 +1192,6 @@ char *yytext;
 /* Definitions */
 /* Options */
 /* %option nodefault */
-/* %option reentrant */
 /* %option debug */
 /* %option stack */
 /* %option 8bit */
@@ -1055,7 +1203,7 @@ char *yytext;
 
 /*--------------------------------------------------------------------------------------*/
 /* Rules */
-#line 1059 "beancount/parser/lexer.c"
+#line 1207 "beancount/parser/lexer.c"
 
 #define INITIAL 0
 #define INVALID 1
@@ -1069,48 +1217,102 @@ char *yytext;
 #include <unistd.h>
 #endif
 
+#define YY_EXTRA_TYPE yyextra_t*
+
 #ifndef YY_EXTRA_TYPE
 #define YY_EXTRA_TYPE void *
 #endif
 
-static int yy_init_globals ( void );
+/* Holds the entire state of the reentrant scanner. */
+struct yyguts_t
+    {
+
+    /* User-defined. Not touched by flex. */
+    YY_EXTRA_TYPE yyextra_r;
+
+    /* The rest are the same as the globals declared in the non-reentrant scanner. */
+    FILE *yyin_r, *yyout_r;
+    size_t yy_buffer_stack_top; /**< index of top of stack. */
+    size_t yy_buffer_stack_max; /**< capacity of stack. */
+    YY_BUFFER_STATE * yy_buffer_stack; /**< Stack as an array. */
+    char yy_hold_char;
+    int yy_n_chars;
+    int yyleng_r;
+    char *yy_c_buf_p;
+    int yy_init;
+    int yy_start;
+    int yy_did_buffer_switch_on_eof;
+    int yy_start_stack_ptr;
+    int yy_start_stack_depth;
+    int *yy_start_stack;
+    yy_state_type yy_last_accepting_state;
+    char* yy_last_accepting_cpos;
+
+    int yylineno_r;
+    int yy_flex_debug_r;
+
+    char *yytext_r;
+    int yy_more_flag;
+    int yy_more_len;
+
+    YYSTYPE * yylval_r;
+
+    YYLTYPE * yylloc_r;
+
+    }; /* end struct yyguts_t */
+
+static int yy_init_globals ( yyscan_t yyscanner );
+
+    /* This must go here because YYSTYPE and YYLTYPE are included
+     * from bison output in section 1.*/
+    #    define yylval yyg->yylval_r
+    
+    #    define yylloc yyg->yylloc_r
+    
+int yylex_init (yyscan_t* scanner);
+
+int yylex_init_extra ( YY_EXTRA_TYPE user_defined, yyscan_t* scanner);
 
 /* Accessor methods to globals.
    These are made visible to non-reentrant scanners for convenience. */
 
-int yylex_destroy ( void );
+int yylex_destroy ( yyscan_t yyscanner );
+
+int yyget_debug ( yyscan_t yyscanner );
+
+void yyset_debug ( int debug_flag , yyscan_t yyscanner );
 
-int yyget_debug ( void );
+YY_EXTRA_TYPE yyget_extra ( yyscan_t yyscanner );
 
-void yyset_debug ( int debug_flag  );
+void yyset_extra ( YY_EXTRA_TYPE user_defined , yyscan_t yyscanner );
 
-YY_EXTRA_TYPE yyget_extra ( void );
+FILE *yyget_in ( yyscan_t yyscanner );
 
-void yyset_extra ( YY_EXTRA_TYPE user_defined  );
+void yyset_in  ( FILE * _in_str , yyscan_t yyscanner );
 
-FILE *yyget_in ( void );
+FILE *yyget_out ( yyscan_t yyscanner );
 
-void yyset_in  ( FILE * _in_str  );
+void yyset_out  ( FILE * _out_str , yyscan_t yyscanner );
 
-FILE *yyget_out ( void );
+			int yyget_leng ( yyscan_t yyscanner );
 
-void yyset_out  ( FILE * _out_str  );
+char *yyget_text ( yyscan_t yyscanner );
 
-			int yyget_leng ( void );
+int yyget_lineno ( yyscan_t yyscanner );
 
-char *yyget_text ( void );
+void yyset_lineno ( int _line_number , yyscan_t yyscanner );
 
-int yyget_lineno ( void );
+int yyget_column  ( yyscan_t yyscanner );
 
-void yyset_lineno ( int _line_number  );
+void yyset_column ( int _column_no , yyscan_t yyscanner );
 
-YYSTYPE * yyget_lval ( void );
+YYSTYPE * yyget_lval ( yyscan_t yyscanner );
 
-void yyset_lval ( YYSTYPE * yylval_param  );
+void yyset_lval ( YYSTYPE * yylval_param , yyscan_t yyscanner );
 
-       YYLTYPE *yyget_lloc ( void );
+       YYLTYPE *yyget_lloc ( yyscan_t yyscanner );
     
-        void yyset_lloc ( YYLTYPE * yylloc_param  );
+        void yyset_lloc ( YYLTYPE * yylloc_param , yyscan_t yyscanner );
     
 /* Macros after this point can all be overridden by user definitions in
  * section 1.
@@ -1118,31 +1320,31 @@ void yyset_lval ( YYSTYPE * yylval_param  );
 
 #ifndef YY_SKIP_YYWRAP
 #ifdef __cplusplus
-extern "C" int yywrap ( void );
+extern "C" int yywrap ( yyscan_t yyscanner );
 #else
-extern int yywrap ( void );
+extern int yywrap ( yyscan_t yyscanner );
 #endif
 #endif
 
 #ifndef YY_NO_UNPUT
     
-    static void yyunput ( int c, char *buf_ptr  );
+    static void yyunput ( int c, char *buf_ptr  , yyscan_t yyscanner);
     
 #endif
 
 #ifndef yytext_ptr
-static void yy_flex_strncpy ( char *, const char *, int );
+static void yy_flex_strncpy ( char *, const char *, int , yyscan_t yyscanner);
 #endif
 
 #ifdef YY_NEED_STRLEN
-static int yy_flex_strlen ( const char * );
+static int yy_flex_strlen ( const char * , yyscan_t yyscanner);
 #endif
 
 #ifndef YY_NO_INPUT
 #ifdef __cplusplus
-static int yyinput ( void );
+static int yyinput ( yyscan_t yyscanner );
 #else
-static int input ( void );
+static int input ( yyscan_t yyscanner );
 #endif
 
 #endif
@@ -1216,7 +1418,7 @@ static int input ( void );
 
 /* Report a fatal error. */
 #ifndef YY_FATAL_ERROR
-#define YY_FATAL_ERROR(msg) yy_fatal_error( msg )
+#define YY_FATAL_ERROR(msg) yy_fatal_error( msg , yyscanner)
 #endif
 
 /* end tables serialization structures and prototypes */
@@ -1228,10 +1430,10 @@ static int input ( void );
 #define YY_DECL_IS_OURS 1
 
 extern int yylex \
-               (YYSTYPE * yylval_param, YYLTYPE * yylloc_param );
+               (YYSTYPE * yylval_param, YYLTYPE * yylloc_param , yyscan_t yyscanner);
 
 #define YY_DECL int yylex \
-               (YYSTYPE * yylval_param, YYLTYPE * yylloc_param )
+               (YYSTYPE * yylval_param, YYLTYPE * yylloc_param , yyscan_t yyscanner)
 #endif /* !YY_DECL */
 
 /* Code executed at the beginning of each rule, after yytext and yyleng
@@ -1256,25 +1458,22 @@ YY_DECL
 	yy_state_type yy_current_state;
 	char *yy_cp, *yy_bp;
 	int yy_act;
-    
-        YYSTYPE * yylval;
-    
-        YYLTYPE * yylloc;
-    
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
     yylval = yylval_param;
 
     yylloc = yylloc_param;
 
-	if ( !(yy_init) )
+	if ( !yyg->yy_init )
 		{
-		(yy_init) = 1;
+		yyg->yy_init = 1;
 
 #ifdef YY_USER_INIT
 		YY_USER_INIT;
 #endif
 
-		if ( ! (yy_start) )
-			(yy_start) = 1;	/* first start state */
+		if ( ! yyg->yy_start )
+			yyg->yy_start = 1;	/* first start state */
 
 		if ( ! yyin )
 			yyin = stdin;
@@ -1283,44 +1482,44 @@ YY_DECL
 			yyout = stdout;
 
 		if ( ! YY_CURRENT_BUFFER ) {
-			yyensure_buffer_stack ();
+			yyensure_buffer_stack (yyscanner);
 			YY_CURRENT_BUFFER_LVALUE =
-				yy_create_buffer( yyin, YY_BUF_SIZE );
+				yy_create_buffer( yyin, YY_BUF_SIZE , yyscanner);
 		}
 
-		yy_load_buffer_state(  );
+		yy_load_buffer_state( yyscanner );
 		}
 
 	{
-#line 128 "beancount/parser/lexer.l"
+#line 306 "beancount/parser/lexer.l"
 
 
 
-#line 132 "beancount/parser/lexer.l"
+#line 310 "beancount/parser/lexer.l"
  /* Newlines are output as explicit tokens, because lines matter in the syntax. */
-#line 1302 "beancount/parser/lexer.c"
+#line 1501 "beancount/parser/lexer.c"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
-		yy_cp = (yy_c_buf_p);
+		yy_cp = yyg->yy_c_buf_p;
 
 		/* Support of yytext. */
-		*yy_cp = (yy_hold_char);
+		*yy_cp = yyg->yy_hold_char;
 
 		/* yy_bp points to the position in yy_ch_buf of the start of
 		 * the current run.
 		 */
 		yy_bp = yy_cp;
 
-		yy_current_state = (yy_start);
+		yy_current_state = yyg->yy_start;
 yy_match:
 		do
 			{
 			YY_CHAR yy_c = yy_ec[YY_SC_TO_UI(*yy_cp)] ;
 			if ( yy_accept[yy_current_state] )
 				{
-				(yy_last_accepting_state) = yy_current_state;
-				(yy_last_accepting_cpos) = yy_cp;
+				yyg->yy_last_accepting_state = yy_current_state;
+				yyg->yy_last_accepting_cpos = yy_cp;
 				}
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
@@ -1332,8 +1531,8 @@ yy_match:
 			++yy_cp;
 			}
 		while ( yy_current_state != 347 );
-		yy_cp = (yy_last_accepting_cpos);
-		yy_current_state = (yy_last_accepting_state);
+		yy_cp = yyg->yy_last_accepting_cpos;
+		yy_current_state = yyg->yy_last_accepting_state;
 
 yy_find_action:
 		yy_act = yy_accept[yy_current_state];
@@ -1346,7 +1545,9 @@ yy_find_action:
 			for ( yyl = 0; yyl < yyleng; ++yyl )
 				if ( yytext[yyl] == '\n' )
 					
-    yylineno++;
+    do{ yylineno++;
+        yycolumn=0;
+    }while(0)
 ;
 			}
 
@@ -1356,17 +1557,17 @@ do_action:	/* This label is used only to access EOF actions. */
 	{ /* beginning of action switch */
 			case 0: /* must back up */
 			/* undo the effects of YY_DO_BEFORE_ACTION */
-			*yy_cp = (yy_hold_char);
-			yy_cp = (yy_last_accepting_cpos);
-			yy_current_state = (yy_last_accepting_state);
+			*yy_cp = yyg->yy_hold_char;
+			yy_cp = yyg->yy_last_accepting_cpos;
+			yy_current_state = yyg->yy_last_accepting_state;
 			goto yy_find_action;
 
 case 1:
 /* rule 1 can match eol */
 YY_RULE_SETUP
-#line 133 "beancount/parser/lexer.l"
+#line 311 "beancount/parser/lexer.l"
 {
-    yy_line_tokens = 0;
+    yyextra->line_tokens = 0;
     yycolumn = 1;
     return EOL;
 }
@@ -1377,13 +1578,13 @@ YY_RULE_SETUP
     the grammar. */
 case 2:
 YY_RULE_SETUP
-#line 143 "beancount/parser/lexer.l"
+#line 321 "beancount/parser/lexer.l"
 {
-    if ( yy_line_tokens == 1 ) {
+    if ( yyextra->line_tokens == 1 ) {
         /* If the next character completes the line, skip it. */
-        if ( yy_hold_char == '\n' ||
-             yy_hold_char == '\r' ||
-             yy_hold_char == '\0' ) {
+        if ( yyg->yy_hold_char == '\n' ||
+             yyg->yy_hold_char == '\r' ||
+             yyg->yy_hold_char == '\0' ) {
             return SKIPPED;
         }
         else {
@@ -1395,114 +1596,114 @@ YY_RULE_SETUP
 /* Characters with special meanings have their own tokens. */
 case 3:
 YY_RULE_SETUP
-#line 158 "beancount/parser/lexer.l"
+#line 336 "beancount/parser/lexer.l"
 { return PIPE; }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 159 "beancount/parser/lexer.l"
+#line 337 "beancount/parser/lexer.l"
 { return ATAT; }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 160 "beancount/parser/lexer.l"
+#line 338 "beancount/parser/lexer.l"
 { return AT; }
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 161 "beancount/parser/lexer.l"
+#line 339 "beancount/parser/lexer.l"
 { return LCURLCURL; }
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 162 "beancount/parser/lexer.l"
+#line 340 "beancount/parser/lexer.l"
 { return RCURLCURL; }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 163 "beancount/parser/lexer.l"
+#line 341 "beancount/parser/lexer.l"
 { return LCURL; }
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 164 "beancount/parser/lexer.l"
+#line 342 "beancount/parser/lexer.l"
 { return RCURL; }
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 165 "beancount/parser/lexer.l"
+#line 343 "beancount/parser/lexer.l"
 { return COMMA; }
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 166 "beancount/parser/lexer.l"
+#line 344 "beancount/parser/lexer.l"
 { return TILDE; }
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 167 "beancount/parser/lexer.l"
+#line 345 "beancount/parser/lexer.l"
 { return PLUS; }
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 168 "beancount/parser/lexer.l"
+#line 346 "beancount/parser/lexer.l"
 { return MINUS; }
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 169 "beancount/parser/lexer.l"
+#line 347 "beancount/parser/lexer.l"
 { return SLASH; }
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 170 "beancount/parser/lexer.l"
+#line 348 "beancount/parser/lexer.l"
 { return LPAREN; }
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 171 "beancount/parser/lexer.l"
+#line 349 "beancount/parser/lexer.l"
 { return RPAREN; }
 	YY_BREAK
 /* Special handling for characters beginning a line to be ignored.
   * I'd like to improve how this is handled. Needs own lexer, really. */
 case 17:
 YY_RULE_SETUP
-#line 175 "beancount/parser/lexer.l"
+#line 353 "beancount/parser/lexer.l"
 {
-    if ( yy_line_tokens != 1 ) {
+    if ( yyextra->line_tokens != 1 ) {
         return HASH;
     }
     else {
         /* Allow org-mode titles. */
-        yy_skip_line();
+        yy_skip_line(yyscanner);
         return SKIPPED;
     }
 }
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 186 "beancount/parser/lexer.l"
+#line 364 "beancount/parser/lexer.l"
 {
-    if ( yy_line_tokens != 1 ) {
+    if ( yyextra->line_tokens != 1 ) {
         return ASTERISK;
     }
     else {
         /* Allow org-mode titles. */
-        yy_skip_line();
+        yy_skip_line(yyscanner);
         return SKIPPED;
     }
 }
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 197 "beancount/parser/lexer.l"
+#line 375 "beancount/parser/lexer.l"
 {
-  if (yy_line_tokens != 1) {
+  if (yyextra->line_tokens != 1) {
     return COLON;
   }
   else {
     /* Allow org-mode drawers. */
-    yy_skip_line();
+    yy_skip_line(yyscanner);
     return SKIPPED;
   }
 }
@@ -1510,7 +1711,7 @@ YY_RULE_SETUP
 /* Skip commented output (but not the accompanying newline). */
 case 20:
 YY_RULE_SETUP
-#line 209 "beancount/parser/lexer.l"
+#line 387 "beancount/parser/lexer.l"
 {
     /* yy_skip_line(); */
     return COMMENT;
@@ -1526,14 +1727,14 @@ YY_RULE_SETUP
     */
 case 21:
 YY_RULE_SETUP
-#line 222 "beancount/parser/lexer.l"
+#line 400 "beancount/parser/lexer.l"
 {
-    if ( yy_line_tokens != 1 ) {
+    if ( yyextra->line_tokens != 1 ) {
         yylval->character = yytext[0];
         return FLAG;
     }
     else {
-        yy_skip_line();
+        yy_skip_line(yyscanner);
         return SKIPPED;
     }
 }
@@ -1541,131 +1742,131 @@ YY_RULE_SETUP
 /* Keywords. */
 case 22:
 YY_RULE_SETUP
-#line 234 "beancount/parser/lexer.l"
+#line 412 "beancount/parser/lexer.l"
 { return TXN; }
 	YY_BREAK
 case 23:
 YY_RULE_SETUP
-#line 235 "beancount/parser/lexer.l"
+#line 413 "beancount/parser/lexer.l"
 { return BALANCE; }
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
-#line 236 "beancount/parser/lexer.l"
+#line 414 "beancount/parser/lexer.l"
 { return OPEN; }
 	YY_BREAK
 case 25:
 YY_RULE_SETUP
-#line 237 "beancount/parser/lexer.l"
+#line 415 "beancount/parser/lexer.l"
 { return CLOSE; }
 	YY_BREAK
 case 26:
 YY_RULE_SETUP
-#line 238 "beancount/parser/lexer.l"
+#line 416 "beancount/parser/lexer.l"
 { return COMMODITY; }
 	YY_BREAK
 case 27:
 YY_RULE_SETUP
-#line 239 "beancount/parser/lexer.l"
+#line 417 "beancount/parser/lexer.l"
 { return PAD; }
 	YY_BREAK
 case 28:
 YY_RULE_SETUP
-#line 240 "beancount/parser/lexer.l"
+#line 418 "beancount/parser/lexer.l"
 { return EVENT; }
 	YY_BREAK
 case 29:
 YY_RULE_SETUP
-#line 241 "beancount/parser/lexer.l"
+#line 419 "beancount/parser/lexer.l"
 { return QUERY; }
 	YY_BREAK
 case 30:
 YY_RULE_SETUP
-#line 242 "beancount/parser/lexer.l"
+#line 420 "beancount/parser/lexer.l"
 { return CUSTOM; }
 	YY_BREAK
 case 31:
 YY_RULE_SETUP
-#line 243 "beancount/parser/lexer.l"
+#line 421 "beancount/parser/lexer.l"
 { return PRICE; }
 	YY_BREAK
 case 32:
 YY_RULE_SETUP
-#line 244 "beancount/parser/lexer.l"
+#line 422 "beancount/parser/lexer.l"
 { return NOTE; }
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
-#line 245 "beancount/parser/lexer.l"
+#line 423 "beancount/parser/lexer.l"
 { return DOCUMENT; }
 	YY_BREAK
 case 34:
 YY_RULE_SETUP
-#line 246 "beancount/parser/lexer.l"
+#line 424 "beancount/parser/lexer.l"
 { return PUSHTAG; }
 	YY_BREAK
 case 35:
 YY_RULE_SETUP
-#line 247 "beancount/parser/lexer.l"
+#line 425 "beancount/parser/lexer.l"
 { return POPTAG; }
 	YY_BREAK
 case 36:
 YY_RULE_SETUP
-#line 248 "beancount/parser/lexer.l"
+#line 426 "beancount/parser/lexer.l"
 { return PUSHMETA; }
 	YY_BREAK
 case 37:
 YY_RULE_SETUP
-#line 249 "beancount/parser/lexer.l"
+#line 427 "beancount/parser/lexer.l"
 { return POPMETA; }
 	YY_BREAK
 case 38:
 YY_RULE_SETUP
-#line 250 "beancount/parser/lexer.l"
+#line 428 "beancount/parser/lexer.l"
 { return OPTION; }
 	YY_BREAK
 case 39:
 YY_RULE_SETUP
-#line 251 "beancount/parser/lexer.l"
+#line 429 "beancount/parser/lexer.l"
 { return PLUGIN; }
 	YY_BREAK
 case 40:
 YY_RULE_SETUP
-#line 252 "beancount/parser/lexer.l"
+#line 430 "beancount/parser/lexer.l"
 { return INCLUDE; }
 	YY_BREAK
 /* Boolean values. */
 case 41:
 YY_RULE_SETUP
-#line 255 "beancount/parser/lexer.l"
+#line 433 "beancount/parser/lexer.l"
 {
-    yylval->pyobj = Py_True;
-    Py_INCREF(Py_True);
+    yylval->pyobj = yyextra->skip_values ? NULL : Py_True;
+    Py_XINCREF(yylval->pyobj);
     return BOOL;
 }
 	YY_BREAK
 case 42:
 YY_RULE_SETUP
-#line 261 "beancount/parser/lexer.l"
+#line 439 "beancount/parser/lexer.l"
 {
-    yylval->pyobj = Py_False;
-    Py_INCREF(Py_False);
+    yylval->pyobj = yyextra->skip_values ? NULL : Py_False;
+    Py_XINCREF(yylval->pyobj);
     return BOOL;
 }
 	YY_BREAK
 case 43:
 YY_RULE_SETUP
-#line 267 "beancount/parser/lexer.l"
+#line 445 "beancount/parser/lexer.l"
 {
-    yylval->pyobj = Py_None;
-    Py_INCREF(Py_None);
+    yylval->pyobj = yyextra->skip_values ? NULL : Py_None;
+    Py_XINCREF(yylval->pyobj);
     return NONE;
 }
 	YY_BREAK
 /* Dates. */
 case 44:
 YY_RULE_SETUP
-#line 274 "beancount/parser/lexer.l"
+#line 452 "beancount/parser/lexer.l"
 {
     const char* year_str;
     const char* month_str;
@@ -1682,17 +1883,32 @@ YY_RULE_SETUP
     day_str++;
     day = strtonl(day_str, yytext + yyleng - day_str);
 
-    /* Attempt to create the date. */
-    BUILD_LEX("DATE", "iii", year, month, day);
+    /* Reuse the date if it was seen before. Otherwise, attempt to create it,
+     * natively if the builder's method is the default one. */
+    if ( !yyextra->skip_values && yyextra->dates.enabled ) {
+        yylval->pyobj = intern_lookup(&yyextra->dates, yytext, yyleng);
+        if ( yylval->pyobj != NULL ) {
+            Py_INCREF(yylval->pyobj);
+            return DATE;
+        }
+        yylval->pyobj = build_date(year, month, day);
+        if ( yylval->pyobj == NULL ) {
+            build_lexer_error_from_exception(yyscanner);
+            return LEX_ERROR;
+        }
+        intern_insert(&yyextra->dates, yytext, yyleng, yylval->pyobj);
+        return DATE;
+    }
+    BUILD_LEX(DATE, "iii", year, month, day);
     return DATE;
 }
 	YY_BREAK
 /* Account names. */
 case 45:
 YY_RULE_SETUP
-#line 296 "beancount/parser/lexer.l"
+#line 489 "beancount/parser/lexer.l"
 {
-    BUILD_LEX("ACCOUNT", "s", yytext);
+    BUILD_LEX_INTERNED(accounts, ACCOUNT, yytext, yyleng);
     return ACCOUNT;
 }
 	YY_BREAK
@@ -1700,9 +1916,9 @@ YY_RULE_SETUP
   * syntax. This is kept in sync with beancount.core.amount.CURRENCY_RE. */
 case 46:
 YY_RULE_SETUP
-#line 303 "beancount/parser/lexer.l"
+#line 496 "beancount/parser/lexer.l"
 {
-    BUILD_LEX("CURRENCY", "s", yytext);
+    BUILD_LEX_INTERNED(currencies, CURRENCY, yytext, yyleng);
     return CURRENCY;
 }
 	YY_BREAK
@@ -1711,9 +1927,37 @@ YY_RULE_SETUP
     See section "Start Conditions" in the GNU Flex manual. */
 case 47:
 YY_RULE_SETUP
-#line 311 "beancount/parser/lexer.l"
-{
-    strbuf_ptr = strbuf;
+#line 504 "beancount/parser/lexer.l"
+{
+    /* Decode literals directly from the input buffer, if they are entirely
+     * contained in it. */
+    size_t length;
+    const char* contents = yy_consume_string_literal(yyscanner, &length);
+    if ( contents != NULL ) {
+        yylloc->first_line = yylloc->last_line = yylineno;
+        if ( yyextra->skip_values ) {
+            yylval->pyobj = NULL;
+            return STRING;
+        }
+        PyObject* unicode_str = PyUnicode_Decode(contents, length,
+                                                 yyextra->encoding, "ignore");
+        if ( unicode_str == NULL ) {
+            build_lexer_error_from_exception(yyscanner);
+            yylval->pyobj = Py_None;
+            Py_INCREF(Py_None);
+            return LEX_ERROR;
+        }
+        if ( yyextra->native_string ) {
+            yylval->pyobj = unicode_str;
+            check_string_lines(yyscanner, contents, length);
+            return STRING;
+        }
+        BUILD_LEX(STRING, "O", unicode_str);
+        Py_DECREF(unicode_str);
+        return STRING;
+    }
+
+    yyextra->strbuf_ptr = yyextra->strbuf;
     BEGIN(STRLIT);
 }
 	YY_BREAK
@@ -1721,115 +1965,140 @@ YY_RULE_SETUP
 /* Saw closing quote - all done. */
 case 48:
 YY_RULE_SETUP
-#line 319 "beancount/parser/lexer.l"
+#line 540 "beancount/parser/lexer.l"
 {
         BEGIN(INITIAL);
-        *strbuf_ptr = '\0';
-        PyObject* unicode_str = PyUnicode_Decode(strbuf, strbuf_ptr - strbuf,
-                                                 yy_encoding, "ignore");
+        *yyextra->strbuf_ptr = '\0';
+        if ( yyextra->skip_values ) {
+            yylval->pyobj = NULL;
+            yyextra->strbuf_ptr = NULL;
+            return STRING;
+        }
+        PyObject* unicode_str = PyUnicode_Decode(yyextra->strbuf,
+                                                 yyextra->strbuf_ptr - yyextra->strbuf,
+                                                 yyextra->encoding, "ignore");
         if ( unicode_str == NULL ) {
-            build_lexer_error_from_exception();
+            build_lexer_error_from_exception(yyscanner);
             yylval->pyobj = Py_None;
             Py_INCREF(Py_None);
             return LEX_ERROR;
         }
-        BUILD_LEX("STRING", "O", unicode_str);
+        if ( yyextra->native_string ) {
+            yylval->pyobj = unicode_str;
+            check_string_lines(yyscanner, yyextra->strbuf,
+                               yyextra->strbuf_ptr - yyextra->strbuf);
+            yyextra->strbuf_ptr = NULL;
+            return STRING;
+        }
+        BUILD_LEX(STRING, "O", unicode_str);
         Py_DECREF(unicode_str);
-        strbuf_ptr = NULL;
+        yyextra->strbuf_ptr = NULL;
         return STRING;
     }
 	YY_BREAK
 /* Escape sequences. */
 case 49:
 YY_RULE_SETUP
-#line 337 "beancount/parser/lexer.l"
+#line 571 "beancount/parser/lexer.l"
 SAFE_COPY_CHAR('\n');
 	YY_BREAK
 case 50:
 YY_RULE_SETUP
-#line 338 "beancount/parser/lexer.l"
+#line 572 "beancount/parser/lexer.l"
 SAFE_COPY_CHAR('\t');
 	YY_BREAK
 case 51:
 YY_RULE_SETUP
-#line 339 "beancount/parser/lexer.l"
+#line 573 "beancount/parser/lexer.l"
 SAFE_COPY_CHAR('\r');
 	YY_BREAK
 case 52:
 YY_RULE_SETUP
-#line 340 "beancount/parser/lexer.l"
+#line 574 "beancount/parser/lexer.l"
 SAFE_COPY_CHAR('\b');
 	YY_BREAK
 case 53:
 YY_RULE_SETUP
-#line 341 "beancount/parser/lexer.l"
+#line 575 "beancount/parser/lexer.l"
 SAFE_COPY_CHAR('\f');
 	YY_BREAK
 case 54:
 /* rule 54 can match eol */
 YY_RULE_SETUP
-#line 342 "beancount/parser/lexer.l"
+#line 576 "beancount/parser/lexer.l"
 SAFE_COPY_CHAR(yytext[1]);
 	YY_BREAK
 /* All other characters. */
 case 55:
 /* rule 55 can match eol */
 YY_RULE_SETUP
-#line 345 "beancount/parser/lexer.l"
+#line 579 "beancount/parser/lexer.l"
 {
-        if ( yyleng > (strbuf_end - strbuf_ptr) ) {
-            strbuf_realloc(yyleng);
-        }
-        ssize_t i;
-        for (i = 0; i < yyleng; ++i) {
-            *strbuf_ptr++ = yytext[i];
+        if ( yyleng > (yyextra->strbuf_end - yyextra->strbuf_ptr) ) {
+            strbuf_realloc(yyextra, yyleng);
         }
+        memcpy(yyextra->strbuf_ptr, yytext, yyleng);
+        yyextra->strbuf_ptr += yyleng;
     }
 	YY_BREAK
 
 /* Numbers */
 case 56:
 YY_RULE_SETUP
-#line 357 "beancount/parser/lexer.l"
-{
-    BUILD_LEX("NUMBER", "s", yytext);
+#line 589 "beancount/parser/lexer.l"
+{
+    /* Convert valid numbers directly; leave it to the builder to report
+     * invalid ones. */
+    if ( yyextra->native_number && !yyextra->skip_values ) {
+        yylval->pyobj = build_number(yytext, yyleng);
+        if ( yylval->pyobj != NULL ) {
+            return NUMBER;
+        }
+        if ( PyErr_Occurred() ) {
+            build_lexer_error_from_exception(yyscanner);
+            return LEX_ERROR;
+        }
+    }
+    BUILD_LEX(NUMBER, "s", yytext);
     return NUMBER;
 }
 	YY_BREAK
 /* Tags */
 case 57:
 YY_RULE_SETUP
-#line 363 "beancount/parser/lexer.l"
+#line 607 "beancount/parser/lexer.l"
 {
-    BUILD_LEX("TAG", "s", &(yytext[1]));
+    BUILD_LEX_INTERNED(tags, TAG, &(yytext[1]), yyleng-1);
     return TAG;
 }
 	YY_BREAK
 /* Links */
 case 58:
 YY_RULE_SETUP
-#line 369 "beancount/parser/lexer.l"
+#line 613 "beancount/parser/lexer.l"
 {
-    BUILD_LEX("LINK", "s", &(yytext[1]));
+    BUILD_LEX_INTERNED(links, LINK, &(yytext[1]), yyleng-1);
     return LINK;
 }
 	YY_BREAK
 /* Key */
 case 59:
 YY_RULE_SETUP
-#line 375 "beancount/parser/lexer.l"
+#line 619 "beancount/parser/lexer.l"
 {
-    BUILD_LEX("KEY", "s#", yytext, (Py_ssize_t)(yyleng-1));
+    BUILD_LEX_INTERNED(keys, KEY, yytext, yyleng-1);
     unput(':');
+    yyextra->offset--;
     return KEY;
 }
 	YY_BREAK
 /* Default rule. {bf253a29a820} */
 case 60:
 YY_RULE_SETUP
-#line 382 "beancount/parser/lexer.l"
+#line 627 "beancount/parser/lexer.l"
 {
     unput(*yytext);
+    yyextra->offset--;
     BEGIN(INVALID);
 }
 	YY_BREAK
@@ -1838,11 +2107,12 @@ YY_RULE_SETUP
 case YY_STATE_EOF(INITIAL):
 case YY_STATE_EOF(INVALID):
 case YY_STATE_EOF(STRLIT):
-#line 389 "beancount/parser/lexer.l"
+#line 635 "beancount/parser/lexer.l"
 {
-  if ( yy_eof_times == 0 ) {
-    yy_eof_times = 1;
+  if ( yyextra->eof_times == 0 ) {
+    yyextra->eof_times = 1;
     yylloc->first_line = yylineno;
+    yyextra->token_offset = yyextra->offset;
     return EOL;
   }
   return 0;
@@ -1854,29 +2124,29 @@ case YY_STATE_EOF(STRLIT):
     this and more. {bba169a1d35a} */
 case 61:
 YY_RULE_SETUP
-#line 402 "beancount/parser/lexer.l"
+#line 649 "beancount/parser/lexer.l"
 {
     char buffer[256];
     size_t length = snprintf(buffer, 256, "Invalid token: '%s'", yytext);
-    build_lexer_error(buffer, length);
+    build_lexer_error(yyscanner, buffer, length);
     BEGIN(INITIAL);
     return LEX_ERROR;
 }
 	YY_BREAK
 case 62:
 YY_RULE_SETUP
-#line 411 "beancount/parser/lexer.l"
+#line 658 "beancount/parser/lexer.l"
 ECHO;
 	YY_BREAK
-#line 1872 "beancount/parser/lexer.c"
+#line 2142 "beancount/parser/lexer.c"
 
 	case YY_END_OF_BUFFER:
 		{
 		/* Amount of text matched not including the EOB char. */
-		int yy_amount_of_matched_text = (int) (yy_cp - (yytext_ptr)) - 1;
+		int yy_amount_of_matched_text = (int) (yy_cp - yyg->yytext_ptr) - 1;
 
 		/* Undo the effects of YY_DO_BEFORE_ACTION. */
-		*yy_cp = (yy_hold_char);
+		*yy_cp = yyg->yy_hold_char;
 		YY_RESTORE_YY_MORE_OFFSET
 
 		if ( YY_CURRENT_BUFFER_LVALUE->yy_buffer_status == YY_BUFFER_NEW )
@@ -1890,7 +2160,7 @@ ECHO;
 			 * this is the first action (other than possibly a
 			 * back-up) that will match for the new input source.
 			 */
-			(yy_n_chars) = YY_CURRENT_BUFFER_LVALUE->yy_n_chars;
+			yyg->yy_n_chars = YY_CURRENT_BUFFER_LVALUE->yy_n_chars;
 			YY_CURRENT_BUFFER_LVALUE->yy_input_file = yyin;
 			YY_CURRENT_BUFFER_LVALUE->yy_buffer_status = YY_BUFFER_NORMAL;
 			}
@@ -1902,13 +2172,13 @@ ECHO;
 		 * end-of-buffer state).  Contrast this with the test
 		 * in input().
 		 */
-		if ( (yy_c_buf_p) <= &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[(yy_n_chars)] )
+		if ( yyg->yy_c_buf_p <= &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[yyg->yy_n_chars] )
 			{ /* This was really a NUL. */
 			yy_state_type yy_next_state;
 
-			(yy_c_buf_p) = (yytext_ptr) + yy_amount_of_matched_text;
+			yyg->yy_c_buf_p = yyg->yytext_ptr + yy_amount_of_matched_text;
 
-			yy_current_state = yy_get_previous_state(  );
+			yy_current_state = yy_get_previous_state( yyscanner );
 
 			/* Okay, we're now positioned to make the NUL
 			 * transition.  We couldn't have
@@ -1919,33 +2189,33 @@ ECHO;
 			 * will run more slowly).
 			 */
 
-			yy_next_state = yy_try_NUL_trans( yy_current_state );
+			yy_next_state = yy_try_NUL_trans( yy_current_state , yyscanner);
 
-			yy_bp = (yytext_ptr) + YY_MORE_ADJ;
+			yy_bp = yyg->yytext_ptr + YY_MORE_ADJ;
 
 			if ( yy_next_state )
 				{
 				/* Consume the NUL. */
-				yy_cp = ++(yy_c_buf_p);
+				yy_cp = ++yyg->yy_c_buf_p;
 				yy_current_state = yy_next_state;
 				goto yy_match;
 				}
 
 			else
 				{
-				yy_cp = (yy_last_accepting_cpos);
-				yy_current_state = (yy_last_accepting_state);
+				yy_cp = yyg->yy_last_accepting_cpos;
+				yy_current_state = yyg->yy_last_accepting_state;
 				goto yy_find_action;
 				}
 			}
 
-		else switch ( yy_get_next_buffer(  ) )
+		else switch ( yy_get_next_buffer( yyscanner ) )
 			{
 			case EOB_ACT_END_OF_FILE:
 				{
-				(yy_did_buffer_switch_on_eof) = 0;
+				yyg->yy_did_buffer_switch_on_eof = 0;
 
-				if ( yywrap(  ) )
+				if ( yywrap( yyscanner ) )
 					{
 					/* Note: because we've taken care in
 					 * yy_get_next_buffer() to have set up
@@ -1956,7 +2226,7 @@ ECHO;
 					 * YY_NULL, it'll still work - another
 					 * YY_NULL will get returned.
 					 */
-					(yy_c_buf_p) = (yytext_ptr) + YY_MORE_ADJ;
+					yyg->yy_c_buf_p = yyg->yytext_ptr + YY_MORE_ADJ;
 
 					yy_act = YY_STATE_EOF(YY_START);
 					goto do_action;
@@ -1964,30 +2234,30 @@ ECHO;
 
 				else
 					{
-					if ( ! (yy_did_buffer_switch_on_eof) )
+					if ( ! yyg->yy_did_buffer_switch_on_eof )
 						YY_NEW_FILE;
 					}
 				break;
 				}
 
 			case EOB_ACT_CONTINUE_SCAN:
-				(yy_c_buf_p) =
-					(yytext_ptr) + yy_amount_of_matched_text;
+				yyg->yy_c_buf_p =
+					yyg->yytext_ptr + yy_amount_of_matched_text;
 
-				yy_current_state = yy_get_previous_state(  );
+				yy_current_state = yy_get_previous_state( yyscanner );
 
-				yy_cp = (yy_c_buf_p);
-				yy_bp = (yytext_ptr) + YY_MORE_ADJ;
+				yy_cp = yyg->yy_c_buf_p;
+				yy_bp = yyg->yytext_ptr + YY_MORE_ADJ;
 				goto yy_match;
 
 			case EOB_ACT_LAST_MATCH:
-				(yy_c_buf_p) =
-				&YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[(yy_n_chars)];
+				yyg->yy_c_buf_p =
+				&YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[yyg->yy_n_chars];
 
-				yy_current_state = yy_get_previous_state(  );
+				yy_current_state = yy_get_previous_state( yyscanner );
 
-				yy_cp = (yy_c_buf_p);
-				yy_bp = (yytext_ptr) + YY_MORE_ADJ;
+				yy_cp = yyg->yy_c_buf_p;
+				yy_bp = yyg->yytext_ptr + YY_MORE_ADJ;
 				goto yy_find_action;
 			}
 		break;
@@ -2008,20 +2278,21 @@ ECHO;
  *	EOB_ACT_CONTINUE_SCAN - continue scanning from current position
  *	EOB_ACT_END_OF_FILE - end of file
  */
-static int yy_get_next_buffer (void)
+static int yy_get_next_buffer (yyscan_t yyscanner)
 {
-    	char *dest = YY_CURRENT_BUFFER_LVALUE->yy_ch_buf;
-	char *source = (yytext_ptr);
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	char *dest = YY_CURRENT_BUFFER_LVALUE->yy_ch_buf;
+	char *source = yyg->yytext_ptr;
 	int number_to_move, i;
 	int ret_val;
 
-	if ( (yy_c_buf_p) > &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[(yy_n_chars) + 1] )
+	if ( yyg->yy_c_buf_p > &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[yyg->yy_n_chars + 1] )
 		YY_FATAL_ERROR(
 		"fatal flex scanner internal error--end of buffer missed" );
 
 	if ( YY_CURRENT_BUFFER_LVALUE->yy_fill_buffer == 0 )
 		{ /* Don't try to fill the buffer, so this is an EOF. */
-		if ( (yy_c_buf_p) - (yytext_ptr) - YY_MORE_ADJ == 1 )
+		if ( yyg->yy_c_buf_p - yyg->yytext_ptr - YY_MORE_ADJ == 1 )
 			{
 			/* We matched a single character, the EOB, so
 			 * treat this as a final EOF.
@@ -2041,7 +2312,7 @@ static int yy_get_next_buffer (void)
 	/* Try to read more data. */
 
 	/* First move last chars to start of buffer. */
-	number_to_move = (int) ((yy_c_buf_p) - (yytext_ptr) - 1);
+	number_to_move = (int) (yyg->yy_c_buf_p - yyg->yytext_ptr - 1);
 
 	for ( i = 0; i < number_to_move; ++i )
 		*(dest++) = *(source++);
@@ -2050,7 +2321,7 @@ static int yy_get_next_buffer (void)
 		/* don't do the read, it's not guaranteed to return an EOF,
 		 * just force an EOF
 		 */
-		YY_CURRENT_BUFFER_LVALUE->yy_n_chars = (yy_n_chars) = 0;
+		YY_CURRENT_BUFFER_LVALUE->yy_n_chars = yyg->yy_n_chars = 0;
 
 	else
 		{
@@ -2064,7 +2335,7 @@ static int yy_get_next_buffer (void)
 			YY_BUFFER_STATE b = YY_CURRENT_BUFFER_LVALUE;
 
 			int yy_c_buf_p_offset =
-				(int) ((yy_c_buf_p) - b->yy_ch_buf);
+				(int) (yyg->yy_c_buf_p - b->yy_ch_buf);
 
 			if ( b->yy_is_our_buffer )
 				{
@@ -2078,7 +2349,7 @@ static int yy_get_next_buffer (void)
 				b->yy_ch_buf = (char *)
 					/* Include room in for 2 EOB chars. */
 					yyrealloc( (void *) b->yy_ch_buf,
-							 (yy_size_t) (b->yy_buf_size + 2)  );
+							 (yy_size_t) (b->yy_buf_size + 2) , yyscanner );
 				}
 			else
 				/* Can't grow it, we don't own it. */
@@ -2088,7 +2359,7 @@ static int yy_get_next_buffer (void)
 				YY_FATAL_ERROR(
 				"fatal error - scanner input buffer overflow" );
 
-			(yy_c_buf_p) = &b->yy_ch_buf[yy_c_buf_p_offset];
+			yyg->yy_c_buf_p = &b->yy_ch_buf[yy_c_buf_p_offset];
 
 			num_to_read = YY_CURRENT_BUFFER_LVALUE->yy_buf_size -
 						number_to_move - 1;
@@ -2100,17 +2371,17 @@ static int yy_get_next_buffer (void)
 
 		/* Read in more data. */
 		YY_INPUT( (&YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[number_to_move]),
-			(yy_n_chars), num_to_read );
+			yyg->yy_n_chars, num_to_read );
 
-		YY_CURRENT_BUFFER_LVALUE->yy_n_chars = (yy_n_chars);
+		YY_CURRENT_BUFFER_LVALUE->yy_n_chars = yyg->yy_n_chars;
 		}
 
-	if ( (yy_n_chars) == 0 )
+	if ( yyg->yy_n_chars == 0 )
 		{
 		if ( number_to_move == YY_MORE_ADJ )
 			{
 			ret_val = EOB_ACT_END_OF_FILE;
-			yyrestart( yyin  );
+			yyrestart( yyin  , yyscanner);
 			}
 
 		else
@@ -2124,42 +2395,42 @@ static int yy_get_next_buffer (void)
 	else
 		ret_val = EOB_ACT_CONTINUE_SCAN;
 
-	if (((yy_n_chars) + number_to_move) > YY_CURRENT_BUFFER_LVALUE->yy_buf_size) {
+	if ((yyg->yy_n_chars + number_to_move) > YY_CURRENT_BUFFER_LVALUE->yy_buf_size) {
 		/* Extend the array by 50%, plus the number we really need. */
-		int new_size = (yy_n_chars) + number_to_move + ((yy_n_chars) >> 1);
+		int new_size = yyg->yy_n_chars + number_to_move + (yyg->yy_n_chars >> 1);
 		YY_CURRENT_BUFFER_LVALUE->yy_ch_buf = (char *) yyrealloc(
-			(void *) YY_CURRENT_BUFFER_LVALUE->yy_ch_buf, (yy_size_t) new_size  );
+			(void *) YY_CURRENT_BUFFER_LVALUE->yy_ch_buf, (yy_size_t) new_size , yyscanner );
 		if ( ! YY_CURRENT_BUFFER_LVALUE->yy_ch_buf )
 			YY_FATAL_ERROR( "out of dynamic memory in yy_get_next_buffer()" );
 		/* "- 2" to take care of EOB's */
 		YY_CURRENT_BUFFER_LVALUE->yy_buf_size = (int) (new_size - 2);
 	}
 
-	(yy_n_chars) += number_to_move;
-	YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[(yy_n_chars)] = YY_END_OF_BUFFER_CHAR;
-	YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[(yy_n_chars) + 1] = YY_END_OF_BUFFER_CHAR;
+	yyg->yy_n_chars += number_to_move;
+	YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[yyg->yy_n_chars] = YY_END_OF_BUFFER_CHAR;
+	YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[yyg->yy_n_chars + 1] = YY_END_OF_BUFFER_CHAR;
 
-	(yytext_ptr) = &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[0];
+	yyg->yytext_ptr = &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[0];
 
 	return ret_val;
 }
 
 /* yy_get_previous_state - get the state just before the EOB char was reached */
 
-    static yy_state_type yy_get_previous_state (void)
+    static yy_state_type yy_get_previous_state (yyscan_t yyscanner)
 {
 	yy_state_type yy_current_state;
 	char *yy_cp;
-    
-	yy_current_state = (yy_start);
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	yy_current_state = yyg->yy_start;
 
-	for ( yy_cp = (yytext_ptr) + YY_MORE_ADJ; yy_cp < (yy_c_buf_p); ++yy_cp )
+	for ( yy_cp = yyg->yytext_ptr + YY_MORE_ADJ; yy_cp < yyg->yy_c_buf_p; ++yy_cp )
 		{
 		YY_CHAR yy_c = (*yy_cp ? yy_ec[YY_SC_TO_UI(*yy_cp)] : 1);
 		if ( yy_accept[yy_current_state] )
 			{
-			(yy_last_accepting_state) = yy_current_state;
-			(yy_last_accepting_cpos) = yy_cp;
+			yyg->yy_last_accepting_state = yy_current_state;
+			yyg->yy_last_accepting_cpos = yy_cp;
 			}
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
@@ -2178,16 +2449,17 @@ static int yy_get_next_buffer (void)
  * synopsis
  *	next_state = yy_try_NUL_trans( current_state );
  */
-    static yy_state_type yy_try_NUL_trans  (yy_state_type yy_current_state )
+    static yy_state_type yy_try_NUL_trans  (yy_state_type yy_current_state , yyscan_t yyscanner)
 {
 	int yy_is_jam;
-    	char *yy_cp = (yy_c_buf_p);
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner; /* This var may be unused depending upon options. */
+	char *yy_cp = yyg->yy_c_buf_p;
 
 	YY_CHAR yy_c = 1;
 	if ( yy_accept[yy_current_state] )
 		{
-		(yy_last_accepting_state) = yy_current_state;
-		(yy_last_accepting_cpos) = yy_cp;
+		yyg->yy_last_accepting_state = yy_current_state;
+		yyg->yy_last_accepting_cpos = yy_cp;
 		}
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
@@ -2198,24 +2470,26 @@ static int yy_get_next_buffer (void)
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + yy_c];
 	yy_is_jam = (yy_current_state == 347);
 
-		return yy_is_jam ? 0 : yy_current_state;
+	(void)yyg;
+	return yy_is_jam ? 0 : yy_current_state;
 }
 
 #ifndef YY_NO_UNPUT
 
-    static void yyunput (int c, char * yy_bp )
+    static void yyunput (int c, char * yy_bp , yyscan_t yyscanner)
 {
 	char *yy_cp;
-    
-    yy_cp = (yy_c_buf_p);
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
+    yy_cp = yyg->yy_c_buf_p;
 
 	/* undo effects of setting up yytext */
-	*yy_cp = (yy_hold_char);
+	*yy_cp = yyg->yy_hold_char;
 
 	if ( yy_cp < YY_CURRENT_BUFFER_LVALUE->yy_ch_buf + 2 )
 		{ /* need to shift things up to make room */
 		/* +2 for EOB chars. */
-		int number_to_move = (yy_n_chars) + 2;
+		int number_to_move = yyg->yy_n_chars + 2;
 		char *dest = &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[
 					YY_CURRENT_BUFFER_LVALUE->yy_buf_size + 2];
 		char *source =
@@ -2227,7 +2501,7 @@ static int yy_get_next_buffer (void)
 		yy_cp += (int) (dest - source);
 		yy_bp += (int) (dest - source);
 		YY_CURRENT_BUFFER_LVALUE->yy_n_chars =
-			(yy_n_chars) = (int) YY_CURRENT_BUFFER_LVALUE->yy_buf_size;
+			yyg->yy_n_chars = (int) YY_CURRENT_BUFFER_LVALUE->yy_buf_size;
 
 		if ( yy_cp < YY_CURRENT_BUFFER_LVALUE->yy_ch_buf + 2 )
 			YY_FATAL_ERROR( "flex scanner push-back overflow" );
@@ -2239,41 +2513,42 @@ static int yy_get_next_buffer (void)
         --yylineno;
     }
 
-	(yytext_ptr) = yy_bp;
-	(yy_hold_char) = *yy_cp;
-	(yy_c_buf_p) = yy_cp;
+	yyg->yytext_ptr = yy_bp;
+	yyg->yy_hold_char = *yy_cp;
+	yyg->yy_c_buf_p = yy_cp;
 }
 
 #endif
 
 #ifndef YY_NO_INPUT
 #ifdef __cplusplus
-    static int yyinput (void)
+    static int yyinput (yyscan_t yyscanner)
 #else
-    static int input  (void)
+    static int input  (yyscan_t yyscanner)
 #endif
 
 {
 	int c;
-    
-	*(yy_c_buf_p) = (yy_hold_char);
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
+	*yyg->yy_c_buf_p = yyg->yy_hold_char;
 
-	if ( *(yy_c_buf_p) == YY_END_OF_BUFFER_CHAR )
+	if ( *yyg->yy_c_buf_p == YY_END_OF_BUFFER_CHAR )
 		{
 		/* yy_c_buf_p now points to the character we want to return.
 		 * If this occurs *before* the EOB characters, then it's a
 		 * valid NUL; if not, then we've hit the end of the buffer.
 		 */
-		if ( (yy_c_buf_p) < &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[(yy_n_chars)] )
+		if ( yyg->yy_c_buf_p < &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[yyg->yy_n_chars] )
 			/* This was really a NUL. */
-			*(yy_c_buf_p) = '\0';
+			*yyg->yy_c_buf_p = '\0';
 
 		else
 			{ /* need more input */
-			int offset = (int) ((yy_c_buf_p) - (yytext_ptr));
-			++(yy_c_buf_p);
+			int offset = (int) (yyg->yy_c_buf_p - yyg->yytext_ptr);
+			++yyg->yy_c_buf_p;
 
-			switch ( yy_get_next_buffer(  ) )
+			switch ( yy_get_next_buffer( yyscanner ) )
 				{
 				case EOB_ACT_LAST_MATCH:
 					/* This happens because yy_g_n_b()
@@ -2287,38 +2562,40 @@ static int yy_get_next_buffer (void)
 					 */
 
 					/* Reset buffer status. */
-					yyrestart( yyin );
+					yyrestart( yyin , yyscanner);
 
 					/*FALLTHROUGH*/
 
 				case EOB_ACT_END_OF_FILE:
 					{
-					if ( yywrap(  ) )
+					if ( yywrap( yyscanner ) )
 						return 0;
 
-					if ( ! (yy_did_buffer_switch_on_eof) )
+					if ( ! yyg->yy_did_buffer_switch_on_eof )
 						YY_NEW_FILE;
 #ifdef __cplusplus
-					return yyinput();
+					return yyinput(yyscanner);
 #else
-					return input();
+					return input(yyscanner);
 #endif
 					}
 
 				case EOB_ACT_CONTINUE_SCAN:
-					(yy_c_buf_p) = (yytext_ptr) + offset;
+					yyg->yy_c_buf_p = yyg->yytext_ptr + offset;
 					break;
 				}
 			}
 		}
 
-	c = *(unsigned char *) (yy_c_buf_p);	/* cast for 8-bit char's */
-	*(yy_c_buf_p) = '\0';	/* preserve yytext */
-	(yy_hold_char) = *++(yy_c_buf_p);
+	c = *(unsigned char *) yyg->yy_c_buf_p;	/* cast for 8-bit char's */
+	*yyg->yy_c_buf_p = '\0';	/* preserve yytext */
+	yyg->yy_hold_char = *++yyg->yy_c_buf_p;
 
 	if ( c == '\n' )
 		
-    yylineno++;
+    do{ yylineno++;
+        yycolumn=0;
+    }while(0)
 ;
 
 	return c;
@@ -2330,60 +2607,63 @@ static int yy_get_next_buffer (void)
  * 
  * @note This function does not reset the start condition to @c INITIAL .
  */
-    void yyrestart  (FILE * input_file )
+    void yyrestart  (FILE * input_file , yyscan_t yyscanner)
 {
-    
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
 	if ( ! YY_CURRENT_BUFFER ){
-        yyensure_buffer_stack ();
+        yyensure_buffer_stack (yyscanner);
 		YY_CURRENT_BUFFER_LVALUE =
-            yy_create_buffer( yyin, YY_BUF_SIZE );
+            yy_create_buffer( yyin, YY_BUF_SIZE , yyscanner);
 	}
 
-	yy_init_buffer( YY_CURRENT_BUFFER, input_file );
-	yy_load_buffer_state(  );
+	yy_init_buffer( YY_CURRENT_BUFFER, input_file , yyscanner);
+	yy_load_buffer_state( yyscanner );
 }
 
 /** Switch to a different input buffer.
  * @param new_buffer The new input buffer.
  * 
  */
-    void yy_switch_to_buffer  (YY_BUFFER_STATE  new_buffer )
+    void yy_switch_to_buffer  (YY_BUFFER_STATE  new_buffer , yyscan_t yyscanner)
 {
-    
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
 	/* TODO. We should be able to replace this entire function body
 	 * with
 	 *		yypop_buffer_state();
 	 *		yypush_buffer_state(new_buffer);
      */
-	yyensure_buffer_stack ();
+	yyensure_buffer_stack (yyscanner);
 	if ( YY_CURRENT_BUFFER == new_buffer )
 		return;
 
 	if ( YY_CURRENT_BUFFER )
 		{
 		/* Flush out information for old buffer. */
-		*(yy_c_buf_p) = (yy_hold_char);
-		YY_CURRENT_BUFFER_LVALUE->yy_buf_pos = (yy_c_buf_p);
-		YY_CURRENT_BUFFER_LVALUE->yy_n_chars = (yy_n_chars);
+		*yyg->yy_c_buf_p = yyg->yy_hold_char;
+		YY_CURRENT_BUFFER_LVALUE->yy_buf_pos = yyg->yy_c_buf_p;
+		YY_CURRENT_BUFFER_LVALUE->yy_n_chars = yyg->yy_n_chars;
 		}
 
 	YY_CURRENT_BUFFER_LVALUE = new_buffer;
-	yy_load_buffer_state(  );
+	yy_load_buffer_state( yyscanner );
 
 	/* We don't actually know whether we did this switch during
 	 * EOF (yywrap()) processing, but the only time this flag
 	 * is looked at is after yywrap() is called, so it's safe
 	 * to go ahead and always set it.
 	 */
-	(yy_did_buffer_switch_on_eof) = 1;
+	yyg->yy_did_buffer_switch_on_eof = 1;
 }
 
-static void yy_load_buffer_state  (void)
+static void yy_load_buffer_state  (yyscan_t yyscanner)
 {
-    	(yy_n_chars) = YY_CURRENT_BUFFER_LVALUE->yy_n_chars;
-	(yytext_ptr) = (yy_c_buf_p) = YY_CURRENT_BUFFER_LVALUE->yy_buf_pos;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	yyg->yy_n_chars = YY_CURRENT_BUFFER_LVALUE->yy_n_chars;
+	yyg->yytext_ptr = yyg->yy_c_buf_p = YY_CURRENT_BUFFER_LVALUE->yy_buf_pos;
 	yyin = YY_CURRENT_BUFFER_LVALUE->yy_input_file;
-	(yy_hold_char) = *(yy_c_buf_p);
+	yyg->yy_hold_char = *yyg->yy_c_buf_p;
 }
 
 /** Allocate and initialize an input buffer state.
@@ -2392,11 +2672,11 @@ static void yy_load_buffer_state  (void)
  * 
  * @return the allocated buffer state.
  */
-    YY_BUFFER_STATE yy_create_buffer  (FILE * file, int  size )
+    YY_BUFFER_STATE yy_create_buffer  (FILE * file, int  size , yyscan_t yyscanner)
 {
 	YY_BUFFER_STATE b;
     
-	b = (YY_BUFFER_STATE) yyalloc( sizeof( struct yy_buffer_state )  );
+	b = (YY_BUFFER_STATE) yyalloc( sizeof( struct yy_buffer_state ) , yyscanner );
 	if ( ! b )
 		YY_FATAL_ERROR( "out of dynamic memory in yy_create_buffer()" );
 
@@ -2405,13 +2685,13 @@ static void yy_load_buffer_state  (void)
 	/* yy_ch_buf has to be 2 characters longer than the size given because
 	 * we need to put in 2 end-of-buffer characters.
 	 */
-	b->yy_ch_buf = (char *) yyalloc( (yy_size_t) (b->yy_buf_size + 2)  );
+	b->yy_ch_buf = (char *) yyalloc( (yy_size_t) (b->yy_buf_size + 2) , yyscanner );
 	if ( ! b->yy_ch_buf )
 		YY_FATAL_ERROR( "out of dynamic memory in yy_create_buffer()" );
 
 	b->yy_is_our_buffer = 1;
 
-	yy_init_buffer( b, file );
+	yy_init_buffer( b, file , yyscanner);
 
 	return b;
 }
@@ -2420,9 +2700,10 @@ static void yy_load_buffer_state  (void)
  * @param b a buffer created with yy_create_buffer()
  * 
  */
-    void yy_delete_buffer (YY_BUFFER_STATE  b )
+    void yy_delete_buffer (YY_BUFFER_STATE  b , yyscan_t yyscanner)
 {
-    
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
 	if ( ! b )
 		return;
 
@@ -2430,21 +2711,22 @@ static void yy_load_buffer_state  (void)
 		YY_CURRENT_BUFFER_LVALUE = (YY_BUFFER_STATE) 0;
 
 	if ( b->yy_is_our_buffer )
-		yyfree( (void *) b->yy_ch_buf  );
+		yyfree( (void *) b->yy_ch_buf , yyscanner );
 
-	yyfree( (void *) b  );
+	yyfree( (void *) b , yyscanner );
 }
 
 /* Initializes or reinitializes a buffer.
  * This function is sometimes called more than once on the same buffer,
  * such as during a yyrestart() or at EOF.
  */
-    static void yy_init_buffer  (YY_BUFFER_STATE  b, FILE * file )
+    static void yy_init_buffer  (YY_BUFFER_STATE  b, FILE * file , yyscan_t yyscanner)
 
 {
 	int oerrno = errno;
-    
-	yy_flush_buffer( b );
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
+	yy_flush_buffer( b , yyscanner);
 
 	b->yy_input_file = file;
 	b->yy_fill_buffer = 1;
@@ -2467,9 +2749,10 @@ static void yy_load_buffer_state  (void)
  * @param b the buffer state to be flushed, usually @c YY_CURRENT_BUFFER.
  * 
  */
-    void yy_flush_buffer (YY_BUFFER_STATE  b )
+    void yy_flush_buffer (YY_BUFFER_STATE  b , yyscan_t yyscanner)
 {
-    	if ( ! b )
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	if ( ! b )
 		return;
 
 	b->yy_n_chars = 0;
@@ -2487,7 +2770,7 @@ static void yy_load_buffer_state  (void)
 	b->yy_buffer_status = YY_BUFFER_NEW;
 
 	if ( b == YY_CURRENT_BUFFER )
-		yy_load_buffer_state(  );
+		yy_load_buffer_state( yyscanner );
 }
 
 /** Pushes the new state onto the stack. The new state becomes
@@ -2496,95 +2779,98 @@ static void yy_load_buffer_state  (void)
  *  @param new_buffer The new state.
  *  
  */
-void yypush_buffer_state (YY_BUFFER_STATE new_buffer )
+void yypush_buffer_state (YY_BUFFER_STATE new_buffer , yyscan_t yyscanner)
 {
-    	if (new_buffer == NULL)
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	if (new_buffer == NULL)
 		return;
 
-	yyensure_buffer_stack();
+	yyensure_buffer_stack(yyscanner);
 
 	/* This block is copied from yy_switch_to_buffer. */
 	if ( YY_CURRENT_BUFFER )
 		{
 		/* Flush out information for old buffer. */
-		*(yy_c_buf_p) = (yy_hold_char);
-		YY_CURRENT_BUFFER_LVALUE->yy_buf_pos = (yy_c_buf_p);
-		YY_CURRENT_BUFFER_LVALUE->yy_n_chars = (yy_n_chars);
+		*yyg->yy_c_buf_p = yyg->yy_hold_char;
+		YY_CURRENT_BUFFER_LVALUE->yy_buf_pos = yyg->yy_c_buf_p;
+		YY_CURRENT_BUFFER_LVALUE->yy_n_chars = yyg->yy_n_chars;
 		}
 
 	/* Only push if top exists. Otherwise, replace top. */
 	if (YY_CURRENT_BUFFER)
-		(yy_buffer_stack_top)++;
+		yyg->yy_buffer_stack_top++;
 	YY_CURRENT_BUFFER_LVALUE = new_buffer;
 
 	/* copied from yy_switch_to_buffer. */
-	yy_load_buffer_state(  );
-	(yy_did_buffer_switch_on_eof) = 1;
+	yy_load_buffer_state( yyscanner );
+	yyg->yy_did_buffer_switch_on_eof = 1;
 }
 
 /** Removes and deletes the top of the stack, if present.
  *  The next element becomes the new top.
  *  
  */
-void yypop_buffer_state (void)
+void yypop_buffer_state (yyscan_t yyscanner)
 {
-    	if (!YY_CURRENT_BUFFER)
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	if (!YY_CURRENT_BUFFER)
 		return;
 
-	yy_delete_buffer(YY_CURRENT_BUFFER );
+	yy_delete_buffer(YY_CURRENT_BUFFER , yyscanner);
 	YY_CURRENT_BUFFER_LVALUE = NULL;
-	if ((yy_buffer_stack_top) > 0)
-		--(yy_buffer_stack_top);
+	if (yyg->yy_buffer_stack_top > 0)
+		--yyg->yy_buffer_stack_top;
 
 	if (YY_CURRENT_BUFFER) {
-		yy_load_buffer_state(  );
-		(yy_did_buffer_switch_on_eof) = 1;
+		yy_load_buffer_state( yyscanner );
+		yyg->yy_did_buffer_switch_on_eof = 1;
 	}
 }
 
 /* Allocates the stack if it does not exist.
  *  Guarantees space for at least one push.
  */
-static void yyensure_buffer_stack (void)
+static void yyensure_buffer_stack (yyscan_t yyscanner)
 {
 	yy_size_t num_to_alloc;
-    
-	if (!(yy_buffer_stack)) {
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
+	if (!yyg->yy_buffer_stack) {
 
 		/* First allocation is just for 2 elements, since we don't know if this
 		 * scanner will even need a stack. We use 2 instead of 1 to avoid an
 		 * immediate realloc on the next call.
          */
       num_to_alloc = 1; /* After all that talk, this was set to 1 anyways... */
-		(yy_buffer_stack) = (struct yy_buffer_state**)yyalloc
+		yyg->yy_buffer_stack = (struct yy_buffer_state**)yyalloc
 								(num_to_alloc * sizeof(struct yy_buffer_state*)
-								);
-		if ( ! (yy_buffer_stack) )
+								, yyscanner);
+		if ( ! yyg->yy_buffer_stack )
 			YY_FATAL_ERROR( "out of dynamic memory in yyensure_buffer_stack()" );
 
-		memset((yy_buffer_stack), 0, num_to_alloc * sizeof(struct yy_buffer_state*));
+		memset(yyg->yy_buffer_stack, 0, num_to_alloc * sizeof(struct yy_buffer_state*));
 
-		(yy_buffer_stack_max) = num_to_alloc;
-		(yy_buffer_stack_top) = 0;
+		yyg->yy_buffer_stack_max = num_to_alloc;
+		yyg->yy_buffer_stack_top = 0;
 		return;
 	}
 
-	if ((yy_buffer_stack_top) >= ((yy_buffer_stack_max)) - 1){
+	if (yyg->yy_buffer_stack_top >= (yyg->yy_buffer_stack_max) - 1){
 
 		/* Increase the buffer to prepare for a possible push. */
 		yy_size_t grow_size = 8 /* arbitrary grow size */;
 
-		num_to_alloc = (yy_buffer_stack_max) + grow_size;
-		(yy_buffer_stack) = (struct yy_buffer_state**)yyrealloc
-								((yy_buffer_stack),
+		num_to_alloc = yyg->yy_buffer_stack_max + grow_size;
+		yyg->yy_buffer_stack = (struct yy_buffer_state**)yyrealloc
+								(yyg->yy_buffer_stack,
 								num_to_alloc * sizeof(struct yy_buffer_state*)
-								);
-		if ( ! (yy_buffer_stack) )
+								, yyscanner);
+		if ( ! yyg->yy_buffer_stack )
 			YY_FATAL_ERROR( "out of dynamic memory in yyensure_buffer_stack()" );
 
 		/* zero only the new slots.*/
-		memset((yy_buffer_stack) + (yy_buffer_stack_max), 0, grow_size * sizeof(struct yy_buffer_state*));
-		(yy_buffer_stack_max) = num_to_alloc;
+		memset(yyg->yy_buffer_stack + yyg->yy_buffer_stack_max, 0, grow_size * sizeof(struct yy_buffer_state*));
+		yyg->yy_buffer_stack_max = num_to_alloc;
 	}
 }
 
@@ -2594,7 +2880,7 @@ static void yyensure_buffer_stack (void)
  * 
  * @return the newly allocated buffer state object.
  */
-YY_BUFFER_STATE yy_scan_buffer  (char * base, yy_size_t  size )
+YY_BUFFER_STATE yy_scan_buffer  (char * base, yy_size_t  size , yyscan_t yyscanner)
 {
 	YY_BUFFER_STATE b;
     
@@ -2604,7 +2890,7 @@ YY_BUFFER_STATE yy_scan_buffer  (char * base, yy_size_t  size )
 		/* They forgot to leave room for the EOB's. */
 		return NULL;
 
-	b = (YY_BUFFER_STATE) yyalloc( sizeof( struct yy_buffer_state )  );
+	b = (YY_BUFFER_STATE) yyalloc( sizeof( struct yy_buffer_state ) , yyscanner );
 	if ( ! b )
 		YY_FATAL_ERROR( "out of dynamic memory in yy_scan_buffer()" );
 
@@ -2618,7 +2904,7 @@ YY_BUFFER_STATE yy_scan_buffer  (char * base, yy_size_t  size )
 	b->yy_fill_buffer = 0;
 	b->yy_buffer_status = YY_BUFFER_NEW;
 
-	yy_switch_to_buffer( b  );
+	yy_switch_to_buffer( b , yyscanner );
 
 	return b;
 }
@@ -2631,10 +2917,10 @@ YY_BUFFER_STATE yy_scan_buffer  (char * base, yy_size_t  size )
  * @note If you want to scan bytes that may contain NUL values, then use
  *       yy_scan_bytes() instead.
  */
-YY_BUFFER_STATE yy_scan_string (const char * yystr )
+YY_BUFFER_STATE yy_scan_string (const char * yystr , yyscan_t yyscanner)
 {
     
-	return yy_scan_bytes( yystr, (int) strlen(yystr) );
+	return yy_scan_bytes( yystr, (int) strlen(yystr) , yyscanner);
 }
 
 /** Setup the input buffer state to scan the given bytes. The next call to yylex() will
@@ -2644,7 +2930,7 @@ YY_BUFFER_STATE yy_scan_string (const char * yystr )
  * 
  * @return the newly allocated buffer state object.
  */
-YY_BUFFER_STATE yy_scan_bytes  (const char * yybytes, int  _yybytes_len )
+YY_BUFFER_STATE yy_scan_bytes  (const char * yybytes, int  _yybytes_len , yyscan_t yyscanner)
 {
 	YY_BUFFER_STATE b;
 	char *buf;
@@ -2653,7 +2939,7 @@ YY_BUFFER_STATE yy_scan_bytes  (const char * yybytes, int  _yybytes_len )
     
 	/* Get memory for full buffer, including space for trailing EOB's. */
 	n = (yy_size_t) (_yybytes_len + 2);
-	buf = (char *) yyalloc( n  );
+	buf = (char *) yyalloc( n , yyscanner );
 	if ( ! buf )
 		YY_FATAL_ERROR( "out of dynamic memory in yy_scan_bytes()" );
 
@@ -2662,7 +2948,7 @@ YY_BUFFER_STATE yy_scan_bytes  (const char * yybytes, int  _yybytes_len )
 
 	buf[_yybytes_len] = buf[_yybytes_len+1] = YY_END_OF_BUFFER_CHAR;
 
-	b = yy_scan_buffer( buf, n );
+	b = yy_scan_buffer( buf, n , yyscanner);
 	if ( ! b )
 		YY_FATAL_ERROR( "bad buffer in yy_scan_bytes()" );
 
@@ -2678,9 +2964,11 @@ YY_BUFFER_STATE yy_scan_bytes  (const char * yybytes, int  _yybytes_len )
 #define YY_EXIT_FAILURE 2
 #endif
 
-static void yynoreturn yy_fatal_error (const char* msg )
+static void yynoreturn yy_fatal_error (const char* msg , yyscan_t yyscanner)
 {
-			fprintf( stderr, "%s\n", msg );
+	struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	(void)yyg;
+	fprintf( stderr, "%s\n", msg );
 	exit( YY_EXIT_FAILURE );
 }
 
@@ -2693,109 +2981,261 @@ static void yynoreturn yy_fatal_error (const char* msg )
 		/* Undo effects of setting up yytext. */ \
         int yyless_macro_arg = (n); \
         YY_LESS_LINENO(yyless_macro_arg);\
-		yytext[yyleng] = (yy_hold_char); \
-		(yy_c_buf_p) = yytext + yyless_macro_arg; \
-		(yy_hold_char) = *(yy_c_buf_p); \
-		*(yy_c_buf_p) = '\0'; \
+		yytext[yyleng] = yyg->yy_hold_char; \
+		yyg->yy_c_buf_p = yytext + yyless_macro_arg; \
+		yyg->yy_hold_char = *yyg->yy_c_buf_p; \
+		*yyg->yy_c_buf_p = '\0'; \
 		yyleng = yyless_macro_arg; \
 		} \
 	while ( 0 )
 
 /* Accessor  methods (get/set functions) to struct members. */
 
+/** Get the user-defined data for this scanner.
+ * @param yyscanner The scanner object.
+ */
+YY_EXTRA_TYPE yyget_extra  (yyscan_t yyscanner)
+{
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    return yyextra;
+}
+
 /** Get the current line number.
- * 
+ * @param yyscanner The scanner object.
  */
-int yyget_lineno  (void)
+int yyget_lineno  (yyscan_t yyscanner)
 {
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
+        if (! YY_CURRENT_BUFFER)
+            return 0;
     
     return yylineno;
 }
 
+/** Get the current column number.
+ * @param yyscanner The scanner object.
+ */
+int yyget_column  (yyscan_t yyscanner)
+{
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
+        if (! YY_CURRENT_BUFFER)
+            return 0;
+    
+    return yycolumn;
+}
+
 /** Get the input stream.
- * 
+ * @param yyscanner The scanner object.
  */
-FILE *yyget_in  (void)
+FILE *yyget_in  (yyscan_t yyscanner)
 {
-        return yyin;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    return yyin;
 }
 
 /** Get the output stream.
- * 
+ * @param yyscanner The scanner object.
  */
-FILE *yyget_out  (void)
+FILE *yyget_out  (yyscan_t yyscanner)
 {
-        return yyout;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    return yyout;
 }
 
 /** Get the length of the current token.
- * 
+ * @param yyscanner The scanner object.
  */
-int yyget_leng  (void)
+int yyget_leng  (yyscan_t yyscanner)
 {
-        return yyleng;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    return yyleng;
 }
 
 /** Get the current token.
- * 
+ * @param yyscanner The scanner object.
  */
 
-char *yyget_text  (void)
+char *yyget_text  (yyscan_t yyscanner)
+{
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    return yytext;
+}
+
+/** Set the user-defined data. This data is never touched by the scanner.
+ * @param user_defined The data to be associated with this scanner.
+ * @param yyscanner The scanner object.
+ */
+void yyset_extra (YY_EXTRA_TYPE  user_defined , yyscan_t yyscanner)
 {
-        return yytext;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    yyextra = user_defined ;
 }
 
 /** Set the current line number.
  * @param _line_number line number
- * 
+ * @param yyscanner The scanner object.
  */
-void yyset_lineno (int  _line_number )
+void yyset_lineno (int  _line_number , yyscan_t yyscanner)
 {
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
+        /* lineno is only valid if an input buffer exists. */
+        if (! YY_CURRENT_BUFFER )
+           YY_FATAL_ERROR( "yyset_lineno called with no buffer" );
     
     yylineno = _line_number;
 }
 
+/** Set the current column.
+ * @param _column_no column number
+ * @param yyscanner The scanner object.
+ */
+void yyset_column (int  _column_no , yyscan_t yyscanner)
+{
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
+        /* column is only valid if an input buffer exists. */
+        if (! YY_CURRENT_BUFFER )
+           YY_FATAL_ERROR( "yyset_column called with no buffer" );
+    
+    yycolumn = _column_no;
+}
+
 /** Set the input stream. This does not discard the current
  * input buffer.
  * @param _in_str A readable stream.
- * 
+ * @param yyscanner The scanner object.
  * @see yy_switch_to_buffer
  */
-void yyset_in (FILE *  _in_str )
+void yyset_in (FILE *  _in_str , yyscan_t yyscanner)
 {
-        yyin = _in_str ;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    yyin = _in_str ;
 }
 
-void yyset_out (FILE *  _out_str )
+void yyset_out (FILE *  _out_str , yyscan_t yyscanner)
 {
-        yyout = _out_str ;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    yyout = _out_str ;
 }
 
-int yyget_debug  (void)
+int yyget_debug  (yyscan_t yyscanner)
 {
-        return yy_flex_debug;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    return yy_flex_debug;
 }
 
-void yyset_debug (int  _bdebug )
+void yyset_debug (int  _bdebug , yyscan_t yyscanner)
 {
-        yy_flex_debug = _bdebug ;
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    yy_flex_debug = _bdebug ;
 }
 
-static int yy_init_globals (void)
+/* Accessor methods for yylval and yylloc */
+
+YYSTYPE * yyget_lval  (yyscan_t yyscanner)
 {
-        /* Initialization is the same as for the non-reentrant scanner.
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    return yylval;
+}
+
+void yyset_lval (YYSTYPE *  yylval_param , yyscan_t yyscanner)
+{
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    yylval = yylval_param;
+}
+
+YYLTYPE *yyget_lloc  (yyscan_t yyscanner)
+{
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    return yylloc;
+}
+    
+void yyset_lloc (YYLTYPE *  yylloc_param , yyscan_t yyscanner)
+{
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    yylloc = yylloc_param;
+}
+    
+/* User-visible API */
+
+/* yylex_init is special because it creates the scanner itself, so it is
+ * the ONLY reentrant function that doesn't take the scanner as the last argument.
+ * That's why we explicitly handle the declaration, instead of using our macros.
+ */
+int yylex_init(yyscan_t* ptr_yy_globals)
+{
+    if (ptr_yy_globals == NULL){
+        errno = EINVAL;
+        return 1;
+    }
+
+    *ptr_yy_globals = (yyscan_t) yyalloc ( sizeof( struct yyguts_t ), NULL );
+
+    if (*ptr_yy_globals == NULL){
+        errno = ENOMEM;
+        return 1;
+    }
+
+    /* By setting to 0xAA, we expose bugs in yy_init_globals. Leave at 0x00 for releases. */
+    memset(*ptr_yy_globals,0x00,sizeof(struct yyguts_t));
+
+    return yy_init_globals ( *ptr_yy_globals );
+}
+
+/* yylex_init_extra has the same functionality as yylex_init, but follows the
+ * convention of taking the scanner as the last argument. Note however, that
+ * this is a *pointer* to a scanner, as it will be allocated by this call (and
+ * is the reason, too, why this function also must handle its own declaration).
+ * The user defined value in the first argument will be available to yyalloc in
+ * the yyextra field.
+ */
+int yylex_init_extra( YY_EXTRA_TYPE yy_user_defined, yyscan_t* ptr_yy_globals )
+{
+    struct yyguts_t dummy_yyguts;
+
+    yyset_extra (yy_user_defined, &dummy_yyguts);
+
+    if (ptr_yy_globals == NULL){
+        errno = EINVAL;
+        return 1;
+    }
+
+    *ptr_yy_globals = (yyscan_t) yyalloc ( sizeof( struct yyguts_t ), &dummy_yyguts );
+
+    if (*ptr_yy_globals == NULL){
+        errno = ENOMEM;
+        return 1;
+    }
+
+    /* By setting to 0xAA, we expose bugs in
+    yy_init_globals. Leave at 0x00 for releases. */
+    memset(*ptr_yy_globals,0x00,sizeof(struct yyguts_t));
+
+    yyset_extra (yy_user_defined, *ptr_yy_globals);
+
+    return yy_init_globals ( *ptr_yy_globals );
+}
+
+static int yy_init_globals (yyscan_t yyscanner)
+{
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+    /* Initialization is the same as for the non-reentrant scanner.
      * This function is called from yylex_destroy(), so don't allocate here.
      */
 
-    /* We do not touch yylineno unless the option is enabled. */
-    yylineno =  1;
-    
-    (yy_buffer_stack) = NULL;
-    (yy_buffer_stack_top) = 0;
-    (yy_buffer_stack_max) = 0;
-    (yy_c_buf_p) = NULL;
-    (yy_init) = 0;
-    (yy_start) = 0;
+    yyg->yy_buffer_stack = NULL;
+    yyg->yy_buffer_stack_top = 0;
+    yyg->yy_buffer_stack_max = 0;
+    yyg->yy_c_buf_p = NULL;
+    yyg->yy_init = 0;
+    yyg->yy_start = 0;
+
+    yyg->yy_start_stack_ptr = 0;
+    yyg->yy_start_stack_depth = 0;
+    yyg->yy_start_stack =  NULL;
 
 /* Defined in main.c */
 #ifdef YY_STDINIT
@@ -2813,24 +3253,32 @@ static int yy_init_globals (void)
 }
 
 /* yylex_destroy is for both reentrant and non-reentrant scanners. */
-int yylex_destroy  (void)
+int yylex_destroy  (yyscan_t yyscanner)
 {
-    
+    struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+
     /* Pop the buffer stack, destroying each element. */
 	while(YY_CURRENT_BUFFER){
-		yy_delete_buffer( YY_CURRENT_BUFFER  );
+		yy_delete_buffer( YY_CURRENT_BUFFER , yyscanner );
 		YY_CURRENT_BUFFER_LVALUE = NULL;
-		yypop_buffer_state();
+		yypop_buffer_state(yyscanner);
 	}
 
 	/* Destroy the stack itself. */
-	yyfree((yy_buffer_stack) );
-	(yy_buffer_stack) = NULL;
+	yyfree(yyg->yy_buffer_stack , yyscanner);
+	yyg->yy_buffer_stack = NULL;
+
+    /* Destroy the start condition stack. */
+        yyfree( yyg->yy_start_stack , yyscanner );
+        yyg->yy_start_stack = NULL;
 
     /* Reset the globals. This is important in a non-reentrant scanner so the next time
      * yylex() is called, initialization will occur. */
-    yy_init_globals( );
+    yy_init_globals( yyscanner);
 
+    /* Destroy the main struct (reentrant only). */
+    yyfree ( yyscanner , yyscanner );
+    yyscanner = NULL;
     return 0;
 }
 
@@ -2839,9 +3287,11 @@ int yylex_destroy  (void)
  */
 
 #ifndef yytext_ptr
-static void yy_flex_strncpy (char* s1, const char * s2, int n )
+static void yy_flex_strncpy (char* s1, const char * s2, int n , yyscan_t yyscanner)
 {
-		
+	struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	(void)yyg;
+
 	int i;
 	for ( i = 0; i < n; ++i )
 		s1[i] = s2[i];
@@ -2849,7 +3299,7 @@ static void yy_flex_strncpy (char* s1, const char * s2, int n )
 #endif
 
 #ifdef YY_NEED_STRLEN
-static int yy_flex_strlen (const char * s )
+static int yy_flex_strlen (const char * s , yyscan_t yyscanner)
 {
 	int n;
 	for ( n = 0; s[n]; ++n )
@@ -2859,14 +3309,18 @@ static int yy_flex_strlen (const char * s )
 }
 #endif
 
-void *yyalloc (yy_size_t  size )
+void *yyalloc (yy_size_t  size , yyscan_t yyscanner)
 {
-			return malloc(size);
+	struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	(void)yyg;
+	return malloc(size);
 }
 
-void *yyrealloc  (void * ptr, yy_size_t  size )
+void *yyrealloc  (void * ptr, yy_size_t  size , yyscan_t yyscanner)
 {
-		
+	struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	(void)yyg;
+
 	/* The cast to (char *) in the following accommodates both
 	 * implementations that use char* generic pointers, and those
 	 * that use void* generic pointers.  It works with the latter
@@ -2877,121 +3331,324 @@ void *yyrealloc  (void * ptr, yy_size_t  size )
 	return realloc(ptr, size);
 }
 
-void yyfree (void * ptr )
+void yyfree (void * ptr , yyscan_t yyscanner)
 {
-			free( (char *) ptr );	/* see yyrealloc() for (char *) cast */
+	struct yyguts_t * yyg = (struct yyguts_t*)yyscanner;
+	(void)yyg;
+	free( (char *) ptr );	/* see yyrealloc() for (char *) cast */
 }
 
 #define YYTABLES_NAME "yytables"
 
-#line 411 "beancount/parser/lexer.l"
+#line 658 "beancount/parser/lexer.l"
 
 /*--------------------------------------------------------------------------------------*/
 /* User Code */
 
 
-/* Note: All these globals should be moved to an yylex_extra */
-
-/* The number of times EOF has been hit. This is used to synthesize an EOL at
- * the end of the file. */
-int yy_eof_times = 0;
-
-/* The filename being tokenized. */
-const char* yy_filename = 0;
-
-/* Number of tokens since the beginning of the line. */
-int yy_line_tokens = 0;
-
-/* The current column we're tokenizing at. */
-int yycolumn = 1;
-
-/* The encoding to use for converting strings. */
-const char* yy_encoding = NULL;
-
-/* A buffer for parsing string literals. It is reused and its size is dynamically allocated. */
-size_t strbuf_size = 0;
-char* strbuf = NULL;
-char* strbuf_end;
-char* strbuf_ptr;
-
-/* Initialize the globals before running the lexer. */
-void yylex_initialize(const char* filename, const char* encoding)
+/* Initialize a new scanner and its state before running the lexer. */
+void* yylex_initialize(PyObject* builder, const char* filename,
+                       const char* encoding, int firstline)
 {
+    yyscan_t scanner;
+    yyextra_t* extra;
     assert(filename != NULL);
-    yy_eof_times = 0;
-    yy_filename = filename;
-    yy_line_tokens = 0;
-    yycolumn = 1;
-    if ( encoding == 0 ) {
-        yy_encoding = "utf8";
+
+    extra = calloc(1, sizeof(yyextra_t));
+    if ( extra == NULL ) {
+        PyErr_NoMemory();
+        return NULL;
     }
-    else {
-        yy_encoding = encoding;
+    extra->builder = builder;
+    extra->filename = strdup(filename);
+    extra->firstline = firstline;
+    extra->eof_times = 0;
+    extra->line_tokens = 0;
+    extra->encoding = strdup(encoding != NULL ? encoding : "utf8");
+    extra->native_number = is_default_lex_method(builder, "NUMBER");
+    extra->dates.enabled = is_default_lex_method(builder, "DATE");
+    extra->accounts.enabled = is_default_lex_method(builder, "ACCOUNT");
+    extra->currencies.enabled = is_default_lex_method(builder, "CURRENCY");
+    extra->tags.enabled = is_default_lex_method(builder, "TAG");
+    extra->links.enabled = is_default_lex_method(builder, "LINK");
+    extra->keys.enabled = is_default_lex_method(builder, "KEY");
+    extra->dates.arena = &extra->arena;
+    extra->accounts.arena = &extra->arena;
+    extra->currencies.arena = &extra->arena;
+    extra->tags.arena = &extra->arena;
+    extra->links.arena = &extra->arena;
+    extra->keys.arena = &extra->arena;
+
+    /* Strings are checked against the threshold the builder has when the
+     * parse begins. */
+    extra->native_string = is_default_lex_method(builder, "STRING");
+    if ( extra->native_string ) {
+        PyObject* maxlines = PyObject_GetAttrString(builder,
+                                                    "long_string_maxlines_default");
+        extra->string_maxlines = maxlines != NULL ? PyLong_AsLong(maxlines) : -1;
+        Py_XDECREF(maxlines);
+        if ( PyErr_Occurred() ) {
+            PyErr_Clear();
+            extra->native_string = 0;
+        }
     }
 
     /* Start with a decent small buffer. */
-    strbuf_size = 1024;
-    strbuf = realloc(strbuf, strbuf_size + 1);
-    strbuf_end = strbuf + strbuf_size - 1;
-    strbuf_ptr = NULL;
-
-    /* Note: If we used a reentrant parser, this routine should eventually call
-     * yylex_init(). */
+    extra->strbuf_size = 1024;
+    extra->strbuf = malloc(extra->strbuf_size + 1);
+    extra->strbuf_end = extra->strbuf + extra->strbuf_size - 1;
+    extra->strbuf_ptr = NULL;
+
+    if ( extra->filename == NULL || extra->encoding == NULL || extra->strbuf == NULL ||
+         yylex_init_extra(extra, &scanner) != 0 ) {
+        free(extra->filename);
+        free(extra->encoding);
+        free(extra->strbuf);
+        free(extra);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    return scanner;
 }
 
-/* Finalize the globals before running the lexer. */
-void yylex_finalize(void)
+/* Finalize the scanner and release its state. */
+void yylex_finalize(void* scanner)
 {
-    yy_filename = NULL;
+    yyextra_t* extra = yyget_extra(scanner);
+
+    /* Release the interned tokens. */
+    intern_clear(&extra->dates);
+    intern_clear(&extra->accounts);
+    intern_clear(&extra->currencies);
+    intern_clear(&extra->tags);
+    intern_clear(&extra->links);
+    intern_clear(&extra->keys);
+    arena_clear(&extra->arena);
+
+    /* Release the builder methods. */
+    builder_dispatch_finalize(&extra->dispatch);
 
     /* Finalize our reading buffer. */
-    if ( strbuf != NULL ) {
-        free(strbuf);
-        strbuf = NULL;
-    }
+    free(extra->filename);
+    free(extra->encoding);
+    free(extra->strbuf);
+    free(extra);
 
     /* Call the yylex finalization routine. */
-    yylex_destroy();
+    yylex_destroy(scanner);
 }
 
 
 /* Reallocate the buffer to accomodate some new characters. */
-void strbuf_realloc(size_t num_new_chars)
+void strbuf_realloc(yyextra_t* extra, size_t num_new_chars)
 {
-    assert(strbuf_ptr != NULL);
-    size_t cur_size = strbuf_ptr - strbuf;
+    assert(extra->strbuf_ptr != NULL);
+    size_t cur_size = extra->strbuf_ptr - extra->strbuf;
     size_t new_size = cur_size + num_new_chars;
-    while ( strbuf_size < new_size ) {
-        strbuf_size <<= 1;
+    while ( extra->strbuf_size < new_size ) {
+        extra->strbuf_size <<= 1;
     }
-    strbuf = realloc(strbuf, strbuf_size + 1);
-    strbuf_ptr = strbuf + cur_size;
-    strbuf_end = strbuf + strbuf_size - 1;
+    extra->strbuf = realloc(extra->strbuf, extra->strbuf_size + 1);
+    extra->strbuf_ptr = extra->strbuf + cur_size;
+    extra->strbuf_end = extra->strbuf + extra->strbuf_size - 1;
 }
 
 
 
 
+int yy_read_input(yyextra_t* extra, FILE* fp, char* buf, size_t max_size)
+{
+    PyThreadState* thread_state = NULL;
+    size_t result;
+    if ( extra->thread_state == NULL ) {
+        thread_state = PyEval_SaveThread();
+    }
+    errno = 0;
+    while ( (result = fread(buf, 1, max_size, fp)) == 0 && ferror(fp) ) {
+        if ( errno != EINTR ) {
+            break;
+        }
+        errno = 0;
+        clearerr(fp);
+    }
+    if ( thread_state != NULL ) {
+        PyEval_RestoreThread(thread_state);
+    }
+    return result == 0 && ferror(fp) ? -1 : (int)result;
+}
+
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#  define HAVE_SSE2 1
+#endif
+
+/* Return a pointer to the first character in [ptr, limit) equal to one of c1,
+ * c2 or c3, or limit if there is none. The input is compared sixteen bytes at a
+ * time where SSE2 is available. */
+static inline const char* scan_for(const char* ptr, const char* limit,
+                                   char c1, char c2, char c3)
+{
+#ifdef HAVE_SSE2
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    const __m128i v3 = _mm_set1_epi8(c3);
+    while ( limit - ptr >= 16 ) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)ptr);
+        __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, v1),
+                                                  _mm_cmpeq_epi8(chunk, v2)),
+                                     _mm_cmpeq_epi8(chunk, v3));
+        int mask = _mm_movemask_epi8(match);
+        if ( mask != 0 ) {
+#  if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return ptr + index;
+#  else
+            return ptr + __builtin_ctz(mask);
+#  endif
+        }
+        ptr += 16;
+    }
+#endif
+    for ( ; ptr < limit; ++ptr ) {
+        char c = *ptr;
+        if ( c == c1 || c == c2 || c == c3 ) {
+            break;
+        }
+    }
+    return ptr;
+}
+
 #define LEXEOF 0
 
-int yy_skip_line()
-{
-    int num_chars = 0;
+int yy_skip_line(void* yyscanner)
+{
+    struct yyguts_t* yyg = (struct yyguts_t*)yyscanner;
+    char* begin = yyg->yy_c_buf_p;
+    char* limit = YY_CURRENT_BUFFER_LVALUE->yy_ch_buf + yyg->yy_n_chars;
+    char* ptr;
+    int num_chars;
+
+    /* Skip the part of the line in the current input buffer at once. */
+    *begin = yyg->yy_hold_char;
+    ptr = (char*)scan_for(begin, limit, '\n', '\0', '\0');
+    num_chars = ptr - begin;
+    yyg->yy_c_buf_p = ptr;
+    yyg->yy_hold_char = *ptr;
+    *ptr = '\0';
+    if ( ptr < limit && yyg->yy_hold_char == '\n' ) {
+        yyextra->offset += num_chars;
+        return num_chars;
+    }
+
+    /* Continue a character at a time through the end of the buffer, which
+     * reads more input, or a NUL character. */
     for ( ;; ) {
-        int c = input();
-        num_chars++;
+        int c = input(yyscanner);
         if ( c == LEXEOF || c == -1 ) {
             break;
         }
         if ( c == '\n' ) {
             unput(c);
-            num_chars--;
             break;
         }
+        num_chars++;
     }
+    yyextra->offset += num_chars;
     return num_chars;
 }
 
+/* If the string literal whose opening quote was just matched is entirely in the
+ * current input buffer, consume it along with its closing quote, as the STRLIT
+ * rules would, and return a pointer to its contents, setting their length. If
+ * the literal has no escape sequences, its contents are left untouched in the
+ * input buffer and returned from there; otherwise they are decoded into the
+ * string buffer. If the literal is not entirely in the buffer or contains a NUL
+ * character, leave the input as is and return NULL. */
+const char* yy_consume_string_literal(void* yyscanner, size_t* length)
+{
+    struct yyguts_t* yyg = (struct yyguts_t*)yyscanner;
+    char* begin = yyg->yy_c_buf_p;
+    char* limit = YY_CURRENT_BUFFER_LVALUE->yy_ch_buf + yyg->yy_n_chars;
+    char* last_newline = NULL;
+    int num_lines = 0;
+    const char* contents = begin;
+    const char* segment;
+    const char* newline;
+    char* ptr;
+
+    /* Put back the character that flex replaced to terminate yytext. */
+    *begin = yyg->yy_hold_char;
+    ptr = (char*)scan_for(begin, limit, '"', '\\', '\0');
+    if ( ptr < limit && *ptr == '\\' ) {
+        /* Decode the escape sequences into the string buffer, as the STRLIT
+         * rules do, copying the text between them in bulk. */
+        yyextra->strbuf_ptr = yyextra->strbuf;
+        segment = begin;
+        /* Note: strbuf_realloc() makes room for one character fewer than asked
+         * for, keeping the last one for the terminator. */
+        while ( ptr < limit && *ptr == '\\' && ptr + 1 < limit ) {
+            ssize_t segment_length = ptr - segment;
+            if ( segment_length + 1 > yyextra->strbuf_end - yyextra->strbuf_ptr ) {
+                strbuf_realloc(yyextra, segment_length + 2);
+            }
+            memcpy(yyextra->strbuf_ptr, segment, segment_length);
+            yyextra->strbuf_ptr += segment_length;
+            switch ( ptr[1] ) {
+                case 'n': *yyextra->strbuf_ptr++ = '\n'; break;
+                case 't': *yyextra->strbuf_ptr++ = '\t'; break;
+                case 'r': *yyextra->strbuf_ptr++ = '\r'; break;
+                case 'b': *yyextra->strbuf_ptr++ = '\b'; break;
+                case 'f': *yyextra->strbuf_ptr++ = '\f'; break;
+                default: *yyextra->strbuf_ptr++ = ptr[1]; break;
+            }
+            segment = ptr + 2;
+            ptr = (char*)scan_for(segment, limit, '"', '\\', '\0');
+        }
+        if ( ptr < limit && *ptr == '"' ) {
+            ssize_t segment_length = ptr - segment;
+            if ( segment_length > yyextra->strbuf_end - yyextra->strbuf_ptr ) {
+                strbuf_realloc(yyextra, segment_length + 1);
+            }
+            memcpy(yyextra->strbuf_ptr, segment, segment_length);
+            yyextra->strbuf_ptr += segment_length;
+            contents = yyextra->strbuf;
+            *length = yyextra->strbuf_ptr - yyextra->strbuf;
+        }
+        yyextra->strbuf_ptr = NULL;
+    }
+    else {
+        *length = ptr - begin;
+    }
+    if ( ptr >= limit || *ptr != '"' ) {
+        *begin = '\0';
+        return NULL;
+    }
+
+    /* Count the lines of the literal. */
+    for ( newline = begin;
+          (newline = memchr(newline, '\n', ptr - newline)) != NULL;
+          newline++ ) {
+        num_lines++;
+        last_newline = (char*)newline;
+    }
+
+    /* Move past the closing quote, making it the current token. */
+    yyextra->offset += ptr + 1 - begin;
+    yylineno += num_lines;
+    yycolumn = (last_newline != NULL ? ptr - last_newline : yycolumn + (ptr - begin)) + 1;
+    yytext = ptr;
+    yyleng = 1;
+    yyg->yy_c_buf_p = ptr + 1;
+    yyg->yy_hold_char = ptr[1];
+    ptr[1] = '\0';
+    return contents;
+}
+
 /* Convert an integer string to a number. */
 int strtonl(const char* buf, size_t nchars)
 {
@@ -3004,22 +3661,303 @@ int strtonl(const char* buf, size_t nchars)
     return result;
 }
 
+/* Hash the token text (FNV-1a). */
+static size_t intern_hash(const char* key, size_t length)
+{
+    size_t hash = (size_t)14695981039346656037ULL;
+    size_t i;
+    for ( i = 0; i < length; ++i ) {
+        hash ^= (unsigned char)key[i];
+        hash *= (size_t)1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Find the slot for the given key: either the one holding it, or the empty
+ * one where it would be inserted. The table must not be full. */
+static intern_entry_t* intern_find(intern_table_t* table, const char* key,
+                                   size_t length, size_t hash)
+{
+    size_t mask = table->capacity - 1;
+    size_t index = hash & mask;
+    for ( ;; ) {
+        intern_entry_t* entry = &table->entries[index];
+        if ( entry->key == NULL ||
+             (entry->hash == hash && entry->length == length &&
+              memcmp(entry->key, key, length) == 0) ) {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+PyObject* intern_lookup(intern_table_t* table, const char* key, size_t length)
+{
+    intern_entry_t* entry;
+    if ( table->size == 0 ) {
+        return NULL;
+    }
+    entry = intern_find(table, key, length, intern_hash(key, length));
+    return entry->value;
+}
+
+void intern_insert(intern_table_t* table, const char* key, size_t length,
+                   PyObject* value)
+{
+    intern_entry_t* entry;
+    size_t hash;
+    if ( !table->enabled ) {
+        return;
+    }
+
+    /* Grow the table to keep its load factor under one half. */
+    if ( 2 * (table->size + 1) > table->capacity ) {
+        size_t old_capacity = table->capacity;
+        intern_entry_t* old_entries = table->entries;
+        size_t new_capacity = old_capacity ? 2 * old_capacity : 64;
+        intern_entry_t* new_entries = calloc(new_capacity, sizeof(intern_entry_t));
+        size_t i;
+        if ( new_entries == NULL ) {
+            return;
+        }
+        table->entries = new_entries;
+        table->capacity = new_capacity;
+        for ( i = 0; i < old_capacity; ++i ) {
+            intern_entry_t* old_entry = &old_entries[i];
+            if ( old_entry->key != NULL ) {
+                *intern_find(table, old_entry->key, old_entry->length,
+                             old_entry->hash) = *old_entry;
+            }
+        }
+        free(old_entries);
+    }
+
+    hash = intern_hash(key, length);
+    entry = intern_find(table, key, length, hash);
+    if ( entry->key != NULL ) {
+        return;
+    }
+    entry->key = arena_alloc(table->arena, length ? length : 1);
+    if ( entry->key == NULL ) {
+        return;
+    }
+    memcpy(entry->key, key, length);
+    entry->length = length;
+    entry->hash = hash;
+    Py_INCREF(value);
+    entry->value = value;
+    table->size++;
+}
+
+void intern_clear(intern_table_t* table)
+{
+    size_t i;
+    for ( i = 0; i < table->capacity; ++i ) {
+        intern_entry_t* entry = &table->entries[i];
+        if ( entry->key != NULL ) {
+            Py_DECREF(entry->value);
+        }
+    }
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->size = 0;
+}
+
+/* The size of the blocks allocated by an arena. Larger requests get a block of
+ * their own. */
+#define ARENA_BLOCK_SIZE  (64 * 1024)
+
+void* arena_alloc(arena_t* arena, size_t size)
+{
+    void* result;
+    size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    if ( size > (size_t)(arena->end - arena->ptr) ) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        arena_block_t* block = malloc(sizeof(arena_block_t) + block_size);
+        if ( block == NULL ) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->ptr = (char*)(block + 1);
+        arena->end = arena->ptr + block_size;
+    }
+    result = arena->ptr;
+    arena->ptr += size;
+    return result;
+}
+
+void arena_clear(arena_t* arena)
+{
+    while ( arena->blocks != NULL ) {
+        arena_block_t* next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    arena->ptr = arena->end = NULL;
+}
+
+void check_string_lines(void* scanner, const char* contents, size_t length)
+{
+    yyextra_t* extra = yyget_extra(scanner);
+    const char* limit = contents + length;
+    const char* newline = contents;
+    long num_lines = 1;
+    char buffer[64];
+    size_t message_length;
+    while ( (newline = memchr(newline, '\n', limit - newline)) != NULL ) {
+        num_lines++;
+        newline++;
+    }
+    if ( num_lines > 1 && num_lines > extra->string_maxlines ) {
+        /* This is just a warning; accept the string anyhow. */
+        message_length = snprintf(buffer, sizeof(buffer),
+                                  "String too long (%ld lines); possible error",
+                                  num_lines);
+        build_lexer_error(scanner, buffer, message_length);
+    }
+}
+
+int is_default_lex_method(PyObject* builder, const char* method_name)
+{
+    /* The default methods are looked up from the LexBuilder class on first use.
+     * The lexer module cannot be imported when this extension module is
+     * initialized, since it imports it. */
+    static PyObject* lex_builder_class = NULL;
+    PyObject* default_function;
+    PyObject* method;
+    int result;
+
+    if ( lex_builder_class == NULL ) {
+        PyObject* lexer_module = PyImport_ImportModule("beancount.parser.lexer");
+        if ( lexer_module == NULL ) {
+            PyErr_Clear();
+            return 0;
+        }
+        lex_builder_class = PyObject_GetAttrString(lexer_module, "LexBuilder");
+        Py_DECREF(lexer_module);
+        if ( lex_builder_class == NULL ) {
+            PyErr_Clear();
+            return 0;
+        }
+    }
+
+    default_function = PyObject_GetAttrString(lex_builder_class, method_name);
+    method = PyObject_GetAttrString(builder, method_name);
+    result = (default_function != NULL && method != NULL &&
+              PyMethod_Check(method) &&
+              PyMethod_GET_FUNCTION(method) == default_function &&
+              PyMethod_GET_SELF(method) == builder);
+    Py_XDECREF(default_function);
+    Py_XDECREF(method);
+    PyErr_Clear();
+    return result;
+}
+
+#include <datetime.h>
+
+PyObject* build_date(int year, int month, int day)
+{
+    /* The datetime C API is imported on first use. */
+    if ( PyDateTimeAPI == NULL ) {
+        PyDateTime_IMPORT;
+        if ( PyDateTimeAPI == NULL ) {
+            return NULL;
+        }
+    }
+    return PyDate_FromDate(year, month, day);
+}
+
+/* Build a Decimal from a NUMBER token, removing the thousands separators.
+ * Returns NULL without an exception set if the commas do not group the
+ * integral part by thousands; the builder is left to report those. */
+PyObject* build_number(const char* text, size_t length)
+{
+    char small_buffer[64];
+    char* buffer = small_buffer;
+    const char* end = text + length;
+    const char* ptr;
+    size_t group_length = 0;
+    int num_commas = 0;
+    size_t num_chars = 0;
+    PyObject* string;
+    PyObject* number;
+
+    /* Validate the grouping of the integral part. The first group may not have
+     * a leading zero and the following groups must have exactly three
+     * digits. */
+    for ( ptr = text; ptr < end && *ptr != '.'; ++ptr ) {
+        if ( *ptr == ',' ) {
+            if ( num_commas == 0 ? (group_length == 0 || group_length > 3 || text[0] == '0')
+                                 : group_length != 3 ) {
+                return NULL;
+            }
+            num_commas++;
+            group_length = 0;
+        }
+        else {
+            group_length++;
+        }
+    }
+    if ( num_commas > 0 && group_length != 3 ) {
+        return NULL;
+    }
+
+    if ( num_commas == 0 ) {
+        string = PyUnicode_FromStringAndSize(text, length);
+    }
+    else {
+        /* Copy the number without its commas. */
+        if ( length >= sizeof(small_buffer) ) {
+            buffer = malloc(length);
+            if ( buffer == NULL ) {
+                return PyErr_NoMemory();
+            }
+        }
+        for ( ptr = text; ptr < end; ++ptr ) {
+            if ( *ptr != ',' ) {
+                buffer[num_chars++] = *ptr;
+            }
+        }
+        string = PyUnicode_FromStringAndSize(buffer, num_chars);
+        if ( buffer != small_buffer ) {
+            free(buffer);
+        }
+    }
+    if ( string == NULL ) {
+        return NULL;
+    }
+    number = PyObject_CallFunctionObjArgs(decimal_type, string, NULL);
+    Py_DECREF(string);
+    return number;
+}
+
 /* Build and accumulate an error on the builder object. */
-void build_lexer_error(const char* string, size_t length)
+void build_lexer_error(void* scanner, const char* string, size_t length)
 {
     TRACE_ERROR("Invalid Token");
 
-    /* Build and accumulate a new error object. {27d1d459c5cd} */
-    PyObject* rv = PyObject_CallMethod(builder, "build_lexer_error",
-                                       "s#", string, (Py_ssize_t)length);
+    /* Build and accumulate a new error object, reacquiring the GIL if it was
+     * released for the scan. {27d1d459c5cd} */
+    yyextra_t* extra = yyget_extra(scanner);
+    PyObject* rv;
+    if (extra->thread_state != NULL) {
+        PyEval_RestoreThread(extra->thread_state);
+    }
+    rv = CALL_BUILDER(&extra->dispatch, extra->builder, build_lexer_error,
+                      "s#", string, (Py_ssize_t)length);
     if (rv == NULL) {
         PyErr_SetString(PyExc_RuntimeError,
                         "Internal error: Building exception from default rule");
     }
     Py_XDECREF(rv);
+    if (extra->thread_state != NULL) {
+        extra->thread_state = PyEval_SaveThread();
+    }
 }
 
-void build_lexer_error_from_exception()
+void build_lexer_error_from_exception(void* scanner)
 {
     TRACE_ERROR("Lexer Builder Exception");
 
@@ -3035,8 +3973,9 @@ void build_lexer_error_from_exception()
 
     if (pvalue != NULL) {
         /* Build and accumulate a new error object. {27d1d459c5cd} */
-        PyObject* rv = PyObject_CallMethod(builder, "build_lexer_error",
-                                           "OO", pvalue, ptype);
+        yyextra_t* extra = yyget_extra(scanner);
+        PyObject* rv = CALL_BUILDER(&extra->dispatch, extra->builder, build_lexer_error,
+                                    "OO", pvalue, ptype);
         Py_XDECREF(ptype);
         Py_XDECREF(pvalue);
         Py_XDECREF(ptraceback);
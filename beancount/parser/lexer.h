@@ -11,71 +11,243 @@
 #include "parser.h"
 #include "grammar.h"
 
+/* A block of memory of an arena, followed by its data. */
+typedef struct arena_block {
+    struct arena_block* next;
+} arena_block_t;
+
+/* A region from which many small blocks of memory are allocated for the
+ * duration of a parse, and released all at once at the end of it. */
+typedef struct {
+    arena_block_t* blocks;  /* The list of blocks, most recent first. */
+    char* ptr;              /* Free space in the current block. */
+    char* end;              /* End of the current block. */
+} arena_t;
+
+/* Allocate memory from the arena. Returns NULL if out of memory. */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/* Release all the memory allocated from the arena. */
+void arena_clear(arena_t* arena);
+
+/* An entry of a token intern table. */
+typedef struct {
+    char* key;        /* Copy of the token text in the arena (not nul-terminated). */
+    size_t length;    /* Length of the token text. */
+    size_t hash;      /* Hash of the token text. */
+    PyObject* value;  /* Reference to the value returned by the builder. */
+} intern_entry_t;
+
+/* A hash table of the values returned by the builder for repeated tokens, keyed
+ * by the token text, so that each distinct token is converted only once and
+ * all its occurrences share the same Python object. */
+typedef struct {
+    int enabled;              /* False if the builder method is overridden. */
+    arena_t* arena;           /* The arena holding the keys. */
+    size_t capacity;          /* Number of slots, a power of two (or zero). */
+    size_t size;              /* Number of occupied slots. */
+    intern_entry_t* entries;  /* Open-addressed array of slots. */
+} intern_table_t;
+
+/* Look up a token in the table. Returns a borrowed reference or NULL. */
+PyObject* intern_lookup(intern_table_t* table, const char* key, size_t length);
+
+/* Insert a token value in the table. Failures are ignored, as it is only a
+ * cache. */
+void intern_insert(intern_table_t* table, const char* key, size_t length,
+                   PyObject* value);
+
+/* Remove all the tokens from the table. */
+void intern_clear(intern_table_t* table);
+
+/* The state of a single lexer instance. This is attached to the scanner as its
+ * "extra" data, so that multiple inputs may be tokenized concurrently. */
+typedef struct {
+    /* The builder object receiving the callbacks (borrowed reference). */
+    PyObject* builder;
+
+    /* The filename being tokenized (owned copy). */
+    char* filename;
+
+    /* Offset added to the line numbers when reporting locations. */
+    int firstline;
+
+    /* The number of times EOF has been hit. This is used to synthesize an EOL
+     * at the end of the file. */
+    int eof_times;
+
+    /* Number of tokens since the beginning of the line. */
+    int line_tokens;
+
+    /* The encoding to use for converting strings (owned copy). */
+    char* encoding;
+
+    /* True if the builder uses the default LexBuilder.NUMBER() method, in
+     * which case NUMBER tokens are converted to Decimal natively. */
+    int native_number;
+
+    /* True if the builder uses the default LexBuilder.STRING() method, in
+     * which case STRING tokens are created natively, warning about strings
+     * with more lines than the builder's long_string_maxlines_default. */
+    int native_string;
+    long string_maxlines;
+
+    /* The memory allocated for the duration of the parse. */
+    arena_t arena;
+
+    /* Values of the repeated tokens. */
+    intern_table_t dates;
+    intern_table_t accounts;
+    intern_table_t currencies;
+    intern_table_t tags;
+    intern_table_t links;
+    intern_table_t keys;
+
+    /* State for building the common grammar objects natively. */
+    native_builder_t native;
+
+    /* The builder methods, if bound once for the whole parse. */
+    builder_dispatch_t dispatch;
+
+    /* If not NULL, the list the entries are appended to as they are reduced,
+     * instead of being accumulated by the grammar (borrowed; see
+     * parser_next()). */
+    PyObject* stream;
+
+    /* If true, the values of the tokens are not built and are left NULL, for
+     * callers which only need the types and positions of the tokens (see
+     * lexer_tokenize()). */
+    int skip_values;
+
+    /* The number of bytes of input consumed so far. */
+    size_t offset;
+
+    /* The byte offset of the beginning of the last token. For string literals,
+     * this is the offset of the opening quote. */
+    size_t token_offset;
+
+    /* The state of the thread while the GIL is released for the scan, or NULL
+     * if it is held. This is only done when the values of the tokens are not
+     * built; build_lexer_error() reacquires the GIL around its callback. See
+     * lexer_tokenize(). */
+    PyThreadState* thread_state;
+
+    /* A buffer for parsing string literals. It is reused and its size is
+     * dynamically allocated. */
+    size_t strbuf_size;  /* Current buffer size (not including final nul). */
+    char* strbuf;        /* Current buffer head. */
+    char* strbuf_end;    /* Current buffer sentinel (points to the final nul). */
+    char* strbuf_ptr;    /* Current insertion point in buffer. */
+} yyextra_t;
+
 /* Build and accumulate an error on the builder object. */
-void build_lexer_error(const char* string, size_t length);
+void build_lexer_error(void* scanner, const char* string, size_t length);
 
 /* Build and accumulate an error on the builder object using the current
  * exception state. */
-void build_lexer_error_from_exception(void);
+void build_lexer_error_from_exception(void* scanner);
 
 /* Callback call site with error handling. */
-#define BUILD_LEX(method_name, format, ...)                                             \
-    yylval->pyobj = PyObject_CallMethod(builder, method_name, format, __VA_ARGS__);     \
-    /* Handle a Python exception raised by the handler {3cfb2739349a} */                \
-    if (yylval->pyobj == NULL) {                                                        \
-       build_lexer_error_from_exception();                                              \
-       return LEX_ERROR;                                                                \
+#define BUILD_LEX(method, format, ...)                                                  \
+    if (yyextra->skip_values) {                                                         \
+        yylval->pyobj = NULL;                                                           \
+    }                                                                                   \
+    else {                                                                              \
+        yylval->pyobj = CALL_BUILDER(&yyextra->dispatch, yyextra->builder,              \
+                                     method, format, __VA_ARGS__);                      \
+        /* Handle a Python exception raised by the handler {3cfb2739349a} */            \
+        if (yylval->pyobj == NULL) {                                                    \
+            build_lexer_error_from_exception(yyscanner);                                \
+            return LEX_ERROR;                                                           \
+        }                                                                               \
+        /* Lexer builder methods should never return None, check for it. */             \
+        else if (yylval->pyobj == Py_None) {                                            \
+            Py_DECREF(Py_None);                                                         \
+            build_lexer_error(yyscanner, "Unexpected None result from lexer", 34);      \
+            return LEX_ERROR;                                                           \
+        }                                                                               \
+    }
+
+/* Callback call site for tokens with interned values: the builder is only called
+ * the first time a particular token text is seen. */
+#define BUILD_LEX_INTERNED(table, method, string, length)                               \
+    if (yyextra->skip_values) {                                                         \
+        yylval->pyobj = NULL;                                                           \
+    }                                                                                   \
+    else if ((yylval->pyobj = intern_lookup(&yyextra->table, string, length)) != NULL) { \
+        Py_INCREF(yylval->pyobj);                                                       \
     }                                                                                   \
-    /* Lexer builder methods should never return None, check for it. */                 \
-    else if (yylval->pyobj == Py_None) {                                                \
-        Py_DECREF(Py_None);                                                             \
-        build_lexer_error("Unexpected None result from lexer", 34);                     \
-        return LEX_ERROR;                                                               \
+    else {                                                                              \
+        BUILD_LEX(method, "s#", string, (Py_ssize_t)(length));                          \
+        intern_insert(&yyextra->table, string, length, yylval->pyobj);                  \
     }
 
 /* Initialization/finalization methods. These are separate from the yylex_init()
- * and yylex_destroy() and they call them. */
-void yylex_initialize(const char* filename, const char* encoding);
-void yylex_finalize(void);
-
-/* Global declarations; defined below. */
-extern int yy_eof_times;
-extern const char* yy_filename;
-extern int yycolumn;
-extern const char* yy_encoding;
-
-/* String buffer statics. */
-extern size_t strbuf_size; /* Current buffer size (not including final nul). */
-extern char* strbuf;       /* Current buffer head. */
-extern char* strbuf_end;   /* Current buffer sentinel (points to the final nul). */
-extern char* strbuf_ptr;   /* Current insertion point in buffer. */
-void strbuf_realloc(size_t num_new_chars);
-
-/* Handle detecting the beginning of line. */
-extern int yy_line_tokens; /* Number of tokens since the bol. */
+ * and yylex_destroy() and they call them. yylex_initialize() returns a new
+ * scanner, or NULL (with a Python exception set) on failure. */
+void* yylex_initialize(PyObject* builder, const char* filename,
+                       const char* encoding, int firstline);
+void yylex_finalize(void* scanner);
+
+/* Reallocate the string buffer to accomodate some new characters. */
+void strbuf_realloc(yyextra_t* extra, size_t num_new_chars);
+
+/* Read the input from a file as flex does by default, but without holding the
+ * GIL while waiting for it. Returns the number of bytes read, or -1 on error. */
+int yy_read_input(yyextra_t* extra, FILE* fp, char* buf, size_t max_size);
+
+#define YY_INPUT(buf, result, max_size)                                 \
+    if ( ((result) = yy_read_input(yyextra, yyin, (buf), (max_size))) < 0 ) { \
+        YY_FATAL_ERROR("input in flex scanner failed");                 \
+    }
 
+/* Handle detecting the beginning of line, and track the offset of the
+ * beginning of the tokens. The rules continuing a string literal are part of
+ * the token started by its opening quote. */
 #define YY_USER_ACTION  {                               \
-    yy_line_tokens++;                                   \
+    yyextra->line_tokens++;                             \
     yylloc->first_line = yylloc->last_line = yylineno;  \
     yylloc->first_column = yycolumn;                    \
     yylloc->last_column = yycolumn+yyleng-1;            \
+    if ( YY_START != STRLIT ) {                         \
+        yyextra->token_offset = yyextra->offset;        \
+    }                                                   \
+    yyextra->offset += yyleng;                          \
     yycolumn += yyleng;                                 \
   }
 
-/* Skip the rest of the input line. */
-int yy_skip_line(void);
+/* Skip the rest of the input line, up to its newline. Returns the number of
+ * characters skipped. */
+int yy_skip_line(void* scanner);
+
+/* Consume a string literal from the input buffer, decoding its escape sequences
+ * if it has any. */
+const char* yy_consume_string_literal(void* scanner, size_t* length);
 
 /* Utility functions. */
 int strtonl(const char* buf, size_t nchars);
 
-/* Append characters to the static string buffer and verify. */
-#define SAFE_COPY_CHAR(value)                    \
-	if (strbuf_ptr >= strbuf_end) {         \
-            strbuf_realloc(1);                  \
-	}                                       \
-        *strbuf_ptr++ = value;
+/* Return true if the builder's method of the given name is the default one from
+ * LexBuilder, which means that the lexer may handle the token natively. */
+int is_default_lex_method(PyObject* builder, const char* method_name);
+
+/* Build a Decimal instance from the text of a NUMBER token. */
+PyObject* build_number(const char* text, size_t length);
+
+/* Build a datetime.date instance, as LexBuilder.DATE() does. */
+PyObject* build_date(int year, int month, int day);
+
+/* Warn about a string with too many lines, as LexBuilder.STRING() does. */
+void check_string_lines(void* scanner, const char* contents, size_t length);
+
+/* Append characters to the string buffer and verify. */
+#define SAFE_COPY_CHAR(value)                                   \
+	if (yyextra->strbuf_ptr >= yyextra->strbuf_end) {       \
+            strbuf_realloc(yyextra, 1);                         \
+	}                                                       \
+        *yyextra->strbuf_ptr++ = value;
 
-#line 79 "beancount/parser/lexer.h"
+#line 251 "beancount/parser/lexer.h"
 
 #define  YY_INT_ALIGNED short int
 
@@ -202,6 +374,12 @@ typedef unsigned int flex_uint32_t;
 #define yynoreturn
 #endif
 
+/* An opaque pointer. */
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
 /* Size of default input buffer. */
 #ifndef YY_BUF_SIZE
 #ifdef __ia64__
@@ -225,10 +403,6 @@ typedef struct yy_buffer_state *YY_BUFFER_STATE;
 typedef size_t yy_size_t;
 #endif
 
-extern int yyleng;
-
-extern FILE *yyin, *yyout;
-
 #ifndef YY_STRUCT_YY_BUFFER_STATE
 #define YY_STRUCT_YY_BUFFER_STATE
 struct yy_buffer_state
@@ -280,34 +454,28 @@ struct yy_buffer_state
 	};
 #endif /* !YY_STRUCT_YY_BUFFER_STATE */
 
-void yyrestart ( FILE *input_file  );
-void yy_switch_to_buffer ( YY_BUFFER_STATE new_buffer  );
-YY_BUFFER_STATE yy_create_buffer ( FILE *file, int size  );
-void yy_delete_buffer ( YY_BUFFER_STATE b  );
-void yy_flush_buffer ( YY_BUFFER_STATE b  );
-void yypush_buffer_state ( YY_BUFFER_STATE new_buffer  );
-void yypop_buffer_state ( void );
+void yyrestart ( FILE *input_file , yyscan_t yyscanner );
+void yy_switch_to_buffer ( YY_BUFFER_STATE new_buffer , yyscan_t yyscanner );
+YY_BUFFER_STATE yy_create_buffer ( FILE *file, int size , yyscan_t yyscanner );
+void yy_delete_buffer ( YY_BUFFER_STATE b , yyscan_t yyscanner );
+void yy_flush_buffer ( YY_BUFFER_STATE b , yyscan_t yyscanner );
+void yypush_buffer_state ( YY_BUFFER_STATE new_buffer , yyscan_t yyscanner );
+void yypop_buffer_state ( yyscan_t yyscanner );
 
-YY_BUFFER_STATE yy_scan_buffer ( char *base, yy_size_t size  );
-YY_BUFFER_STATE yy_scan_string ( const char *yy_str  );
-YY_BUFFER_STATE yy_scan_bytes ( const char *bytes, int len  );
+YY_BUFFER_STATE yy_scan_buffer ( char *base, yy_size_t size , yyscan_t yyscanner );
+YY_BUFFER_STATE yy_scan_string ( const char *yy_str , yyscan_t yyscanner );
+YY_BUFFER_STATE yy_scan_bytes ( const char *bytes, int len , yyscan_t yyscanner );
 
-void *yyalloc ( yy_size_t  );
-void *yyrealloc ( void *, yy_size_t  );
-void yyfree ( void *  );
+void *yyalloc ( yy_size_t , yyscan_t yyscanner );
+void *yyrealloc ( void *, yy_size_t , yyscan_t yyscanner );
+void yyfree ( void * , yyscan_t yyscanner );
 
 /* Begin user sect3 */
 
-#define yywrap() (/*CONSTCOND*/1)
+#define yywrap(yyscanner) (/*CONSTCOND*/1)
 #define YY_SKIP_YYWRAP
 
-extern int yylineno;
-
-extern char *yytext;
-#ifdef yytext_ptr
-#undef yytext_ptr
-#endif
-#define yytext_ptr yytext
+#define yytext_ptr yytext_r
 
 #ifdef YY_HEADER_EXPORT_START_CONDITIONS
 #define INITIAL 0
@@ -324,46 +492,56 @@ extern char *yytext;
 #include <unistd.h>
 #endif
 
+#define YY_EXTRA_TYPE yyextra_t*
+
 #ifndef YY_EXTRA_TYPE
 #define YY_EXTRA_TYPE void *
 #endif
 
+int yylex_init (yyscan_t* scanner);
+
+int yylex_init_extra ( YY_EXTRA_TYPE user_defined, yyscan_t* scanner);
+
 /* Accessor methods to globals.
    These are made visible to non-reentrant scanners for convenience. */
 
-int yylex_destroy ( void );
+int yylex_destroy ( yyscan_t yyscanner );
+
+int yyget_debug ( yyscan_t yyscanner );
+
+void yyset_debug ( int debug_flag , yyscan_t yyscanner );
 
-int yyget_debug ( void );
+YY_EXTRA_TYPE yyget_extra ( yyscan_t yyscanner );
 
-void yyset_debug ( int debug_flag  );
+void yyset_extra ( YY_EXTRA_TYPE user_defined , yyscan_t yyscanner );
 
-YY_EXTRA_TYPE yyget_extra ( void );
+FILE *yyget_in ( yyscan_t yyscanner );
 
-void yyset_extra ( YY_EXTRA_TYPE user_defined  );
+void yyset_in  ( FILE * _in_str , yyscan_t yyscanner );
 
-FILE *yyget_in ( void );
+FILE *yyget_out ( yyscan_t yyscanner );
 
-void yyset_in  ( FILE * _in_str  );
+void yyset_out  ( FILE * _out_str , yyscan_t yyscanner );
 
-FILE *yyget_out ( void );
+			int yyget_leng ( yyscan_t yyscanner );
 
-void yyset_out  ( FILE * _out_str  );
+char *yyget_text ( yyscan_t yyscanner );
 
-			int yyget_leng ( void );
+int yyget_lineno ( yyscan_t yyscanner );
 
-char *yyget_text ( void );
+void yyset_lineno ( int _line_number , yyscan_t yyscanner );
 
-int yyget_lineno ( void );
+int yyget_column  ( yyscan_t yyscanner );
 
-void yyset_lineno ( int _line_number  );
+void yyset_column ( int _column_no , yyscan_t yyscanner );
 
-YYSTYPE * yyget_lval ( void );
+YYSTYPE * yyget_lval ( yyscan_t yyscanner );
 
-void yyset_lval ( YYSTYPE * yylval_param  );
+void yyset_lval ( YYSTYPE * yylval_param , yyscan_t yyscanner );
 
-       YYLTYPE *yyget_lloc ( void );
+       YYLTYPE *yyget_lloc ( yyscan_t yyscanner );
     
-        void yyset_lloc ( YYLTYPE * yylloc_param  );
+        void yyset_lloc ( YYLTYPE * yylloc_param , yyscan_t yyscanner );
     
 /* Macros after this point can all be overridden by user definitions in
  * section 1.
@@ -371,18 +549,18 @@ void yyset_lval ( YYSTYPE * yylval_param  );
 
 #ifndef YY_SKIP_YYWRAP
 #ifdef __cplusplus
-extern "C" int yywrap ( void );
+extern "C" int yywrap ( yyscan_t yyscanner );
 #else
-extern int yywrap ( void );
+extern int yywrap ( yyscan_t yyscanner );
 #endif
 #endif
 
 #ifndef yytext_ptr
-static void yy_flex_strncpy ( char *, const char *, int );
+static void yy_flex_strncpy ( char *, const char *, int , yyscan_t yyscanner);
 #endif
 
 #ifdef YY_NEED_STRLEN
-static int yy_flex_strlen ( const char * );
+static int yy_flex_strlen ( const char * , yyscan_t yyscanner);
 #endif
 
 #ifndef YY_NO_INPUT
@@ -411,10 +589,10 @@ static int yy_flex_strlen ( const char * );
 #define YY_DECL_IS_OURS 1
 
 extern int yylex \
-               (YYSTYPE * yylval_param, YYLTYPE * yylloc_param );
+               (YYSTYPE * yylval_param, YYLTYPE * yylloc_param , yyscan_t yyscanner);
 
 #define YY_DECL int yylex \
-               (YYSTYPE * yylval_param, YYLTYPE * yylloc_param )
+               (YYSTYPE * yylval_param, YYLTYPE * yylloc_param , yyscan_t yyscanner)
 #endif /* !YY_DECL */
 
 /* yy_get_previous_state - get the state just before the EOB char was reached */
@@ -576,9 +754,9 @@ extern int yylex \
 #undef yyTABLES_NAME
 #endif
 
-#line 411 "beancount/parser/lexer.l"
+#line 658 "beancount/parser/lexer.l"
 
 
-#line 583 "beancount/parser/lexer.h"
+#line 761 "beancount/parser/lexer.h"
 #undef yyIN_HEADER
 #endif /* yyHEADER_H */
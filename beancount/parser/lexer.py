@@ -3,6 +3,7 @@
 __copyright__ = "Copyright (C) 2014-2016  Martin Blais"
 __license__ = "GNU GPLv2"
 
+import array
 import collections
 import datetime
 import re
@@ -163,7 +164,7 @@ class LexBuilder:
                                "Invalid number format: '{}'".format(number), None))
             else:
                 int_string, float_string = match.groups()
-                reformatted_number = r"{:,.0f}".format(int(int_string.replace(",", "")))
+                reformatted_number = r"{:,d}".format(int(int_string.replace(",", "")))
                 if int_string != reformatted_number:
                     self.errors.append(
                         LexerError(self.get_lexer_location(),
@@ -224,15 +225,15 @@ def lex_iter(file, builder=None, encoding=None):
         filename = file.name
     if builder is None:
         builder = LexBuilder()
-    _parser.lexer_initialize(filename, builder, encoding)
+    lexer = _parser.lexer_initialize(filename, builder, encoding)
     try:
         while 1:
-            token_tuple = _parser.lexer_next()
+            token_tuple = _parser.lexer_next(lexer)
             if token_tuple is None:
                 break
             yield token_tuple
     finally:
-        _parser.lexer_finalize()
+        _parser.lexer_finalize(lexer)
 
 
 def lex_iter_string(string, builder=None, encoding=None):
@@ -251,3 +252,43 @@ def lex_iter_string(string, builder=None, encoding=None):
     tmp_file.flush()
     # Note: We pass in the file object in order to keep it alive during parsing.
     return lex_iter(tmp_file, builder, encoding)
+
+
+# The names of the token types returned by tokenize(), keyed by token type.
+TOKEN_NAMES = _parser.get_token_names()
+
+# The number of integers stored for each token by tokenize().
+TOKEN_NUM_FIELDS = 5
+
+
+def tokenize(file, builder=None):
+    """Tokenize a file without building the values of its tokens.
+
+    This is much faster than lex_iter() for callers which only need the types
+    and positions of the tokens, e.g., editors and syntax checkers: no Python
+    object is created for each token. The GIL is released while the file is
+    loaded and scanned, so other threads keep running; it is only reacquired to
+    call the builder's build_lexer_error() method for invalid tokens.
+
+    Args:
+      file: A string, the filename to run the lexer on, or a file object.
+      builder: A builder of your choice, which receives the errors of invalid
+        tokens. Invalid values, e.g. impossible dates, are not detected, as they
+        are not built. If not specified, a LexBuilder is used and discarded
+        (along with its errors).
+    Returns:
+      An array of integers, TOKEN_NUM_FIELDS for each token: its type (a key of
+      TOKEN_NAMES), the line and column where it begins (both starting at 1),
+      and the byte offset and length of its text in the file. A string literal
+      is located at its opening quote, and an EOL at the end of the line it
+      terminates.
+    """
+    if isinstance(file, str):
+        filename = file
+    else:
+        filename = file.name
+    if builder is None:
+        builder = LexBuilder()
+    tokens = array.array('i')
+    tokens.frombytes(_parser.lexer_tokenize(filename, builder, None))
+    return tokens
@@ -4,13 +4,16 @@ Tests for lexer.
 __copyright__ = "Copyright (C) 2014-2016  Martin Blais"
 __license__ = "GNU GPLv2"
 
+import concurrent.futures
 import datetime
 import functools
 import textwrap
 import unittest
 import re
+import tempfile
 
 from beancount.core.number import D
+from beancount.core.number import Decimal
 from beancount.parser import lexer
 
 
@@ -407,6 +410,20 @@ class TestLexer(unittest.TestCase):
         self.assertTrue(tokens[0], 'LEX_ERROR')
         self.assertTrue(tokens[1], 'EOL')
 
+    def test_string_escaped_buffer_boundaries(self):
+        # Long literals with escape sequences straddle the boundaries of the
+        # buffers the input is read in, and are decoded by different paths.
+        value = 'Escaped "quotes" \\ and\ttabs, ' * 1000 + '\nend'
+        literal = '"{}"'.format(
+            value.replace('\\', r'\\').replace('"', r'\"').replace('\t', r'\t'))
+        string = '\n'.join([literal] * 3) + '\n2014-01-01\n'
+        builder = lexer.LexBuilder()
+        tokens = list(lexer.lex_iter_string(string, builder))
+        self.assertFalse(builder.errors)
+        self.assertEqual([value] * 3,
+                         [token[3] for token in tokens if token[0] == 'STRING'])
+        self.assertEqual(('DATE', 7), tokens[-3][:2])
+
     @lex_tokens
     def test_popmeta(self, tokens, errors):
         '''
@@ -509,6 +526,14 @@ class TestIgnoredLines(unittest.TestCase):
         ], tokens)
         self.assertFalse(errors)
 
+    def test_ignored__long_lines(self):
+        # Long skipped lines straddle the boundaries of the input buffers.
+        string = ('* ' + 'x' * 10000 + '\n') * 5 + '2014-01-01 open Assets:Cash\n'
+        tokens = list(lexer.lex_iter_string(string))
+        self.assertEqual(['SKIPPED', 'EOL'] * 5 + ['DATE', 'OPEN', 'ACCOUNT', 'EOL', 'EOL'],
+                         [token[0] for token in tokens])
+        self.assertEqual(('DATE', 6), tokens[10][:2])
+
     @lex_tokens
     def test_ignored__org_mode_drawer(self, tokens, errors):
         """
@@ -748,6 +773,18 @@ class TestLexerUnicode(unittest.TestCase):
 
 class TestLexerMisc(unittest.TestCase):
 
+    def test_lex_iter_interleaved(self):
+        # Two lexers may run at the same time, each with their own state.
+        iter1 = lexer.lex_iter_string('2014-01-01 open Assets:Cash\n')
+        iter2 = lexer.lex_iter_string('"string" 1.23 USD\n')
+        tokens = [(next(iter1)[0], next(iter2)[0]) for _ in range(4)]
+        self.assertEqual([('DATE', 'STRING'),
+                          ('OPEN', 'NUMBER'),
+                          ('ACCOUNT', 'CURRENCY'),
+                          ('EOL', 'EOL')], tokens)
+        self.assertEqual([('EOL', 2, '\x00', None)], list(iter1))
+        self.assertEqual([('EOL', 2, '\x00', None)], list(iter2))
+
     @lex_tokens
     def test_valid_commas_in_number(self, tokens, errors):
         """\
@@ -772,6 +809,112 @@ class TestLexerMisc(unittest.TestCase):
             ('EOL', 2, '\x00', None),
         ], tokens)
 
+    def test_interned_tokens(self):
+        string = textwrap.dedent("""\
+          Assets:Cash USD #tag ^link key: Assets:Cash USD #tag ^link key:
+          Assets:Checking CAD #tag2 ^link2 key2:
+        """)
+        builder = lexer.LexBuilder()
+        tokens = list(lexer.lex_iter_string(string, builder))
+        values = [token[3] for token in tokens if token[0] not in ('EOL', 'COLON')]
+        self.assertEqual(['Assets:Cash', 'USD', 'tag', 'link', 'key',
+                          'Assets:Cash', 'USD', 'tag', 'link', 'key',
+                          'Assets:Checking', 'CAD', 'tag2', 'link2', 'key2'], values)
+        # Repeated tokens share the same object.
+        for value1, value2 in zip(values[0:5], values[5:10]):
+            self.assertIs(value1, value2)
+        self.assertEqual({'USD', 'CAD'}, builder.commodities)
+        self.assertFalse(builder.errors)
+
+    def test_interned_tokens_overridden(self):
+        class CountingBuilder(lexer.LexBuilder):
+            num_calls = 0
+            def ACCOUNT(self, account_name):
+                self.num_calls += 1
+                return super().ACCOUNT(account_name)
+        builder = CountingBuilder()
+        list(lexer.lex_iter_string('Assets:Cash Assets:Cash Assets:Cash', builder))
+        self.assertEqual(3, builder.num_calls)
+
+    def test_native_numbers(self):
+        # Numbers are converted natively by default; check that this produces
+        # the same tokens and errors as the builder method.
+        class PythonNumberBuilder(lexer.LexBuilder):
+            def NUMBER(self, number):
+                self.num_calls = getattr(self, 'num_calls', 0) + 1
+                return super().NUMBER(number)
+        string = textwrap.dedent("""\
+          0 00 0.0 1. 123 1234 1,234 12,345 123,456.78 1,234,567.8901
+          1,23 1234,567 0,123 01,234 1,,234 12345678901234567890.123456789
+          1111111111111111111111111111111111111111111111111111111111111111111111.2
+          1,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111.2
+        """)
+        native_builder = lexer.LexBuilder()
+        native_tokens = list(lexer.lex_iter_string(string, native_builder))
+        python_builder = PythonNumberBuilder()
+        python_tokens = list(lexer.lex_iter_string(string, python_builder))
+        self.assertEqual(python_tokens, native_tokens)
+        self.assertEqual(18, python_builder.num_calls)
+        self.assertEqual([error.message for error in python_builder.errors],
+                         [error.message for error in native_builder.errors])
+        self.assertEqual(5, len(native_builder.errors))
+        for token in native_tokens:
+            if token[0] == 'NUMBER':
+                self.assertIsInstance(token[3], Decimal)
+
+    def test_native_dates(self):
+        # Dates are built natively by default and reused; check that this
+        # produces the same tokens and errors as the builder method.
+        class PythonDateBuilder(lexer.LexBuilder):
+            num_calls = 0
+            def DATE(self, year, month, day):
+                self.num_calls += 1
+                return super().DATE(year, month, day)
+        string = textwrap.dedent("""\
+          2014-01-01 2014/01/01 2014-1-1 2014-01-01 2014-02-30 2014-13-01
+          2014-02-30 0000-01-01 1-2-3 9999-12-31
+        """)
+        native_builder = lexer.LexBuilder()
+        native_tokens = list(lexer.lex_iter_string(string, native_builder))
+        python_builder = PythonDateBuilder()
+        python_tokens = list(lexer.lex_iter_string(string, python_builder))
+        self.assertEqual(python_tokens, native_tokens)
+        self.assertEqual(9, python_builder.num_calls)
+        self.assertEqual([error.message for error in python_builder.errors],
+                         [error.message for error in native_builder.errors])
+        self.assertEqual(4, len(native_builder.errors))
+        self.assertIs(native_tokens[0][3], native_tokens[3][3])
+        self.assertEqual(datetime.date(2014, 1, 1), native_tokens[1][3])
+        self.assertEqual(datetime.date(9999, 12, 31), native_tokens[-3][3])
+
+    def test_native_strings(self):
+        # Strings are built natively by default; check that this produces the
+        # same tokens and warnings as the builder method.
+        class PythonStringBuilder(lexer.LexBuilder):
+            num_calls = 0
+            def STRING(self, string):
+                self.num_calls += 1
+                return super().STRING(string)
+        string = ('"short" "two\nlines" "three\n\nlines" "esc\\"aped\nthree\n"\n' +
+                  '"{}"\n'.format('line\n' * 3 + 'x' * 20000))
+        tokens = []
+        for maxlines in 2, 3, 64:
+            native_builder = lexer.LexBuilder()
+            native_builder.long_string_maxlines_default = maxlines
+            native_tokens = list(lexer.lex_iter_string(string, native_builder))
+            python_builder = PythonStringBuilder()
+            python_builder.long_string_maxlines_default = maxlines
+            python_tokens = list(lexer.lex_iter_string(string, python_builder))
+            self.assertEqual(python_tokens, native_tokens)
+            self.assertEqual(5, python_builder.num_calls)
+            self.assertEqual([(error.source['lineno'], error.message)
+                              for error in python_builder.errors],
+                             [(error.source['lineno'], error.message)
+                              for error in native_builder.errors])
+            tokens.append(native_tokens)
+            self.assertEqual({2: 3, 3: 1, 64: 0}[maxlines], len(native_builder.errors))
+        self.assertEqual('esc"aped\nthree\n', tokens[0][3][3])
+
     @lex_tokens
     def test_invalid_commas_in_fractional(self, tokens, errors):
         """\
@@ -790,5 +933,155 @@ class TestLexerMisc(unittest.TestCase):
         ], tokens)
 
 
+class TestTokenize(unittest.TestCase):
+
+    maxDiff = None
+
+    def tokenize(self, string):
+        """Tokenize a string and check that the token types and their texts
+        match those of lex_iter().
+
+        Args:
+          string: A str, the contents of a file.
+        Returns:
+          A list of (token-name, line, column, text) tuples, and the errors.
+        """
+        with tempfile.NamedTemporaryFile('wb') as file:
+            contents = string.encode('utf8')
+            file.write(contents)
+            file.flush()
+            builder = lexer.LexBuilder()
+            tokens = lexer.tokenize(file.name, builder)
+            self.assertEqual(0, len(tokens) % lexer.TOKEN_NUM_FIELDS)
+            result = []
+            for index in range(0, len(tokens), lexer.TOKEN_NUM_FIELDS):
+                token, line, column, offset, length = tokens[
+                    index:index + lexer.TOKEN_NUM_FIELDS]
+                result.append((lexer.TOKEN_NAMES[token], line, column,
+                               contents[offset:offset + length].decode('utf8')))
+
+            iter_builder = lexer.LexBuilder()
+            self.assertEqual([token[0] for token in lexer.lex_iter(file.name,
+                                                                   iter_builder)],
+                             [token[0] for token in result])
+            self.assertEqual([error.message for error in iter_builder.errors],
+                             [error.message for error in builder.errors])
+        return result, builder.errors
+
+    def test_tokenize(self):
+        tokens, errors = self.tokenize(textwrap.dedent('''\
+          2013-05-18 * "Nice dinner at Mermaid Inn" #trip ^link
+            key: TRUE
+            Expenses:Café         {{100.00 USD}} ; Comment
+          * Org title
+        '''))
+        self.assertEqual([], errors)
+        self.assertEqual([
+            ('DATE', 1, 1, '2013-05-18'),
+            ('ASTERISK', 1, 12, '*'),
+            ('STRING', 1, 14, '"Nice dinner at Mermaid Inn"'),
+            ('TAG', 1, 43, '#trip'),
+            ('LINK', 1, 49, '^link'),
+            ('EOL', 1, 54, '\n'),
+            ('INDENT', 2, 1, '  '),
+            ('KEY', 2, 3, 'key'),
+            ('COLON', 2, 6, ':'),
+            ('BOOL', 2, 8, 'TRUE'),
+            ('EOL', 2, 12, '\n'),
+            ('INDENT', 3, 1, '  '),
+            ('ACCOUNT', 3, 3, 'Expenses:Café'),
+            ('LCURLCURL', 3, 26, '{{'),
+            ('NUMBER', 3, 28, '100.00'),
+            ('CURRENCY', 3, 35, 'USD'),
+            ('RCURLCURL', 3, 38, '}}'),
+            ('COMMENT', 3, 41, '; Comment'),
+            ('EOL', 3, 50, '\n'),
+            ('SKIPPED', 4, 1, '* Org title'),
+            ('EOL', 4, 12, '\n'),
+            ('EOL', 5, 1, ''),
+        ], tokens)
+
+    def test_tokenize_strings(self):
+        tokens, errors = self.tokenize(
+            '2014-01-01 note Assets:Cash "Multiple\nlines" "Escaped \\"quote\\"\n\n"')
+        self.assertEqual([], errors)
+        self.assertEqual([
+            ('DATE', 1, 1, '2014-01-01'),
+            ('NOTE', 1, 12, 'note'),
+            ('ACCOUNT', 1, 17, 'Assets:Cash'),
+            ('STRING', 1, 29, '"Multiple\nlines"'),
+            ('STRING', 2, 8, '"Escaped \\"quote\\"\n\n"'),
+            ('EOL', 4, 2, ''),
+        ], tokens)
+
+    def test_tokenize_errors(self):
+        tokens, errors = self.tokenize('2014-01-01 open Assets:Cash $$$ )\n')
+        self.assertEqual(1, len(errors))
+        self.assertEqual([
+            ('DATE', 1, 1, '2014-01-01'),
+            ('OPEN', 1, 12, 'open'),
+            ('ACCOUNT', 1, 17, 'Assets:Cash'),
+            ('LEX_ERROR', 1, 29, '$$$'),
+            ('RPAREN', 1, 33, ')'),
+            ('EOL', 1, 34, '\n'),
+            ('EOL', 2, 1, ''),
+        ], tokens)
+
+    def test_tokenize_long_lines(self):
+        string = ('* ' + 'x' * 10000 + '\n' +
+                  '"' + r'\"quoted\" ' * 3000 + '"\n')
+        tokens, errors = self.tokenize(string)
+        self.assertEqual([], errors)
+        self.assertEqual([
+            ('SKIPPED', 1, 1, '* ' + 'x' * 10000),
+            ('EOL', 1, 10003, '\n'),
+            ('STRING', 2, 1, '"' + r'\"quoted\" ' * 3000 + '"'),
+            ('EOL', 2, 33003, '\n'),
+            ('EOL', 3, 1, ''),
+        ], tokens)
+
+    def test_tokenize_empty(self):
+        tokens, errors = self.tokenize('')
+        self.assertEqual([], errors)
+        self.assertEqual([('EOL', 1, 1, '')], tokens)
+
+    def test_tokenize_threads(self):
+        # The GIL is released while scanning and reacquired to report errors.
+        string = ''.join('2014-01-01 open Assets:Cash{} $$$ TRUE NULL\n'.format(index)
+                         for index in range(10000))
+        with tempfile.NamedTemporaryFile('w') as file:
+            file.write(string)
+            file.flush()
+            def tokenize(_):
+                builder = lexer.LexBuilder()
+                tokens = lexer.tokenize(file.name, builder)
+                return tokens, [(error.source['filename'], error.source['lineno'])
+                                for error in builder.errors]
+            with concurrent.futures.ThreadPoolExecutor(4) as executor:
+                results = list(executor.map(tokenize, range(8)))
+        tokens, errors = results[0]
+        self.assertEqual(7 * 10000 + 1, len(tokens) // lexer.TOKEN_NUM_FIELDS)
+        self.assertEqual([(file.name, index + 1) for index in range(10000)], errors)
+        for result in results[1:]:
+            self.assertEqual(results[0], result)
+
+    def test_tokenize_error_raises(self):
+        class RaisingBuilder(lexer.LexBuilder):
+            def build_lexer_error(self, message, exc_type=None):
+                raise ValueError(message)
+        with tempfile.NamedTemporaryFile('w') as file:
+            file.write('2014-01-01 open Assets:Cash $$$\n')
+            file.flush()
+            with self.assertRaises(RuntimeError):
+                lexer.tokenize(file.name, RaisingBuilder())
+        with self.assertRaises(IOError):
+            lexer.tokenize('/does/not/exist.beancount')
+
+    def test_token_names(self):
+        names = set(lexer.TOKEN_NAMES.values())
+        self.assertLessEqual({'DATE', 'COMMODITY', 'INCLUDE', 'LCURLCURL'}, names)
+        self.assertNotIn('<NO_STRING_TRANSLATION>', lexer.TOKEN_NAMES.values())
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,360 @@
+"""An index of the lots held in the balances of accounts, for booking.
+
+Booking a posting which reduces the inventory of its account matches its cost
+spec against the positions of that inventory. Scanning all the positions of the
+inventory for each reduction, and copying it for each transaction, makes booking
+quadratic in the number of lots of accounts which hold many of them, e.g.,
+accounts with reinvested dividends. Instead, a LotIndex keeps the positions of
+the balances of the accounts indexed by currency, and for each currency, the
+lots held at cost indexed by cost number, date and label, and ordered by date.
+Matching a cost spec then looks up the smallest of these, and FIFO and LIFO
+reductions only walk the oldest or most recent lots, as many as are needed.
+
+The matches are returned in the same order as that of the positions in the
+inventory, or for FIFO and LIFO, in the order in which the booking method
+reduces them, so that booking yields exactly the same results as scanning the
+inventory.
+"""
+__copyright__ = "Copyright (C) 2017  Martin Blais"
+__license__ = "GNU GPLv2"
+
+import bisect
+import collections
+import itertools
+
+from beancount.core.number import ZERO
+from beancount.core.data import Booking
+from beancount.core.amount import Amount
+from beancount.core.position import Position
+from beancount.core import inventory
+
+
+class CurrencyLots:
+    """The positions of one currency in the balance of an account.
+
+    Attributes:
+      num_positive: The number of positions with a positive or zero number of
+        units, held at cost or not.
+      num_negative: The number of positions with a negative number of units.
+      costs: A dict of the Cost instances of the positions held at cost to their
+        sequence number, in the order of the positions in the inventory.
+      by_number: A dict of cost number to the set of Cost instances.
+      by_date: A dict of cost date to the set of Cost instances.
+      by_label: A dict of cost label to the set of Cost instances.
+      dated: A sorted list of (date, sequence number, Cost instance) for the
+        costs with a date.
+      num_undated: The number of costs without a date.
+    """
+    __slots__ = ('num_positive', 'num_negative', 'costs',
+                 'by_number', 'by_date', 'by_label', 'dated', 'num_undated')
+
+    def __init__(self):
+        self.num_positive = 0
+        self.num_negative = 0
+        self.costs = {}
+        self.by_number = collections.defaultdict(set)
+        self.by_date = collections.defaultdict(set)
+        self.by_label = collections.defaultdict(set)
+        self.dated = []
+        self.num_undated = 0
+
+    def add(self, cost, sequence):
+        """Index a new cost.
+
+        Args:
+          cost: An instance of Cost.
+          sequence: Its sequence number.
+        """
+        self.costs[cost] = sequence
+        self.by_number[cost.number].add(cost)
+        self.by_date[cost.date].add(cost)
+        self.by_label[cost.label].add(cost)
+        if cost.date is None:
+            self.num_undated += 1
+        else:
+            bisect.insort(self.dated, (cost.date, sequence, cost))
+
+    def remove(self, cost):
+        """Remove a cost from the index.
+
+        Args:
+          cost: An instance of Cost.
+        """
+        sequence = self.costs.pop(cost)
+        for index, key in ((self.by_number, cost.number),
+                           (self.by_date, cost.date),
+                           (self.by_label, cost.label)):
+            costs = index[key]
+            costs.discard(cost)
+            if not costs:
+                del index[key]
+        if cost.date is None:
+            self.num_undated -= 1
+        else:
+            del self.dated[bisect.bisect_left(self.dated, (cost.date, sequence))]
+
+    def iter_dated(self, reverse):
+        """Iterate over the dated costs in the order of FIFO or LIFO reductions.
+
+        The costs are sorted by date, or by reverse date, and the costs with the
+        same date in the order of the inventory, as the booking methods sort
+        them.
+
+        Args:
+          reverse: A boolean, true to iterate from the most recent costs.
+        Yields:
+          Instances of Cost.
+        """
+        if not reverse:
+            for _, _, cost in self.dated:
+                yield cost
+        else:
+            end = len(self.dated)
+            while end > 0:
+                begin = bisect.bisect_left(self.dated, (self.dated[end - 1][0],))
+                for _, _, cost in self.dated[begin:end]:
+                    yield cost
+                end = begin
+
+
+class LotIndex:
+    """The balances of accounts, with an index of their positions.
+
+    Attributes:
+      balances: A dict of account name to Inventory instance. The inventories
+        must only be updated through add_position(), which updates the index.
+      lots: A dict of account name to a dict of currency to CurrencyLots.
+      cost_currencies: A dict of account name to a dict of cost currency to the
+        number of positions held at cost in that currency.
+      sequence: An iterator of the sequence numbers of new positions.
+    """
+
+    def __init__(self, balances=None):
+        """Create an index of existing balances.
+
+        Args:
+          balances: A dict of account name to Inventory instance, or None. The
+            inventories are not copied, and add_position() updates them.
+        """
+        self.balances = collections.defaultdict(inventory.Inventory)
+        self.lots = {}
+        self.cost_currencies = {}
+        self.sequence = itertools.count()
+        if balances:
+            self.balances.update(balances)
+            for account, balance in balances.items():
+                for position in balance:
+                    self._add(account, position.units, position.cost)
+
+    def _add(self, account, units, cost):
+        """Index a new position.
+
+        Args:
+          account: A string, the account name.
+          units: The Amount of the position.
+          cost: The Cost of the position, or None.
+        """
+        account_lots = self.lots.setdefault(account, {})
+        lots = account_lots.get(units.currency)
+        if lots is None:
+            lots = account_lots[units.currency] = CurrencyLots()
+        if units.number >= ZERO:
+            lots.num_positive += 1
+        else:
+            lots.num_negative += 1
+        if cost is not None:
+            lots.add(cost, next(self.sequence))
+            cost_currencies = self.cost_currencies.setdefault(account, {})
+            cost_currencies[cost.currency] = cost_currencies.get(cost.currency, 0) + 1
+
+    def add_position(self, account, position):
+        """Add a position or posting to the balance of an account.
+
+        Args:
+          account: A string, the account name.
+          position: An instance of Position or Posting.
+        """
+        old_position, booking = self.balances[account].add_position(position)
+        if booking is inventory.Booking.CREATED:
+            self._add(account, position.units, position.cost)
+        elif booking is not inventory.Booking.IGNORED:
+            units = old_position.units
+            lots = self.lots[account][units.currency]
+            if units.number >= ZERO:
+                lots.num_positive -= 1
+            else:
+                lots.num_negative -= 1
+            new_position = self.balances[account].get((units.currency, old_position.cost))
+            if new_position is None:
+                cost = old_position.cost
+                if cost is not None:
+                    lots.remove(cost)
+                    cost_currencies = self.cost_currencies[account]
+                    cost_currencies[cost.currency] -= 1
+                    if not cost_currencies[cost.currency]:
+                        del cost_currencies[cost.currency]
+            elif new_position.units.number >= ZERO:
+                lots.num_positive += 1
+            else:
+                lots.num_negative += 1
+
+    def get_currencies(self, account):
+        """Get the currencies of the units held in the balance of an account.
+
+        Args:
+          account: A string, the account name.
+        Returns:
+          A set of currency strings, as from Inventory.currencies().
+        """
+        return {currency
+                for currency, lots in self.lots.get(account, {}).items()
+                if lots.num_positive or lots.num_negative}
+
+    def get_cost_currencies(self, account):
+        """Get the cost currencies of the positions in the balance of an account.
+
+        Args:
+          account: A string, the account name.
+        Returns:
+          A set of currency strings, as from Inventory.cost_currencies().
+        """
+        return set(self.cost_currencies.get(account, ()))
+
+    def get_balance(self, account, changes=None):
+        """Get the balance of an account.
+
+        Args:
+          account: A string, the account name.
+          changes: An Inventory of changes to apply to the balance, or None.
+        Returns:
+          A new Inventory instance.
+        """
+        balance = inventory.Inventory(self.balances.get(account, {}))
+        if changes is not None:
+            balance.add_inventory(changes)
+        return balance
+
+    def is_reduced_by(self, account, units, changes=None):
+        """Return true if an amount could reduce the balance of an account.
+
+        This is Inventory.is_reduced_by() on the changed balance of the account.
+
+        Args:
+          account: A string, the account name.
+          units: An instance of Amount.
+          changes: An Inventory of changes to apply to the balance, or None.
+        Returns:
+          A boolean.
+        """
+        if units.number == ZERO:
+            return False
+        lots = self.lots.get(account, {}).get(units.currency)
+        if lots is None:
+            return False
+        num_positive, num_negative = lots.num_positive, lots.num_negative
+        if changes is not None:
+            balance = self.balances[account]
+            for key, change in changes.items():
+                if key[0] != units.currency:
+                    continue
+                number = balance[key].units.number
+                if number >= ZERO:
+                    num_positive -= 1
+                else:
+                    num_negative -= 1
+                number += change.units.number
+                if number > ZERO:
+                    num_positive += 1
+                elif number < ZERO:
+                    num_negative += 1
+        return bool(num_negative if units.number >= ZERO else num_positive)
+
+    def match(self, account, units, costspec, cost_number, method, changes=None):
+        """Find the positions held at cost which match a reducing posting.
+
+        Args:
+          account: A string, the account name.
+          units: The Amount of the posting.
+          costspec: The CostSpec of the posting.
+          cost_number: The cost number of the posting, or None, as computed
+            from its cost spec.
+          method: The Booking method of the account.
+          changes: An Inventory of changes to apply to the balance, or None.
+        Returns:
+          A list of the matching positions, in the order of the inventory, or
+          for FIFO and LIFO, as many of them as the posting can reduce, in the
+          order in which they are reduced.
+        """
+        account_lots = self.lots.get(account, {})
+        if units.currency:
+            lots_list = ([(units.currency, account_lots[units.currency])]
+                         if units.currency in account_lots else [])
+        else:
+            lots_list = list(account_lots.items())
+
+        def matches_spec(cost):
+            return not ((cost_number is not None and cost.number != cost_number) or
+                        (isinstance(costspec.currency, str) and
+                         cost.currency != costspec.currency) or
+                        (costspec.date and cost.date != costspec.date) or
+                        (costspec.label and cost.label != costspec.label))
+
+        balance = self.balances.get(account, {})
+        def get_position(currency, cost):
+            position = balance[(currency, cost)]
+            if changes is not None:
+                change = changes.get((currency, cost))
+                if change is not None:
+                    number = position.units.number + change.units.number
+                    if number == ZERO:
+                        return None
+                    position = Position(Amount(number, currency), cost)
+            return position
+
+        # Reduce the oldest or most recent lots first.
+        if (len(lots_list) == 1 and
+            (method is Booking.FIFO or method is Booking.LIFO) and
+            not (cost_number is not None or costspec.date or costspec.label) and
+            lots_list[0][1].num_undated == 0):
+            currency, lots = lots_list[0]
+            sign = -1 if units.number < ZERO else 1
+            remaining = abs(units.number)
+            matches = []
+            for cost in lots.iter_dated(method is Booking.LIFO):
+                if remaining <= ZERO:
+                    return [position for _, position in matches]
+                if not matches_spec(cost):
+                    continue
+                position = get_position(currency, cost)
+                if position is None:
+                    continue
+                matches.append((lots.costs[cost], position))
+                if position.units.number * sign <= ZERO:
+                    remaining -= min(abs(position.units.number), remaining)
+            if remaining <= ZERO:
+                return [position for _, position in matches]
+            # There are not enough lots; return them all, in order.
+            return [position for _, position in sorted(matches, key=lambda m: m[0])]
+
+        # Look up the smallest of the indexes which apply.
+        matches = []
+        for currency, lots in lots_list:
+            candidates = lots.costs
+            for index, key, applies in (
+                    (lots.by_number, cost_number, cost_number is not None),
+                    (lots.by_date, costspec.date, costspec.date),
+                    (lots.by_label, costspec.label, costspec.label)):
+                if applies:
+                    costs = index.get(key, ())
+                    if len(costs) < len(candidates):
+                        candidates = costs
+            for cost in candidates:
+                if matches_spec(cost):
+                    matches.append((lots.costs[cost], currency, cost))
+        matches.sort(key=lambda match: match[0])
+        positions = []
+        for _, currency, cost in matches:
+            position = get_position(currency, cost)
+            if position is not None:
+                positions.append(position)
+        return positions
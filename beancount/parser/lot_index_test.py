@@ -0,0 +1,112 @@
+__copyright__ = "Copyright (C) 2017  Martin Blais"
+__license__ = "GNU GPLv2"
+
+import datetime
+import unittest
+
+from beancount.core.number import D
+from beancount.core.amount import A
+from beancount.core.data import Booking
+from beancount.core.position import Cost
+from beancount.core.position import CostSpec
+from beancount.core.position import Position
+from beancount.core import inventory
+from beancount.parser import lot_index
+
+
+def cost(number, date, label=None):
+    return Cost(D(number), 'USD', datetime.date(2017, 1, date), label)
+
+
+EMPTY_SPEC = CostSpec(None, None, None, None, None, False)
+
+
+class TestLotIndex(unittest.TestCase):
+
+    def setUp(self):
+        self.index = lot_index.LotIndex()
+        for position in [Position(A('10 HOOL'), cost('1', 3)),
+                         Position(A('20 HOOL'), cost('2', 1)),
+                         Position(A('30 HOOL'), cost('3', 2, 'lot')),
+                         Position(A('40 HOOL'), cost('4', 1)),
+                         Position(A('5 CAD'), None)]:
+            self.index.add_position('Assets:Invest', position)
+
+    def match(self, number, costspec=EMPTY_SPEC, cost_number=None,
+              method=Booking.STRICT, changes=None):
+        return [position.cost.number
+                for position in self.index.match('Assets:Invest', A(number), costspec,
+                                                 cost_number, method, changes)]
+
+    def test_match(self):
+        # All lots, in the order of the inventory.
+        self.assertEqual([D('1'), D('2'), D('3'), D('4')], self.match('-1 HOOL'))
+        self.assertEqual([], self.match('-1 AAPL'))
+
+        # Lots matching the cost spec.
+        self.assertEqual([D('2')], self.match('-1 HOOL', cost_number=D('2')))
+        self.assertEqual([D('2'), D('4')],
+                         self.match('-1 HOOL', EMPTY_SPEC._replace(
+                             date=datetime.date(2017, 1, 1))))
+        self.assertEqual([D('3')], self.match('-1 HOOL', EMPTY_SPEC._replace(label='lot')))
+        self.assertEqual([], self.match('-1 HOOL', EMPTY_SPEC._replace(currency='CAD')))
+
+    def test_match_xifo(self):
+        # Only the lots which are reduced, in the order of their reduction.
+        self.assertEqual([D('2'), D('4')], self.match('-25 HOOL', method=Booking.FIFO))
+        self.assertEqual([D('1'), D('3')], self.match('-15 HOOL', method=Booking.LIFO))
+
+        # All the lots, in the order of the inventory, if there aren't enough.
+        self.assertEqual([D('1'), D('2'), D('3'), D('4')],
+                         self.match('-101 HOOL', method=Booking.FIFO))
+
+        # With changes applied to the balance.
+        changes = inventory.Inventory()
+        changes.add_amount(A('-20 HOOL'), cost('2', 1))
+        changes.add_amount(A('-5 HOOL'), cost('4', 1))
+        self.assertEqual([D('4'), D('3')], self.match('-60 HOOL', method=Booking.FIFO,
+                                                      changes=changes))
+
+    def test_add_position(self):
+        self.index.add_position('Assets:Invest', Position(A('-20 HOOL'), cost('2', 1)))
+        self.index.add_position('Assets:Invest', Position(A('-10 HOOL'), cost('4', 1)))
+        self.assertEqual([D('4'), D('3')], self.match('-31 HOOL', method=Booking.FIFO))
+        self.assertEqual(inventory.from_string(
+            '10 HOOL {1 USD, 2017-01-03}, 30 HOOL {3 USD, 2017-01-02, "lot"}, '
+            '30 HOOL {4 USD, 2017-01-01}, 5 CAD'),
+                         self.index.balances['Assets:Invest'])
+        self.assertEqual({'HOOL', 'CAD'}, self.index.get_currencies('Assets:Invest'))
+        self.assertEqual({'USD'}, self.index.get_cost_currencies('Assets:Invest'))
+
+        self.index.add_position('Assets:Invest', Position(A('-5 CAD'), None))
+        self.assertEqual({'HOOL'}, self.index.get_currencies('Assets:Invest'))
+        self.assertEqual(set(), self.index.get_currencies('Assets:Other'))
+
+    def test_is_reduced_by(self):
+        self.assertTrue(self.index.is_reduced_by('Assets:Invest', A('-1 HOOL')))
+        self.assertFalse(self.index.is_reduced_by('Assets:Invest', A('1 HOOL')))
+        self.assertFalse(self.index.is_reduced_by('Assets:Invest', A('0 HOOL')))
+        self.assertFalse(self.index.is_reduced_by('Assets:Invest', A('-1 AAPL')))
+        self.assertFalse(self.index.is_reduced_by('Assets:Other', A('-1 HOOL')))
+
+        changes = inventory.from_string('-10 HOOL {1 USD, 2017-01-03}, '
+                                        '-20 HOOL {2 USD, 2017-01-01}, '
+                                        '-30 HOOL {3 USD, 2017-01-02, "lot"}')
+        self.assertTrue(self.index.is_reduced_by('Assets:Invest', A('-1 HOOL'), changes))
+        changes.add_amount(A('-41 HOOL'), cost('4', 1))
+        self.assertFalse(self.index.is_reduced_by('Assets:Invest', A('-1 HOOL'), changes))
+        self.assertTrue(self.index.is_reduced_by('Assets:Invest', A('1 HOOL'), changes))
+
+    def test_existing_balances(self):
+        balances = {'Assets:Invest': self.index.balances['Assets:Invest']}
+        index = lot_index.LotIndex(balances)
+        self.assertIs(balances['Assets:Invest'], index.balances['Assets:Invest'])
+        self.assertEqual(self.match('-25 HOOL', method=Booking.FIFO),
+                         [position.cost.number
+                          for position in index.match('Assets:Invest', A('-25 HOOL'),
+                                                      EMPTY_SPEC, None, Booking.FIFO)])
+        self.assertEqual({'HOOL', 'CAD'}, index.get_currencies('Assets:Invest'))
+
+
+if __name__ == '__main__':
+    unittest.main()
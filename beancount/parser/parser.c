@@ -7,33 +7,163 @@
 #include "parser.h"
 #include "lexer.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#  define HAVE_MMAP 1
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
 #define XSTRINGIFY(s) STRINGIFY(s)
 #define STRINGIFY(s) #s
 
-/* The bison header file does not contain this... silly. */
-extern int yyparse(void);
-
 extern const char* getTokenName(int token);
 
-extern int yy_firstline;
 
+/* Thread-local storage qualifier. */
+#if defined(_MSC_VER)
+#  define THREAD_LOCAL __declspec(thread)
+#else
+#  define THREAD_LOCAL __thread
+#endif
 
-/* The current builder during parsing (as a global variable for now). */
-PyObject* builder = 0;
+/* The scanner currently running on this thread, if any. This is used to
+ * answer get_yyfilename() and get_yylineno() from within the builder
+ * callbacks. Each parse has its own scanner, so this is only a per-thread
+ * pointer to the innermost running one. */
+static THREAD_LOCAL yyscan_t current_scanner = NULL;
 
 /* A reference to a Python-defined constant object used as a placeholder for
    missing cost specifications. */
 PyObject* missing_obj = 0;
 
+/* A reference to the Decimal type, used to convert numbers in the lexer. */
+PyObject* decimal_type = 0;
+
 
 PyDoc_STRVAR(parse_file_doc,
 "Parse the filename, calling back methods on the builder.\n\
 Your builder is responsible to accumulating results.\n\
-If you pass in '-' for filename, stdin is parsed.");
+If you pass in '-' for filename, stdin is parsed.\n\
+Regular files are memory-mapped and scanned in place unless 'mmap' is false.\n\
+If 'fastcall' is true, the builder methods are looked up once at the start.\n\
+The GIL is released while the file is opened and loaded, and while reading\n\
+from a stream; it is held while scanning, as the token values are built.");
 
 PyDoc_STRVAR(parse_string_doc,
 "Parse the given string, calling back methods on the builder.\n\
-Your builder is responsible to accumulating results.");
+Your builder is responsible to accumulating results.\n\
+If 'fastcall' is true, the builder methods are looked up once at the start.");
+
+
+/* The names of the builder methods, indexed by builder_method_t. */
+#define BUILDER_METHOD_NAME(name) #name,
+static const char* builder_method_names[] = {
+    BUILDER_METHODS(BUILDER_METHOD_NAME)
+};
+#undef BUILDER_METHOD_NAME
+
+/* The maximum number of arguments of a builder method, plus one for the
+ * instance. */
+#define MAX_BUILDER_ARGS 16
+
+/* Look up all the methods of the builder. Methods which are missing are left
+ * out, and raise an AttributeError when called. */
+int builder_dispatch_initialize(builder_dispatch_t* dispatch, PyObject* builder)
+{
+    int i;
+    memset(dispatch, 0, sizeof(builder_dispatch_t));
+    for ( i = 0; i < NUM_BUILDER_METHODS; ++i ) {
+        PyObject* method = PyObject_GetAttrString(builder, builder_method_names[i]);
+        if ( method == NULL ) {
+            if ( !PyErr_ExceptionMatches(PyExc_AttributeError) ) {
+                builder_dispatch_finalize(dispatch);
+                return -1;
+            }
+            PyErr_Clear();
+            continue;
+        }
+        /* Unbind methods, so that the instance can be passed in the arguments
+         * vector instead of having to copy it. */
+        if ( PyMethod_Check(method) ) {
+            dispatch->functions[i] = PyMethod_GET_FUNCTION(method);
+            dispatch->selves[i] = PyMethod_GET_SELF(method);
+            Py_INCREF(dispatch->functions[i]);
+            Py_INCREF(dispatch->selves[i]);
+            Py_DECREF(method);
+        }
+        else {
+            dispatch->functions[i] = method;
+        }
+    }
+    dispatch->enabled = 1;
+    return 0;
+}
+
+void builder_dispatch_finalize(builder_dispatch_t* dispatch)
+{
+    int i;
+    for ( i = 0; i < NUM_BUILDER_METHODS; ++i ) {
+        Py_CLEAR(dispatch->functions[i]);
+        Py_CLEAR(dispatch->selves[i]);
+    }
+    dispatch->enabled = 0;
+}
+
+PyObject* call_builder(builder_dispatch_t* dispatch, builder_method_t method,
+                       const char* format, ...)
+{
+    PyObject* stack[MAX_BUILDER_ARGS];
+    PyObject* function = dispatch->functions[method];
+    PyObject* args;
+    PyObject* result;
+    va_list va;
+    Py_ssize_t nargs;
+    Py_ssize_t i;
+
+    if ( function == NULL ) {
+        return PyErr_Format(PyExc_AttributeError, "Builder has no method '%s'",
+                            builder_method_names[method]);
+    }
+
+    /* Build the arguments, with the same conventions as PyObject_CallMethod():
+     * a single tuple value is used as the arguments. */
+    va_start(va, format);
+    args = Py_VaBuildValue(format, va);
+    va_end(va);
+    if ( args == NULL ) {
+        return NULL;
+    }
+    if ( !PyTuple_Check(args) ) {
+        stack[1] = args;
+        nargs = 1;
+    }
+    else {
+        nargs = PyTuple_GET_SIZE(args);
+        if ( nargs >= MAX_BUILDER_ARGS ) {
+            result = PyObject_Call(function, args, NULL);
+            Py_DECREF(args);
+            return result;
+        }
+        for ( i = 0; i < nargs; ++i ) {
+            stack[i + 1] = PyTuple_GET_ITEM(args, i);
+        }
+    }
+
+    /* Call the function with the instance prepended, or the callable as is,
+     * allowing it to use the first slot. */
+    if ( dispatch->selves[method] != NULL ) {
+        stack[0] = dispatch->selves[method];
+        result = PyObject_Vectorcall(function, stack, nargs + 1, NULL);
+    }
+    else {
+        result = PyObject_Vectorcall(function, stack + 1,
+                                     nargs | PY_VECTORCALL_ARGUMENTS_OFFSET, NULL);
+    }
+    Py_DECREF(args);
+    return result;
+}
 
 
 /* Handle the result of yyparse() {459018e2905c}. */
@@ -42,7 +172,11 @@ PyObject* handle_yyparse_result(int result)
     /* Check for internal errors during parsing (which would be the result of
      * calling YYABORT, which we don't call), and this should raise an
      * exception. */
-    if ( result == 1 ) {
+    if ( result == -1 ) {
+        /* The parser could not be started; the exception is already set. */
+        return NULL;
+    }
+    else if ( result == 1 ) {
         return PyErr_Format(PyExc_RuntimeError, "Parser aborted (internal error)");
     }
     else if ( result == 2 ) {
@@ -52,130 +186,271 @@ PyObject* handle_yyparse_result(int result)
     Py_RETURN_NONE;
 }
 
+/* Run the parser with the given scanner, making it the current one on this
+ * thread for the duration of the parse. If 'fastcall' is true, the builder
+ * methods are bound once beforehand. Returns -1 with an exception set if this
+ * fails. */
+static int run_yyparse(yyscan_t scanner, PyObject* builder, int fastcall)
+{
+    yyscan_t previous_scanner = current_scanner;
+    yyextra_t* extra = yyget_extra(scanner);
+    int result;
+    if ( fastcall && builder_dispatch_initialize(&extra->dispatch, builder) < 0 ) {
+        return -1;
+    }
+    current_scanner = scanner;
+    native_builder_initialize(&extra->native, builder, extra->filename);
+    result = yyparse(scanner, builder);
+    native_builder_finalize(&extra->native);
+    current_scanner = previous_scanner;
+    return result;
+}
+
+#ifdef HAVE_MMAP
+/* Map the contents of a regular file into memory, followed by the two NUL
+ * bytes flex requires at the end of a buffer it scans in place. Return NULL
+ * if the file cannot be mapped, in which case the caller should fall back on
+ * reading it. The pages are private and copy-on-write, as flex temporarily
+ * writes a terminator after each token. This does not use the Python API, so
+ * that it may be called without holding the GIL. */
+static char* map_file(const char* filename, size_t* size)
+{
+    struct stat st;
+    char* base;
+    size_t page_size;
+    size_t map_size;
+    size_t offset;
+    int fd = open(filename, O_RDONLY);
+    if ( fd == -1 ) {
+        return NULL;
+    }
+    if ( fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0 ) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+
+    /* Reserve zero-filled room for the file and its terminators, then map the
+     * file over the beginning of it. */
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    map_size = ((*size + 2 + page_size - 1) / page_size) * page_size;
+    base = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ( base == MAP_FAILED ) {
+        close(fd);
+        return NULL;
+    }
+    if ( mmap(base, *size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED ) {
+        munmap(base, map_size);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    /* Read and copy the pages now, as the caller does not hold the GIL, rather
+     * than one at a time as the scan writes to them. */
+    for ( offset = 0; offset < *size; offset += page_size ) {
+        ((volatile char*)base)[offset] = base[offset];
+    }
+    return base;
+}
+
+static void unmap_file(char* base, size_t size)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    munmap(base, ((size + 2 + page_size - 1) / page_size) * page_size);
+}
+#endif
+
 PyObject* parse_file(PyObject *self, PyObject *args, PyObject* kwds)
 {
     FILE* fp = NULL;
+    char* mapped = NULL;
+    size_t mapped_size = 0;
+    yyscan_t scanner;
     int result;
 
     /* Unpack and validate arguments */
+    PyObject* builder = NULL;
     const char* filename = 0;
     const char* report_filename = 0;
     int report_firstline = 0;
     extern int yydebug;
     const char* encoding = 0;
+    int use_mmap = 1;
+    int fastcall = 0;
     static char *kwlist[] = {"filename", "builder",
                              "report_filename", "report_firstline",
-                             "encoding", "yydebug", NULL};
-    if ( !PyArg_ParseTupleAndKeywords(args, kwds, "sO|zizp", kwlist,
+                             "encoding", "yydebug", "mmap", "fastcall", NULL};
+    if ( !PyArg_ParseTupleAndKeywords(args, kwds, "sO|zizppp", kwlist,
                                       &filename, &builder,
                                       &report_filename, &report_firstline,
-                                      &encoding, &yydebug) ) {
+                                      &encoding, &yydebug, &use_mmap, &fastcall) ) {
         return NULL;
     }
 
-    /* Open the file. */
+    /* Open the file, without holding the GIL. */
     if ( strcmp(filename, "-") == 0 ) {
       fp = stdin;
     }
     else {
-      fp = fopen(filename, "r");
-      if ( fp == NULL ) {
+      Py_BEGIN_ALLOW_THREADS
+#ifdef HAVE_MMAP
+      if ( use_mmap ) {
+        mapped = map_file(filename, &mapped_size);
+      }
+#endif
+      if ( mapped == NULL ) {
+        fp = fopen(filename, "r");
+      }
+      Py_END_ALLOW_THREADS
+      if ( mapped == NULL && fp == NULL ) {
         return PyErr_Format(PyExc_IOError, "Cannot open file '%s'", filename);
       }
     }
 
     /* Initialize the lexer. */
-    yylex_initialize(report_filename != NULL ? report_filename : filename,
-                     encoding);
-    yyin = fp;
-
-    /* Initialize the parser. */
-    yy_firstline = report_firstline;
+    scanner = yylex_initialize(builder,
+                               report_filename != NULL ? report_filename : filename,
+                               encoding, report_firstline);
+    if ( scanner == NULL ) {
+#ifdef HAVE_MMAP
+        if ( mapped != NULL ) {
+            unmap_file(mapped, mapped_size);
+        }
+#endif
+        if ( fp != NULL && fp != stdin ) {
+            fclose(fp);
+        }
+        return NULL;
+    }
+    if ( mapped != NULL ) {
+        yy_scan_buffer(mapped, mapped_size + 2, scanner);
+        yyset_lineno(1, scanner);
+    }
+    else {
+        yyrestart(fp, scanner);
+    }
+    yyset_column(1, scanner);
 
     /* Parse! This will call back methods on the builder instance. */
-    result = yyparse();
-
-    /* Finalize the parser. */
-    /* Noop. */
+    Py_INCREF(builder);
+    result = run_yyparse(scanner, builder, fastcall);
+    Py_DECREF(builder);
 
     /* Finalize the lexer. */
-    if ( fp != NULL ) {
+    yylex_finalize(scanner);
+#ifdef HAVE_MMAP
+    if ( mapped != NULL ) {
+        unmap_file(mapped, mapped_size);
+    }
+#endif
+    if ( fp != NULL && fp != stdin ) {
         fclose(fp);
     }
-    yylex_finalize();
-
-    builder = 0;
 
     return handle_yyparse_result(result);
 }
 
 PyObject* parse_string(PyObject *self, PyObject *args, PyObject* kwds)
 {
+    yyscan_t scanner;
     int result;
 
     /* Unpack and validate arguments */
+    PyObject* builder = NULL;
     const char* input_string = 0;
     Py_ssize_t input_length = 0;
     const char* report_filename = 0;
     const char* encoding = 0;
     int report_firstline = 0;
     extern int yydebug;
+    int fastcall = 0;
     static char *kwlist[] = {"input_string", "builder",
                              "report_filename", "report_firstline",
-                             "encoding", "yydebug", NULL};
-    if ( !PyArg_ParseTupleAndKeywords(args, kwds, "s#O|zizp", kwlist,
+                             "encoding", "yydebug", "fastcall", NULL};
+    if ( !PyArg_ParseTupleAndKeywords(args, kwds, "s#O|zizpp", kwlist,
                                       &input_string, &input_length, &builder,
                                       &report_filename, &report_firstline,
-                                      &encoding, &yydebug) ) {
+                                      &encoding, &yydebug, &fastcall) ) {
         return NULL;
     }
 
     /* Initialize the lexer. */
-    yylex_initialize(report_filename != NULL ? report_filename : "<string>",
-                     encoding);
-    yy_switch_to_buffer(yy_scan_string(input_string));
-
-    /* Initialize the parser. */
-    yy_firstline = report_firstline;
+    scanner = yylex_initialize(builder,
+                               report_filename != NULL ? report_filename : "<string>",
+                               encoding, report_firstline);
+    if ( scanner == NULL ) {
+        return NULL;
+    }
+    yy_scan_string(input_string, scanner);
+    yyset_lineno(1, scanner);
+    yyset_column(1, scanner);
 
     /* Parse! This will call back methods on the builder instance. */
-    result = yyparse();
-
-    /* Finalize the parser. */
-    /* Noop. */
+    Py_INCREF(builder);
+    result = run_yyparse(scanner, builder, fastcall);
+    Py_DECREF(builder);
 
     /* Finalize the lexer. */
-    yylex_finalize();
-
-    builder = 0;
+    yylex_finalize(scanner);
 
     return handle_yyparse_result(result);
 }
 
 PyObject* get_yyfilename(PyObject *self, PyObject *args)
 {
-    return PyUnicode_FromString(yy_filename);
+    if ( current_scanner == NULL ) {
+        return PyErr_Format(PyExc_RuntimeError, "No lexer running in this thread");
+    }
+    return PyUnicode_FromString(yyget_extra(current_scanner)->filename);
 }
 
 PyObject* get_yylineno(PyObject *self, PyObject *args)
 {
-    return PyLong_FromLong(yylineno + yy_firstline);
+    if ( current_scanner == NULL ) {
+        return PyErr_Format(PyExc_RuntimeError, "No lexer running in this thread");
+    }
+    return PyLong_FromLong(yyget_lineno(current_scanner) +
+                           yyget_extra(current_scanner)->firstline);
 }
 
 
 
-/* Inititalize the lexer to start running in debug mode. */
+/* The name of the capsules holding a lexer instance for lexer_*(). */
+static const char* lexer_capsule_name = "beancount.parser._parser.lexer";
+
+/* Release a lexer instance held by a capsule. */
+static void lexer_capsule_destroy(PyObject* capsule)
+{
+    yyscan_t scanner = PyCapsule_GetPointer(capsule, lexer_capsule_name);
+    if ( scanner == NULL ) {
+        return;
+    }
+    FILE* fp = yyget_in(scanner);
+    if ( fp != NULL ) {
+        fclose(fp);
+    }
+    Py_XDECREF(yyget_extra(scanner)->builder);
+    yylex_finalize(scanner);
+}
+
+/* Inititalize the lexer to start running in debug mode. Returns an opaque
+ * object holding the lexer instance, to be passed to lexer_next(). */
 PyObject* lexer_initialize(PyObject *self, PyObject *args)
 {
     FILE* fp = NULL;
+    yyscan_t scanner;
+    PyObject* capsule;
 
     /* Unpack and validate arguments */
+    PyObject* builder = NULL;
     const char* filename = NULL;
     const char* encoding = NULL;
     if ( !PyArg_ParseTuple(args, "sOz", &filename, &builder, &encoding) ) {
         return NULL;
     }
-    Py_XINCREF(builder);
 
     /* Open the file. */
     fp = fopen(filename, "r");
@@ -184,22 +459,44 @@ PyObject* lexer_initialize(PyObject *self, PyObject *args)
     }
 
     /* Initialize the lexer. */
-    yylex_initialize(filename, encoding);
-    yyin = fp;
+    scanner = yylex_initialize(builder, filename, encoding, 0);
+    if ( scanner == NULL ) {
+        fclose(fp);
+        return NULL;
+    }
+    Py_INCREF(builder);
+    yyrestart(fp, scanner);
+    yyset_column(1, scanner);
 
-    Py_RETURN_NONE;
+    capsule = PyCapsule_New(scanner, lexer_capsule_name, lexer_capsule_destroy);
+    if ( capsule == NULL ) {
+        fclose(fp);
+        Py_DECREF(builder);
+        yylex_finalize(scanner);
+        return NULL;
+    }
+    return capsule;
 }
 
-/* Inititalize the lexer to start running in debug mode. */
+/* Finalize the lexer instance. The lexer is released when the object returned
+ * by lexer_initialize() is destroyed; this is kept for symmetry. */
 PyObject* lexer_finalize(PyObject *self, PyObject *args)
 {
-    /* Finalize the lexer. */
-    yylex_finalize();
+    PyObject* capsule = NULL;
+    if ( !PyArg_ParseTuple(args, "O", &capsule) ) {
+        return NULL;
+    }
+    if ( !PyCapsule_IsValid(capsule, lexer_capsule_name) ) {
+        return PyErr_Format(PyExc_TypeError, "Invalid lexer object");
+    }
 
-    /* /\* Close the file. *\/ */
-    /* if ( fclose(yyin) != 0 ) { */
-    /*     return PyErr_Format(PyExc_IOError, "Cannot close lexer file"); */
-    /* } */
+    /* Close the file early; the rest is released with the capsule. */
+    yyscan_t scanner = PyCapsule_GetPointer(capsule, lexer_capsule_name);
+    FILE* fp = yyget_in(scanner);
+    if ( fp != NULL ) {
+        fclose(fp);
+        yyset_in(NULL, scanner);
+    }
 
     Py_RETURN_NONE;
 }
@@ -212,11 +509,27 @@ PyObject* lexer_next(PyObject *self, PyObject *args)
     YYLTYPE yylloc;
     int token;
     PyObject* obj;
+    PyObject* capsule = NULL;
+    yyscan_t scanner;
+    yyscan_t previous_scanner;
+
+    if ( !PyArg_ParseTuple(args, "O", &capsule) ) {
+        return NULL;
+    }
+    scanner = PyCapsule_GetPointer(capsule, lexer_capsule_name);
+    if ( scanner == NULL ) {
+        return NULL;
+    }
+    if ( yyget_in(scanner) == NULL ) {
+        Py_RETURN_NONE;
+    }
 
     /* Run the lexer. */
-    token = yylex(&yylval, &yylloc);
+    previous_scanner = current_scanner;
+    current_scanner = scanner;
+    token = yylex(&yylval, &yylloc, scanner);
+    current_scanner = previous_scanner;
     if ( token == 0 ) {
-        yylex_destroy();
         Py_RETURN_NONE;
     }
 
@@ -234,7 +547,407 @@ PyObject* lexer_next(PyObject *self, PyObject *args)
     }
 
     tokenName = getTokenName(token);
-    return Py_BuildValue("(sis#O)", tokenName, yylloc.first_line, yytext, (Py_ssize_t)yyleng, obj);
+    return Py_BuildValue("(sis#O)", tokenName, yylloc.first_line,
+                         yyget_text(scanner), (Py_ssize_t)yyget_leng(scanner), obj);
+}
+
+/* Read the contents of a file into a new buffer, followed by the two NUL bytes
+ * flex requires at the end of a buffer it scans in place. Return NULL on
+ * failure, with errno set. The buffer is to be released with free(). Like
+ * map_file(), this may be called without holding the GIL. */
+static char* read_file(const char* filename, size_t* size)
+{
+    char* buffer = NULL;
+    size_t capacity = 0;
+    FILE* fp = fopen(filename, "rb");
+    if ( fp == NULL ) {
+        return NULL;
+    }
+    *size = 0;
+    for ( ;; ) {
+        if ( capacity - *size < 2 + 1 ) {
+            char* new_buffer;
+            capacity = capacity ? capacity * 2 : 65536;
+            new_buffer = realloc(buffer, capacity);
+            if ( new_buffer == NULL ) {
+                free(buffer);
+                fclose(fp);
+                errno = ENOMEM;
+                return NULL;
+            }
+            buffer = new_buffer;
+        }
+        size_t num_read = fread(buffer + *size, 1, capacity - *size - 2, fp);
+        if ( num_read == 0 ) {
+            break;
+        }
+        *size += num_read;
+    }
+    if ( ferror(fp) ) {
+        int error = errno;
+        free(buffer);
+        fclose(fp);
+        errno = error;
+        return NULL;
+    }
+    fclose(fp);
+    buffer[*size] = buffer[*size + 1] = '\0';
+    return buffer;
+}
+
+/* The number of integers stored for each token by lexer_tokenize(). */
+#define TOKEN_NUM_FIELDS 5
+
+/* Tokenize a whole file without building the values of the tokens. Return a
+ * bytes object holding native 32-bit integers, TOKEN_NUM_FIELDS per token: the
+ * token type, line, column, byte offset and length. Errors are reported on the
+ * builder, as LEX_ERROR tokens. The file is scanned in memory, and the lines
+ * and columns are counted from the offsets of the tokens, so that a token is
+ * located where its text begins.
+ *
+ * As no Python object is created, the file is loaded and scanned without
+ * holding the GIL. It is only reacquired to report the errors to the builder
+ * (see build_lexer_error()). */
+PyObject* lexer_tokenize(PyObject *self, PyObject *args)
+{
+    char* buffer = NULL;
+    size_t size = 0;
+    int mapped = 0;
+    yyscan_t scanner;
+    yyscan_t previous_scanner;
+    yyextra_t* extra;
+    YYSTYPE yylval;
+    YYLTYPE yylloc;
+    int token;
+    int32_t* tokens = NULL;
+    size_t num_tokens = 0;
+    size_t capacity = 0;
+    size_t line_offset = 0;  /* The offset of the beginning of the line. */
+    size_t scan_offset = 0;  /* The offset up to which newlines were counted. */
+    int32_t line = 1;
+    int failed = 0;
+    PyObject* result = NULL;
+
+    /* Unpack and validate arguments */
+    PyObject* builder = NULL;
+    const char* filename = NULL;
+    const char* encoding = NULL;
+    if ( !PyArg_ParseTuple(args, "sOz", &filename, &builder, &encoding) ) {
+        return NULL;
+    }
+
+    /* Load the file. */
+    Py_BEGIN_ALLOW_THREADS
+#ifdef HAVE_MMAP
+    buffer = map_file(filename, &size);
+    mapped = (buffer != NULL);
+#endif
+    if ( buffer == NULL ) {
+        buffer = read_file(filename, &size);
+    }
+    Py_END_ALLOW_THREADS
+    if ( buffer == NULL ) {
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
+    }
+    if ( size > INT32_MAX ) {
+        PyErr_Format(PyExc_ValueError, "File too large to tokenize: '%s'", filename);
+        goto done;
+    }
+
+    /* Initialize the lexer. */
+    scanner = yylex_initialize(builder, filename, encoding, 0);
+    if ( scanner == NULL ) {
+        goto done;
+    }
+    extra = yyget_extra(scanner);
+    extra->skip_values = 1;
+    yy_scan_buffer(buffer, size + 2, scanner);
+    yyset_lineno(1, scanner);
+    yyset_column(1, scanner);
+
+    Py_INCREF(builder);
+    previous_scanner = current_scanner;
+    current_scanner = scanner;
+    extra->thread_state = PyEval_SaveThread();
+    while ( (token = yylex(&yylval, &yylloc, scanner)) != 0 ) {
+        /* Check the result of reporting an error to the builder. */
+        if ( token == LEX_ERROR ) {
+            PyEval_RestoreThread(extra->thread_state);
+            failed = (PyErr_Occurred() != NULL);
+            extra->thread_state = PyEval_SaveThread();
+            if ( failed ) {
+                break;
+            }
+        }
+        if ( num_tokens == capacity ) {
+            int32_t* new_tokens;
+            capacity = capacity ? capacity * 2 : 4096;
+            new_tokens = realloc(tokens, capacity * TOKEN_NUM_FIELDS * sizeof(int32_t));
+            if ( new_tokens == NULL ) {
+                failed = 1;
+                break;
+            }
+            tokens = new_tokens;
+        }
+
+        /* Count the lines up to the beginning of the token. The text before it
+         * is left untouched by the lexer. */
+        for ( ; scan_offset < extra->token_offset; ++scan_offset ) {
+            if ( buffer[scan_offset] == '\n' ) {
+                line++;
+                line_offset = scan_offset + 1;
+            }
+        }
+        int32_t* fields = tokens + num_tokens * TOKEN_NUM_FIELDS;
+        fields[0] = token;
+        fields[1] = line;
+        fields[2] = (int32_t)(extra->token_offset - line_offset + 1);
+        fields[3] = (int32_t)extra->token_offset;
+        fields[4] = (int32_t)(extra->offset - extra->token_offset);
+        num_tokens++;
+    }
+    PyEval_RestoreThread(extra->thread_state);
+    extra->thread_state = NULL;
+    current_scanner = previous_scanner;
+    Py_DECREF(builder);
+
+    if ( failed && !PyErr_Occurred() ) {
+        PyErr_NoMemory();
+    }
+    if ( !failed ) {
+        result = PyBytes_FromStringAndSize(
+            (const char*)tokens, num_tokens * TOKEN_NUM_FIELDS * sizeof(int32_t));
+    }
+    free(tokens);
+    yylex_finalize(scanner);
+
+  done:
+#ifdef HAVE_MMAP
+    if ( mapped ) {
+        unmap_file(buffer, size);
+        buffer = NULL;
+    }
+#endif
+    free(buffer);
+    return result;
+}
+
+/* Return a dict of the names of the token types, keyed by token type. */
+PyObject* get_token_names(PyObject *self, PyObject *args)
+{
+    PyObject* names = PyDict_New();
+    int token;
+    if ( names == NULL ) {
+        return NULL;
+    }
+    for ( token = LEX_ERROR; token <= KEY; token++ ) {
+        PyObject* key = PyLong_FromLong(token);
+        PyObject* value = PyUnicode_FromString(getTokenName(token));
+        if ( key == NULL || value == NULL || PyDict_SetItem(names, key, value) < 0 ) {
+            Py_XDECREF(key);
+            Py_XDECREF(value);
+            Py_DECREF(names);
+            return NULL;
+        }
+        Py_DECREF(key);
+        Py_DECREF(value);
+    }
+    return names;
+}
+
+
+/* The state of an incremental parse, held by a capsule. The parser is run in
+ * push mode, a token at a time, and stopped as soon as some entries have been
+ * reduced, so that they can be returned by parser_next(). */
+typedef struct {
+    yyscan_t scanner;
+    yypstate* pstate;
+    PyObject* builder;
+    PyObject* entries;  /* The entries reduced and not returned yet. */
+    FILE* fp;
+    int result;         /* The result of the parse, or YYPUSH_MORE if running. */
+} parser_stream_t;
+
+static const char* parser_capsule_name = "beancount.parser._parser.parser";
+
+/* Close the input file of an incremental parse. */
+static void parser_stream_close(parser_stream_t* stream)
+{
+    if ( stream->fp != NULL && stream->fp != stdin ) {
+        fclose(stream->fp);
+    }
+    stream->fp = NULL;
+}
+
+/* Release an incremental parse held by a capsule. */
+static void parser_capsule_destroy(PyObject* capsule)
+{
+    parser_stream_t* stream = PyCapsule_GetPointer(capsule, parser_capsule_name);
+    if ( stream == NULL ) {
+        return;
+    }
+    if ( stream->pstate != NULL ) {
+        yypstate_delete(stream->pstate);
+    }
+    if ( stream->scanner != NULL ) {
+        native_builder_finalize(&yyget_extra(stream->scanner)->native);
+        yylex_finalize(stream->scanner);
+    }
+    parser_stream_close(stream);
+    Py_XDECREF(stream->entries);
+    Py_XDECREF(stream->builder);
+    free(stream);
+}
+
+/* Start an incremental parse of a file. This returns an opaque object holding
+ * the state of the parser, to be passed to parser_next(). */
+PyObject* parser_initialize(PyObject *self, PyObject *args, PyObject* kwds)
+{
+    parser_stream_t* stream;
+    yyextra_t* extra;
+    PyObject* capsule;
+
+    /* Unpack and validate arguments */
+    PyObject* builder = NULL;
+    const char* filename = 0;
+    const char* report_filename = 0;
+    int report_firstline = 0;
+    const char* encoding = 0;
+    int fastcall = 0;
+    static char *kwlist[] = {"filename", "builder",
+                             "report_filename", "report_firstline",
+                             "encoding", "fastcall", NULL};
+    if ( !PyArg_ParseTupleAndKeywords(args, kwds, "sO|zizp", kwlist,
+                                      &filename, &builder,
+                                      &report_filename, &report_firstline,
+                                      &encoding, &fastcall) ) {
+        return NULL;
+    }
+
+    stream = calloc(1, sizeof(parser_stream_t));
+    if ( stream == NULL ) {
+        return PyErr_NoMemory();
+    }
+    stream->result = YYPUSH_MORE;
+    Py_INCREF(builder);
+    stream->builder = builder;
+    capsule = PyCapsule_New(stream, parser_capsule_name, parser_capsule_destroy);
+    if ( capsule == NULL ) {
+        Py_DECREF(builder);
+        free(stream);
+        return NULL;
+    }
+
+    /* Open the file. The rest of the state is released with the capsule from
+     * here on. */
+    if ( strcmp(filename, "-") == 0 ) {
+        stream->fp = stdin;
+    }
+    else {
+        stream->fp = fopen(filename, "r");
+        if ( stream->fp == NULL ) {
+            Py_DECREF(capsule);
+            return PyErr_Format(PyExc_IOError, "Cannot open file '%s'", filename);
+        }
+    }
+
+    /* Initialize the lexer. */
+    stream->scanner = yylex_initialize(builder,
+                                       report_filename != NULL ? report_filename : filename,
+                                       encoding, report_firstline);
+    if ( stream->scanner == NULL ) {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    yyrestart(stream->fp, stream->scanner);
+    yyset_column(1, stream->scanner);
+    extra = yyget_extra(stream->scanner);
+    if ( fastcall && builder_dispatch_initialize(&extra->dispatch, builder) < 0 ) {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    native_builder_initialize(&extra->native, builder, extra->filename);
+
+    /* Initialize the parser and the list receiving the entries. */
+    stream->entries = PyList_New(0);
+    stream->pstate = yypstate_new();
+    if ( stream->entries == NULL || stream->pstate == NULL ) {
+        Py_DECREF(capsule);
+        return PyErr_NoMemory();
+    }
+    extra->stream = stream->entries;
+
+    return capsule;
+}
+
+/* Get the next entries of an incremental parse, in the order of the input
+ * file, as a non-empty list; return None if complete. */
+PyObject* parser_next(PyObject *self, PyObject *args)
+{
+    YYSTYPE yylval;
+    YYLTYPE yylloc;
+    int token;
+    PyObject* capsule = NULL;
+    PyObject* entries;
+    parser_stream_t* stream;
+    yyscan_t previous_scanner;
+
+    if ( !PyArg_ParseTuple(args, "O", &capsule) ) {
+        return NULL;
+    }
+    stream = PyCapsule_GetPointer(capsule, parser_capsule_name);
+    if ( stream == NULL ) {
+        return NULL;
+    }
+
+    /* Run the parser until it reduces some entries or completes. */
+    if ( stream->result == YYPUSH_MORE && stream->fp != NULL ) {
+        previous_scanner = current_scanner;
+        current_scanner = stream->scanner;
+        do {
+            token = yylex(&yylval, &yylloc, stream->scanner);
+            stream->result = yypush_parse(stream->pstate, token, &yylval, &yylloc,
+                                          stream->scanner, stream->builder);
+        } while ( stream->result == YYPUSH_MORE &&
+                  PyList_GET_SIZE(stream->entries) == 0 );
+        current_scanner = previous_scanner;
+        if ( stream->result != YYPUSH_MORE ) {
+            parser_stream_close(stream);
+        }
+    }
+
+    /* Hand over the reduced entries, replacing the list that receives them. */
+    if ( PyList_GET_SIZE(stream->entries) > 0 ) {
+        entries = stream->entries;
+        stream->entries = PyList_New(0);
+        if ( stream->entries == NULL ) {
+            stream->entries = entries;
+            return NULL;
+        }
+        yyget_extra(stream->scanner)->stream = stream->entries;
+        return entries;
+    }
+    if ( stream->result == YYPUSH_MORE ) {
+        /* The parse was stopped early by parser_finalize(). */
+        Py_RETURN_NONE;
+    }
+    return handle_yyparse_result(stream->result);
+}
+
+/* Finalize an incremental parse. The parser is released when the object
+ * returned by parser_initialize() is destroyed; this closes the file early
+ * and stops the parse, if it is not complete. */
+PyObject* parser_finalize(PyObject *self, PyObject *args)
+{
+    PyObject* capsule = NULL;
+    if ( !PyArg_ParseTuple(args, "O", &capsule) ) {
+        return NULL;
+    }
+    if ( !PyCapsule_IsValid(capsule, parser_capsule_name) ) {
+        return PyErr_Format(PyExc_TypeError, "Invalid parser object");
+    }
+    parser_stream_close(PyCapsule_GetPointer(capsule, parser_capsule_name));
+    Py_RETURN_NONE;
 }
 
 
@@ -246,6 +959,11 @@ static PyMethodDef module_functions[] = {
     {"lexer_initialize", lexer_initialize, METH_VARARGS, NULL},
     {"lexer_next", lexer_next, METH_VARARGS, NULL},
     {"lexer_finalize", lexer_finalize, METH_VARARGS, NULL},
+    {"lexer_tokenize", lexer_tokenize, METH_VARARGS, NULL},
+    {"get_token_names", get_token_names, METH_NOARGS, NULL},
+    {"parser_initialize", (PyCFunction)parser_initialize, METH_VARARGS|METH_KEYWORDS, NULL},
+    {"parser_next", parser_next, METH_VARARGS, NULL},
+    {"parser_finalize", parser_finalize, METH_VARARGS, NULL},
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
@@ -315,6 +1033,10 @@ PyMODINIT_FUNC PyInit__parser(void)
     if ( missing_obj == NULL ) {
         Py_RETURN_NONE;
     }
+    decimal_type = PyObject_GetAttrString(number_module, "Decimal");
+    if ( decimal_type == NULL ) {
+        Py_RETURN_NONE;
+    }
 
     return module;
 }
@@ -5,8 +5,72 @@
 #include <Python.h>
 
 
-extern PyObject* builder;
 extern PyObject* missing_obj;
+extern PyObject* decimal_type;
+
+
+/* All the builder methods called by the lexer and the grammar. */
+#define BUILDER_METHODS(X)                                                      \
+    X(DATE) X(ACCOUNT) X(CURRENCY) X(STRING) X(NUMBER) X(TAG) X(LINK) X(KEY)    \
+    X(build_lexer_error) X(build_grammar_error) X(pipe_deprecated_error)        \
+    X(handle_list) X(tag_link_new) X(tag_link_TAG) X(tag_link_LINK)             \
+    X(amount) X(compound_amount) X(cost_merge) X(cost_spec) X(key_value)        \
+    X(posting) X(transaction) X(open) X(close) X(commodity) X(pad) X(balance)   \
+    X(price) X(event) X(query) X(note) X(document) X(custom) X(custom_value)    \
+    X(pushtag) X(poptag) X(pushmeta) X(popmeta) X(option) X(include) X(plugin)  \
+    X(store_result)
+
+#define BUILDER_METHOD_ENUM(name) BUILDER_##name,
+typedef enum {
+    BUILDER_METHODS(BUILDER_METHOD_ENUM)
+    NUM_BUILDER_METHODS
+} builder_method_t;
+#undef BUILDER_METHOD_ENUM
+
+/* A table of the builder methods, looked up once at the beginning of a parse
+ * instead of on every call. This is opt-in, since methods replaced on the
+ * builder during the parse are not seen. */
+typedef struct {
+    int enabled;
+    PyObject* functions[NUM_BUILDER_METHODS];  /* Unbound functions, or callables. */
+    PyObject* selves[NUM_BUILDER_METHODS];     /* Their bound instances, or NULL. */
+} builder_dispatch_t;
+
+/* Set up and release the dispatch table of a builder. */
+int builder_dispatch_initialize(builder_dispatch_t* dispatch, PyObject* builder);
+void builder_dispatch_finalize(builder_dispatch_t* dispatch);
+
+/* Call a builder method from the dispatch table, building its arguments from
+ * the format like PyObject_CallMethod(). */
+PyObject* call_builder(builder_dispatch_t* dispatch, builder_method_t method,
+                       const char* format, ...);
+
+/* Call a builder method, through the dispatch table if it is enabled. The
+ * method is given as an identifier. */
+#define CALL_BUILDER(dispatch, builder, method, format, ...)                    \
+    ((dispatch)->enabled ?                                                      \
+     call_builder((dispatch), BUILDER_##method, format, __VA_ARGS__) :          \
+     PyObject_CallMethod((builder), #method, format, __VA_ARGS__))
+
+
+/* The state used by the grammar to create the most common objects natively,
+ * instead of calling the builder for every reduction. This is only enabled if
+ * the builder does not override the grammar.Builder methods creating them.
+ * See grammar.y. */
+typedef struct {
+    int enabled;
+    PyObject* filename;  /* The filename stored in the metadata. */
+    PyObject* errors;    /* The builder's list of errors. */
+    PyObject* tags;      /* The builder's list of pushed tags. */
+    PyObject* meta;      /* The builder's dict of pushed metadata. */
+    PyObject* dcupdate;  /* The update method of the builder's display context. */
+    PyObject* empty_tags_links;  /* A TagsLinks shared by the entries without any. */
+} native_builder_t;
+
+/* Set up and release the native state for a builder. */
+void native_builder_initialize(native_builder_t* native, PyObject* builder,
+                               const char* filename);
+void native_builder_finalize(native_builder_t* native);
 
 /* #define DO_TRACE_ERRORS   1 */
 
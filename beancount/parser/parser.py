@@ -198,6 +198,39 @@ def parse_file(filename, **kw):
     return builder.finalize()
 
 
+def iter_parse_file(filename, builder=None, **kw):
+    """Parse a beancount input file incrementally, yielding its directives.
+
+    The directives are yielded as soon as the parser reduces them, in the order
+    in which they appear in the file (not sorted), and are not accumulated, so
+    that the memory used does not grow with the size of the file. The consumer
+    may stop early; the file is closed when the generator is.
+
+    Errors and options are accumulated on the builder as usual. Provide your
+    own builder to fetch them once the directives have all been consumed,
+    e.g., with builder.finalize(), which then returns an empty list of entries.
+
+    Args:
+      filename: the name of the file to be parsed.
+      builder: An optional instance of grammar.Builder, created if None.
+      kw: a dict of keywords to be applied to the C parser.
+    Yields:
+      Directives, which may need completion.
+    """
+    if builder is None:
+        abs_filename = path.abspath(filename) if filename else None
+        builder = grammar.Builder(abs_filename)
+    stream = _parser.parser_initialize(filename, builder, **kw)
+    try:
+        while True:
+            entries = _parser.parser_next(stream)
+            if entries is None:
+                break
+            yield from entries
+    finally:
+        _parser.parser_finalize(stream)
+
+
 def parse_string(string, report_filename=None, **kw):
     """Parse a beancount input file and return Ledger with the list of
     transactions and tree of accounts.
@@ -7,6 +7,7 @@ __license__ = "GNU GPLv2"
 import unittest
 import tempfile
 import textwrap
+import threading
 import sys
 import subprocess
 
@@ -14,6 +15,8 @@ from pytest import mark
 
 from beancount.core.number import D
 from beancount.core import data
+from beancount.parser import _parser
+from beancount.parser import grammar
 from beancount.parser import parser
 from beancount.utils import test_utils
 
@@ -114,6 +117,137 @@ class TestParserInputs(unittest.TestCase):
             entries, errors, _ = parser.parse_string("something", None, report_filename)
 
 
+class TestParserMappedFile(unittest.TestCase):
+    """Check that scanning a memory-mapped file matches reading it."""
+
+    INPUT = textwrap.dedent("""
+      2013-05-18 * "Nice dinner" "at Mermaid Inn"
+        Expenses:Restaurant         100 USD
+        Assets:US:Cash
+
+      2013-05-19 note Assets:US:Cash "Multi-line
+      note with a \\"quote\\" and
+      a few lines"
+
+      2013-05-20 note Assets:US:Cash "After"
+    """)
+
+    def parse_both(self, contents):
+        with tempfile.NamedTemporaryFile('wb', suffix='.beancount') as file:
+            file.write(contents.encode('utf8'))
+            file.flush()
+            mapped = parser.parse_file(file.name)
+            unmapped = parser.parse_file(file.name, mmap=False)
+        self.assertEqual(unmapped[0], mapped[0])
+        self.assertEqual([error.source['lineno'] for error in unmapped[1]],
+                         [error.source['lineno'] for error in mapped[1]])
+        return mapped
+
+    def test_parse_mapped(self):
+        entries, errors, _ = self.parse_both(self.INPUT)
+        self.assertFalse(errors)
+        self.assertEqual([2, 6, 10], [entry.meta['lineno'] for entry in entries])
+        self.assertEqual(('Nice dinner', 'at Mermaid Inn'),
+                         (entries[0].payee, entries[0].narration))
+        self.assertEqual('Multi-line\nnote with a "quote" and\na few lines',
+                         entries[1].comment)
+
+    def test_parse_mapped_no_final_newline(self):
+        entries, errors, _ = self.parse_both(self.INPUT.rstrip('\n'))
+        self.assertFalse(errors)
+        self.assertEqual('After', entries[-1].comment)
+
+    def test_parse_mapped_page_multiple(self):
+        entry = '2013-05-20 note Assets:US:Cash "Note"\n'
+        padding = 4096 - (len(self.INPUT) + len(entry)) % 4096
+        contents = self.INPUT + ';' * (padding - 1) + '\n' + entry
+        self.assertEqual(0, len(contents) % 4096)
+        entries, errors, _ = self.parse_both(contents)
+        self.assertFalse(errors)
+        self.assertEqual('Note', entries[-1].comment)
+
+    def test_parse_mapped_unterminated_string(self):
+        entries, errors, _ = self.parse_both(self.INPUT + '2013-05-21 note Assets:US:Cash "')
+        self.assertEqual(3, len(entries))
+
+    def test_parse_mapped_empty(self):
+        entries, errors, _ = self.parse_both('')
+        self.assertFalse(entries)
+        self.assertFalse(errors)
+
+
+class TestParserIterFile(unittest.TestCase):
+    """Directives may be streamed out of the parser as they are reduced."""
+
+    INPUT = textwrap.dedent("""
+      option "title" "Streamed"
+
+      2013-05-20 note Assets:US:Cash "Later"
+
+      2013-05-18 * "Nice dinner" "at Mermaid Inn"
+        Expenses:Restaurant         100 USD
+        Assets:US:Cash
+
+      2013-05-19 balance Assets:US:Cash  -100 USD
+      2013-05-19 invalid Assets:US:Cash
+
+      pushtag #trip
+      2013-05-21 close Assets:US:Cash
+    """)
+
+    def setUp(self):
+        self.file = tempfile.NamedTemporaryFile('w', suffix='.beancount')
+        self.file.write(self.INPUT)
+        self.file.flush()
+
+    def tearDown(self):
+        self.file.close()
+
+    def test_iter_parse_file(self):
+        builder = grammar.Builder(self.file.name)
+        streamed = list(parser.iter_parse_file(self.file.name, builder))
+        self.assertEqual([4, 6, 10, 14],
+                         [entry.meta['lineno'] for entry in streamed])
+
+        entries, errors, options_map = parser.parse_file(self.file.name)
+        self.assertEqual(entries, sorted(streamed, key=data.entry_sortkey))
+        no_entries, iter_errors, iter_options_map = builder.finalize()
+        self.assertEqual([], no_entries)
+        self.assertEqual([error.message for error in errors],
+                         [error.message for error in iter_errors])
+        self.assertEqual(2, len(iter_errors))
+        self.assertEqual('Streamed', iter_options_map['title'])
+        self.assertEqual(options_map['title'], iter_options_map['title'])
+
+    def test_iter_parse_file_fastcall(self):
+        self.assertEqual(list(parser.iter_parse_file(self.file.name)),
+                         list(parser.iter_parse_file(self.file.name, fastcall=True)))
+
+    def test_iter_parse_file_incremental(self):
+        class CountingBuilder(grammar.Builder):
+            num_dates = 0
+            def DATE(self, year, month, day):
+                self.num_dates += 1
+                return super().DATE(year, month, day)
+
+        builder = CountingBuilder(self.file.name)
+        iterator = parser.iter_parse_file(self.file.name, builder)
+        entry = next(iterator)
+        self.assertEqual('Later', entry.comment)
+        # The parser has not read past the next directive.
+        self.assertLessEqual(builder.num_dates, 2)
+        iterator.close()
+        self.assertLessEqual(builder.num_dates, 2)
+
+    def test_iter_parse_file_empty(self):
+        with tempfile.NamedTemporaryFile('w', suffix='.beancount') as file:
+            self.assertEqual([], list(parser.iter_parse_file(file.name)))
+
+    def test_iter_parse_file_missing(self):
+        with self.assertRaises(IOError):
+            list(parser.iter_parse_file('/some/file/that/does/not/exist.beancount'))
+
+
 class TestUnicodeErrors(unittest.TestCase):
 
     test_utf8_string = textwrap.dedent("""
@@ -163,6 +297,129 @@ class TestUnicodeErrors(unittest.TestCase):
         self.assertFalse(entries)
 
 
+class TestParserReentrancy(unittest.TestCase):
+    """The parser state is per-invocation and may be nested or run concurrently."""
+
+    OUTER = textwrap.dedent("""
+      2013-05-18 note Assets:US:Cash "Before"
+      include "other.beancount"
+
+      2013-05-20 note Assets:US:Cash "After"
+    """)
+
+    INNER = textwrap.dedent("""
+      2013-01-01 open Assets:US:Bank
+
+
+      2013-01-02 open Assets:US:Other
+    """)
+
+    def test_parse_nested(self):
+        test = self
+
+        class NestedBuilder(grammar.Builder):
+            def include(self, filename, lineno, include_filename):
+                # Run another parser from within a callback of this one.
+                test.inner_result = parser.parse_string(test.INNER, '/inner')
+                self.nested_location = (_parser.get_yyfilename(),
+                                        _parser.get_yylineno())
+                return super().include(filename, lineno, include_filename)
+
+        builder = NestedBuilder('/outer')
+        _parser.parse_string(self.OUTER, builder, report_filename='/outer')
+        entries, errors, _ = builder.finalize()
+        self.assertFalse(errors)
+        self.assertEqual([('/outer', 2), ('/outer', 5)],
+                         [(entry.meta['filename'], entry.meta['lineno'])
+                          for entry in entries])
+        self.assertEqual(('/outer', 4), builder.nested_location)
+
+        inner_entries, inner_errors, _ = self.inner_result
+        self.assertFalse(inner_errors)
+        self.assertEqual([('/inner', 2), ('/inner', 5)],
+                         [(entry.meta['filename'], entry.meta['lineno'])
+                          for entry in inner_entries])
+
+    def test_parse_threads(self):
+        inputs = [textwrap.dedent("""
+          2013-05-{day:02d} * "Payee {index}"
+            Expenses:Restaurant         {index}.00 USD
+            Assets:US:Cash
+        """).format(day=(index % 28) + 1, index=index) * 50
+                  for index in range(8)]
+        expected = [parser.parse_string(string) for string in inputs]
+
+        results = [None] * len(inputs)
+        def parse(index):
+            for _ in range(5):
+                results[index] = parser.parse_string(inputs[index])
+        threads = [threading.Thread(target=parse, args=(index,))
+                   for index in range(len(inputs))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        for (exp_entries, exp_errors, _), (entries, errors, __) in zip(expected, results):
+            self.assertEqual(exp_entries, entries)
+            self.assertEqual(len(exp_errors), len(errors))
+
+    def test_location_outside_parser(self):
+        with self.assertRaises(RuntimeError):
+            _parser.get_yylineno()
+
+
+class TestParserFastCall(unittest.TestCase):
+    """Builder methods may be bound once for the whole parse."""
+
+    INPUT = textwrap.dedent("""
+      2013-05-18 * "Payee" "Narration" #tag ^link
+        key: "value"
+        Expenses:Restaurant         100 USD {200 # 5 USD}
+        Assets:US:Cash             -200 USD @ 1 CAD
+
+      2013-05-19 balance Assets:US:Cash  -100 USD
+      2013-05-20 close Assets:Invalid
+    """)
+
+    def test_fastcall_equivalent(self):
+        entries, errors, _ = parser.parse_string(self.INPUT)
+        fast_entries, fast_errors, _ = parser.parse_string(self.INPUT, fastcall=True)
+        self.assertEqual(entries, fast_entries)
+        self.assertEqual([error.message for error in errors],
+                         [error.message for error in fast_errors])
+
+    def test_fastcall_binds_once(self):
+        class ReplacingBuilder(grammar.Builder):
+            def DATE(self, year, month, day):
+                # Replace a method while parsing.
+                self.balance = lambda *args: None
+                return super().DATE(year, month, day)
+
+        builder = ReplacingBuilder('<string>')
+        _parser.parse_string(self.INPUT, builder, fastcall=True)
+        entries, _, __ = builder.finalize()
+        self.assertEqual(3, len(entries))
+
+        builder = ReplacingBuilder('<string>')
+        _parser.parse_string(self.INPUT, builder)
+        entries, _, __ = builder.finalize()
+        self.assertEqual(2, len(entries))
+
+    def test_fastcall_missing_method(self):
+        class MissingBuilder(grammar.Builder):
+            def __getattribute__(self, name):
+                if name == 'balance':
+                    raise AttributeError(name)
+                return super().__getattribute__(name)
+
+        builder = MissingBuilder('<string>')
+        _parser.parse_string(self.INPUT, builder, fastcall=True)
+        entries, errors, _ = builder.finalize()
+        self.assertEqual(2, len(entries))
+        self.assertTrue(any("balance" in error.message for error in errors))
+
+
 class TestTestUtils(unittest.TestCase):
 
     def test_parse_many(self):
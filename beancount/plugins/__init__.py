@@ -9,3 +9,27 @@ mailing-list.
 """
 __copyright__ = "Copyright (C) 2014, 2016  Martin Blais"
 __license__ = "GNU GPLv2"
+
+
+def readonly_plugin(function):
+    """Declare a plugin function as read-only.
+
+    A read-only plugin function only validates the entries: it must return the
+    entries it is given unchanged, and must not modify them nor the options.
+    When all the functions of a plugin are read-only, the loader runs the plugin
+    together with the read-only plugins which follow it, concurrently, on an
+    immutable snapshot of the entries (a tuple), keeps only their errors and
+    does not sort the entries again after it. Use it as a decorator:
+
+      @readonly_plugin
+      def validate_something(entries, options_map):
+          ...
+          return entries, errors
+
+    Args:
+      function: A plugin function.
+    Returns:
+      The same function, marked as read-only.
+    """
+    function.__readonly__ = True
+    return function
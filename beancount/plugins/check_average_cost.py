@@ -20,6 +20,7 @@ from beancount.core.data import Transaction
 from beancount.core.data import Booking
 from beancount.core import getters
 from beancount.core import inventory
+from beancount.plugins import readonly_plugin
 
 __plugins__ = ('validate_average_cost',)
 
@@ -34,6 +35,7 @@ MatchBasisError = collections.namedtuple('MatchBasisError', 'source message entr
 DEFAULT_TOLERANCE = 0.01
 
 
+@readonly_plugin
 def validate_average_cost(entries, options_map, config_str=None):
     """Check that reducing legs on unbooked postings are near the average cost basis.
 
@@ -11,6 +11,7 @@ import collections
 
 from beancount.core import data
 from beancount.core import getters
+from beancount.plugins import readonly_plugin
 
 __plugins__ = ('validate_commodity_directives',)
 
@@ -18,6 +19,7 @@ __plugins__ = ('validate_commodity_directives',)
 CheckCommodityError = collections.namedtuple('CheckCommodityError', 'source message entry')
 
 
+@readonly_plugin
 def validate_commodity_directives(entries, options_map):
     """Find all commodities used and ensure they have a corresponding Commodity directive.
 
@@ -9,6 +9,7 @@ __license__ = "GNU GPLv2"
 import collections
 
 from beancount.core import data
+from beancount.plugins import readonly_plugin
 
 __plugins__ = ('validate_coherent_cost',)
 
@@ -16,6 +17,7 @@ __plugins__ = ('validate_coherent_cost',)
 CoherentCostError = collections.namedtuple('CoherentCostError', 'source message entry')
 
 
+@readonly_plugin
 def validate_coherent_cost(entries, unused_options_map):
     """Check that all currencies are either used at cost or not at all, but never both.
 
@@ -21,6 +21,7 @@ __license__ = "GNU GPLv2"
 import collections
 
 from beancount.core import data
+from beancount.plugins import readonly_plugin
 
 __plugins__ = ('validate_commodity_attr',)
 
@@ -28,6 +29,7 @@ ConfigError = collections.namedtuple('ConfigError', 'source message entry')
 CommodityError = collections.namedtuple('CommodityError', 'source message entry')
 
 
+@readonly_plugin
 def validate_commodity_attr(entries, unused_options_map, config_str):
     """Check that all Commodity directives have a valid attribute.
 
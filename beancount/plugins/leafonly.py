@@ -14,6 +14,7 @@ import collections
 from beancount.core import getters
 from beancount.core import data
 from beancount.core import realization
+from beancount.plugins import readonly_plugin
 
 __plugins__ = ('validate_leaf_only',)
 
@@ -21,6 +22,7 @@ __plugins__ = ('validate_leaf_only',)
 LeafOnlyError = collections.namedtuple('LeafOnlyError', 'source message entry')
 
 
+@readonly_plugin
 def validate_leaf_only(entries, unused_options_map):
     """Check for non-leaf accounts that have postings on them.
 
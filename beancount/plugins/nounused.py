@@ -7,6 +7,7 @@ import collections
 
 from beancount.core import data
 from beancount.core import getters
+from beancount.plugins import readonly_plugin
 
 __plugins__ = ('validate_unused_accounts',)
 
@@ -14,6 +15,7 @@ __plugins__ = ('validate_unused_accounts',)
 UnusedAccountError = collections.namedtuple('UnusedAccountError', 'source message entry')
 
 
+@readonly_plugin
 def validate_unused_accounts(entries, unused_options_map):
     """Check that all accounts declared open are actually used.
 
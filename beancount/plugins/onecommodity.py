@@ -6,6 +6,7 @@ __license__ = "GNU GPLv2"
 import collections
 
 from beancount.core import data
+from beancount.plugins import readonly_plugin
 
 __plugins__ = ('validate_one_commodity',)
 
@@ -13,6 +14,7 @@ __plugins__ = ('validate_one_commodity',)
 OneCommodityError = collections.namedtuple('OneCommodityError', 'source message entry')
 
 
+@readonly_plugin
 def validate_one_commodity(entries, unused_options_map):
     """Check that each account has units in only a single commodity.
 
@@ -69,6 +69,7 @@ from beancount.core import inventory
 from beancount.core import account_types
 from beancount.core import interpolate
 from beancount.parser import options
+from beancount.plugins import readonly_plugin
 
 __plugins__ = ('validate_sell_gains',)
 
@@ -81,6 +82,7 @@ SellGainsError = collections.namedtuple('SellGainsError', 'source message entry'
 EXTRA_TOLERANCE_MULTIPLIER = 2
 
 
+@readonly_plugin
 def validate_sell_gains(entries, options_map):
     """Check the sum of asset account totals for lots sold with a price on them.
 
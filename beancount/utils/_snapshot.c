@@ -0,0 +1,1257 @@
+/* A compact binary format for snapshots of loaded ledgers.
+ *
+ * This serializes the (entries, errors, options_map) triples returned by the
+ * loader much like pickle does, but it is specialized for the objects these
+ * are made of, which makes restoring them a lot cheaper:
+ *
+ * - Strings, dates and numbers are stored once in tables which are built as
+ *   they are first encountered, and are referred to by index afterwards. The
+ *   restored objects are shared, e.g., all the occurrences of an account name
+ *   or of a date are the same object.
+ * - Named tuples are created directly from their type and fields, without
+ *   calling their __new__() method.
+ * - Lists, dicts, sets and named tuples are memoized, so that the sharing of
+ *   these objects is preserved, e.g., entries referred to by errors.
+ * - Other objects (enums, display contexts, ...) are restored from the result
+ *   of their __reduce_ex__() method like pickle does, or pickled if this
+ *   doesn't apply.
+ *
+ * The stream is a header followed by a single object, encoded as a one-byte
+ * opcode followed by its payload. All integers are little-endian.
+ */
+
+#define PY_SSIZE_T_CLEAN
+
+#include <Python.h>
+#include <datetime.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/* The header of a snapshot; change the version number if the format changes. */
+static const char snapshot_magic[8] = {'B', 'C', 'S', 'N', 'A', 'P', '0', '2'};
+
+/* The maximum depth of nested objects. */
+#define MAX_DEPTH 1000
+
+/* Opcodes. */
+enum {
+    OP_NONE = 'N',         /* None */
+    OP_TRUE = 'T',         /* True */
+    OP_FALSE = 'F',        /* False */
+    OP_INT = 'I',          /* int, as an int64 */
+    OP_LONG = 'J',         /* Larger int: u32 length, ASCII decimal digits */
+    OP_FLOAT = 'G',        /* float, as a double */
+    OP_STR = 's',          /* New string: u32 length, UTF-8 bytes */
+    OP_STR_REF = 'S',      /* Known string: u32 index */
+    OP_BYTES = 'B',        /* bytes: u32 length, bytes */
+    OP_DATE = 'd',         /* New date: u16 year, u8 month, u8 day */
+    OP_DATE_REF = 'D',     /* Known date: u32 index */
+    OP_DECIMAL = 'x',      /* New Decimal: u32 length, ASCII string */
+    OP_DECIMAL_REF = 'X',  /* Known Decimal: u32 index */
+    OP_TUPLE = 't',        /* tuple: u32 size, items */
+    OP_LIST = 'l',         /* list: u32 size, items (memoized) */
+    OP_DICT = 'm',         /* dict: u32 size, key and value pairs (memoized) */
+    OP_SET = 'e',          /* set: u32 size, items (memoized) */
+    OP_FROZENSET = 'z',    /* frozenset: u32 size, items (memoized) */
+    OP_TYPE = 'k',         /* New named tuple type: module and qualified name
+                              strings, followed by an OP_NTUPLE */
+    OP_NTUPLE = 'c',       /* Named tuple: u32 type index, u32 size, items
+                              (memoized) */
+    OP_MEMO = 'r',         /* Memoized object: u32 index */
+    OP_GLOBAL = 'g',       /* Type or function: module and qualified name
+                              strings (memoized) */
+    OP_REDUCE = 'o',       /* Object created like pickle does from the result
+                              of __reduce_ex__(): function, arguments tuple
+                              and state objects (memoized) */
+    OP_PICKLE = 'p',       /* Any other object: u32 length, pickle (memoized) */
+};
+
+
+/* Module-level constants. */
+static PyObject* decimal_type = NULL;
+static PyObject* pickle_dumps = NULL;
+static PyObject* pickle_loads = NULL;
+
+
+/*------------------------------------------------------------------------------
+ * Writer.
+ */
+
+typedef struct {
+    char* data;          /* Output buffer. */
+    size_t size;         /* Number of bytes written. */
+    size_t capacity;     /* Allocated size of the buffer. */
+    PyObject* strings;   /* dict of str to index. */
+    PyObject* dates;     /* dict of date to index. */
+    PyObject* decimals;  /* dict of the str() of a Decimal to index. */
+    PyObject* types;     /* dict of type to index, or None if not a named tuple. */
+    PyObject* memo;      /* dict of object id to index, or None while writing it. */
+    PyObject* memo_objects;  /* list of the memoized objects, which keeps the
+                                temporary ones alive so their ids are not reused. */
+    Py_ssize_t num_types;
+    Py_ssize_t num_memo;
+    int depth;
+} writer_t;
+
+static int write_object(writer_t* writer, PyObject* obj);
+
+/* Make room for 'size' more bytes in the output buffer. */
+static int writer_reserve(writer_t* writer, size_t size)
+{
+    size_t capacity;
+    char* data;
+    if ( writer->size + size <= writer->capacity ) {
+        return 0;
+    }
+    capacity = writer->capacity * 2;
+    while ( capacity < writer->size + size ) {
+        capacity *= 2;
+    }
+    data = PyMem_Realloc(writer->data, capacity);
+    if ( data == NULL ) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    writer->data = data;
+    writer->capacity = capacity;
+    return 0;
+}
+
+static int write_bytes(writer_t* writer, const void* bytes, size_t size)
+{
+    if ( writer_reserve(writer, size) < 0 ) {
+        return -1;
+    }
+    memcpy(writer->data + writer->size, bytes, size);
+    writer->size += size;
+    return 0;
+}
+
+static int write_u8(writer_t* writer, unsigned int value)
+{
+    unsigned char byte = (unsigned char)value;
+    return write_bytes(writer, &byte, 1);
+}
+
+static int write_u64(writer_t* writer, uint64_t value, int size)
+{
+    unsigned char bytes[8];
+    int i;
+    for ( i = 0; i < size; i++ ) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    return write_bytes(writer, bytes, size);
+}
+
+static int write_u32(writer_t* writer, Py_ssize_t value)
+{
+    if ( value < 0 || (uint64_t)value > UINT32_MAX ) {
+        PyErr_SetString(PyExc_OverflowError, "Object too large for a snapshot");
+        return -1;
+    }
+    return write_u64(writer, (uint64_t)value, 4);
+}
+
+/* Write an opcode and a u32 index or size. */
+static int write_op_u32(writer_t* writer, int op, Py_ssize_t value)
+{
+    if ( write_u8(writer, op) < 0 ) {
+        return -1;
+    }
+    return write_u32(writer, value);
+}
+
+/* Write an opcode and a length-prefixed string of bytes. */
+static int write_op_data(writer_t* writer, int op, const char* data, Py_ssize_t size)
+{
+    if ( write_op_u32(writer, op, size) < 0 ) {
+        return -1;
+    }
+    return write_bytes(writer, data, size);
+}
+
+/* Look up the index of a key in one of the tables of the writer. If absent,
+ * add it with the next index and return -1; return -2 on error. */
+static Py_ssize_t writer_lookup(PyObject* table, PyObject* key)
+{
+    PyObject* index = PyDict_GetItemWithError(table, key);
+    if ( index != NULL ) {
+        return PyLong_AsSsize_t(index);
+    }
+    if ( PyErr_Occurred() ) {
+        return -2;
+    }
+    index = PyLong_FromSsize_t(PyDict_GET_SIZE(table));
+    if ( index == NULL || PyDict_SetItem(table, key, index) < 0 ) {
+        Py_XDECREF(index);
+        return -2;
+    }
+    Py_DECREF(index);
+    return -1;
+}
+
+static int write_str(writer_t* writer, PyObject* obj)
+{
+    Py_ssize_t size;
+    const char* data;
+    Py_ssize_t index = writer_lookup(writer->strings, obj);
+    if ( index >= 0 ) {
+        return write_op_u32(writer, OP_STR_REF, index);
+    }
+    else if ( index == -2 ) {
+        return -1;
+    }
+    data = PyUnicode_AsUTF8AndSize(obj, &size);
+    if ( data == NULL ) {
+        return -1;
+    }
+    return write_op_data(writer, OP_STR, data, size);
+}
+
+static int write_date(writer_t* writer, PyObject* obj)
+{
+    Py_ssize_t index = writer_lookup(writer->dates, obj);
+    if ( index >= 0 ) {
+        return write_op_u32(writer, OP_DATE_REF, index);
+    }
+    else if ( index == -2 ) {
+        return -1;
+    }
+    if ( write_u8(writer, OP_DATE) < 0 ||
+         write_u64(writer, PyDateTime_GET_YEAR(obj), 2) < 0 ||
+         write_u8(writer, PyDateTime_GET_MONTH(obj)) < 0 ||
+         write_u8(writer, PyDateTime_GET_DAY(obj)) < 0 ) {
+        return -1;
+    }
+    return 0;
+}
+
+static int write_decimal(writer_t* writer, PyObject* obj)
+{
+    Py_ssize_t size;
+    const char* data;
+    Py_ssize_t index;
+    int result = -1;
+
+    /* Key the table by the string, as equal numbers may differ in precision. */
+    PyObject* string = PyObject_Str(obj);
+    if ( string == NULL ) {
+        return -1;
+    }
+    index = writer_lookup(writer->decimals, string);
+    if ( index >= 0 ) {
+        result = write_op_u32(writer, OP_DECIMAL_REF, index);
+    }
+    else if ( index == -1 ) {
+        data = PyUnicode_AsUTF8AndSize(string, &size);
+        if ( data != NULL ) {
+            result = write_op_data(writer, OP_DECIMAL, data, size);
+        }
+    }
+    Py_DECREF(string);
+    return result;
+}
+
+/* Write the number of items of a sequence or set, followed by the items. */
+static int write_items(writer_t* writer, PyObject* obj)
+{
+    PyObject* iterator;
+    PyObject* item;
+    if ( write_u32(writer, PyObject_Length(obj)) < 0 ) {
+        return -1;
+    }
+    iterator = PyObject_GetIter(obj);
+    if ( iterator == NULL ) {
+        return -1;
+    }
+    while ( (item = PyIter_Next(iterator)) != NULL ) {
+        int result = write_object(writer, item);
+        Py_DECREF(item);
+        if ( result < 0 ) {
+            Py_DECREF(iterator);
+            return -1;
+        }
+    }
+    Py_DECREF(iterator);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static int write_dict(writer_t* writer, PyObject* obj)
+{
+    Py_ssize_t pos = 0;
+    PyObject* key;
+    PyObject* value;
+    if ( write_op_u32(writer, OP_DICT, PyDict_GET_SIZE(obj)) < 0 ) {
+        return -1;
+    }
+    while ( PyDict_Next(obj, &pos, &key, &value) ) {
+        if ( write_object(writer, key) < 0 || write_object(writer, value) < 0 ) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Return the index of a named tuple type, writing its definition on first use;
+ * return -1 if the type can't be created from its fields, or -2 on error. */
+static Py_ssize_t write_type(writer_t* writer, PyTypeObject* type)
+{
+    PyObject* index;
+    PyObject* module = NULL;
+    PyObject* qualname = NULL;
+    Py_ssize_t result = -2;
+
+    index = PyDict_GetItemWithError(writer->types, (PyObject*)type);
+    if ( index != NULL ) {
+        return index == Py_None ? -1 : PyLong_AsSsize_t(index);
+    }
+    if ( PyErr_Occurred() ) {
+        return -2;
+    }
+
+    /* Only named tuples without instance attributes whose type can be
+     * imported by name are supported. */
+    module = PyObject_GetAttrString((PyObject*)type, "__module__");
+    qualname = PyObject_GetAttrString((PyObject*)type, "__qualname__");
+    if ( type->tp_dictoffset == 0 &&
+         PyObject_HasAttrString((PyObject*)type, "_fields") &&
+         module != NULL && PyUnicode_Check(module) &&
+         qualname != NULL && PyUnicode_Check(qualname) &&
+         PyUnicode_FindChar(qualname, '<', 0, PyUnicode_GET_LENGTH(qualname), 1) == -1 ) {
+        index = PyLong_FromSsize_t(writer->num_types);
+        if ( index != NULL &&
+             write_u8(writer, OP_TYPE) == 0 &&
+             write_str(writer, module) == 0 &&
+             write_str(writer, qualname) == 0 ) {
+            result = writer->num_types++;
+        }
+    }
+    else {
+        PyErr_Clear();
+        index = Py_None;
+        Py_INCREF(index);
+        result = -1;
+    }
+    if ( index != NULL && result != -2 &&
+         PyDict_SetItem(writer->types, (PyObject*)type, index) < 0 ) {
+        result = -2;
+    }
+    Py_XDECREF(index);
+    Py_XDECREF(module);
+    Py_XDECREF(qualname);
+    return result;
+}
+
+/* Write a type or function by name. */
+static int write_global(writer_t* writer, PyObject* obj)
+{
+    int result = -1;
+    PyObject* module = PyObject_GetAttrString(obj, "__module__");
+    PyObject* qualname = PyObject_GetAttrString(obj, "__qualname__");
+    if ( module != NULL && qualname != NULL ) {
+        if ( !PyUnicode_Check(module) || !PyUnicode_Check(qualname) ||
+             PyUnicode_FindChar(qualname, '<', 0,
+                                PyUnicode_GET_LENGTH(qualname), 1) != -1 ) {
+            PyErr_Format(PyExc_ValueError, "Can't snapshot %R by name", obj);
+        }
+        else if ( write_u8(writer, OP_GLOBAL) == 0 &&
+                  write_str(writer, module) == 0 ) {
+            result = write_str(writer, qualname);
+        }
+    }
+    Py_XDECREF(module);
+    Py_XDECREF(qualname);
+    return result;
+}
+
+/* Write an object from the result of its __reduce_ex__() method. Return 1 if
+ * this is not supported, i.e., the result is a string or includes list or
+ * dict items, in which case the object should be pickled. */
+static int write_reduce(writer_t* writer, PyObject* obj)
+{
+    int result = 1;
+    Py_ssize_t size;
+    PyObject* reduced = PyObject_CallMethod(obj, "__reduce_ex__", "i", 4);
+    if ( reduced == NULL ) {
+        return -1;
+    }
+    size = PyTuple_Check(reduced) ? PyTuple_GET_SIZE(reduced) : 0;
+    if ( size >= 2 && size <= 5 &&
+         PyTuple_Check(PyTuple_GET_ITEM(reduced, 1)) &&
+         (size < 4 || PyTuple_GET_ITEM(reduced, 3) == Py_None) &&
+         (size < 5 || PyTuple_GET_ITEM(reduced, 4) == Py_None) ) {
+        if ( write_u8(writer, OP_REDUCE) < 0 ||
+             write_object(writer, PyTuple_GET_ITEM(reduced, 0)) < 0 ||
+             write_object(writer, PyTuple_GET_ITEM(reduced, 1)) < 0 ||
+             write_object(writer, size >= 3 ? PyTuple_GET_ITEM(reduced, 2) : Py_None) < 0 ) {
+            result = -1;
+        }
+        else {
+            result = 0;
+        }
+    }
+    Py_DECREF(reduced);
+    return result;
+}
+
+static int write_pickle(writer_t* writer, PyObject* obj)
+{
+    int result;
+    PyObject* data = PyObject_CallFunctionObjArgs(pickle_dumps, obj, NULL);
+    if ( data == NULL ) {
+        return -1;
+    }
+    if ( !PyBytes_Check(data) ) {
+        Py_DECREF(data);
+        PyErr_SetString(PyExc_TypeError, "pickle.dumps() did not return bytes");
+        return -1;
+    }
+    result = write_op_data(writer, OP_PICKLE, PyBytes_AS_STRING(data),
+                           PyBytes_GET_SIZE(data));
+    Py_DECREF(data);
+    return result;
+}
+
+/* Write an object which is memoized, i.e., all but the scalars and tuples. */
+static int write_memoized(writer_t* writer, PyObject* obj)
+{
+    PyObject* key;
+    PyObject* index;
+    Py_ssize_t type_index;
+    int result;
+
+    key = PyLong_FromVoidPtr(obj);
+    if ( key == NULL ) {
+        return -1;
+    }
+    index = PyDict_GetItemWithError(writer->memo, key);
+    if ( index != NULL ) {
+        Py_DECREF(key);
+        if ( index == Py_None ) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Recursive objects are not supported in snapshots");
+            return -1;
+        }
+        return write_op_u32(writer, OP_MEMO, PyLong_AsSsize_t(index));
+    }
+    if ( PyErr_Occurred() || PyDict_SetItem(writer->memo, key, Py_None) < 0 ) {
+        Py_DECREF(key);
+        return -1;
+    }
+
+    if ( PyList_CheckExact(obj) ) {
+        result = write_u8(writer, OP_LIST) == 0 ? write_items(writer, obj) : -1;
+    }
+    else if ( PyDict_CheckExact(obj) ) {
+        result = write_dict(writer, obj);
+    }
+    else if ( PySet_CheckExact(obj) ) {
+        result = write_u8(writer, OP_SET) == 0 ? write_items(writer, obj) : -1;
+    }
+    else if ( PyFrozenSet_CheckExact(obj) ) {
+        result = write_u8(writer, OP_FROZENSET) == 0 ? write_items(writer, obj) : -1;
+    }
+    else if ( PyTuple_Check(obj) &&
+              (type_index = write_type(writer, Py_TYPE(obj))) != -1 ) {
+        result = -1;
+        if ( type_index >= 0 && write_op_u32(writer, OP_NTUPLE, type_index) == 0 ) {
+            result = write_items(writer, obj);
+        }
+    }
+    else if ( PyErr_Occurred() ) {
+        result = -1;
+    }
+    else if ( PyType_Check(obj) || PyFunction_Check(obj) || PyCFunction_Check(obj) ) {
+        result = write_global(writer, obj);
+    }
+    else if ( (result = write_reduce(writer, obj)) == 1 ) {
+        result = write_pickle(writer, obj);
+    }
+
+    /* Memoize the object once written, as it is when read. */
+    if ( result == 0 ) {
+        index = PyLong_FromSsize_t(writer->num_memo++);
+        if ( index == NULL || PyDict_SetItem(writer->memo, key, index) < 0 ||
+             PyList_Append(writer->memo_objects, obj) < 0 ) {
+            result = -1;
+        }
+        Py_XDECREF(index);
+    }
+    Py_DECREF(key);
+    return result;
+}
+
+static int write_object(writer_t* writer, PyObject* obj)
+{
+    int result;
+    if ( obj == Py_None ) {
+        return write_u8(writer, OP_NONE);
+    }
+    else if ( obj == Py_True ) {
+        return write_u8(writer, OP_TRUE);
+    }
+    else if ( obj == Py_False ) {
+        return write_u8(writer, OP_FALSE);
+    }
+    else if ( PyUnicode_CheckExact(obj) ) {
+        return write_str(writer, obj);
+    }
+    else if ( (PyObject*)Py_TYPE(obj) == decimal_type ) {
+        return write_decimal(writer, obj);
+    }
+    else if ( PyDate_CheckExact(obj) ) {
+        return write_date(writer, obj);
+    }
+    else if ( PyLong_CheckExact(obj) ) {
+        int overflow;
+        long long value = PyLong_AsLongLongAndOverflow(obj, &overflow);
+        if ( overflow == 0 ) {
+            if ( value == -1 && PyErr_Occurred() ) {
+                return -1;
+            }
+            if ( write_u8(writer, OP_INT) < 0 ) {
+                return -1;
+            }
+            return write_u64(writer, (uint64_t)value, 8);
+        }
+        else {
+            /* Write larger integers in decimal; like small ones, they are not
+               memoized. */
+            Py_ssize_t size;
+            const char* data;
+            PyObject* string = PyObject_Str(obj);
+            if ( string == NULL ) {
+                return -1;
+            }
+            data = PyUnicode_AsUTF8AndSize(string, &size);
+            result = data == NULL ? -1 : write_op_data(writer, OP_LONG, data, size);
+            Py_DECREF(string);
+            return result;
+        }
+    }
+    else if ( PyFloat_CheckExact(obj) ) {
+        double value = PyFloat_AS_DOUBLE(obj);
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        if ( write_u8(writer, OP_FLOAT) < 0 ) {
+            return -1;
+        }
+        return write_u64(writer, bits, 8);
+    }
+    else if ( PyBytes_CheckExact(obj) ) {
+        return write_op_data(writer, OP_BYTES, PyBytes_AS_STRING(obj),
+                             PyBytes_GET_SIZE(obj));
+    }
+
+    if ( ++writer->depth > MAX_DEPTH ) {
+        PyErr_SetString(PyExc_ValueError, "Object too deeply nested for a snapshot");
+        return -1;
+    }
+    if ( PyTuple_CheckExact(obj) ) {
+        result = write_u8(writer, OP_TUPLE) == 0 ? write_items(writer, obj) : -1;
+    }
+    else {
+        result = write_memoized(writer, obj);
+    }
+    writer->depth--;
+    return result;
+}
+
+static char dumps_doc[] =
+    "dumps(obj) -> bytes\n"
+    "\n"
+    "Return a snapshot of the given object.";
+
+static PyObject* dumps(PyObject* self, PyObject* obj)
+{
+    PyObject* result = NULL;
+    writer_t writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.capacity = 1 << 16;
+    writer.data = PyMem_Malloc(writer.capacity);
+    writer.strings = PyDict_New();
+    writer.dates = PyDict_New();
+    writer.decimals = PyDict_New();
+    writer.types = PyDict_New();
+    writer.memo = PyDict_New();
+    writer.memo_objects = PyList_New(0);
+    if ( writer.data == NULL ) {
+        PyErr_NoMemory();
+    }
+    else if ( writer.strings != NULL && writer.dates != NULL &&
+              writer.decimals != NULL && writer.types != NULL && writer.memo != NULL &&
+              writer.memo_objects != NULL &&
+              write_bytes(&writer, snapshot_magic, sizeof(snapshot_magic)) == 0 &&
+              write_object(&writer, obj) == 0 ) {
+        result = PyBytes_FromStringAndSize(writer.data, writer.size);
+    }
+    PyMem_Free(writer.data);
+    Py_XDECREF(writer.strings);
+    Py_XDECREF(writer.dates);
+    Py_XDECREF(writer.decimals);
+    Py_XDECREF(writer.types);
+    Py_XDECREF(writer.memo);
+    Py_XDECREF(writer.memo_objects);
+    return result;
+}
+
+
+/*------------------------------------------------------------------------------
+ * Reader.
+ */
+
+typedef struct {
+    const unsigned char* data;
+    Py_ssize_t size;
+    Py_ssize_t pos;
+    PyObject* strings;   /* list of str */
+    PyObject* dates;     /* list of date */
+    PyObject* decimals;  /* list of Decimal */
+    PyObject* types;     /* list of named tuple types */
+    PyObject* type_sizes;  /* list of the numbers of fields of the types */
+    PyObject* memo;      /* list of memoized objects */
+    int depth;
+} reader_t;
+
+static PyObject* read_object(reader_t* reader);
+
+static void* invalid_snapshot(const char* reason)
+{
+    PyErr_Format(PyExc_ValueError, "Invalid snapshot: %s", reason);
+    return NULL;
+}
+
+/* Return a pointer to the next 'size' bytes and skip them. */
+static const unsigned char* read_bytes(reader_t* reader, Py_ssize_t size)
+{
+    const unsigned char* data;
+    if ( size > reader->size - reader->pos ) {
+        return invalid_snapshot("truncated data");
+    }
+    data = reader->data + reader->pos;
+    reader->pos += size;
+    return data;
+}
+
+static int read_u64(reader_t* reader, int size, uint64_t* value)
+{
+    const unsigned char* data = read_bytes(reader, size);
+    int i;
+    if ( data == NULL ) {
+        return -1;
+    }
+    *value = 0;
+    for ( i = 0; i < size; i++ ) {
+        *value |= (uint64_t)data[i] << (8 * i);
+    }
+    return 0;
+}
+
+static Py_ssize_t read_u32(reader_t* reader)
+{
+    uint64_t value;
+    if ( read_u64(reader, 4, &value) < 0 ) {
+        return -1;
+    }
+    return (Py_ssize_t)value;
+}
+
+/* Read a size and check that there are at least as many bytes left, as all
+ * the objects and items take at least one byte. */
+static Py_ssize_t read_size(reader_t* reader)
+{
+    Py_ssize_t size = read_u32(reader);
+    if ( size > reader->size - reader->pos ) {
+        invalid_snapshot("truncated data");
+        return -1;
+    }
+    return size;
+}
+
+/* Return a new reference to an item of one of the tables of the reader. */
+static PyObject* read_ref(reader_t* reader, PyObject* table)
+{
+    PyObject* obj;
+    Py_ssize_t index = read_u32(reader);
+    if ( index < 0 ) {
+        return NULL;
+    }
+    if ( index >= PyList_GET_SIZE(table) ) {
+        return invalid_snapshot("invalid reference");
+    }
+    obj = PyList_GET_ITEM(table, index);
+    Py_INCREF(obj);
+    return obj;
+}
+
+/* Append a new object to one of the tables of the reader and return it. */
+static PyObject* reader_add(PyObject* table, PyObject* obj)
+{
+    if ( obj != NULL && PyList_Append(table, obj) < 0 ) {
+        Py_DECREF(obj);
+        return NULL;
+    }
+    return obj;
+}
+
+static PyObject* read_str(reader_t* reader)
+{
+    Py_ssize_t size = read_size(reader);
+    const unsigned char* data;
+    if ( size < 0 || (data = read_bytes(reader, size)) == NULL ) {
+        return NULL;
+    }
+    return reader_add(reader->strings,
+                      PyUnicode_DecodeUTF8((const char*)data, size, NULL));
+}
+
+static PyObject* read_date(reader_t* reader)
+{
+    uint64_t year;
+    const unsigned char* month_day;
+    if ( read_u64(reader, 2, &year) < 0 ||
+         (month_day = read_bytes(reader, 2)) == NULL ) {
+        return NULL;
+    }
+    return reader_add(reader->dates,
+                      PyDate_FromDate((int)year, month_day[0], month_day[1]));
+}
+
+static PyObject* read_decimal(reader_t* reader)
+{
+    PyObject* string;
+    PyObject* number;
+    Py_ssize_t size = read_size(reader);
+    const unsigned char* data;
+    if ( size < 0 || (data = read_bytes(reader, size)) == NULL ) {
+        return NULL;
+    }
+    string = PyUnicode_DecodeASCII((const char*)data, size, NULL);
+    if ( string == NULL ) {
+        return NULL;
+    }
+    number = PyObject_CallFunctionObjArgs(decimal_type, string, NULL);
+    Py_DECREF(string);
+    return reader_add(reader->decimals, number);
+}
+
+static PyObject* read_long(reader_t* reader)
+{
+    PyObject* string;
+    PyObject* number;
+    Py_ssize_t size = read_size(reader);
+    const unsigned char* data;
+    if ( size < 0 || (data = read_bytes(reader, size)) == NULL ) {
+        return NULL;
+    }
+    string = PyUnicode_DecodeASCII((const char*)data, size, NULL);
+    if ( string == NULL ) {
+        return NULL;
+    }
+    number = PyLong_FromUnicodeObject(string, 10);
+    Py_DECREF(string);
+    return number;
+}
+
+/* Read 'size' items into a new tuple or a tuple subclass. */
+static PyObject* read_tuple(reader_t* reader, PyTypeObject* type, Py_ssize_t size)
+{
+    Py_ssize_t i;
+    PyObject* tuple = (type == &PyTuple_Type ?
+                       PyTuple_New(size) :
+                       type->tp_alloc(type, size));
+    if ( tuple == NULL ) {
+        return NULL;
+    }
+    for ( i = 0; i < size; i++ ) {
+        PyObject* item = read_object(reader);
+        if ( item == NULL ) {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(tuple, i, item);
+    }
+    return tuple;
+}
+
+static PyObject* read_list(reader_t* reader, Py_ssize_t size)
+{
+    Py_ssize_t i;
+    PyObject* list = PyList_New(size);
+    if ( list == NULL ) {
+        return NULL;
+    }
+    for ( i = 0; i < size; i++ ) {
+        PyObject* item = read_object(reader);
+        if ( item == NULL ) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+static PyObject* read_dict(reader_t* reader, Py_ssize_t size)
+{
+    Py_ssize_t i;
+    PyObject* dict = PyDict_New();
+    if ( dict == NULL ) {
+        return NULL;
+    }
+    for ( i = 0; i < size; i++ ) {
+        PyObject* key = read_object(reader);
+        PyObject* value = key != NULL ? read_object(reader) : NULL;
+        if ( value == NULL || PyDict_SetItem(dict, key, value) < 0 ) {
+            Py_XDECREF(key);
+            Py_XDECREF(value);
+            Py_DECREF(dict);
+            return NULL;
+        }
+        Py_DECREF(key);
+        Py_DECREF(value);
+    }
+    return dict;
+}
+
+static PyObject* read_set(reader_t* reader, Py_ssize_t size, int frozen)
+{
+    PyObject* set;
+    PyObject* items = read_list(reader, size);
+    if ( items == NULL ) {
+        return NULL;
+    }
+    set = frozen ? PyFrozenSet_New(items) : PySet_New(items);
+    Py_DECREF(items);
+    return set;
+}
+
+/* Read a module name and a qualified name and return the object they refer to. */
+static PyObject* read_global(reader_t* reader)
+{
+    PyObject* module_name;
+    PyObject* qualname;
+    PyObject* names = NULL;
+    PyObject* obj = NULL;
+    Py_ssize_t i;
+
+    module_name = read_object(reader);
+    qualname = module_name != NULL ? read_object(reader) : NULL;
+    if ( qualname == NULL ) {
+        Py_XDECREF(module_name);
+        return NULL;
+    }
+    if ( !PyUnicode_Check(module_name) || !PyUnicode_Check(qualname) ) {
+        invalid_snapshot("invalid global name");
+        goto done;
+    }
+
+    /* Import the module and look up the object in it. */
+    obj = PyImport_Import(module_name);
+    if ( obj == NULL ) {
+        goto done;
+    }
+    names = PyObject_CallMethod(qualname, "split", "s", ".");
+    if ( names == NULL ) {
+        Py_CLEAR(obj);
+        goto done;
+    }
+    for ( i = 0; obj != NULL && i < PyList_GET_SIZE(names); i++ ) {
+        Py_SETREF(obj, PyObject_GetAttr(obj, PyList_GET_ITEM(names, i)));
+    }
+
+  done:
+    Py_XDECREF(names);
+    Py_DECREF(module_name);
+    Py_DECREF(qualname);
+    return obj;
+}
+
+/* Read the definition of a named tuple type and import it. */
+static int read_type(reader_t* reader)
+{
+    PyObject* fields;
+    PyObject* num_fields = NULL;
+    int result = -1;
+    PyObject* obj = read_global(reader);
+    if ( obj == NULL ) {
+        return -1;
+    }
+    if ( !PyType_Check(obj) || !PyType_IsSubtype((PyTypeObject*)obj, &PyTuple_Type) ) {
+        PyErr_Format(PyExc_ValueError, "Invalid snapshot: %R is not a named tuple", obj);
+        Py_DECREF(obj);
+        return -1;
+    }
+
+    /* Save the current number of fields of the type, to check the tuples. */
+    fields = PyObject_GetAttrString(obj, "_fields");
+    if ( fields != NULL ) {
+        num_fields = PyLong_FromSsize_t(PyObject_Length(fields));
+        Py_DECREF(fields);
+    }
+    if ( num_fields != NULL &&
+         PyList_Append(reader->type_sizes, num_fields) == 0 ) {
+        result = PyList_Append(reader->types, obj);
+    }
+    Py_XDECREF(num_fields);
+    Py_DECREF(obj);
+    return result;
+}
+
+/* Set the state of an object created by a reduce opcode, like pickle does. */
+static int set_state(PyObject* obj, PyObject* state)
+{
+    PyObject* setstate;
+    PyObject* slot_state = NULL;
+    PyObject* dict;
+    PyObject* key;
+    PyObject* value;
+    Py_ssize_t pos = 0;
+
+    setstate = PyObject_GetAttrString(obj, "__setstate__");
+    if ( setstate == NULL ) {
+        if ( !PyErr_ExceptionMatches(PyExc_AttributeError) ) {
+            return -1;
+        }
+        PyErr_Clear();
+    }
+    else {
+        PyObject* result = PyObject_CallOneArg(setstate, state);
+        Py_DECREF(setstate);
+        Py_XDECREF(result);
+        return result != NULL ? 0 : -1;
+    }
+
+    /* The state is a dict of attributes, or a (dict, slots dict) pair. */
+    if ( PyTuple_Check(state) && PyTuple_GET_SIZE(state) == 2 ) {
+        slot_state = PyTuple_GET_ITEM(state, 1);
+        state = PyTuple_GET_ITEM(state, 0);
+    }
+    if ( state != Py_None ) {
+        if ( !PyDict_Check(state) ) {
+            invalid_snapshot("invalid object state");
+            return -1;
+        }
+        dict = PyObject_GenericGetDict(obj, NULL);
+        if ( dict == NULL ) {
+            return -1;
+        }
+        pos = PyDict_Update(dict, state);
+        Py_DECREF(dict);
+        if ( pos < 0 ) {
+            return -1;
+        }
+    }
+    if ( slot_state != NULL && slot_state != Py_None ) {
+        if ( !PyDict_Check(slot_state) ) {
+            invalid_snapshot("invalid object state");
+            return -1;
+        }
+        pos = 0;
+        while ( PyDict_Next(slot_state, &pos, &key, &value) ) {
+            if ( PyObject_SetAttr(obj, key, value) < 0 ) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Read an object created by calling a function and setting its state. */
+static PyObject* read_reduce(reader_t* reader)
+{
+    PyObject* obj = NULL;
+    PyObject* function;
+    PyObject* args = NULL;
+    PyObject* state = NULL;
+
+    function = read_object(reader);
+    if ( function != NULL ) {
+        args = read_object(reader);
+    }
+    if ( args != NULL ) {
+        state = read_object(reader);
+    }
+    if ( state != NULL ) {
+        if ( !PyTuple_Check(args) ) {
+            invalid_snapshot("invalid reduce arguments");
+        }
+        else {
+            obj = PyObject_Call(function, args, NULL);
+            if ( obj != NULL && state != Py_None && set_state(obj, state) < 0 ) {
+                Py_CLEAR(obj);
+            }
+        }
+    }
+    Py_XDECREF(function);
+    Py_XDECREF(args);
+    Py_XDECREF(state);
+    return obj;
+}
+
+/* Read a named tuple and check that it has the number of fields its type
+ * currently has. */
+static PyObject* read_ntuple(reader_t* reader)
+{
+    PyObject* type;
+    Py_ssize_t num_fields;
+    Py_ssize_t size;
+    Py_ssize_t index = read_u32(reader);
+    if ( index < 0 ) {
+        return NULL;
+    }
+    if ( index >= PyList_GET_SIZE(reader->types) ) {
+        return invalid_snapshot("invalid type reference");
+    }
+    type = PyList_GET_ITEM(reader->types, index);
+    num_fields = PyLong_AsSsize_t(PyList_GET_ITEM(reader->type_sizes, index));
+    if ( (size = read_size(reader)) < 0 ) {
+        return NULL;
+    }
+    if ( num_fields != size ) {
+        return PyErr_Format(PyExc_ValueError,
+                            "Invalid snapshot: %R has %zd fields instead of %zd",
+                            type, num_fields, size);
+    }
+    return read_tuple(reader, (PyTypeObject*)type, size);
+}
+
+static PyObject* read_pickle(reader_t* reader)
+{
+    PyObject* data;
+    PyObject* obj;
+    Py_ssize_t size = read_size(reader);
+    const unsigned char* bytes;
+    if ( size < 0 || (bytes = read_bytes(reader, size)) == NULL ) {
+        return NULL;
+    }
+    data = PyBytes_FromStringAndSize((const char*)bytes, size);
+    if ( data == NULL ) {
+        return NULL;
+    }
+    obj = PyObject_CallFunctionObjArgs(pickle_loads, data, NULL);
+    Py_DECREF(data);
+    return obj;
+}
+
+static PyObject* read_object(reader_t* reader)
+{
+    const unsigned char* op;
+    PyObject* obj;
+    Py_ssize_t size;
+    uint64_t value;
+
+    op = read_bytes(reader, 1);
+    if ( op == NULL ) {
+        return NULL;
+    }
+    switch ( *op ) {
+        case OP_NONE:
+            Py_RETURN_NONE;
+        case OP_TRUE:
+            Py_RETURN_TRUE;
+        case OP_FALSE:
+            Py_RETURN_FALSE;
+        case OP_INT:
+            if ( read_u64(reader, 8, &value) < 0 ) {
+                return NULL;
+            }
+            return PyLong_FromLongLong((long long)value);
+        case OP_LONG:
+            return read_long(reader);
+        case OP_FLOAT: {
+            double number;
+            if ( read_u64(reader, 8, &value) < 0 ) {
+                return NULL;
+            }
+            memcpy(&number, &value, sizeof(number));
+            return PyFloat_FromDouble(number);
+        }
+        case OP_STR:
+            return read_str(reader);
+        case OP_STR_REF:
+            return read_ref(reader, reader->strings);
+        case OP_BYTES: {
+            const unsigned char* data;
+            if ( (size = read_size(reader)) < 0 ||
+                 (data = read_bytes(reader, size)) == NULL ) {
+                return NULL;
+            }
+            return PyBytes_FromStringAndSize((const char*)data, size);
+        }
+        case OP_DATE:
+            return read_date(reader);
+        case OP_DATE_REF:
+            return read_ref(reader, reader->dates);
+        case OP_DECIMAL:
+            return read_decimal(reader);
+        case OP_DECIMAL_REF:
+            return read_ref(reader, reader->decimals);
+        case OP_MEMO:
+            return read_ref(reader, reader->memo);
+        case OP_TYPE:
+            if ( read_type(reader) < 0 ) {
+                return NULL;
+            }
+            /* The named tuple follows its type. */
+            if ( reader->pos >= reader->size || reader->data[reader->pos] != OP_NTUPLE ) {
+                return invalid_snapshot("type not followed by a named tuple");
+            }
+            return read_object(reader);
+        default:
+            break;
+    }
+
+    if ( ++reader->depth > MAX_DEPTH ) {
+        return invalid_snapshot("objects too deeply nested");
+    }
+    obj = NULL;
+    switch ( *op ) {
+        case OP_TUPLE:
+            if ( (size = read_size(reader)) >= 0 ) {
+                obj = read_tuple(reader, &PyTuple_Type, size);
+            }
+            reader->depth--;
+            return obj;
+        case OP_LIST:
+            if ( (size = read_size(reader)) >= 0 ) {
+                obj = read_list(reader, size);
+            }
+            break;
+        case OP_DICT:
+            if ( (size = read_size(reader)) >= 0 ) {
+                obj = read_dict(reader, size);
+            }
+            break;
+        case OP_SET:
+        case OP_FROZENSET:
+            if ( (size = read_size(reader)) >= 0 ) {
+                obj = read_set(reader, size, *op == OP_FROZENSET);
+            }
+            break;
+        case OP_NTUPLE:
+            obj = read_ntuple(reader);
+            break;
+        case OP_GLOBAL:
+            obj = read_global(reader);
+            break;
+        case OP_REDUCE:
+            obj = read_reduce(reader);
+            break;
+        case OP_PICKLE:
+            obj = read_pickle(reader);
+            break;
+        default:
+            invalid_snapshot("unknown opcode");
+            break;
+    }
+    reader->depth--;
+    return reader_add(reader->memo, obj);
+}
+
+static char loads_doc[] =
+    "loads(data) -> object\n"
+    "\n"
+    "Restore an object from a snapshot created by dumps().";
+
+static PyObject* loads(PyObject* self, PyObject* arg)
+{
+    Py_buffer buffer;
+    PyObject* result = NULL;
+    reader_t reader;
+
+    if ( PyObject_GetBuffer(arg, &buffer, PyBUF_SIMPLE) < 0 ) {
+        return NULL;
+    }
+    memset(&reader, 0, sizeof(reader));
+    reader.data = buffer.buf;
+    reader.size = buffer.len;
+    reader.strings = PyList_New(0);
+    reader.dates = PyList_New(0);
+    reader.decimals = PyList_New(0);
+    reader.types = PyList_New(0);
+    reader.type_sizes = PyList_New(0);
+    reader.memo = PyList_New(0);
+    if ( reader.strings != NULL && reader.dates != NULL && reader.decimals != NULL &&
+         reader.types != NULL && reader.type_sizes != NULL && reader.memo != NULL ) {
+        if ( reader.size < (Py_ssize_t)sizeof(snapshot_magic) ||
+             memcmp(reader.data, snapshot_magic, sizeof(snapshot_magic)) != 0 ) {
+            invalid_snapshot("bad header");
+        }
+        else {
+            reader.pos = sizeof(snapshot_magic);
+            result = read_object(&reader);
+            if ( result != NULL && reader.pos != reader.size ) {
+                Py_CLEAR(result);
+                invalid_snapshot("trailing data");
+            }
+        }
+    }
+    Py_XDECREF(reader.strings);
+    Py_XDECREF(reader.dates);
+    Py_XDECREF(reader.decimals);
+    Py_XDECREF(reader.types);
+    Py_XDECREF(reader.type_sizes);
+    Py_XDECREF(reader.memo);
+    PyBuffer_Release(&buffer);
+    return result;
+}
+
+
+/*------------------------------------------------------------------------------
+ * Module.
+ */
+
+static PyMethodDef module_functions[] = {
+    {"dumps", dumps, METH_O, dumps_doc},
+    {"loads", loads, METH_O, loads_doc},
+    {NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+static struct PyModuleDef moduledef = {
+    PyModuleDef_HEAD_INIT,
+    "_snapshot",                              /* m_name */
+    "Beancount snapshot extension module",    /* m_doc */
+    -1,                                       /* m_size */
+    module_functions,                         /* m_methods */
+    NULL,                                     /* m_reload */
+    NULL,                                     /* m_traverse */
+    NULL,                                     /* m_clear */
+    NULL,                                     /* m_free */
+};
+
+PyMODINIT_FUNC PyInit__snapshot(void)
+{
+    PyObject* module;
+    PyObject* imported;
+
+    PyDateTime_IMPORT;
+    if ( PyDateTimeAPI == NULL ) {
+        return NULL;
+    }
+
+    imported = PyImport_ImportModule("decimal");
+    if ( imported == NULL ) {
+        return NULL;
+    }
+    decimal_type = PyObject_GetAttrString(imported, "Decimal");
+    Py_DECREF(imported);
+    if ( decimal_type == NULL ) {
+        return NULL;
+    }
+
+    imported = PyImport_ImportModule("pickle");
+    if ( imported == NULL ) {
+        return NULL;
+    }
+    pickle_dumps = PyObject_GetAttrString(imported, "dumps");
+    pickle_loads = PyObject_GetAttrString(imported, "loads");
+    Py_DECREF(imported);
+    if ( pickle_dumps == NULL || pickle_loads == NULL ) {
+        return NULL;
+    }
+
+    module = PyModule_Create(&moduledef);
+    return module;
+}
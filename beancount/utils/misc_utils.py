@@ -9,6 +9,7 @@ from time import time
 import collections
 import contextlib
 import functools
+import gc
 import io
 import re
 import sys
@@ -93,6 +94,26 @@ def swallow(*exception_types):
             raise
 
 
+@contextlib.contextmanager
+def gc_disabled():
+    """Disable the garbage collector temporarily.
+
+    This is useful around the creation of large numbers of objects that won't
+    be released, e.g. when unpickling, where repeated collections would scan
+    all of them over and over.
+
+    Yields:
+      None.
+    """
+    enabled = gc.isenabled()
+    gc.disable()
+    try:
+        yield
+    finally:
+        if enabled:
+            gc.enable()
+
+
 def groupby(keyfun, elements):
     """Group the elements as a dict of lists, where the key is computed using the
     function 'keyfun'.
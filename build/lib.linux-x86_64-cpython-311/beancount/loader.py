@@ -0,0 +1,1108 @@
+"""Loader code. This is the main entry point to load up a file.
+"""
+__copyright__ = "Copyright (C) 2013-2016  Martin Blais"
+__license__ = "GNU GPLv2"
+
+from os import path
+from concurrent import futures
+import collections
+import functools
+import glob
+import hashlib
+import importlib
+import io
+import itertools
+import logging
+import multiprocessing
+import multiprocessing.pool
+import operator
+import os
+import struct
+import textwrap
+import time
+import warnings
+
+from beancount.utils import misc_utils
+from beancount.core import data
+from beancount.parser import _parser
+from beancount.parser import hashsrc
+from beancount.parser import parser
+from beancount.parser import booking
+from beancount.parser import options
+from beancount.parser import printer
+from beancount.ops import validation
+from beancount.utils import encryption
+from beancount.utils import file_utils
+from beancount.utils import snapshot
+
+
+LoadError = collections.namedtuple('LoadError', 'source message entry')
+
+
+# List of default plugins to run.
+DEFAULT_PLUGINS_PRE = [
+    ("beancount.ops.pad", None),
+    ("beancount.ops.documents", None),
+    ]
+
+DEFAULT_PLUGINS_POST = [
+    ("beancount.ops.balance", None),
+    ]
+
+# A mapping of modules to warn about, to their renamed names.
+RENAMED_MODULES = {}
+
+
+# Filename pattern for the pickle-cache.
+PICKLE_CACHE_FILENAME = '.{filename}.picklecache'
+
+# The threshold below which we don't bother creating a cache file, in seconds.
+PICKLE_CACHE_THRESHOLD = 1.0
+
+# Filename pattern for the cache of the parse of each input file.
+PARSE_CACHE_FILENAME = '.{filename}.parsecache'
+
+# The threshold below which we don't bother caching the parse of a file, in seconds.
+PARSE_CACHE_THRESHOLD = 0.25
+
+# Filename pattern for the checkpoint of the booking of a top-level file.
+BOOKING_CHECKPOINT_FILENAME = '.{filename}.bookingcheckpoint'
+
+# The threshold below which we don't bother checkpointing the booking, in seconds.
+BOOKING_CHECKPOINT_THRESHOLD = 1.0
+
+# The maximum number of processes used to parse include files in parallel. The
+# parsed entries have to be transferred back to this process, which costs about
+# as much as parsing them, so this is disabled by default; raise it if you have
+# idle cores and large includes.
+PARSE_PROCESSES = 1
+
+# The total size of the files at one level of includes below which we don't
+# bother starting processes to parse them, in bytes.
+PARALLEL_PARSE_THRESHOLD = 4 * 1024 * 1024
+
+# The maximum number of processes used to run read-only plugins in parallel. The
+# processes are forked and inherit the entries, so only the errors are
+# transferred back to this process. Forking a process which runs other threads
+# isn't safe, so this is disabled by default; raise it from a single-threaded
+# program if you run many slow read-only plugins.
+PLUGIN_PROCESSES = 1
+
+# The number of entries below which we don't bother starting processes to run
+# read-only plugins.
+PARALLEL_PLUGINS_THRESHOLD = 20000
+
+# The read-only plugins being run in parallel and their inputs, inherited by the
+# worker processes, or None.
+_readonly_plugins_state = None
+
+
+def load_file(filename, log_timings=None, log_errors=None, extra_validations=None,
+              encoding=None):
+    """Open a Beancount input file, parse it, run transformations and validate.
+
+    Args:
+      filename: The name of the file to be parsed.
+      log_timings: A file object or function to write timings to,
+        or None, if it should remain quiet.
+      log_errors: A file object or function to write errors to,
+        or None, if it should remain quiet.
+      extra_validations: A list of extra validation functions to run after loading
+        this list of entries.
+      encoding: A string or None, the encoding to decode the input filename with.
+    Returns:
+      A triple of (entries, errors, option_map) where "entries" is a date-sorted
+      list of entries from the file, "errors" a list of error objects generated
+      while parsing and validating the file, and "options_map", a dict of the
+      options parsed from the file.
+    """
+    filename = path.expandvars(path.expanduser(filename))
+    if not path.isabs(filename):
+        filename = path.normpath(path.join(os.getcwd(), filename))
+
+    if encryption.is_encrypted_file(filename):
+        # Note: Caching is not supported for encrypted files.
+        entries, errors, options_map = load_encrypted_file(
+            filename,
+            log_timings, log_errors,
+            extra_validations, False, encoding)
+    else:
+        entries, errors, options_map = _load_file(
+            filename, log_timings,
+            extra_validations, encoding)
+        _log_errors(errors, log_errors)
+    return entries, errors, options_map
+
+
+def load_encrypted_file(filename, log_timings=None, log_errors=None, extra_validations=None,
+                        dedent=False, encoding=None):
+    """Load an encrypted Beancount input file.
+
+    Args:
+      filename: The name of an encrypted file to be parsed.
+      log_timings: See load_string().
+      log_errors: See load_string().
+      extra_validations: See load_string().
+      dedent: See load_string().
+      encoding: See load_string().
+    Returns:
+      A triple of (entries, errors, option_map) where "entries" is a date-sorted
+      list of entries from the file, "errors" a list of error objects generated
+      while parsing and validating the file, and "options_map", a dict of the
+      options parsed from the file.
+    """
+    contents = encryption.read_encrypted_file(filename)
+    return load_string(contents,
+                       log_timings=log_timings,
+                       log_errors=log_errors,
+                       extra_validations=extra_validations,
+                       encoding=encoding)
+
+
+def _log_errors(errors, log_errors):
+    """Log errors, if 'log_errors' is set.
+
+    Args:
+      log_errors: A file object or function to write errors to,
+        or None, if it should remain quiet.
+    """
+    if log_errors and errors:
+        if hasattr(log_errors, 'write'):
+            printer.print_errors(errors, file=log_errors)
+        else:
+            error_io = io.StringIO()
+            printer.print_errors(errors, file=error_io)
+            log_errors(error_io.getvalue())
+
+
+def pickle_cache_function(pattern, time_threshold, function):
+    """Decorate a loader function to make it loads its result from a pickle cache.
+
+    The cache file is now a snapshot (see beancount.utils.snapshot), which is
+    much faster to restore than a pickle; the name has been kept. This considers
+    the first argument as a top-level filename and assumes the function to be
+    cached returns an (entries, errors, options_map) triple. We use the 'include'
+    option value in order to check whether any of the included files has
+    changed. It's essentially a special case for an on-disk memoizer. If any of
+    the included files are more recent than the cache, the function is
+    recomputed and the cache refreshed.
+
+    Args:
+      pattern: A string, the filename pattern for the cache file.
+        A {filename} in it gets replaced by the basename of the input filename.
+      time_threshold: A float, the number of seconds below which we don't bother
+        caching.
+      function: A function object to decorate for caching.
+    Returns:
+      A decorated function which will pull its result from a cache file if
+      it is available.
+    """
+    @functools.wraps(function)
+    def wrapped(toplevel_filename, *args, **kw):
+        abs_filename = path.abspath(toplevel_filename)
+        cache_filename = path.join(
+            path.dirname(abs_filename),
+            pattern.format(filename=path.basename(toplevel_filename)))
+
+        # Read the cache if it exists in order to get the list of files whose
+        # timestamps to check.
+        exists = path.exists(cache_filename)
+        if exists:
+            with open(cache_filename, 'rb') as file:
+                try:
+                    result = snapshot.load(file)
+                except Exception as exc:
+                    # Note: Not a big fan of doing this, but here we handle all
+                    # possible exceptions because restoring an old (e.g., a
+                    # pickle) or corrupted cache file manifests as a variety of
+                    # different exception types.
+
+                    # The cache file is corrupted; ignore it and recompute.
+                    logging.error("Cache file is corrupted: %s; recomputing.", exc)
+                    result = None
+
+                else:
+                    # Check that the latest timestamp has not been written after the
+                    # cache file.
+                    entries, errors, options_map = result
+                    if not needs_refresh(options_map):
+                        # All timestamps are legit; cache hit.
+                        return result
+
+        # We failed; recompute the value.
+        if exists:
+            try:
+                os.remove(cache_filename)
+            except OSError as exc:
+                # Warn for errors on read-only filesystems.
+                logging.warning("Could not remove picklecache file %s: %s",
+                                cache_filename, exc)
+
+        time_before = time.time()
+        result = function(toplevel_filename, *args, **kw)
+        time_after = time.time()
+
+        # Overwrite the cache file if the time it takes to compute it
+        # justifies it.
+        if time_after - time_before > time_threshold:
+            try:
+                with open(cache_filename, 'wb') as file:
+                    snapshot.dump(result, file)
+            except Exception as exc:
+                logging.warning("Could not write to picklecache file %s: %s",
+                                cache_filename, exc)
+
+        return result
+    return wrapped
+
+
+def parse_cache_function(pattern, time_threshold, function):
+    """Decorate a file parsing function to make it load its result from a cache.
+
+    This is used on each of the files parsed by the loader, so that unchanged
+    files don't need to be parsed again when some of the others are edited.
+    This considers the first argument as a filename and assumes the function to
+    be cached returns an (entries, errors, options_map) triple. The cache is
+    keyed by a hash of the name and contents of the file, of the other
+    arguments and of the version of the parser (see compute_parse_cache_key()).
+
+    Args:
+      pattern: A string, the filename pattern for the cache file, created next
+        to the parsed file. A {filename} in it gets replaced by the basename of
+        the parsed file.
+      time_threshold: A float, the number of seconds below which we don't bother
+        caching.
+      function: A function object to decorate for caching.
+    Returns:
+      A decorated function which will pull its result from a cache file if
+      it is available.
+    """
+    @functools.wraps(function)
+    def wrapped(filename, *args, **kw):
+        cache_filename = path.join(path.dirname(filename),
+                                   pattern.format(filename=path.basename(filename)))
+        with open(filename, 'rb') as file:
+            key = compute_parse_cache_key(filename, file.read(), *args, **kw)
+
+        if path.exists(cache_filename):
+            try:
+                with open(cache_filename, 'rb') as file:
+                    cache_key, result = snapshot.load(file)
+            except Exception as exc:
+                # The cache file is corrupted; ignore it and parse again (see
+                # pickle_cache_function()).
+                logging.error("Parse cache file is corrupted: %s; reparsing.", exc)
+            else:
+                if cache_key == key:
+                    return result
+
+        time_before = time.time()
+        result = function(filename, *args, **kw)
+        time_after = time.time()
+
+        # Overwrite the cache file if the time it takes to parse justifies it.
+        if time_after - time_before > time_threshold:
+            try:
+                with open(cache_filename, 'wb') as file:
+                    snapshot.dump((key, result), file)
+            except Exception as exc:
+                logging.warning("Could not write to parse cache file %s: %s",
+                                cache_filename, exc)
+
+        return result
+    return wrapped
+
+
+def booking_checkpoint_function(pattern, time_threshold, function):
+    """Decorate a booking function to make it resume from a checkpoint.
+
+    Ledgers to which transactions are only ever appended don't need all their
+    history to be booked again on every load. This saves the state of booking at
+    the date of the last entry in a file next to the top-level file, and books
+    only the entries from that date on the next time, if the entries before it
+    haven't changed (see booking.book_checkpointed()). The function to decorate
+    takes (entries, options_map) and returns an (entries, errors) pair, like
+    booking.book(); it is called for entries which don't come from a file.
+
+    Args:
+      pattern: A string, the filename pattern for the checkpoint file. A
+        {filename} in it gets replaced by the basename of the top-level file.
+      time_threshold: A float, the number of seconds below which we don't bother
+        creating a checkpoint.
+      function: A booking function object to decorate.
+    Returns:
+      A decorated function which resumes booking from a checkpoint file if it
+      is available.
+    """
+    @functools.wraps(function)
+    def wrapped(entries, options_map):
+        filename = options_map['filename']
+        if not (filename and path.isfile(filename)):
+            return function(entries, options_map)
+        checkpoint_filename = path.join(path.dirname(filename),
+                                        pattern.format(filename=path.basename(filename)))
+
+        checkpoint = None
+        if path.exists(checkpoint_filename):
+            try:
+                with open(checkpoint_filename, 'rb') as file:
+                    checkpoint = snapshot.load(file)
+            except Exception as exc:
+                # The checkpoint file is corrupted; ignore it and book all the
+                # entries (see pickle_cache_function()).
+                logging.error("Booking checkpoint file is corrupted: %s; rebooking.", exc)
+
+        time_before = time.time()
+        entries, errors, new_checkpoint = booking.book_checkpointed(
+            entries, options_map, checkpoint)
+        time_after = time.time()
+
+        # Overwrite the checkpoint file if it was used and has moved forward, or
+        # if the time it took to book justifies it.
+        if (new_checkpoint is not None and new_checkpoint is not checkpoint) and (
+                checkpoint is not None or time_after - time_before > time_threshold):
+            try:
+                with open(checkpoint_filename, 'wb') as file:
+                    snapshot.dump(new_checkpoint, file)
+            except Exception as exc:
+                logging.warning("Could not write to booking checkpoint file %s: %s",
+                                checkpoint_filename, exc)
+
+        return entries, errors
+    return wrapped
+
+
+@functools.lru_cache()
+def get_parser_version():
+    """Return a string identifying the version of the parser.
+
+    This is the hash of the parser source code, or the one built into the
+    extension module if the source is not available, with the release version.
+
+    Returns:
+      A string.
+    """
+    source_hash = hashsrc.hash_parser_source_files() or _parser.SOURCE_HASH
+    return '{}:{}'.format(source_hash, _parser.__version__)
+
+
+def compute_parse_cache_key(filename, contents, *args, **kw):
+    """Compute the key of the cached parse of a file.
+
+    Args:
+      filename: A string, the name of the parsed file.
+      contents: A bytes object, the contents of the parsed file.
+      *args: The other arguments of the parse.
+      **kw: The other keyword arguments of the parse.
+    Returns:
+      A string, the hexadecimal hash of the parse inputs.
+    """
+    md5 = hashlib.md5()
+    md5.update(get_parser_version().encode('utf8'))
+    md5.update(repr((filename, args, sorted(kw.items()))).encode('utf8'))
+    md5.update(contents)
+    return md5.hexdigest()
+
+
+def _parse_file(filename, encoding=None):
+    """Delegate to parser.parse_file. Note: This gets conditionally advised by
+    caching below."""
+    return parser.parse_file(filename, encoding=encoding)
+_uncached_parse_file = _parse_file  # pylint: disable=invalid-name
+
+
+def _book(entries, options_map):
+    """Delegate to booking.book. Note: This gets conditionally advised by
+    checkpointing below."""
+    return booking.book(entries, options_map)
+_uncached_book = _book  # pylint: disable=invalid-name
+
+
+def _load_file(filename, *args, **kw):
+    """Delegate to _load. Note: This gets conditionally advised by caching below."""
+    return _load([(filename, True)], *args, **kw)
+_uncached_load_file = _load_file  # pylint: disable=invalid-name
+
+
+def needs_refresh(options_map):
+    """Predicate that returns true if at least one of the input files may have changed.
+
+    Args:
+      options_map: An options dict as per the parser.
+      mtime: A modified time, to check if it covers the include files in the options_map.
+    Returns:
+      A boolean, true if the input is obsoleted by changes in the input files.
+    """
+    if options_map is None:
+        return True
+    input_hash = compute_input_hash(options_map['include'])
+    return 'input_hash' not in options_map or input_hash != options_map['input_hash']
+
+
+def compute_input_hash(filenames):
+    """Compute a hash of the input data.
+
+    Args:
+      filenames: A list of input files. Order is not relevant.
+    """
+    md5 = hashlib.md5()
+    for filename in sorted(filenames):
+        md5.update(filename.encode('utf8'))
+        if not path.exists(filename):
+            continue
+        stat = os.stat(filename)
+        md5.update(struct.pack('dd', stat.st_mtime_ns, stat.st_size))
+    return md5.hexdigest()
+
+
+def load_string(string, log_timings=None, log_errors=None, extra_validations=None,
+                dedent=False, encoding=None):
+
+    """Open a Beancount input string, parse it, run transformations and validate.
+
+    Args:
+      string: A Beancount input string.
+      log_timings: A file object or function to write timings to,
+        or None, if it should remain quiet.
+      log_errors: A file object or function to write errors to,
+        or None, if it should remain quiet.
+      extra_validations: A list of extra validation functions to run after loading
+        this list of entries.
+      dedent: A boolean, if set, remove the whitespace in front of the lines.
+      encoding: A string or None, the encoding to decode the input string with.
+    Returns:
+      A triple of (entries, errors, option_map) where "entries" is a date-sorted
+      list of entries from the string, "errors" a list of error objects
+      generated while parsing and validating the string, and "options_map", a
+      dict of the options parsed from the string.
+    """
+    if dedent:
+        string = textwrap.dedent(string)
+    entries, errors, options_map = _load([(string, False)], log_timings,
+                                         extra_validations, encoding)
+    _log_errors(errors, log_errors)
+    return entries, errors, options_map
+
+
+def _parse_recursive(sources, log_timings, encoding=None):
+    """Parse Beancount input, run its transformations and validate it.
+
+    Recursively parse a list of files or strings and their include files and
+    return an aggregate of parsed directives, errors, and the top-level
+    options-map. If the same file is being parsed twice, ignore it and issue an
+    error.
+
+    Args:
+      sources: A list of (filename-or-string, is-filename) where the first
+        element is a string, with either a filename or a string to be parsed directly,
+        and the second arugment is a boolean that is true if the first is a filename.
+        You may provide a list of such arguments to be parsed. Filenames must be absolute
+        paths.
+      log_timings: A function to write timings to, or None, if it should remain quiet.
+      encoding: A string or None, the encoding to decode the input filename with.
+    Returns:
+      A tuple of (entries, parse_errors, options_map).
+    """
+    assert isinstance(sources, list) and all(isinstance(el, tuple) for el in sources)
+
+    # Current parse state.
+    entries, parse_errors = [], []
+    options_map = None
+
+    # A stack of sources to be parsed.
+    source_stack = list(sources)
+
+    # A list of absolute filenames that have been parsed in the past, used to
+    # detect and avoid duplicates (cycles).
+    filenames_seen = set()
+
+    with misc_utils.log_time('beancount.parser.parser', log_timings, indent=1):
+        while source_stack:
+            # Process all the pending sources at once. Their includes are only
+            # appended after them, so they are visited in the same order as if
+            # they were taken one at a time, whether they are parsed in
+            # parallel or not.
+            level_sources, source_stack = source_stack, []
+            level_parsed = _parse_files_parallel(level_sources, filenames_seen,
+                                                 log_timings, encoding)
+
+            for source, is_file in level_sources:
+                is_top_level = options_map is None
+
+                # If the file is encrypted, read it in and process it as a string.
+                if is_file:
+                    cwd = path.dirname(source)
+                    source_filename = source
+                    if encryption.is_encrypted_file(source):
+                        source = encryption.read_encrypted_file(source)
+                        is_file = False
+                else:
+                    # If we're parsing a string, the CWD is the current process
+                    # working directory.
+                    cwd = os.getcwd()
+                    source_filename = None
+
+                if is_file:
+                    # All filenames here must be absolute.
+                    assert path.isabs(source)
+                    filename = path.normpath(source)
+
+                    # Check for file previously parsed... detect duplicates.
+                    if filename in filenames_seen:
+                        parse_errors.append(
+                            LoadError(data.new_metadata("<load>", 0),
+                                      'Duplicate filename parsed: "{}"'.format(filename),
+                                      None))
+                        continue
+
+                    # Check for a file that does not exist.
+                    if not path.exists(filename):
+                        parse_errors.append(
+                            LoadError(data.new_metadata("<load>", 0),
+                                      'File "{}" does not exist'.format(filename), None))
+                        continue
+
+                    # Parse a file from disk directly.
+                    filenames_seen.add(filename)
+                    if filename in level_parsed:
+                        (src_entries,
+                         src_errors,
+                         src_options_map) = level_parsed.pop(filename)
+                    else:
+                        with misc_utils.log_time('beancount.parser.parser.parse_file',
+                                                 log_timings, indent=2):
+                            (src_entries,
+                             src_errors,
+                             src_options_map) = _parse_file(filename, encoding=encoding)
+
+                    cwd = path.dirname(filename)
+                else:
+                    # Encode the contents if necessary.
+                    if encoding:
+                        if isinstance(source, bytes):
+                            source = source.decode(encoding)
+                        source = source.encode('ascii', 'replace')
+
+                    # Parse a string buffer from memory.
+                    with misc_utils.log_time('beancount.parser.parser.parse_string',
+                                             log_timings, indent=2):
+                        (src_entries,
+                         src_errors,
+                         src_options_map) = parser.parse_string(source, source_filename)
+
+                # Merge the entries resulting from the parsed file.
+                entries.extend(src_entries)
+                parse_errors.extend(src_errors)
+
+                # We need the options from the very top file only (the very
+                # first file being processed). No merging of options should
+                # occur.
+                if is_top_level:
+                    options_map = src_options_map
+                else:
+                    aggregate_options_map(options_map, src_options_map)
+
+                # Add includes to the list of sources to process. chdir() for glob,
+                # which uses it indirectly.
+                include_expanded = []
+                with file_utils.chdir(cwd):
+                    for include_filename in src_options_map['include']:
+                        matched_filenames = glob.glob(include_filename, recursive=True)
+                        if matched_filenames:
+                            include_expanded.extend(matched_filenames)
+                        else:
+                            parse_errors.append(
+                                LoadError(data.new_metadata("<load>", 0),
+                                          'File glob "{}" does not match any files'.format(
+                                              include_filename), None))
+                for include_filename in include_expanded:
+                    if not path.isabs(include_filename):
+                        include_filename = path.join(cwd, include_filename)
+                    include_filename = path.normpath(include_filename)
+
+                    # Add the include filenames to be processed later.
+                    source_stack.append((include_filename, True))
+
+    # Make sure we have at least a dict of valid options.
+    if options_map is None:
+        options_map = options.OPTIONS_DEFAULTS.copy()
+
+    # Save the set of parsed filenames in options_map.
+    options_map['include'] = sorted(filenames_seen)
+
+    return entries, parse_errors, options_map
+
+
+def _parse_files_parallel(sources, filenames_seen, log_timings, encoding=None):
+    """Parse the plain files among a list of sources in separate processes.
+
+    Only the files that _parse_recursive() would parse from disk are parsed,
+    that is, existing and unencrypted files that have not been seen before.
+    Nothing is parsed if there are not enough of them or if they are too small
+    to be worth the overhead (see PARSE_PROCESSES and PARALLEL_PARSE_THRESHOLD).
+
+    Args:
+      sources: A list of (filename-or-string, is-filename) tuples, as for
+        _parse_recursive().
+      filenames_seen: A set of the normalized filenames already parsed.
+      log_timings: A function to write timings to, or None, if it should remain quiet.
+      encoding: A string or None, the encoding to decode the input filename with.
+    Returns:
+      A dict of normalized filename to the (entries, errors, options_map) tuple
+      returned by _parse_file() for it.
+    """
+    filenames = []
+    seen = set(filenames_seen)
+    for source, is_file in sources:
+        if not is_file:
+            continue
+        filename = path.normpath(source)
+        if (filename in seen or
+            not path.exists(filename) or
+            encryption.is_encrypted_file(filename)):
+            continue
+        seen.add(filename)
+        filenames.append(filename)
+
+    num_processes = min(PARSE_PROCESSES, len(filenames))
+    if (num_processes < 2 or
+        sum(path.getsize(filename) for filename in filenames) < PARALLEL_PARSE_THRESHOLD):
+        return {}
+
+    parse_file = functools.partial(_parse_file, encoding=encoding)
+    with misc_utils.log_time('beancount.parser.parser.parse_file',
+                             log_timings, indent=2):
+        with futures.ProcessPoolExecutor(num_processes) as executor:
+            return dict(zip(filenames, executor.map(parse_file, filenames)))
+
+
+def aggregate_options_map(options_map, src_options_map):
+    """Aggregate some of the attributes of options map.
+
+    Args:
+      options_map: The target map in which we want to aggregate attributes.
+        Note: This value is mutated in-place.
+      src_options_map: A source map whose values we'd like to see aggregated.
+    """
+    op_currencies = options_map["operating_currency"]
+    for currency in src_options_map["operating_currency"]:
+        if currency not in op_currencies:
+            op_currencies.append(currency)
+
+    commodities = options_map["commodities"]
+    for currency in src_options_map["commodities"]:
+        commodities.add(currency)
+
+
+def _load(sources, log_timings, extra_validations, encoding):
+    """Parse Beancount input, run its transformations and validate it.
+
+    (This is an internal method.)
+    This routine does all that is necessary to obtain a list of entries ready
+    for realization and working with them. This is the principal call for of the
+    scripts that load a ledger. It returns a list of entries transformed and
+    ready for reporting, a list of errors, and parser's options dict.
+
+    Args:
+      sources: A list of (filename-or-string, is-filename) where the first
+        element is a string, with either a filename or a string to be parsed directly,
+        and the second arugment is a boolean that is true if the first is a filename.
+        You may provide a list of such arguments to be parsed. Filenames must be absolute
+        paths.
+      log_timings: A file object or function to write timings to,
+        or None, if it should remain quiet.
+      extra_validations: A list of extra validation functions to run after loading
+        this list of entries.
+      encoding: A string or None, the encoding to decode the input filename with.
+    Returns:
+      See load() or load_string().
+    """
+    assert isinstance(sources, list) and all(isinstance(el, tuple) for el in sources)
+
+    if hasattr(log_timings, 'write'):
+        log_timings = log_timings.write
+
+    # Parse all the files recursively. Ensure that the entries are sorted before
+    # running any processes on them.
+    with misc_utils.log_time('parse', log_timings, indent=1):
+        entries, parse_errors, options_map = _parse_recursive(
+            sources, log_timings, encoding)
+        entries.sort(key=data.entry_sortkey)
+
+    # Run interpolation on incomplete entries.
+    with misc_utils.log_time('booking', log_timings, indent=1):
+        entries, balance_errors = _book(entries, options_map)
+        parse_errors.extend(balance_errors)
+
+    # Transform the entries.
+    with misc_utils.log_time('run_transformations', log_timings, indent=1):
+        entries, errors = run_transformations(entries, parse_errors, options_map,
+                                              log_timings)
+
+    # Validate the list of entries.
+    with misc_utils.log_time('beancount.ops.validate', log_timings, indent=1):
+        valid_errors = validation.validate(entries, options_map, log_timings,
+                                           extra_validations)
+        errors.extend(valid_errors)
+
+        # Note: We could go hardcore here and further verify that the entries
+        # haven't been modified by user-provided validation routines, by
+        # comparing hashes before and after. Not needed for now.
+
+    # Compute the input hash.
+    options_map['input_hash'] = compute_input_hash(options_map['include'])
+
+    return entries, errors, options_map
+
+
+def run_transformations(entries, parse_errors, options_map, log_timings):
+    """Run the various transformations on the entries.
+
+    This is where entries are being synthesized, checked, plugins are run, etc.
+
+    Args:
+      entries: A list of directives as read from the parser.
+      parse_errors: A list of errors so far.
+      options_map: An options dict as read from the parser.
+      log_timings: A function to write timing log entries to, or None, if it
+        should be quiet.
+    Returns:
+      A list of modified entries, and a list of errors, also possibly modified.
+    """
+    # A list of errors to extend (make a copy to avoid modifying the input).
+    errors = list(parse_errors)
+
+    # Process the plugins.
+    if options_map['plugin_processing_mode'] == 'raw':
+        plugins_iter = options_map["plugin"]
+    elif options_map['plugin_processing_mode'] == 'default':
+        plugins_iter = itertools.chain(DEFAULT_PLUGINS_PRE,
+                                       options_map["plugin"],
+                                       DEFAULT_PLUGINS_POST)
+    else:
+        assert "Invalid value for plugin_processing_mode: {}".format(
+            options_map['plugin_processing_mode'])
+
+    # The read-only plugins are not run as they come but accumulated, to run
+    # them together on the same entries once the next plugin which may modify
+    # them comes (see beancount.plugins.readonly_plugin()).
+    readonly_plugins = []
+
+    for plugin_name, plugin_config in plugins_iter:
+
+        # Issue a warning on a renamed module.
+        renamed_name = RENAMED_MODULES.get(plugin_name, None)
+        if renamed_name:
+            warnings.warn("Deprecation notice: Module '{}' has been renamed to '{}'; "
+                          "please adjust your plugin directive.".format(
+                              plugin_name, renamed_name))
+            plugin_name = renamed_name
+
+        # Try to import the module.
+        try:
+            module = importlib.import_module(plugin_name)
+            if not hasattr(module, '__plugins__'):
+                continue
+
+            callbacks = []
+            for function_name in module.__plugins__:
+                if isinstance(function_name, str):
+                    # Support plugin functions provided by name.
+                    callbacks.append(getattr(module, function_name))
+                else:
+                    # Support function types directly, not just names.
+                    callbacks.append(function_name)
+
+            if all(getattr(callback, '__readonly__', False) for callback in callbacks):
+                readonly_plugins.append((plugin_name, plugin_config, callbacks))
+                continue
+            errors.extend(run_readonly_plugins(readonly_plugins, entries, options_map,
+                                               log_timings))
+            readonly_plugins = []
+
+            with misc_utils.log_time(plugin_name, log_timings, indent=2):
+
+                # Run each transformer function in the plugin. Keep a copy of
+                # the sorted entries, which the plugin may modify in place.
+                sorted_entries = list(entries)
+                for callback in callbacks:
+                    entries, plugin_errors = call_plugin(callback, entries, options_map,
+                                                         plugin_config)
+                    errors.extend(plugin_errors)
+
+            # Ensure that the entries are sorted. Don't trust the plugins
+            # themselves.
+            entries = resort_entries(entries, sorted_entries)
+
+        except (ImportError, TypeError) as exc:
+            # Upon failure, just issue an error.
+            errors.append(LoadError(data.new_metadata("<load>", 0),
+                                    'Error importing "{}": {}'.format(
+                                        plugin_name, str(exc)), None))
+
+    errors.extend(run_readonly_plugins(readonly_plugins, entries, options_map,
+                                       log_timings))
+    return entries, errors
+
+
+def resort_entries(entries, sorted_entries):
+    """Sort the entries returned by a plugin, given those it was given.
+
+    Plugins mostly return the entries they were given, unchanged or with a few
+    new entries appended or inserted. Instead of sorting all the entries again,
+    the longest prefix and suffix of the entries which are the entries given to
+    the plugin are found by identity, and if the entries between them are few,
+    only those are sorted and merged into the others, in O(n + k log n) for k
+    entries between them.
+
+    Args:
+      entries: A list of directives, as returned by a plugin.
+      sorted_entries: A sorted copy of the list of directives given to the plugin.
+    Returns:
+      A sorted list of the directives of 'entries'.
+    """
+    # Find the common prefix and suffix.
+    identical = list(map(operator.is_, entries, sorted_entries))
+    identical.append(False)
+    prefix = identical.index(False)
+    identical = list(itertools.islice(map(operator.is_, reversed(entries),
+                                          reversed(sorted_entries)),
+                                      min(len(entries), len(sorted_entries)) - prefix))
+    identical.append(False)
+    suffix = identical.index(False)
+    new_entries = entries[prefix:len(entries) - suffix]
+    if not new_entries:
+        return entries
+    kept_entries = sorted_entries[:prefix]
+    kept_entries.extend(sorted_entries[len(sorted_entries) - suffix:])
+    if len(new_entries) * max(1, len(kept_entries).bit_length()) > len(entries):
+        entries.sort(key=data.entry_sortkey)
+        return entries
+    new_entries.sort(key=data.entry_sortkey)
+
+    # Insert each new entry among the kept ones, after those of the prefix and
+    # before those of the suffix with the same sort key, as a stable sort would.
+    merged_entries = []
+    begin = 0
+    for entry in new_entries:
+        key = (data.entry_sortkey(entry), 1)
+        end = len(kept_entries)
+        index = begin
+        while index < end:
+            middle = (index + end) // 2
+            if key < (data.entry_sortkey(kept_entries[middle]), 0 if middle < prefix else 2):
+                end = middle
+            else:
+                index = middle + 1
+        merged_entries.extend(kept_entries[begin:index])
+        merged_entries.append(entry)
+        begin = index
+    merged_entries.extend(kept_entries[begin:])
+    return merged_entries
+
+
+def call_plugin(callback, entries, options_map, plugin_config):
+    """Call a plugin function, with its configuration if it has one.
+
+    Args:
+      callback: A plugin function.
+      entries: A list of directives.
+      options_map: An options dict.
+      plugin_config: The configuration string of the plugin, or None.
+    Returns:
+      The pair of entries and errors returned by the plugin function.
+    """
+    if plugin_config is not None:
+        return callback(entries, options_map, plugin_config)
+    else:
+        return callback(entries, options_map)
+
+
+def run_readonly_plugins(plugins, entries, options_map, log_timings):
+    """Run read-only plugins on a snapshot of the entries.
+
+    The plugins are all given the same immutable snapshot of the entries, a
+    tuple, and their returned entries are ignored. If there are enough entries,
+    they are run concurrently in forked processes, which inherit the snapshot.
+
+    Args:
+      plugins: A list of (plugin name, configuration string, list of plugin
+        functions) tuples.
+      entries: A list of directives.
+      options_map: An options dict.
+      log_timings: A function to write timing log entries to, or None.
+    Returns:
+      A list of the errors returned by the plugins, in the order of the plugins.
+    """
+    if not plugins:
+        return []
+    global _readonly_plugins_state  # pylint: disable=global-statement
+    snapshot = tuple(entries)
+
+    num_processes = min(PLUGIN_PROCESSES, len(plugins))
+    if (num_processes < 2 or
+        len(snapshot) < PARALLEL_PLUGINS_THRESHOLD or
+        'fork' not in multiprocessing.get_all_start_methods()):
+        results = []
+        for plugin in plugins:
+            with misc_utils.log_time(plugin[0], log_timings, indent=2):
+                results.append(_run_readonly_plugin(plugin, snapshot, options_map))
+    else:
+        plugin_names = ', '.join(plugin_name for plugin_name, _, _ in plugins)
+        _readonly_plugins_state = (plugins, snapshot, options_map)
+        try:
+            with misc_utils.log_time(plugin_names, log_timings, indent=2):
+                with multiprocessing.get_context('fork').Pool(num_processes) as pool:
+                    async_results = [pool.apply_async(_run_readonly_plugin_forked, (index,))
+                                     for index in range(len(plugins))]
+                    results = []
+                    for plugin, async_result in zip(plugins, async_results):
+                        try:
+                            results.append(async_result.get())
+                        except multiprocessing.pool.MaybeEncodingError:
+                            # The errors could not be pickled; run it here.
+                            results.append(_run_readonly_plugin(plugin, snapshot,
+                                                                options_map))
+        finally:
+            _readonly_plugins_state = None
+
+    errors = []
+    for (plugin_name, _, _), (plugin_errors, exc) in zip(plugins, results):
+        errors.extend(plugin_errors)
+        if exc is not None:
+            errors.append(LoadError(data.new_metadata("<load>", 0),
+                                    'Error importing "{}": {}'.format(
+                                        plugin_name, str(exc)), None))
+    return errors
+
+
+def _run_readonly_plugin(plugin, entries, options_map):
+    """Run the functions of a read-only plugin.
+
+    Args:
+      plugin: A (plugin name, configuration string, list of plugin functions)
+        tuple.
+      entries: A tuple of directives.
+      options_map: An options dict.
+    Returns:
+      A pair of the list of errors returned by the functions and the exception
+      which interrupted them, as caught by run_transformations(), or None.
+    """
+    _, plugin_config, callbacks = plugin
+    errors = []
+    try:
+        for callback in callbacks:
+            _, plugin_errors = call_plugin(callback, entries, options_map, plugin_config)
+            errors.extend(plugin_errors)
+    except (ImportError, TypeError) as exc:
+        return errors, exc
+    return errors, None
+
+
+def _run_readonly_plugin_forked(index):
+    """Run one of the read-only plugins of a worker process.
+
+    Args:
+      index: The index of the plugin in the state inherited from the parent.
+    Returns:
+      The result of _run_readonly_plugin().
+    """
+    plugins, entries, options_map = _readonly_plugins_state
+    return _run_readonly_plugin(plugins[index], entries, options_map)
+
+
+def combine_plugins(*plugin_modules):
+    """Combine the plugins from the given plugin modules.
+
+    This is used to create plugins of plugins.
+    Args:
+      *plugins_modules: A sequence of module objects.
+    Returns:
+      A list that can be assigned to the new module's __plugins__ attribute.
+    """
+    modules = []
+    for module in plugin_modules:
+        modules.extend([getattr(module, name)
+                        for name in module.__plugins__])
+    return modules
+
+
+def load_doc(expect_errors=False):
+    """A factory of decorators that loads the docstring and calls the function with entries.
+
+    This is an incredibly convenient tool to write lots of tests. Write a
+    unittest using the standard TestCase class and put the input entries in the
+    function's docstring.
+
+    Args:
+      expect_errors: A boolean or None, with the following semantics,
+        True: Expect errors and fail if there are none.
+        False: Expect no errors and fail if there are some.
+        None: Do nothing, no check.
+    Returns:
+      A wrapped method that accepts a single 'self' argument.
+    """
+    def decorator(fun):
+        """A decorator that parses the function's docstring as an argument.
+
+        Args:
+          fun: A callable method, that accepts the three return arguments that
+              load() returns.
+        Returns:
+          A decorated test function.
+        """
+        @functools.wraps(fun)
+        def wrapper(self):
+            entries, errors, options_map = load_string(fun.__doc__, dedent=True)
+
+            if expect_errors is not None:
+                if expect_errors is False and errors:
+                    oss = io.StringIO()
+                    printer.print_errors(errors, file=oss)
+                    self.fail("Unexpected errors found:\n{}".format(oss.getvalue()))
+                elif expect_errors is True and not errors:
+                    self.fail("Expected errors, none found:")
+
+            # Note: Even if we expected no errors, we call this function with an
+            # empty 'errors' list. This is so that the interface does not change
+            # based on the arguments to the decorator, which would be somewhat
+            # ugly and which would require explanation.
+            return fun(self, entries, errors, options_map)
+
+        wrapper.__input__ = wrapper.__doc__
+        wrapper.__doc__ = None
+        return wrapper
+
+    return decorator
+
+
+def initialize():
+    """Initialize the loader."""
+
+    # Unless an environment variable disables it, use the pickle load cache
+    # automatically.
+    # pylint: disable=invalid-name
+    global _load_file
+    if os.getenv('BEANCOUNT_DISABLE_LOAD_CACHE') is None:
+        _load_file = pickle_cache_function(
+            os.getenv('BEANCOUNT_LOAD_CACHE_FILENAME') or PICKLE_CACHE_FILENAME,
+            PICKLE_CACHE_THRESHOLD,
+            _uncached_load_file)
+
+    # Likewise, cache the parse of each of the input files.
+    global _parse_file
+    if os.getenv('BEANCOUNT_DISABLE_PARSE_CACHE') is None:
+        _parse_file = parse_cache_function(
+            PARSE_CACHE_FILENAME,
+            PARSE_CACHE_THRESHOLD,
+            _uncached_parse_file)
+
+    # Likewise, resume booking from a checkpoint.
+    global _book
+    if os.getenv('BEANCOUNT_DISABLE_BOOKING_CHECKPOINT') is None:
+        _book = booking_checkpoint_function(
+            BOOKING_CHECKPOINT_FILENAME,
+            BOOKING_CHECKPOINT_THRESHOLD,
+            _uncached_book)
+
+initialize()
@@ -0,0 +1,880 @@
+__copyright__ = "Copyright (C) 2014-2016  Martin Blais"
+__license__ = "GNU GPLv2"
+
+import datetime
+import logging
+import unittest
+import tempfile
+import textwrap
+import os
+import sys
+import types
+from unittest import mock
+from os import path
+
+from beancount.core.amount import A
+from beancount.core import data
+from beancount import loader
+from beancount.plugins import readonly_plugin
+from beancount.parser import booking
+from beancount.parser import parser
+from beancount.utils import test_utils
+from beancount.utils import encryption_test
+
+
+TEST_INPUT = """
+
+2014-01-01 open Assets:MyBank:Checking   USD
+2014-01-01 open Expenses:Restaurant   USD
+
+2014-02-22 * "Something happened."
+  Assets:MyBank:Checking       100.00 USD
+  Expenses:Restaurant         -100.00 USD
+
+2015-01-01 close Assets:MyBank:Checking
+2015-01-01 close Expenses:Restaurant
+
+"""
+
+
+class TestLoader(unittest.TestCase):
+
+    def test_run_transformations(self):
+        # Test success case.
+        entries, errors, options_map = parser.parse_string(TEST_INPUT)
+        trans_entries, trans_errors = loader.run_transformations(
+            entries, errors, options_map, None)
+        self.assertEqual(0, len(trans_errors))
+
+        # Test an invalid plugin name.
+        entries, errors, options_map = parser.parse_string(
+            'plugin "invalid.module.name"\n\n' + TEST_INPUT)
+        trans_entries, trans_errors = loader.run_transformations(
+            entries, errors, options_map, None)
+        self.assertEqual(1, len(trans_errors))
+
+    def test_load(self):
+        with test_utils.capture():
+            with tempfile.NamedTemporaryFile('w') as tmpfile:
+                tmpfile.write(TEST_INPUT)
+                tmpfile.flush()
+                entries, errors, options_map = loader.load_file(tmpfile.name)
+                self.assertTrue(isinstance(entries, list))
+                self.assertTrue(isinstance(errors, list))
+                self.assertTrue(isinstance(options_map, dict))
+
+                entries, errors, options_map = loader.load_file(tmpfile.name,
+                                                                log_timings=logging.info)
+                self.assertTrue(isinstance(entries, list))
+                self.assertTrue(isinstance(errors, list))
+                self.assertTrue(isinstance(options_map, dict))
+
+    def test_load_string(self):
+        with test_utils.capture():
+            entries, errors, options_map = loader.load_string(TEST_INPUT)
+            self.assertTrue(isinstance(entries, list))
+            self.assertTrue(isinstance(errors, list))
+            self.assertTrue(isinstance(options_map, dict))
+
+            entries, errors, options_map = loader.load_string(TEST_INPUT,
+                                                              log_timings=logging.info)
+            self.assertTrue(isinstance(entries, list))
+            self.assertTrue(isinstance(errors, list))
+            self.assertTrue(isinstance(options_map, dict))
+
+    def test_load_nonexist(self):
+        entries, errors, options_map = loader.load_file('/some/bullshit/filename.beancount')
+        self.assertEqual([], entries)
+        self.assertTrue(errors)
+        self.assertRegex(errors[0].message, 'does not exist')
+
+    @mock.patch.dict(loader.RENAMED_MODULES,
+                     {"beancount.ops.auto_accounts": "beancount.plugins.auto_accounts"},
+                     clear=True)
+    @mock.patch('warnings.warn')
+    def test_renamed_plugin_warnings(self, warn):
+        with test_utils.capture('stderr'):
+            entries, errors, options_map = loader.load_string("""
+              plugin "beancount.ops.auto_accounts"
+            """, dedent=True)
+        self.assertTrue(warn.called)
+        self.assertFalse(errors)
+
+
+class TestLoadDoc(unittest.TestCase):
+
+    def test_load_doc(self):
+        def test_function(self_, entries, errors, options_map):
+            self.assertTrue(isinstance(entries, list))
+            self.assertTrue(isinstance(errors, list))
+            self.assertTrue(isinstance(options_map, dict))
+
+        test_function.__doc__ = TEST_INPUT
+        test_function = loader.load_doc(test_function)
+        test_function(self)
+
+    # pylint: disable=empty-docstring
+    @loader.load_doc()
+    def test_load_doc_empty(self, entries, errors, options_map):
+        """
+        """
+        self.assertTrue(isinstance(entries, list))
+        self.assertTrue(isinstance(errors, list))
+        self.assertFalse(errors)
+        self.assertTrue(isinstance(options_map, dict))
+
+    @loader.load_doc(expect_errors=True)
+    def test_load_doc_plugin(self, entries, errors, options_map):
+        """
+        plugin "beancount.does.not.exist"
+        """
+        self.assertTrue(isinstance(entries, list))
+        self.assertTrue(isinstance(options_map, dict))
+        self.assertTrue([loader.LoadError], list(map(type, errors)))
+
+    def test_load_doc_plugin_auto_pythonpath(self):
+        with tempfile.TemporaryDirectory() as tmpdir:
+            ledger_fn = path.join(tmpdir, 'my.beancount')
+            with open(ledger_fn, 'w') as ledger_file:
+                ledger_file.write('option "insert_pythonpath" "TRUE"\n')
+                ledger_file.write('plugin "localplugin"\n')
+
+            plugin_fn = path.join(tmpdir, 'localplugin.py')
+            with open(plugin_fn, 'w') as plugin_file:
+                plugin_file.write(textwrap.dedent("""\
+                  __plugins__ = ()
+                """))
+            entries, errors, options_map = loader.load_file(ledger_fn)
+            self.assertTrue(isinstance(entries, list))
+            self.assertTrue(isinstance(errors, list))
+            self.assertTrue(isinstance(options_map, dict))
+            self.assertFalse(errors)
+
+
+class TestLoadIncludes(unittest.TestCase):
+
+    def test_load_file_no_includes(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  2014-01-01 open Assets:Apples
+                """})
+            entries, errors, options_map = loader.load_file(
+                path.join(tmp, 'apples.beancount'))
+            self.assertEqual(0, len(errors))
+            self.assertEqual(['apples.beancount'],
+                             list(map(path.basename, options_map['include'])))
+
+    def test_load_file_nonexist(self):
+        entries, errors, options_map = loader.load_file('/bull/bla/root.beancount')
+        self.assertEqual(1, len(errors))
+        self.assertRegex(errors[0].message, 'does not exist')
+        self.assertEqual([], list(map(path.basename, options_map['include'])))
+
+    def test_load_file_with_nonexist_include(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'root.beancount': """
+                  include "/some/file/that/does/not/exist.beancount"
+                """})
+            entries, errors, options_map = loader.load_file(
+                path.join(tmp, 'root.beancount'))
+            self.assertEqual(1, len(errors))
+            self.assertRegex(errors[0].message, 'does not (match any|exist)')
+        self.assertEqual(['root.beancount'],
+                         list(map(path.basename, options_map['include'])))
+
+    def test_load_file_with_absolute_include(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "{root}/fruits/oranges.beancount"
+                  2014-01-01 open Assets:Apples
+                """,
+                'fruits/oranges.beancount': """
+                  2014-01-02 open Assets:Oranges
+                """})
+            entries, errors, options_map = loader.load_file(
+                path.join(tmp, 'apples.beancount'))
+        self.assertFalse(errors)
+        self.assertEqual(2, len(entries))
+        self.assertEqual(['apples.beancount', 'oranges.beancount'],
+                         list(map(path.basename, options_map['include'])))
+
+    def test_load_file_with_relative_include(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "fruits/oranges.beancount"
+                  2014-01-01 open Assets:Apples
+                """,
+                'fruits/oranges.beancount': """
+                  2014-01-02 open Assets:Oranges
+                """})
+            entries, errors, options_map = loader.load_file(
+                path.join(tmp, 'apples.beancount'))
+        self.assertFalse(errors)
+        self.assertEqual(2, len(entries))
+        self.assertEqual(['apples.beancount', 'oranges.beancount'],
+                         list(map(path.basename, options_map['include'])))
+
+    def test_load_file_with_multiple_includes(self):
+        # Including recursive includes and mixed and absolute.
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "fruits/oranges.beancount"
+                  include "{root}/legumes/patates.beancount"
+                  2014-01-01 open Assets:Apples
+                """,
+                'fruits/oranges.beancount': """
+                  include "../legumes/tomates.beancount"
+                  2014-01-02 open Assets:Oranges
+                """,
+                'legumes/tomates.beancount': """
+                  2014-01-03 open Assets:Tomates
+                """,
+                'legumes/patates.beancount': """
+                  2014-01-04 open Assets:Patates
+                """})
+            entries, errors, options_map = loader.load_file(
+                path.join(tmp, 'apples.beancount'))
+        self.assertFalse(errors)
+        self.assertEqual(4, len(entries))
+        self.assertEqual(['apples.beancount', 'oranges.beancount',
+                          'patates.beancount', 'tomates.beancount'],
+                         list(map(path.basename, options_map['include'])))
+
+    def test_load_file_with_duplicate_includes(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "fruits/oranges.beancount"
+                  include "{root}/legumes/tomates.beancount"
+                  2014-01-01 open Assets:Apples
+                """,
+                'fruits/oranges.beancount': """
+                  include "../legumes/tomates.beancount"
+                  2014-01-02 open Assets:Oranges
+                """,
+                'legumes/tomates.beancount': """
+                  2014-01-03 open Assets:Tomates
+                """,
+                'legumes/patates.beancount': """
+                  2014-01-04 open Assets:Patates
+                """})
+            entries, errors, options_map = loader.load_file(
+                path.join(tmp, 'apples.beancount'))
+        self.assertTrue(errors)
+        self.assertEqual(3, len(entries))
+        self.assertEqual(['apples.beancount', 'oranges.beancount', 'tomates.beancount'],
+                         list(map(path.basename, options_map['include'])))
+
+    def test_load_string_with_relative_include(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "fruits/oranges.beancount"
+                  2014-01-01 open Assets:Apples
+                """,
+                'fruits/oranges.beancount': """
+                  2014-01-02 open Assets:Oranges
+                """})
+            try:
+                cwd = os.getcwd()
+                os.chdir(tmp)
+                entries, errors, options_map = loader.load_file(
+                    path.join(tmp, 'apples.beancount'))
+            finally:
+                os.chdir(cwd)
+        self.assertFalse(errors)
+        self.assertEqual(2, len(entries))
+        self.assertEqual(['apples.beancount', 'oranges.beancount'],
+                         list(map(path.basename, options_map['include'])))
+
+    def test_load_file_return_include_filenames(self):
+        # Also check that they are normalized paths.
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "oranges.beancount"
+                  2014-01-01 open Assets:Apples
+                """,
+                'oranges.beancount': """
+                  include "bananas.beancount"
+                  2014-01-02 open Assets:Oranges
+                """,
+                'bananas.beancount': """
+                  2014-01-02 open Assets:Bananas
+                """})
+            entries, errors, options_map = loader.load_file(
+                path.join(tmp, 'apples.beancount'))
+        self.assertFalse(errors)
+        self.assertEqual(3, len(entries))
+        self.assertTrue(all(path.isabs(filename)
+                            for filename in options_map['include']))
+        self.assertEqual(['apples.beancount', 'bananas.beancount', 'oranges.beancount'],
+                         list(map(path.basename, options_map['include'])))
+
+
+class TestLoadIncludesParallel(unittest.TestCase):
+
+    FILES = {
+        'apples.beancount': """
+          include "fruits/*.beancount"
+          include "legumes/tomates.beancount"
+          include "legumes/missing.beancount"
+          option "operating_currency" "USD"
+          2014-01-01 open Assets:Apples
+        """,
+        'fruits/oranges.beancount': """
+          include "../apples.beancount"
+          include "../legumes/tomates.beancount"
+          option "operating_currency" "CAD"
+          2014-01-02 open Assets:Oranges  CAD
+        """,
+        'fruits/bananas.beancount': """
+          include "../legumes/patates.beancount"
+          option "operating_currency" "EUR"
+          2014-01-03 open Assets:Bananas  EUR
+          2014-01-03 invalid Assets:Bananas
+        """,
+        'legumes/tomates.beancount': """
+          2014-01-04 open Assets:Tomates
+        """,
+        'legumes/patates.beancount': """
+          include "../fruits/bananas.beancount"
+          2014-01-05 open Assets:Patates  JPY
+        """}
+
+    def parse(self, tmp, num_processes):
+        with mock.patch.object(loader, 'PARSE_PROCESSES', num_processes), \
+             mock.patch.object(loader, 'PARALLEL_PARSE_THRESHOLD', 0):
+            return loader._parse_recursive(
+                [(path.join(tmp, 'apples.beancount'), True)], None)
+
+    def test_parse_files_parallel(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, self.FILES)
+            sources = [(path.join(tmp, 'fruits/oranges.beancount'), True),
+                       (path.join(tmp, 'fruits/bananas.beancount'), True),
+                       (path.join(tmp, 'fruits/oranges.beancount'), True),
+                       (path.join(tmp, 'legumes/missing.beancount'), True),
+                       ('2014-01-01 open Assets:String', False)]
+            with mock.patch.object(loader, 'PARSE_PROCESSES', 2), \
+                 mock.patch.object(loader, 'PARALLEL_PARSE_THRESHOLD', 0):
+                parsed = loader._parse_files_parallel(sources, set(), None)
+                self.assertEqual({path.join(tmp, 'fruits/oranges.beancount'),
+                                  path.join(tmp, 'fruits/bananas.beancount')},
+                                 set(parsed))
+                self.assertEqual(parser.parse_file(
+                    path.join(tmp, 'fruits/bananas.beancount'))[0],
+                                 parsed[path.join(tmp, 'fruits/bananas.beancount')][0])
+
+                # Too few files.
+                self.assertEqual({}, loader._parse_files_parallel(sources[2:], set(), None))
+
+            with mock.patch.object(loader, 'PARSE_PROCESSES', 2):
+                # Too small files.
+                self.assertEqual({}, loader._parse_files_parallel(sources, set(), None))
+
+    def test_parse_recursive_parallel(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, self.FILES)
+            entries, errors, options_map = self.parse(tmp, 1)
+            par_entries, par_errors, par_options_map = self.parse(tmp, 4)
+
+        self.assertEqual(entries, par_entries)
+        self.assertEqual([error.message for error in errors],
+                         [error.message for error in par_errors])
+        for key in 'include', 'operating_currency', 'commodities':
+            self.assertEqual(options_map[key], par_options_map[key])
+
+        # Cycles and duplicates are still detected.
+        self.assertEqual(5, len(entries))
+        self.assertEqual(['apples.beancount', 'bananas.beancount', 'oranges.beancount',
+                          'patates.beancount', 'tomates.beancount'],
+                         list(map(path.basename, par_options_map['include'])))
+        self.assertEqual(3, sum('Duplicate filename' in error.message
+                                for error in par_errors))
+        self.assertEqual(1, sum('does not match' in error.message
+                                for error in par_errors))
+        self.assertEqual(['USD', 'CAD', 'EUR'], par_options_map['operating_currency'])
+        self.assertEqual({'CAD', 'EUR', 'JPY'}, par_options_map['commodities'])
+
+
+@readonly_plugin
+def count_entries(entries, unused_options_map, config=None):
+    """A read-only plugin reporting the number and type of the entries."""
+    message = '{} {} {}'.format(config, type(entries).__name__, len(entries))
+    return entries, [loader.LoadError(data.new_metadata('<count>', 0), message, None)]
+
+
+@readonly_plugin
+def fail_entries(entries, unused_options_map):
+    """A read-only plugin failing."""
+    raise TypeError("Failed")
+
+
+def add_entry(entries, unused_options_map):
+    """A plugin adding an entry."""
+    return entries + [data.Open(data.new_metadata('<add>', 0), entries[0].date,
+                                'Assets:Added', None, None)], []
+
+
+class TestReadonlyPlugins(unittest.TestCase):
+
+    def load(self):
+        modules = {}
+        for name, plugins in [('count', [count_entries]),
+                              ('fail', [count_entries, fail_entries]),
+                              ('add', [count_entries, add_entry])]:
+            modules['readonly_test.' + name] = module = types.ModuleType(name)
+            module.__plugins__ = plugins
+        with mock.patch.dict(sys.modules, modules):
+            return loader.load_string("""
+              plugin "readonly_test.count" "a"
+              plugin "readonly_test.fail"
+              plugin "readonly_test.count" "b"
+              plugin "readonly_test.add"
+              plugin "readonly_test.count" "c"
+              plugin "readonly_test.count" "d"
+
+              2014-01-01 open Assets:Cash
+              2014-01-01 open Assets:Other
+            """, dedent=True)
+
+    def test_readonly_plugins(self):
+        entries, errors, _ = self.load()
+        self.assertEqual(3, len(entries))
+        self.assertEqual(['a tuple 2',
+                          'None tuple 2',
+                          'Error importing "readonly_test.fail": Failed',
+                          'b tuple 2',
+                          'None list 2',
+                          'c tuple 3',
+                          'd tuple 3'],
+                         [error.message for error in errors])
+
+    def test_readonly_plugins_parallel(self):
+        entries, errors, _ = self.load()
+        with mock.patch.object(loader, 'PLUGIN_PROCESSES', 2), \
+             mock.patch.object(loader, 'PARALLEL_PLUGINS_THRESHOLD', 0):
+            par_entries, par_errors, _ = self.load()
+        self.assertEqual(entries, par_entries)
+        self.assertEqual(errors, par_errors)
+        self.assertIsNone(loader._readonly_plugins_state)
+
+
+class TestResortEntries(unittest.TestCase):
+
+    def note(self, day, lineno):
+        return data.Note(data.new_metadata('<test>', lineno),
+                         datetime.date(2014, 1, day), 'Assets:Cash', str(lineno))
+
+    def assertResorted(self, entries, sorted_entries):
+        expected = sorted(entries, key=data.entry_sortkey)
+        resorted = loader.resort_entries(list(entries), list(sorted_entries))
+        self.assertEqual(list(map(id, expected)), list(map(id, resorted)))
+
+    def test_resort_entries(self):
+        sorted_entries = [self.note(day, 1) for day in range(1, 30)]
+        new_entries = [self.note(15, 1), self.note(2, 0), self.note(29, 2)]
+
+        # Unchanged, or with entries removed.
+        self.assertResorted(sorted_entries, sorted_entries)
+        self.assertResorted(sorted_entries[:10] + sorted_entries[12:], sorted_entries)
+        self.assertResorted([], sorted_entries)
+
+        # Appended, prepended or inserted entries, sorted with the same keys
+        # as those around them in the order they were returned.
+        self.assertResorted(sorted_entries + new_entries, sorted_entries)
+        self.assertResorted(new_entries + sorted_entries, sorted_entries)
+        self.assertResorted(sorted_entries[:5] + new_entries + sorted_entries[5:],
+                            sorted_entries)
+        self.assertResorted(new_entries, [])
+
+        # Replaced and reordered entries.
+        self.assertResorted(list(reversed(sorted_entries)), sorted_entries)
+        self.assertResorted([entry._replace(comment='') for entry in sorted_entries],
+                            sorted_entries)
+
+
+class TestLoadIncludesEncrypted(encryption_test.TestEncryptedBase):
+
+    def test_include_encrypted(self):
+        with test_utils.tempdir() as tmpdir:
+            test_utils.create_temporary_files(tmpdir, {
+                'apples.beancount': """
+                  include "oranges.beancount.asc"
+                  2014-01-01 open Assets:Apples
+                """,
+                'oranges.beancount': """
+                  2014-01-02 open Assets:Oranges
+                """})
+
+            # Encrypt the oranges file and remove the unencrypted file.
+            with open(path.join(tmpdir, 'oranges.beancount')) as infile:
+                self.encrypt_as_file(infile.read(),
+                                     path.join(tmpdir, 'oranges.beancount.asc'))
+            os.remove(path.join(tmpdir, 'oranges.beancount'))
+
+            # Load the top-level file which includes the encrypted file.
+            with test_utils.environ('GNUPGHOME', self.ringdir):
+                entries, errors, options_map = loader.load_file(
+                    path.join(tmpdir, 'apples.beancount'))
+
+        self.assertFalse(errors)
+        self.assertEqual(2, len(entries))
+        self.assertRegex(entries[0].meta['filename'], 'apples.beancount')
+        self.assertRegex(entries[1].meta['filename'], 'oranges.+count.asc')
+
+
+class TestLoadCache(unittest.TestCase):
+
+    def setUp(self):
+        self.num_calls = 0
+        mock.patch('beancount.loader._load_file',
+                   loader.pickle_cache_function(loader.PICKLE_CACHE_FILENAME,
+                                                0,  # No time threshold.
+                                                self._load_file)).start()
+    def tearDown(self):
+        mock.patch.stopall()
+
+    def _load_file(self, filename, *args, **kw):
+        self.num_calls += 1
+        return loader._load([(filename, True)], *args, **kw)
+
+    def test_load_cache(self):
+        # Create an initial set of files and load file, thus creating a cache.
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "oranges.beancount"
+                  2014-01-01 open Assets:Apples
+                """,
+                'oranges.beancount': """
+                  include "bananas.beancount"
+                  2014-01-02 open Assets:Oranges
+                """,
+                'bananas.beancount': """
+                  2014-01-02 open Assets:Bananas
+                """})
+            top_filename = path.join(tmp, 'apples.beancount')
+            entries, errors, options_map = loader.load_file(top_filename)
+            self.assertFalse(errors)
+            self.assertEqual(3, len(entries))
+            self.assertEqual(1, self.num_calls)
+
+            # Make sure the cache was created.
+            self.assertTrue(path.exists(path.join(tmp, '.apples.beancount.picklecache')))
+
+            # Load the root file again, make sure the cache is being hit.
+            entries, errors, options_map = loader.load_file(top_filename)
+            self.assertEqual(1, self.num_calls)
+
+            # Touch the top-level file and ensure it's a cache miss.
+            with open(top_filename, 'a') as file:
+                file.write('\n')
+            entries, errors, options_map = loader.load_file(top_filename)
+            self.assertEqual(2, self.num_calls)
+
+            # Load the root file again, make sure the cache is being hit.
+            entries, errors, options_map = loader.load_file(top_filename)
+            self.assertEqual(2, self.num_calls)
+
+            # Touch the top-level file and ensure it's a cache miss.
+            with open(top_filename, 'a') as file:
+                file.write('\n')
+            entries, errors, options_map = loader.load_file(top_filename)
+            self.assertEqual(3, self.num_calls)
+
+    def test_load_cache_moved_file(self):
+        # Create an initial set of files and load file, thus creating a cache.
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "oranges.beancount"
+                  2014-01-01 open Assets:Apples
+                """,
+                'oranges.beancount': """
+                  2014-01-02 open Assets:Oranges
+                """})
+            top_filename = path.join(tmp, 'apples.beancount')
+            entries, errors, options_map = loader.load_file(top_filename)
+            self.assertFalse(errors)
+            self.assertEqual(2, len(entries))
+            self.assertEqual(1, self.num_calls)
+
+            # Make sure the cache was created.
+            self.assertTrue(path.exists(path.join(tmp, '.apples.beancount.picklecache')))
+
+            # Check that it doesn't need refresh
+            self.assertFalse(loader.needs_refresh(options_map))
+
+            # Move the input file.
+            new_top_filename = path.join(tmp, 'bigapples.beancount')
+            os.rename(top_filename, new_top_filename)
+
+            # Check that it needs refresh.
+            self.assertTrue(loader.needs_refresh(options_map))
+
+            # Load the root file again, make sure the cache is being hit.
+            entries, errors, options_map = loader.load_file(top_filename)
+            self.assertEqual(2, self.num_calls)
+
+    @mock.patch('os.remove', side_effect=OSError)
+    @mock.patch('logging.warning')
+    def test_load_cache_read_only_fs(self, remove_mock, warn_mock):
+        # Create an initial set of files and load file, thus creating a cache.
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  2014-01-01 open Assets:Apples
+                """})
+            filename = path.join(tmp, 'apples.beancount')
+            entries, errors, options_map = loader.load_file(filename)
+            with open(filename, 'w'): pass
+            entries, errors, options_map = loader.load_file(filename)
+            self.assertEqual(1, len(warn_mock.mock_calls))
+
+    @mock.patch('beancount.loader.PICKLE_CACHE_THRESHOLD', 0.0)
+    def test_load_cache_override_filename_pattern(self):
+        orig_load_file = loader._load_file
+        prev_env = os.getenv('BEANCOUNT_LOAD_CACHE_FILENAME')
+        os.environ['BEANCOUNT_LOAD_CACHE_FILENAME'] = '__{filename}__'
+        loader.initialize()
+        try:
+            with test_utils.tempdir() as tmp:
+                test_utils.create_temporary_files(tmp, {
+                    'apples.beancount': """
+                      2014-01-01 open Assets:Apples
+                    """})
+                filename = path.join(tmp, 'apples.beancount')
+                entries, errors, options_map = loader.load_file(filename)
+                self.assertEqual({'__apples.beancount__', 'apples.beancount'},
+                                 set(os.listdir(tmp)))
+        finally:
+            # Restore pre-test values.
+            loader._load_file = orig_load_file
+            if prev_env is None:
+                del os.environ['BEANCOUNT_LOAD_CACHE_FILENAME']
+            else:
+                os.environ['BEANCOUNT_LOAD_CACHE_FILENAME'] = prev_env
+
+
+class TestParseCache(unittest.TestCase):
+
+    def setUp(self):
+        self.parsed = []
+        mock.patch('beancount.loader._parse_file',
+                   loader.parse_cache_function(loader.PARSE_CACHE_FILENAME,
+                                               0,  # No time threshold.
+                                               self._parse_file)).start()
+
+    def tearDown(self):
+        mock.patch.stopall()
+
+    def _parse_file(self, filename, *args, **kw):
+        self.parsed.append(path.basename(filename))
+        return parser.parse_file(filename, *args, **kw)
+
+    def parse(self, filename):
+        self.parsed.clear()
+        return loader._parse_recursive([(filename, True)], None)
+
+    def test_parse_cache(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "oranges.beancount"
+                  include "bananas.beancount"
+                  option "operating_currency" "USD"
+                  2014-01-01 open Assets:Apples
+                """,
+                'oranges.beancount': """
+                  2014-01-02 open Assets:Oranges  CAD
+                """,
+                'bananas.beancount': """
+                  2014-01-02 open Assets:Bananas
+                """})
+            top_filename = path.join(tmp, 'apples.beancount')
+            entries, errors, options_map = self.parse(top_filename)
+            self.assertEqual(['apples.beancount', 'oranges.beancount',
+                              'bananas.beancount'], self.parsed)
+            self.assertTrue(path.exists(path.join(tmp, '.oranges.beancount.parsecache')))
+
+            # Parse again, all the files come from the cache.
+            cached_entries, cached_errors, cached_options_map = self.parse(top_filename)
+            self.assertEqual([], self.parsed)
+            self.assertEqual(entries, cached_entries)
+            self.assertEqual(options_map['include'], cached_options_map['include'])
+            self.assertEqual({'CAD'}, cached_options_map['commodities'])
+
+            # Edit one of the files, only that one is parsed again.
+            with open(path.join(tmp, 'bananas.beancount'), 'a') as file:
+                file.write('2014-01-03 open Assets:Plantains\n')
+            entries, errors, options_map = self.parse(top_filename)
+            self.assertEqual(['bananas.beancount'], self.parsed)
+            self.assertEqual(4, len(entries))
+
+            # Corrupt a cache file, it gets parsed again.
+            with open(path.join(tmp, '.oranges.beancount.parsecache'), 'wb') as file:
+                file.write(b'garbage')
+            with test_utils.capture('stderr'):
+                self.parse(top_filename)
+            self.assertEqual(['oranges.beancount'], self.parsed)
+
+            # A different parser invalidates all the files.
+            with mock.patch.object(loader, 'get_parser_version', return_value='other'):
+                self.parse(top_filename)
+            self.assertEqual(3, len(self.parsed))
+
+    def test_parse_cache_key(self):
+        key = loader.compute_parse_cache_key('/a.beancount', b'contents')
+        self.assertEqual(key, loader.compute_parse_cache_key('/a.beancount', b'contents'))
+        self.assertNotEqual(key, loader.compute_parse_cache_key('/b.beancount',
+                                                                b'contents'))
+        self.assertNotEqual(key, loader.compute_parse_cache_key('/a.beancount',
+                                                                b'contents\n'))
+        self.assertNotEqual(key, loader.compute_parse_cache_key('/a.beancount',
+                                                                b'contents',
+                                                                encoding='latin1'))
+
+
+class TestBookingCheckpoint(unittest.TestCase):
+
+    def setUp(self):
+        mock.patch('beancount.loader._book',
+                   loader.booking_checkpoint_function(loader.BOOKING_CHECKPOINT_FILENAME,
+                                                      0,  # No time threshold.
+                                                      loader._uncached_book)).start()
+        self.book_mock = mock.patch('beancount.parser.booking.book_checkpointed',
+                                    wraps=booking.book_checkpointed).start()
+
+    def tearDown(self):
+        mock.patch.stopall()
+
+    def load(self, filename):
+        return loader._load([(filename, True)], None, None, None)
+
+    def test_booking_checkpoint(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'ledger.beancount': """
+                  2014-01-01 open Assets:Invest
+                  2014-01-01 open Assets:Cash
+
+                  2014-01-02 *
+                    Assets:Invest     10 HOOL {100.00 USD}
+                    Assets:Cash
+
+                  2014-01-03 *
+                    Assets:Invest     -2 HOOL {}
+                    Assets:Cash
+                """})
+            filename = path.join(tmp, 'ledger.beancount')
+            checkpoint_filename = path.join(tmp, '.ledger.beancount.bookingcheckpoint')
+            self.load(filename)
+            self.assertTrue(path.exists(checkpoint_filename))
+            self.assertIsNone(self.book_mock.call_args[0][2])
+
+            # Append a transaction, booking resumes from the checkpoint.
+            with open(filename, 'a') as file:
+                file.write('2014-01-04 *\n'
+                           '  Assets:Invest     -3 HOOL {}\n'
+                           '  Assets:Cash\n')
+            entries, errors, _ = self.load(filename)
+            checkpoint = self.book_mock.call_args[0][2]
+            self.assertEqual(datetime.date(2014, 1, 3), checkpoint.date)
+            self.assertEqual(entries[:3], checkpoint.entries)
+            with mock.patch.object(loader, '_book', loader._uncached_book):
+                expected_entries, expected_errors, _ = self.load(filename)
+            self.assertEqual(expected_entries, entries)
+            self.assertEqual(expected_errors, errors)
+
+            # Load again, the checkpoint has moved to the last date.
+            self.load(filename)
+            self.assertEqual(datetime.date(2014, 1, 4),
+                             self.book_mock.call_args[0][2].date)
+
+            # Edit the history, the checkpoint isn't used.
+            with open(filename) as file:
+                contents = file.read()
+            with open(filename, 'w') as file:
+                file.write(contents.replace('10 HOOL', '20 HOOL'))
+            entries, errors, _ = self.load(filename)
+            self.assertEqual([], errors)
+            self.assertEqual(A('-2000.00 USD'), entries[2].postings[1].units)
+
+            # Corrupt the checkpoint file, all the entries are booked.
+            with open(checkpoint_filename, 'wb') as file:
+                file.write(b'garbage')
+            with test_utils.capture('stderr'):
+                entries, errors, _ = self.load(filename)
+            self.assertEqual([], errors)
+            self.assertEqual(A('-2000.00 USD'), entries[2].postings[1].units)
+
+
+class TestEncoding(unittest.TestCase):
+
+    def test_string_unicode(self):
+        utf8_bytes = textwrap.dedent("""
+          2015-01-01 open Assets:Something
+          2015-05-23 note Assets:Something "¡¢£¤¥¦§¨©ª«¬®¯°±²³´µ¶·¸¹º»¼ "
+        """).encode('utf-8')
+        entries, errors, options_map = loader.load_string(utf8_bytes, encoding='utf8')
+        self.assertFalse(errors)
+
+    def test_string_latin1(self):
+        utf8_bytes = textwrap.dedent("""
+          2015-01-01 open Assets:Something
+          2015-05-23 note Assets:Something "¡¢£¤¥¦§¨©ª«¬®¯°±²³´µ¶·¸¹º»¼ "
+        """).encode('latin1')
+        entries, errors, options_map = loader.load_string(utf8_bytes, encoding='latin1')
+        self.assertFalse(errors)
+
+
+class TestOptionsAggregation(unittest.TestCase):
+
+    def test_aggregate_operating_currencies(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "oranges.beancount"
+                  include "bananas.beancount"
+                  option "operating_currency" "USD"
+                """,
+                'oranges.beancount': """
+                  option "operating_currency" "CAD"
+                """,
+                'bananas.beancount': """
+                  option "operating_currency" "EUR"
+                """})
+            top_filename = path.join(tmp, 'apples.beancount')
+            entries, errors, options_map = loader.load_file(top_filename)
+
+            self.assertEqual({'USD', 'EUR', 'CAD'}, set(options_map['operating_currency']))
+
+    def test_aggregate_commodities(self):
+        with test_utils.tempdir() as tmp:
+            test_utils.create_temporary_files(tmp, {
+                'apples.beancount': """
+                  include "oranges.beancount"
+                  include "bananas.beancount"
+                  option "operating_currency" "USD"
+                """,
+                'oranges.beancount': """
+                  2015-12-12 open Assets:CA:Checking  CAD
+                """,
+                'bananas.beancount': """
+                  2015-12-13 open Assets:FR:Checking  EUR
+                """})
+            top_filename = path.join(tmp, 'apples.beancount')
+            entries, errors, options_map = loader.load_file(top_filename)
+
+            self.assertEqual({'EUR', 'CAD'}, options_map['commodities'])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,92 @@
+__copyright__ = "Copyright (C) 2017  Martin Blais"
+__license__ = "GNU GPLv2"
+
+import io
+import json
+import unittest
+
+from beancount.parser import benchmark
+from beancount.utils import test_utils
+from beancount import loader
+
+
+class TestBenchmark(test_utils.TestCase):
+
+    def test_generate_ledger(self):
+        oss = io.StringIO()
+        benchmark.generate_ledger(oss, 500)
+        entries, errors, _ = loader.load_string(oss.getvalue())
+        self.assertFalse(errors)
+        # One more account is opened for the stock.
+        self.assertEqual(len(benchmark.ACCOUNTS) + 1 + 500, len(entries))
+
+    def test_parse_size(self):
+        self.assertEqual(2500, benchmark.parse_size('2500'))
+        self.assertEqual(10000, benchmark.parse_size('10K'))
+        self.assertEqual(2000000, benchmark.parse_size('2m'))
+        with self.assertRaises(ValueError):
+            benchmark.parse_size('1G')
+
+    @test_utils.docfile
+    def test_run_stages(self, filename):
+        """
+          2014-01-01 open Assets:Cash
+          2014-01-01 open Income:Salary
+
+          2014-02-01 * "Salary"
+            Assets:Cash      1000.00 USD
+            Income:Salary
+        """
+        results = benchmark.run_stages(filename)
+        self.assertEqual(['lex', 'parse', 'booking', 'plugins', 'validation'],
+                         [result['stage'] for result in results])
+        self.assertEqual(3, results[1]['directives'])
+        self.assertTrue(results[0]['tokens'] > 0)
+        self.assertIsNone(results[0]['directives'])
+        self.assertIsNone(results[2]['tokens'])
+
+    @test_utils.docfile
+    def test_run_stages_errors(self, filename):
+        """
+          2014-02-01 * "Salary"
+            Assets:Cash      1000.00 USD
+            Income:Salary
+        """
+        with self.assertRaises(ValueError):
+            benchmark.run_stages(filename)
+
+    def test_main(self):
+        with test_utils.tempdir() as tmpdir:
+            with test_utils.capture('stdout') as stdout:
+                result = test_utils.run_with_args(benchmark.main, [
+                    '--sizes=200,1K', '--format=json', '--directory', tmpdir])
+            self.assertEqual(0, result)
+            report = json.loads(stdout.getvalue())
+            self.assertEqual([200, 1000], [ledger['postings']
+                                           for ledger in report['ledgers']])
+            for ledger in report['ledgers']:
+                self.assertEqual(5, len(ledger['stages']))
+                parse = ledger['stages'][1]
+                self.assertTrue(parse['tokens_per_sec'] > 0)
+                self.assertTrue(parse['directives_per_sec'] > 0)
+
+            # The ledgers are reused from the directory.
+            with test_utils.capture('stdout') as stdout:
+                result = test_utils.run_with_args(benchmark.main, [
+                    '--sizes=200', '--directory', tmpdir])
+            self.assertEqual(0, result)
+            self.assertRegex(stdout.getvalue(), r'200 +validation')
+
+    def test_main_compare_fastcall(self):
+        with test_utils.capture('stdout') as stdout:
+            result = test_utils.run_with_args(benchmark.main, [
+                '--sizes=200', '--compare-fastcall'])
+        self.assertEqual(0, result)
+        output = stdout.getvalue()
+        self.assertRegex(output, r'200 postings')
+        self.assertRegex(output, r'fastcall=True .* tokens/s')
+        self.assertRegex(output, r'fastcall adds')
+
+
+if __name__ == '__main__':
+    unittest.main()
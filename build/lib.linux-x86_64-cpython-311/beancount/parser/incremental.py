@@ -0,0 +1,359 @@
+"""Incremental reparsing of edited ledger files.
+
+Editors and other interactive tools which validate a file as it is being typed
+would otherwise have to parse the entire file again after every change. Instead,
+keep the result of parsing it with parse_file(), and apply each edit with
+reparse(): only the directives around the edited byte range are lexed and parsed
+again, from the beginning of the dated directive where the edit begins up to the
+next line that begins with a date or changes the state of the parser after it,
+where the parser is known to be resynchronized.
+
+Edits which touch lines that change the state of the parser for the rest of the
+file (options, plugins, includes and pushed tags and metadata) cause the whole
+file to be parsed again, as do all edits to files where a string literal may
+span lines, and edits to directives with invalid tokens or syntax errors, before
+or after the edit. Note that the keywords of these directives are also looked
+for within strings.
+"""
+__copyright__ = "Copyright (C) 2017  Martin Blais"
+__license__ = "GNU GPLv2"
+
+import collections
+import datetime
+import re
+
+from beancount.core import data
+from beancount.parser import _parser
+from beancount.parser import grammar
+from beancount.parser import lexer
+
+
+# The result of parsing a file, kept to reparse it incrementally.
+#
+# Attributes:
+#   filename: The absolute filename of the parsed file, as stored in the
+#     metadata.
+#   contents: A bytes object, the contents that were parsed.
+#   entries: The sorted list of parsed directives, as from parser.parse_file().
+#   errors: The list of errors.
+#   options_map: The dict of options.
+#   num_open_lines: The number of lines which may leave a string literal open,
+#     e.g., the first line of a multi-line string. The file is only reparsed
+#     incrementally if there are none.
+ParsedFile = collections.namedtuple(
+    'ParsedFile', 'filename contents entries errors options_map num_open_lines')
+
+
+# A regular expression matching the lines which begin with a date, where the
+# parser resynchronizes.
+DATE_LINE_RE = re.compile(br'^[0-9]{4,}[\-/][0-9]+[\-/][0-9]+', re.M)
+
+# A regular expression matching dates anywhere.
+DATE_RE = re.compile(br'([0-9]{4,})[\-/]([0-9]+)[\-/]([0-9]+)')
+
+# A regular expression matching the keywords of the directives which change the
+# state of the parser for the rest of the file. These are also matched within
+# lines, where the parser may find them when it recovers from a syntax error.
+STATE_RE = re.compile(
+    br'(?:^|(?<=[ \t]))(option|plugin|include|pushtag|poptag|pushmeta|popmeta)\b', re.M)
+
+# A regular expression matching the lines where a reparsed region may end: the
+# lines which begin with a date and those which change the state.
+END_LINE_RE = re.compile(
+    br'^([0-9]{4,}[\-/][0-9]+[\-/][0-9]+|'
+    br'(option|plugin|include|pushtag|poptag|pushmeta|popmeta)\b)', re.M)
+
+# A regular expression matching the lines which contain quotes.
+QUOTE_LINE_RE = re.compile(br'^[^\n"]*"[^\n]*', re.M)
+
+# A regular expression matching the directives which push or pop tags and
+# metadata, up to the end of their line.
+PUSH_RE = re.compile(
+    br'(?:^|(?<=[ \t]))(pushtag|poptag|pushmeta|popmeta)\b[^\n]*', re.M)
+
+
+def parse_file(filename):
+    """Parse a file, keeping what is needed to reparse it incrementally.
+
+    Args:
+      filename: The name of the file to parse.
+    Returns:
+      An instance of ParsedFile.
+    """
+    with open(filename, 'rb') as file:
+        contents = file.read()
+    return parse_contents(filename, contents)
+
+
+def parse_contents(filename, contents):
+    """Parse the contents of a file, keeping them to reparse them incrementally.
+
+    Args:
+      filename: The name of the file the contents are from.
+      contents: A bytes object.
+    Returns:
+      An instance of ParsedFile.
+    """
+    builder = grammar.Builder(filename)
+    _parser.parse_string(contents, builder, report_filename=filename)
+    entries, errors, options_map = builder.finalize()
+    return ParsedFile(filename, contents, entries, errors, options_map,
+                      count_open_lines(contents))
+
+
+def reparse(parsed_file, begin, end, text):
+    """Apply an edit to a parsed file and reparse the directives it affects.
+
+    Only the directives from the beginning of the dated directive where the edit
+    begins up to the next line beginning with a date after it (or changing the
+    state of the parser) are parsed again.
+    The line numbers in the metadata of the directives and errors which follow
+    them are updated in place, so the previous ParsedFile instance should not be
+    used anymore. The display context and commodities of the options are updated
+    with those of the new directives, but not cleared of those of the replaced
+    ones.
+
+    Args:
+      parsed_file: An instance of ParsedFile.
+      begin: The byte offset of the beginning of the replaced range.
+      end: The byte offset of the end of the replaced range.
+      text: A bytes or str object, the replacement text.
+    Returns:
+      A triple of the new ParsedFile instance, the list of directives which were
+      removed and the list of directives which replace them, both sorted.
+    """
+    if isinstance(text, str):
+        text = text.encode('utf8')
+    old_contents = parsed_file.contents
+    if not 0 <= begin <= end <= len(old_contents):
+        raise ValueError("Invalid range for an edit: {}-{}".format(begin, end))
+    contents = b''.join((old_contents[:begin], text, old_contents[end:]))
+
+    # Find the beginning of the dated directive where the edit begins, which
+    # must still begin there after the edit.
+    region_begin = old_contents.rfind(b'\n', 0, begin) + 1
+    while region_begin > 0 and not (DATE_LINE_RE.match(old_contents, region_begin) and
+                                    DATE_LINE_RE.match(contents, region_begin)):
+        region_begin = old_contents.rfind(b'\n', 0, region_begin - 1) + 1
+
+    # Find the next line beginning with a date or changing the state after the
+    # edit. The text which follows the edit is the same in the old and new
+    # contents, but the line right after it must begin a line in both.
+    new_end = begin + len(text)
+    next_line = contents.rfind(b'\n', 0, new_end) + 1
+    if next_line < new_end or old_contents[end - 1:end] != b'\n':
+        next_line = contents.find(b'\n', new_end) + 1 or len(contents)
+    match = END_LINE_RE.search(contents, next_line)
+    region_end = match.start() if match else len(contents)
+    old_region_end = region_end - new_end + end
+
+    old_region = old_contents[region_begin:old_region_end]
+    region = contents[region_begin:region_end]
+    filename = parsed_file.filename
+    first_line = old_contents.count(b'\n', 0, region_begin) + 1
+    old_end_line = first_line + old_region.count(b'\n')
+    if old_region and not old_region.endswith(b'\n'):
+        # The region runs to the end of a file without a final newline.
+        old_end_line += 1
+
+    delta = region.count(b'\n') - old_region.count(b'\n')
+
+    def in_region(meta, end_line=old_end_line):
+        return (isinstance(meta, dict) and meta.get('filename') == filename and
+                first_line <= meta.get('lineno', 0) < end_line)
+
+    def is_unsafe(error, end_line):
+        # The quotes are only counted approximately: the lexer may also swallow
+        # them in invalid tokens (e.g. 'Dinner"'), or read a ';' in one instead
+        # of a comment. The recovery of the parser from a syntax error depends
+        # on the tokens which follow, beyond the region. And an error at the end
+        # of the region is reported on the line after it, where it can't be
+        # told apart from those of the next directive.
+        return (in_region(error.source, end_line + 1) and
+                (isinstance(error, (lexer.LexerError, grammar.ParserSyntaxError)) or
+                 error.source['lineno'] == end_line))
+
+    num_open_lines = (parsed_file.num_open_lines -
+                      count_open_lines(old_region) + count_open_lines(region))
+    if (num_open_lines or STATE_RE.search(old_region) or STATE_RE.search(region) or
+            any(is_unsafe(error, old_end_line) for error in parsed_file.errors)):
+        return reparse_all(parsed_file, contents)
+
+    # Parse the region from the state of the parser at its beginning.
+    tags, meta = get_pushed_state(filename, old_contents, region_begin)
+    builder = grammar.Builder(filename)
+    builder.resume(parsed_file.options_map, tags, meta)
+    _parser.parse_string(region, builder, report_filename=filename,
+                         report_firstline=first_line - 1)
+    if any(is_unsafe(error, old_end_line + delta) for error in builder.errors):
+        return reparse_all(parsed_file, contents)
+    new_entries = builder.get_entries()
+
+    # Remove the directives of the old region. The entries are sorted by date,
+    # so only those with the dates which appear in it are looked at.
+    entries = list(parsed_file.entries)
+    removed_indexes = set()
+    for date in get_dates(old_region):
+        for index in range(*find_date_range(entries, date)):
+            if in_region(entries[index].meta):
+                removed_indexes.add(index)
+    removed_entries = [entries[index] for index in sorted(removed_indexes)]
+    for index in sorted(removed_indexes, reverse=True):
+        del entries[index]
+    errors = [error for error in parsed_file.errors if not in_region(error.source)]
+
+    # Insert the new directives, once the others are at their new lines.
+    if delta:
+        shift_lines(entries, errors, filename, old_end_line, delta)
+    for entry in new_entries:
+        entries.insert(find_position(entries, data.entry_sortkey(entry)), entry)
+    errors.extend(builder.errors)
+
+    new_parsed_file = ParsedFile(filename, contents, entries, errors,
+                                 parsed_file.options_map, 0)
+    return new_parsed_file, removed_entries, new_entries
+
+
+def reparse_all(parsed_file, contents):
+    """Parse the new contents of a file entirely, as a fallback of reparse().
+
+    Args:
+      parsed_file: The instance of ParsedFile before the edit.
+      contents: A bytes object, the contents after the edit.
+    Returns:
+      A triple like that returned by reparse().
+    """
+    new_parsed_file = parse_contents(parsed_file.filename, contents)
+    return new_parsed_file, parsed_file.entries, new_parsed_file.entries
+
+
+def count_open_lines(contents):
+    """Count the lines which may leave a string literal open.
+
+    These are the lines with an odd number of quotes, not counting the escaped
+    ones nor those in comments.
+
+    Args:
+      contents: A bytes object.
+    Returns:
+      An integer, the number of such lines.
+    """
+    count = 0
+    for match in QUOTE_LINE_RE.finditer(contents):
+        line = match.group(0).replace(b'\\\\', b'').replace(b'\\"', b'')
+        parts = line.split(b'"')
+        for index in range(0, len(parts), 2):
+            if b';' in parts[index]:
+                del parts[index + 1:]
+                break
+        if len(parts) % 2 == 0:
+            count += 1
+    return count
+
+
+def get_dates(contents):
+    """Get the dates which appear in some contents.
+
+    Args:
+      contents: A bytes object.
+    Returns:
+      A set of datetime.date instances.
+    """
+    dates = set()
+    for match in DATE_RE.finditer(contents):
+        try:
+            dates.add(datetime.date(*map(int, match.groups())))
+        except ValueError:
+            pass
+    return dates
+
+
+def find_date_range(entries, date):
+    """Find the range of the directives of a date in a sorted list.
+
+    Args:
+      entries: A list of directives, sorted by date.
+      date: A datetime.date instance.
+    Returns:
+      A pair of the indexes of the beginning and end of the range.
+    """
+    begin, end = 0, len(entries)
+    while begin < end:
+        middle = (begin + end) // 2
+        if entries[middle].date < date:
+            begin = middle + 1
+        else:
+            end = middle
+    end = begin
+    upper = len(entries)
+    while end < upper:
+        middle = (end + upper) // 2
+        if entries[middle].date <= date:
+            end = middle + 1
+        else:
+            upper = middle
+    return begin, end
+
+
+def find_position(entries, key):
+    """Find where to insert a directive in a sorted list.
+
+    Args:
+      entries: A list of directives, sorted by data.entry_sortkey().
+      key: The sort key of the directive to insert.
+    Returns:
+      The index to insert it at.
+    """
+    begin, end = 0, len(entries)
+    while begin < end:
+        middle = (begin + end) // 2
+        if data.entry_sortkey(entries[middle]) < key:
+            begin = middle + 1
+        else:
+            end = middle
+    return begin
+
+
+def get_pushed_state(filename, contents, end):
+    """Get the tags and metadata pushed at some point of the contents of a file.
+
+    Args:
+      filename: The name of the file the contents are from.
+      contents: A bytes object.
+      end: The offset in the contents.
+    Returns:
+      A pair of the list of pushed tags and the dict of lists of pushed metadata
+      values, by key.
+    """
+    if contents.find(b'push', 0, end) == -1:
+        return [], {}
+    lines = [match.group(0) for match in PUSH_RE.finditer(contents, 0, end)]
+    builder = grammar.Builder(filename)
+    _parser.parse_string(b'\n'.join(lines), builder)
+    return builder.tags, builder.meta
+
+
+def shift_lines(entries, errors, filename, first_line, delta):
+    """Shift the line numbers of the metadata of directives and errors in place.
+
+    Args:
+      entries: A list of directives.
+      errors: A list of errors.
+      filename: The name of the file whose lines are shifted.
+      first_line: The first line number to shift.
+      delta: The number of lines to add to the line numbers.
+    """
+    shifted = set()
+    def shift(meta):
+        if (isinstance(meta, dict) and id(meta) not in shifted and
+                meta.get('filename') == filename and
+                meta.get('lineno', 0) >= first_line):
+            meta['lineno'] += delta
+            shifted.add(id(meta))
+    for entry in entries:
+        shift(entry.meta)
+        if isinstance(entry, data.Transaction):
+            for posting in entry.postings:
+                shift(posting.meta)
+    for error in errors:
+        shift(error.source)
@@ -0,0 +1,214 @@
+__copyright__ = "Copyright (C) 2017  Martin Blais"
+__license__ = "GNU GPLv2"
+
+import random
+import tempfile
+import textwrap
+import unittest
+
+from beancount.core import data
+from beancount.parser import incremental
+
+
+INPUT = textwrap.dedent("""\
+  option "title" "Incremental"
+
+  2014-01-01 open Assets:Cash
+  2014-01-01 open Expenses:Food
+
+  2014-01-02 * "Lunch"
+    Expenses:Food   10.00 USD
+    Assets:Cash
+
+  2014-01-03 * "Dinner" #tag
+    key: "value"
+    Expenses:Food   20.00 USD
+      sub: 2014-01-03
+    Assets:Cash
+
+  pushtag #trip
+  pushmeta location: "Paris"
+
+  2014-01-04 * "Breakfast"
+    Expenses:Food    5.00 USD
+    Assets:Cash
+
+  2014-01-05 balance Assets:Cash  -35.00 USD
+
+  popmeta location:
+  poptag #trip
+""").encode('utf8')
+
+
+class TestReparse(unittest.TestCase):
+
+    def check_edit(self, parsed_file, old, new, count=1):
+        """Replace some text and check that reparsing matches a full parse.
+
+        Args:
+          parsed_file: An instance of ParsedFile.
+          old: A bytes object, the text to replace.
+          new: A bytes object, its replacement.
+          count: The number of occurrence of the text to replace.
+        Returns:
+          The triple returned by reparse().
+        """
+        begin = -1
+        for _ in range(count):
+            begin = parsed_file.contents.index(old, begin + 1)
+        return self.check_reparse(parsed_file, begin, begin + len(old), new)
+
+    def check_reparse(self, parsed_file, begin, end, text):
+        """Reparse an edit and check that it matches a full parse.
+
+        Args:
+          parsed_file: An instance of ParsedFile.
+          begin: The byte offset of the beginning of the replaced range.
+          end: The byte offset of the end of the replaced range.
+          text: A bytes object, the replacement text.
+        Returns:
+          The triple returned by reparse().
+        """
+        result = incremental.reparse(parsed_file, begin, end, text)
+        new_parsed_file = result[0]
+        expected = incremental.parse_contents(parsed_file.filename,
+                                              new_parsed_file.contents)
+        self.assertEqual(expected.entries, new_parsed_file.entries)
+        self.assertEqual(
+            sorted((error.source['lineno'], error.message) for error in expected.errors),
+            sorted((error.source['lineno'], error.message)
+                   for error in new_parsed_file.errors))
+        return result
+
+    def test_edits(self):
+        parsed_file = incremental.parse_contents('/ledger.beancount', INPUT)
+        self.assertEqual(6, len(parsed_file.entries))
+
+        # Change an amount.
+        parsed_file, removed, added = self.check_edit(parsed_file, b'10.00', b'12.00')
+        self.assertEqual(['Lunch'], [entry.narration for entry in removed])
+        self.assertEqual(['Lunch'], [entry.narration for entry in added])
+
+        # Insert lines, shifting the following directives.
+        balance_lineno = parsed_file.entries[-1].meta['lineno']
+        parsed_file, removed, added = self.check_edit(
+            parsed_file, b'  Assets:Cash\n\n2014-01-03',
+            b'  Assets:Cash\n\n2014-01-02 * "Snack"\n  Expenses:Food  1 USD\n'
+            b'  Assets:Cash\n\n2014-01-03')
+        self.assertEqual(['Lunch', 'Snack', 'Dinner'],
+                         [entry.narration for entry in added])
+        self.assertEqual(balance_lineno + 4, parsed_file.entries[-1].meta['lineno'])
+
+        # Break a directive, then fix it.
+        parsed_file, removed, added = self.check_edit(parsed_file, b'Expenses:Food  1',
+                                                      b'Expenses:Food  $$ 1')
+        self.assertTrue(parsed_file.errors)
+        parsed_file, removed, added = self.check_edit(parsed_file, b'  $$ 1', b'  1')
+        self.assertFalse(parsed_file.errors)
+
+        # Remove a date, merging two directives into one.
+        parsed_file, removed, added = self.check_edit(
+            parsed_file, b'2014-01-03 * "Dinner"', b'')
+        self.assertTrue(parsed_file.errors)
+
+        # Edit after pushed tags and metadata.
+        parsed_file, removed, added = self.check_edit(parsed_file, b'5.00', b'6.00')
+        self.assertEqual({'trip'}, added[0].tags)
+        self.assertEqual('Paris', added[0].meta['location'])
+
+        # Edit the last directive.
+        parsed_file, removed, added = self.check_edit(
+            parsed_file, b'-35.00 USD', b'-40.00 USD\n2014-01-06 close Assets:Cash')
+        self.assertEqual([data.Balance, data.Close], list(map(type, added)))
+
+    def test_edit_state_lines(self):
+        parsed_file = incremental.parse_contents('/ledger.beancount', INPUT)
+
+        # Lines changing the state of the parser require parsing everything.
+        parsed_file, removed, added = self.check_edit(parsed_file, b'#trip', b'#travel')
+        self.assertEqual(parsed_file.entries, added)
+        self.assertEqual({'travel'}, parsed_file.entries[-2].tags)
+
+        parsed_file, removed, added = self.check_edit(
+            parsed_file, b'  Assets:Cash\n\n', b'  Assets:Cash\n\npoptag #travel\n', 3)
+        self.assertEqual(parsed_file.entries, added)
+
+    def test_edit_joining_lines(self):
+        parsed_file = incremental.parse_contents('/ledger.beancount', INPUT)
+        self.check_edit(parsed_file, b'Assets:Cash\n\n2014-01-03', b'Assets:Cash\n\n2014')
+        parsed_file = incremental.parse_contents('/ledger.beancount', INPUT)
+        self.check_edit(parsed_file, b'\n2014-01-01 open Expenses', b' 2014-01-01 open Expenses')
+        parsed_file = incremental.parse_contents('/ledger.beancount', INPUT)
+        self.check_edit(parsed_file, b'"title" "Incremental"\n', b'')
+
+    def test_edit_last_line_without_newline(self):
+        parsed_file = incremental.parse_contents(
+            '/ledger.beancount', b'2020-01-01 open Assets:A\n2020-01-02 open Assets:B\n'
+            b'2020-01-03 open Assets:C')
+        parsed_file, removed, added = self.check_edit(parsed_file, b'Assets:C', b'Assets:D')
+        self.assertEqual(['Assets:C'], [entry.account for entry in removed])
+        self.assertEqual(['Assets:D'], [entry.account for entry in added])
+        self.assertEqual(3, added[0].meta['lineno'])
+
+    def test_random_edits(self):
+        # Half-typed edits, which often leave invalid tokens and quotes which
+        # aren't closed. The first line and the final newline are kept, to
+        # leave the first and last tokens of the file valid.
+        contents = textwrap.dedent("""\
+          option "title" "Random"
+          2014-01-01 open Assets:Cash
+          2014-01-01 open Expenses:Food
+
+          2014-01-02 * "Lunch" "Sandwich"
+            Expenses:Food   10.00 USD
+            Assets:Cash
+
+          2014-01-03 * "Dinner" #tag
+            key: "value"
+            Expenses:Food   20.00 USD
+              sub: 2014-01-03
+            Assets:Cash
+
+          pushtag #trip
+
+          2014-01-04 note Assets:Cash "Paid in cash"
+
+          2014-01-05 balance Assets:Cash  -30.00 USD
+
+          poptag #trip
+
+          2014-01-06 * "Breakfast" ; Comment
+            Expenses:Food    5.00 USD
+            Assets:Cash
+        """).encode('utf8')
+        fragments = [b'"', b';', b'un;c', b'Dinner"', b'\\"', b'"Lunch"', b'#', b'{', b'}',
+                     b'\n', b'\n  ', b' ', b'x', b'12.', b'USD', b'Assets:', b'2014-',
+                     b'2014-01-06 * "Tea"\n', b'  Assets:Cash  1 USD\n', b'balance ',
+                     b'note ', b'pushtag']
+        rand = random.Random(0)
+        for _ in range(50):
+            parsed_file = incremental.parse_contents('/ledger.beancount', contents)
+            for _ in range(20):
+                size = len(parsed_file.contents)
+                begin = rand.randrange(parsed_file.contents.index(b'\n') + 1, size)
+                end = min(size - 1, begin + rand.choice([0, 0, 1, 2, 5]))
+                text = b''.join(rand.choice(fragments)
+                                for _ in range(rand.choice([0, 1, 1, 2])))
+                parsed_file, _, __ = self.check_reparse(parsed_file, begin, end, text)
+
+    def test_invalid_range(self):
+        parsed_file = incremental.parse_contents('/ledger.beancount', INPUT)
+        with self.assertRaises(ValueError):
+            incremental.reparse(parsed_file, 10, 5, b'')
+
+    def test_parse_file(self):
+        with tempfile.NamedTemporaryFile('wb') as file:
+            file.write(INPUT)
+            file.flush()
+            parsed_file = incremental.parse_file(file.name)
+        self.assertEqual(INPUT, parsed_file.contents)
+        self.assertEqual(file.name, parsed_file.entries[0].meta['filename'])
+
+
+if __name__ == '__main__':
+    unittest.main()
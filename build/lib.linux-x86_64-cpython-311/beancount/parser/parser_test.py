@@ -0,0 +1,455 @@
+"""
+Tests for parser.
+"""
+__copyright__ = "Copyright (C) 2014-2016  Martin Blais"
+__license__ = "GNU GPLv2"
+
+import unittest
+import tempfile
+import textwrap
+import threading
+import sys
+import subprocess
+
+from pytest import mark
+
+from beancount.core.number import D
+from beancount.core import data
+from beancount.parser import _parser
+from beancount.parser import grammar
+from beancount.parser import parser
+from beancount.utils import test_utils
+
+
+class TestCompareTestFunctions(unittest.TestCase):
+
+    def test_is_entry_incomplete(self):
+        entries, _, __ = parser.parse_string("""
+
+          2014-01-27 * "UNION MARKET"
+            Liabilities:US:Amex:BlueCash    -22.02 USD
+            Expenses:Food:Grocery            22.02 USD
+
+          2014-01-27 * "UNION MARKET"
+            Liabilities:US:Amex:BlueCash    -22.02 USD
+            Expenses:Food:Grocery
+
+        """, dedent=True)
+        self.assertFalse(parser.is_entry_incomplete(entries[0]))
+        self.assertTrue(parser.is_entry_incomplete(entries[1]))
+
+
+class TestParserDoc(unittest.TestCase):
+
+    @parser.parse_doc(expect_errors=None)
+    def test_parse_doc__disabled(self, entries, errors, options_map):
+        """
+        2013-05-40 * "Nice dinner at Mermaid Inn"
+          Expenses:Restaurant         100 USD
+          Assets:US:Cash
+        """
+        self.assertTrue(errors)
+
+    @unittest.skipIf('/bazel/' in __file__, "Skipping test in Bazel")
+    @mark.xfail
+    @parser.parse_doc(expect_errors=False)
+    def test_parse_doc__errors(self, _, __, ___):
+        """
+        2013-05-40 * "Invalid date for parser"
+          Expenses:Restaurant         100 USD
+          Assets:US:Cash             -100 USD
+        """
+
+    @unittest.skipIf('/bazel/' in __file__, "Skipping test in Bazel")
+    @mark.xfail
+    @parser.parse_doc(expect_errors=True)
+    def test_parse_doc__noerrors(self, _, __, ___):
+        """
+        2013-05-01 * "Valid date for parser"
+          Expenses:Restaurant         100 USD
+          Assets:US:Cash             -100 USD
+        """
+
+
+class TestParserInputs(unittest.TestCase):
+    """Try difference sources for the parser's input."""
+
+    INPUT = """
+      2013-05-18 * "Nice dinner at Mermaid Inn"
+        Expenses:Restaurant         100 USD
+        Assets:US:Cash
+    """
+
+    def test_parse_string(self):
+        entries, errors, _ = parser.parse_string(self.INPUT)
+        self.assertEqual(1, len(entries))
+        self.assertEqual(0, len(errors))
+
+    def test_parse_file(self):
+        with tempfile.NamedTemporaryFile('w', suffix='.beancount') as file:
+            file.write(self.INPUT)
+            file.flush()
+            entries, errors, _ = parser.parse_file(file.name)
+            self.assertEqual(1, len(entries))
+            self.assertEqual(0, len(errors))
+
+    @classmethod
+    def parse_stdin(cls):
+        entries, errors, _ = parser.parse_file("-")
+        assert entries, "Empty entries: {}".format(entries)
+        assert not errors, "Errors: {}".format(errors)
+
+    def test_parse_stdin(self):
+        env = test_utils.subprocess_env() if 'bazel' not in __file__ else None
+        code = ('import beancount.parser.parser_test as p; '
+                'p.TestParserInputs.parse_stdin()')
+        pipe = subprocess.Popen([sys.executable, '-c', code, __file__],
+                                env=env,
+                                stdin=subprocess.PIPE)
+        output, errors = pipe.communicate(self.INPUT.encode('utf-8'))
+        self.assertEqual(0, pipe.returncode)
+
+    def test_parse_string_None(self):
+        input_string = report_filename = None
+        with self.assertRaises(TypeError):
+            entries, errors, _ = parser.parse_string(input_string)
+        with self.assertRaises(TypeError):
+            entries, errors, _ = parser.parse_string("something", None, report_filename)
+
+
+class TestParserMappedFile(unittest.TestCase):
+    """Check that scanning a memory-mapped file matches reading it."""
+
+    INPUT = textwrap.dedent("""
+      2013-05-18 * "Nice dinner" "at Mermaid Inn"
+        Expenses:Restaurant         100 USD
+        Assets:US:Cash
+
+      2013-05-19 note Assets:US:Cash "Multi-line
+      note with a \\"quote\\" and
+      a few lines"
+
+      2013-05-20 note Assets:US:Cash "After"
+    """)
+
+    def parse_both(self, contents):
+        with tempfile.NamedTemporaryFile('wb', suffix='.beancount') as file:
+            file.write(contents.encode('utf8'))
+            file.flush()
+            mapped = parser.parse_file(file.name)
+            unmapped = parser.parse_file(file.name, mmap=False)
+        self.assertEqual(unmapped[0], mapped[0])
+        self.assertEqual([error.source['lineno'] for error in unmapped[1]],
+                         [error.source['lineno'] for error in mapped[1]])
+        return mapped
+
+    def test_parse_mapped(self):
+        entries, errors, _ = self.parse_both(self.INPUT)
+        self.assertFalse(errors)
+        self.assertEqual([2, 6, 10], [entry.meta['lineno'] for entry in entries])
+        self.assertEqual(('Nice dinner', 'at Mermaid Inn'),
+                         (entries[0].payee, entries[0].narration))
+        self.assertEqual('Multi-line\nnote with a "quote" and\na few lines',
+                         entries[1].comment)
+
+    def test_parse_mapped_no_final_newline(self):
+        entries, errors, _ = self.parse_both(self.INPUT.rstrip('\n'))
+        self.assertFalse(errors)
+        self.assertEqual('After', entries[-1].comment)
+
+    def test_parse_mapped_page_multiple(self):
+        entry = '2013-05-20 note Assets:US:Cash "Note"\n'
+        padding = 4096 - (len(self.INPUT) + len(entry)) % 4096
+        contents = self.INPUT + ';' * (padding - 1) + '\n' + entry
+        self.assertEqual(0, len(contents) % 4096)
+        entries, errors, _ = self.parse_both(contents)
+        self.assertFalse(errors)
+        self.assertEqual('Note', entries[-1].comment)
+
+    def test_parse_mapped_unterminated_string(self):
+        entries, errors, _ = self.parse_both(self.INPUT + '2013-05-21 note Assets:US:Cash "')
+        self.assertEqual(3, len(entries))
+
+    def test_parse_mapped_empty(self):
+        entries, errors, _ = self.parse_both('')
+        self.assertFalse(entries)
+        self.assertFalse(errors)
+
+
+class TestParserIterFile(unittest.TestCase):
+    """Directives may be streamed out of the parser as they are reduced."""
+
+    INPUT = textwrap.dedent("""
+      option "title" "Streamed"
+
+      2013-05-20 note Assets:US:Cash "Later"
+
+      2013-05-18 * "Nice dinner" "at Mermaid Inn"
+        Expenses:Restaurant         100 USD
+        Assets:US:Cash
+
+      2013-05-19 balance Assets:US:Cash  -100 USD
+      2013-05-19 invalid Assets:US:Cash
+
+      pushtag #trip
+      2013-05-21 close Assets:US:Cash
+    """)
+
+    def setUp(self):
+        self.file = tempfile.NamedTemporaryFile('w', suffix='.beancount')
+        self.file.write(self.INPUT)
+        self.file.flush()
+
+    def tearDown(self):
+        self.file.close()
+
+    def test_iter_parse_file(self):
+        builder = grammar.Builder(self.file.name)
+        streamed = list(parser.iter_parse_file(self.file.name, builder))
+        self.assertEqual([4, 6, 10, 14],
+                         [entry.meta['lineno'] for entry in streamed])
+
+        entries, errors, options_map = parser.parse_file(self.file.name)
+        self.assertEqual(entries, sorted(streamed, key=data.entry_sortkey))
+        no_entries, iter_errors, iter_options_map = builder.finalize()
+        self.assertEqual([], no_entries)
+        self.assertEqual([error.message for error in errors],
+                         [error.message for error in iter_errors])
+        self.assertEqual(2, len(iter_errors))
+        self.assertEqual('Streamed', iter_options_map['title'])
+        self.assertEqual(options_map['title'], iter_options_map['title'])
+
+    def test_iter_parse_file_fastcall(self):
+        self.assertEqual(list(parser.iter_parse_file(self.file.name)),
+                         list(parser.iter_parse_file(self.file.name, fastcall=True)))
+
+    def test_iter_parse_file_incremental(self):
+        class CountingBuilder(grammar.Builder):
+            num_dates = 0
+            def DATE(self, year, month, day):
+                self.num_dates += 1
+                return super().DATE(year, month, day)
+
+        builder = CountingBuilder(self.file.name)
+        iterator = parser.iter_parse_file(self.file.name, builder)
+        entry = next(iterator)
+        self.assertEqual('Later', entry.comment)
+        # The parser has not read past the next directive.
+        self.assertLessEqual(builder.num_dates, 2)
+        iterator.close()
+        self.assertLessEqual(builder.num_dates, 2)
+
+    def test_iter_parse_file_empty(self):
+        with tempfile.NamedTemporaryFile('w', suffix='.beancount') as file:
+            self.assertEqual([], list(parser.iter_parse_file(file.name)))
+
+    def test_iter_parse_file_missing(self):
+        with self.assertRaises(IOError):
+            list(parser.iter_parse_file('/some/file/that/does/not/exist.beancount'))
+
+
+class TestUnicodeErrors(unittest.TestCase):
+
+    test_utf8_string = textwrap.dedent("""
+      2015-05-23 note Assets:Something "a¡¢£¤¥¦§¨©ª«¬®¯°±²³´µ¶·¸¹º»¼ z"
+    """)
+    expected_utf8_string = "a¡¢£¤¥¦§¨©ª«¬®¯°±²³´µ¶·¸¹º»¼ z"
+
+    test_latin1_string = textwrap.dedent("""
+      2015-05-23 note Assets:Something "école Floß søllerød"
+    """)
+    expected_latin1_string = "école Floß søllerød"
+
+    # Test providing utf8 bytes to the lexer.
+    def test_bytes_encoded_utf8(self):
+        utf8_bytes = self.test_utf8_string.encode('utf8')
+        entries, errors, _ = parser.parse_string(utf8_bytes)
+        self.assertEqual(1, len(entries))
+        self.assertFalse(errors)
+        # Check that the lexer correctly parsed the UTF8 string.
+        self.assertEqual(self.expected_utf8_string, entries[0].comment)
+
+    # Test providing latin1 bytes to the lexer when it is expecting utf8.
+    def test_bytes_encoded_incorrect(self):
+        latin1_bytes = self.test_utf8_string.encode('latin1')
+        entries, errors, _ = parser.parse_string(latin1_bytes)
+        self.assertEqual(1, len(entries))
+        self.assertFalse(errors)
+        # Check that the lexer failed to convert the string but did not cause
+        # other errors.
+        self.assertNotEqual(self.expected_utf8_string, entries[0].comment)
+
+    # Test providing latin1 bytes to the lexer with an encoding.
+    def test_bytes_encoded_latin1(self):
+        latin1_bytes = self.test_latin1_string.encode('latin1')
+        entries, errors, _ = parser.parse_string(latin1_bytes, encoding='latin1')
+        self.assertEqual(1, len(entries))
+        self.assertFalse(errors)
+        # Check that the lexer correctly parsed the latin1 string.
+        self.assertEqual(self.expected_latin1_string, entries[0].comment)
+
+    # Test using a garbage invalid encoding.
+    def test_bytes_encoded_invalid(self):
+        latin1_bytes = self.test_latin1_string.encode('latin1')
+        entries, errors, _ = parser.parse_string(latin1_bytes, encoding='garbage')
+        self.assertEqual(1, len(errors))
+        self.assertRegex(errors[0].message, "unknown encoding")
+        self.assertFalse(entries)
+
+
+class TestParserReentrancy(unittest.TestCase):
+    """The parser state is per-invocation and may be nested or run concurrently."""
+
+    OUTER = textwrap.dedent("""
+      2013-05-18 note Assets:US:Cash "Before"
+      include "other.beancount"
+
+      2013-05-20 note Assets:US:Cash "After"
+    """)
+
+    INNER = textwrap.dedent("""
+      2013-01-01 open Assets:US:Bank
+
+
+      2013-01-02 open Assets:US:Other
+    """)
+
+    def test_parse_nested(self):
+        test = self
+
+        class NestedBuilder(grammar.Builder):
+            def include(self, filename, lineno, include_filename):
+                # Run another parser from within a callback of this one.
+                test.inner_result = parser.parse_string(test.INNER, '/inner')
+                self.nested_location = (_parser.get_yyfilename(),
+                                        _parser.get_yylineno())
+                return super().include(filename, lineno, include_filename)
+
+        builder = NestedBuilder('/outer')
+        _parser.parse_string(self.OUTER, builder, report_filename='/outer')
+        entries, errors, _ = builder.finalize()
+        self.assertFalse(errors)
+        self.assertEqual([('/outer', 2), ('/outer', 5)],
+                         [(entry.meta['filename'], entry.meta['lineno'])
+                          for entry in entries])
+        self.assertEqual(('/outer', 4), builder.nested_location)
+
+        inner_entries, inner_errors, _ = self.inner_result
+        self.assertFalse(inner_errors)
+        self.assertEqual([('/inner', 2), ('/inner', 5)],
+                         [(entry.meta['filename'], entry.meta['lineno'])
+                          for entry in inner_entries])
+
+    def test_parse_threads(self):
+        inputs = [textwrap.dedent("""
+          2013-05-{day:02d} * "Payee {index}"
+            Expenses:Restaurant         {index}.00 USD
+            Assets:US:Cash
+        """).format(day=(index % 28) + 1, index=index) * 50
+                  for index in range(8)]
+        expected = [parser.parse_string(string) for string in inputs]
+
+        results = [None] * len(inputs)
+        def parse(index):
+            for _ in range(5):
+                results[index] = parser.parse_string(inputs[index])
+        threads = [threading.Thread(target=parse, args=(index,))
+                   for index in range(len(inputs))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        for (exp_entries, exp_errors, _), (entries, errors, __) in zip(expected, results):
+            self.assertEqual(exp_entries, entries)
+            self.assertEqual(len(exp_errors), len(errors))
+
+    def test_location_outside_parser(self):
+        with self.assertRaises(RuntimeError):
+            _parser.get_yylineno()
+
+
+class TestParserFastCall(unittest.TestCase):
+    """Builder methods may be bound once for the whole parse."""
+
+    INPUT = textwrap.dedent("""
+      2013-05-18 * "Payee" "Narration" #tag ^link
+        key: "value"
+        Expenses:Restaurant         100 USD {200 # 5 USD}
+        Assets:US:Cash             -200 USD @ 1 CAD
+
+      2013-05-19 balance Assets:US:Cash  -100 USD
+      2013-05-20 close Assets:Invalid
+    """)
+
+    def test_fastcall_equivalent(self):
+        entries, errors, _ = parser.parse_string(self.INPUT)
+        fast_entries, fast_errors, _ = parser.parse_string(self.INPUT, fastcall=True)
+        self.assertEqual(entries, fast_entries)
+        self.assertEqual([error.message for error in errors],
+                         [error.message for error in fast_errors])
+
+    def test_fastcall_binds_once(self):
+        class ReplacingBuilder(grammar.Builder):
+            def DATE(self, year, month, day):
+                # Replace a method while parsing.
+                self.balance = lambda *args: None
+                return super().DATE(year, month, day)
+
+        builder = ReplacingBuilder('<string>')
+        _parser.parse_string(self.INPUT, builder, fastcall=True)
+        entries, _, __ = builder.finalize()
+        self.assertEqual(3, len(entries))
+
+        builder = ReplacingBuilder('<string>')
+        _parser.parse_string(self.INPUT, builder)
+        entries, _, __ = builder.finalize()
+        self.assertEqual(2, len(entries))
+
+    def test_fastcall_missing_method(self):
+        class MissingBuilder(grammar.Builder):
+            def __getattribute__(self, name):
+                if name == 'balance':
+                    raise AttributeError(name)
+                return super().__getattribute__(name)
+
+        builder = MissingBuilder('<string>')
+        _parser.parse_string(self.INPUT, builder, fastcall=True)
+        entries, errors, _ = builder.finalize()
+        self.assertEqual(2, len(entries))
+        self.assertTrue(any("balance" in error.message for error in errors))
+
+
+class TestTestUtils(unittest.TestCase):
+
+    def test_parse_many(self):
+        with self.assertRaises(AssertionError):
+            entries = parser.parse_many("""
+              2014-12-15 * 2014-12-15
+            """)
+
+        number = D('101.23')
+        entries = parser.parse_many("""
+          2014-12-15 * "Payee" "Narration"
+            Assets:Checking   {number} USD
+            Equity:Blah
+        """)
+        self.assertEqual(1, len(entries))
+        self.assertEqual(number, entries[0].postings[0].units.number)
+
+    def test_parse_one(self):
+        with self.assertRaises(AssertionError):
+            parser.parse_one("""
+              2014-12-15 * 2014-12-15
+            """)
+
+        entry = parser.parse_one("""
+          2014-12-15 * "Payee" "Narration"
+            Assets:Checking   101.23 USD
+            Equity:Blah
+        """)
+        self.assertTrue(isinstance(entry, data.Transaction))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,63 @@
+"""A compact binary format to save and restore loaded ledgers.
+
+This is used like pickle, but the format is specialized for the directives,
+errors and options produced by the loader. Strings, dates and numbers are stored
+once and shared when restored, and named tuples are created without calling
+their constructors, which makes restoring a ledger much faster than unpickling
+it. Other objects are pickled. See _snapshot.c for the details of the format.
+"""
+__copyright__ = "Copyright (C) 2017  Martin Blais"
+__license__ = "GNU GPLv2"
+
+from beancount.utils import _snapshot
+from beancount.utils import misc_utils
+
+
+def dumps(obj):
+    """Return a snapshot of an object.
+
+    Args:
+      obj: The object to save, e.g., an (entries, errors, options_map) triple.
+    Returns:
+      A bytes object.
+    Raises:
+      ValueError: If the object contains recursive references.
+    """
+    return _snapshot.dumps(obj)
+
+
+def loads(data):
+    """Restore an object from a snapshot.
+
+    Args:
+      data: A bytes-like object, as returned by dumps().
+    Returns:
+      The restored object.
+    Raises:
+      ValueError: If the data is not a valid snapshot, or if the types of the
+        named tuples it contains have changed.
+    """
+    # Don't let the garbage collector scan the new objects over and over.
+    with misc_utils.gc_disabled():
+        return _snapshot.loads(data)
+
+
+def dump(obj, file):
+    """Write a snapshot of an object to a file.
+
+    Args:
+      obj: The object to save.
+      file: A file object opened in binary mode.
+    """
+    file.write(dumps(obj))
+
+
+def load(file):
+    """Restore an object from a snapshot read from a file.
+
+    Args:
+      file: A file object opened in binary mode.
+    Returns:
+      The restored object.
+    """
+    return loads(file.read())
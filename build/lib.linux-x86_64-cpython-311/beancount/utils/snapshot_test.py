@@ -0,0 +1,162 @@
+__copyright__ = "Copyright (C) 2017  Martin Blais"
+__license__ = "GNU GPLv2"
+
+import collections
+import datetime
+import io
+import pickle
+import unittest
+
+from beancount.core.number import D
+from beancount.core import data
+from beancount.core import display_context
+from beancount.utils import defdict
+from beancount.utils import snapshot
+from beancount import loader
+
+
+Point = collections.namedtuple('Point', 'x y')
+
+
+class Unsupported:
+    """A class which can only be pickled."""
+
+    def __init__(self, value):
+        self.value = value
+
+    def __reduce__(self):
+        return 'UNSUPPORTED'
+
+UNSUPPORTED = Unsupported(42)
+
+
+class TestSnapshot(unittest.TestCase):
+
+    def roundtrip(self, obj):
+        restored = snapshot.loads(snapshot.dumps(obj))
+        self.assertEqual(obj, restored)
+        return restored
+
+    def test_scalars(self):
+        for obj in [None, True, False, 0, -1, 2**63 - 1, -2**63, 2**100, 1.5,
+                    '', 'Assets:Cash', 'café', b'\x00\xff',
+                    D('0'), D('-12.3400'), D('1E+3'), D('-Infinity'),
+                    datetime.date(2014, 1, 2), datetime.date(1, 1, 1),
+                    datetime.datetime(2014, 1, 2, 3, 4, 5)]:
+            self.assertEqual(type(obj), type(self.roundtrip(obj)))
+
+        # Equal numbers of different precision remain distinct.
+        numbers = self.roundtrip([D('1.0'), D('1.00'), D('1.0')])
+        self.assertEqual(['1.0', '1.00', '1.0'], list(map(str, numbers)))
+
+    def test_containers(self):
+        self.roundtrip(((), (1, ('a', 'b')), [], [1, [2]], {}, {'a': {'b': 1}},
+                        set(), {1, 2}, frozenset(), frozenset({'a'})))
+
+    def test_shared(self):
+        string = 'Assets:Cash'.join(['', ''])
+        date = datetime.date(2014, 1, 2)
+        number = D('1.00')
+        items = [1, 2]
+        restored = self.roundtrip([string, date, number, items,
+                                   string, date, number, items])
+        for index in range(4):
+            self.assertIs(restored[index], restored[index + 4])
+
+    def test_shared_with_large_ints(self):
+        items = [1]
+        mapping = {'x': 2}
+        restored = self.roundtrip([2**70, items, mapping, -2**70, items, mapping, 2**70])
+        self.assertEqual([2**70, [1], {'x': 2}, -2**70, [1], {'x': 2}, 2**70], restored)
+        self.assertIs(restored[1], restored[4])
+        self.assertIs(restored[2], restored[5])
+
+    def test_named_tuples(self):
+        meta = data.new_metadata('/tmp/file.beancount', 1)
+        entry = data.Open(meta, datetime.date(2014, 1, 2), 'Assets:Cash', ['USD'],
+                          data.Booking.FIFO)
+        restored = self.roundtrip([Point(1, 2), entry, data.Amount(D('1'), 'USD')])
+        self.assertIs(Point, type(restored[0]))
+        self.assertIs(data.Open, type(restored[1]))
+        self.assertIs(data.Booking.FIFO, restored[1].booking)
+
+    def test_reduce(self):
+        tolerances = defdict.ImmutableDictWithDefault({'USD': D('0.005')},
+                                                      default=D('0'))
+        restored = self.roundtrip(tolerances)
+        self.assertIs(defdict.ImmutableDictWithDefault, type(restored))
+        self.assertEqual(D('0'), restored['CAD'])
+
+        dcontext = display_context.DisplayContext()
+        dcontext.update(D('1.234'), 'USD')
+        restored = snapshot.loads(snapshot.dumps(dcontext))
+        self.assertEqual(str(dcontext), str(restored))
+
+        restored = snapshot.loads(snapshot.dumps([UNSUPPORTED, print]))
+        self.assertEqual([UNSUPPORTED, print], restored)
+
+    def test_recursive(self):
+        items = []
+        items.append(items)
+        with self.assertRaises(ValueError):
+            snapshot.dumps(items)
+
+    def test_invalid(self):
+        data_ = snapshot.dumps([1, 'a', (2, 3)])
+        for invalid in [b'', b'garbage', data_[:-1], data_ + b'N',
+                        pickle.dumps([1, 'a', (2, 3)])]:
+            with self.assertRaises(ValueError):
+                snapshot.loads(invalid)
+
+    def test_changed_named_tuple(self):
+        global Point  # pylint: disable=global-statement
+        data_ = snapshot.dumps(Point(1, 2))
+        original = Point
+        try:
+            Point = collections.namedtuple('Point', 'x y z')
+            with self.assertRaises(ValueError):
+                snapshot.loads(data_)
+        finally:
+            Point = original
+
+    def test_file(self):
+        file = io.BytesIO()
+        snapshot.dump([1, 2], file)
+        file.seek(0)
+        self.assertEqual([1, 2], snapshot.load(file))
+
+    @loader.load_doc(expect_errors=True)
+    def test_ledger(self, entries, errors, options_map):
+        """
+          option "operating_currency" "USD"
+
+          2014-01-01 open Assets:Cash
+          2014-01-01 open Assets:Invest  "FIFO"
+          2014-01-01 open Income:Salary
+
+          2014-02-01 * "Salary" #work ^pay-1
+            Assets:Cash      1000.00 USD
+            Income:Salary
+
+          2014-02-02 * "Buy"
+            Assets:Invest    10 HOOL {50.00 USD}
+            Assets:Cash
+
+          2014-03-01 balance Assets:Cash  400.00 USD
+        """
+        self.assertEqual(1, len(errors))
+        restored_entries, restored_errors, restored_options_map = snapshot.loads(
+            snapshot.dumps((entries, errors, options_map)))
+        self.assertEqual(entries, restored_entries)
+        self.assertEqual(errors, restored_errors)
+        self.assertIs(errors[0].source, errors[0].entry.meta)
+        self.assertIs(restored_errors[0].source, restored_errors[0].entry.meta)
+        self.assertEqual(set(options_map), set(restored_options_map))
+        self.assertEqual(options_map['operating_currency'],
+                         restored_options_map['operating_currency'])
+        self.assertEqual(str(options_map['dcontext']),
+                         str(restored_options_map['dcontext']))
+
+
+if __name__ == '__main__':
+    unittest.main()
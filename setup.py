@@ -274,6 +274,18 @@ setup(
                       ('VC_TIMESTAMP', int(float(vc_timestamp))),
                       ('PARSER_SOURCE_HASH', hash_parser_source_files())],
                   extra_compile_args=get_cflags()),
+
+        Extension("beancount.utils._snapshot",
+                  sources=[
+                      "beancount/utils/_snapshot.c",
+                  ],
+                  extra_compile_args=get_cflags()),
+
+        Extension("beancount.core._inventory",
+                  sources=[
+                      "beancount/core/_inventory.c",
+                  ],
+                  extra_compile_args=get_cflags()),
     ],
 
     # Include the Emacs support for completeness, for packagers not to have to